@@ -0,0 +1,131 @@
+#!/usr/bin/python
+#
+# bench-getrawtransaction.py: measure getrawtransaction throughput with
+# several concurrent RPC clients.
+#
+# Distributed under the MIT/X11 software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+#
+
+from __future__ import print_function
+import base64
+import json
+import random
+import re
+import sys
+import threading
+import time
+
+try:
+	import httplib
+except ImportError:
+	import http.client as httplib
+
+settings = {}
+
+class BitcoinRPC:
+	def __init__(self, host, port, username, password):
+		authpair = "%s:%s" % (username, password)
+		self.authhdr = "Basic %s" % (base64.b64encode(authpair.encode('utf-8')).decode('ascii'))
+		self.conn = httplib.HTTPConnection(host, port, timeout=30)
+
+	def execute(self, method, params):
+		obj = { 'version' : '1.1', 'method' : method, 'params' : params, 'id' : 0 }
+		self.conn.request('POST', '/', json.dumps(obj),
+			{ 'Authorization' : self.authhdr,
+			  'Content-type' : 'application/json' })
+		resp = self.conn.getresponse()
+		resp_obj = json.loads(resp.read().decode('utf-8'))
+		if resp_obj.get('error') is not None:
+			raise RuntimeError("%s: %s" % (method, resp_obj['error']))
+		return resp_obj['result']
+
+def new_rpc():
+	return BitcoinRPC(settings['host'], settings['port'],
+			  settings['rpcuser'], settings['rpcpassword'])
+
+def collect_txids(rpc):
+	"""Gather txids from the most recent blocks of the active chain."""
+	txids = []
+	height = rpc.execute('getblockcount', [])
+	while height > 0 and len(txids) < settings['txids']:
+		block = rpc.execute('getblock', [rpc.execute('getblockhash', [height])])
+		txids.extend(block['tx'])
+		height -= 1
+	return txids[:settings['txids']]
+
+def client(txids, deadline, results, idx):
+	rpc = new_rpc()
+	count = 0
+	latencies = []
+	while time.time() < deadline:
+		txid = random.choice(txids)
+		start = time.time()
+		rpc.execute('getrawtransaction', [txid, 1])
+		latencies.append(time.time() - start)
+		count += 1
+	results[idx] = (count, latencies)
+
+def run(txids, clients):
+	results = [None] * clients
+	deadline = time.time() + settings['duration']
+	threads = [threading.Thread(target=client, args=(txids, deadline, results, i)) for i in range(clients)]
+	for t in threads:
+		t.start()
+	for t in threads:
+		t.join()
+
+	total = sum(r[0] for r in results)
+	latencies = sorted(l for r in results for l in r[1])
+	if not latencies:
+		return
+	p50 = latencies[len(latencies) // 2] * 1000
+	p99 = latencies[min(len(latencies) - 1, len(latencies) * 99 // 100)] * 1000
+	print("clients=%d calls=%d calls/s=%.1f p50=%.2fms p99=%.2fms" %
+		(clients, total, total / float(settings['duration']), p50, p99))
+
+if __name__ == '__main__':
+	if len(sys.argv) != 2:
+		print("Usage: bench-getrawtransaction.py CONFIG-FILE")
+		sys.exit(1)
+
+	f = open(sys.argv[1])
+	for line in f:
+		# skip comment lines
+		m = re.search('^\s*#', line)
+		if m:
+			continue
+
+		# parse key=value lines
+		m = re.search('^(\w+)\s*=\s*(\S.*)$', line)
+		if m is None:
+			continue
+		settings[m.group(1)] = m.group(2)
+	f.close()
+
+	if 'host' not in settings:
+		settings['host'] = '127.0.0.1'
+	if 'port' not in settings:
+		settings['port'] = 39999
+	if 'clients' not in settings:
+		settings['clients'] = '1,4,16'
+	if 'duration' not in settings:
+		settings['duration'] = 10
+	if 'txids' not in settings:
+		settings['txids'] = 2000
+	if 'rpcuser' not in settings or 'rpcpassword' not in settings:
+		print("Missing username and/or password in cfg file", file=sys.stderr)
+		sys.exit(1)
+
+	settings['port'] = int(settings['port'])
+	settings['duration'] = int(settings['duration'])
+	settings['txids'] = int(settings['txids'])
+
+	txids = collect_txids(new_rpc())
+	if not txids:
+		print("No transactions found", file=sys.stderr)
+		sys.exit(1)
+	print("Using %d txids from recent blocks, %ds per run" % (len(txids), settings['duration']))
+
+	for clients in [int(c) for c in settings['clients'].split(',')]:
+		run(txids, clients)
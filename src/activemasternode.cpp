@@ -184,6 +184,7 @@ bool CActiveMasternode::SendMasternodePing(std::string& errorMessage)
         }
 
         pmn->lastPing = mnp;
+        mnodeman.SetChanged(pmn->vin);
         mnodeman.mapSeenMasternodePing.insert(make_pair(mnp.GetHash(), mnp));
 
         //mnodeman.mapSeenMasternodeBroadcast.lastPing is probably outdated, so we'll update it
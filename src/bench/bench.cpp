@@ -0,0 +1,95 @@
+// Copyright (c) 2015 The Bitcoin Core developers
+// Copyright (c) 2019 The TRBO developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "utiltime.h"
+
+#include <univalue.h>
+
+#include <limits>
+
+static double GetTimeDouble()
+{
+    return GetTimeMicros() * 0.000001;
+}
+
+benchmark::BenchRunner::BenchmarkMap& benchmark::BenchRunner::Benchmarks()
+{
+    // Function local so that registration from other translation units does
+    // not depend on static initialization order
+    static BenchmarkMap benchmarks;
+    return benchmarks;
+}
+
+benchmark::BenchRunner::BenchRunner(const std::string& name, benchmark::BenchFunction func)
+{
+    Benchmarks().insert(std::make_pair(name, func));
+}
+
+UniValue benchmark::BenchRunner::RunAll(const std::string& strFilter, double elapsedTimeForOne)
+{
+    UniValue results(UniValue::VARR);
+    for (BenchmarkMap::iterator it = Benchmarks().begin(); it != Benchmarks().end(); ++it) {
+        if (it->first.find(strFilter) == std::string::npos)
+            continue;
+        State state(it->first, elapsedTimeForOne);
+        it->second(state);
+        results.push_back(state.ToJSON());
+    }
+    return results;
+}
+
+benchmark::State::State(const std::string& nameIn, double maxElapsedIn)
+    : name(nameIn), maxElapsed(maxElapsedIn), beginTime(0), lastTime(0), count(0), timeCheckCount(1)
+{
+    minTime = std::numeric_limits<double>::max();
+    maxTime = std::numeric_limits<double>::min();
+}
+
+bool benchmark::State::KeepRunning()
+{
+    double now;
+    if (count == 0) {
+        beginTime = now = GetTimeDouble();
+    } else {
+        // Only read the clock every timeCheckCount iterations, so that very
+        // short loop bodies are not dominated by the cost of timing them
+        if ((count + 1) % timeCheckCount != 0) {
+            ++count;
+            return true;
+        }
+        now = GetTimeDouble();
+        double elapsedOne = (now - lastTime) / timeCheckCount;
+        if (elapsedOne < minTime)
+            minTime = elapsedOne;
+        if (elapsedOne > maxTime)
+            maxTime = elapsedOne;
+        if (elapsedOne * timeCheckCount < maxElapsed / 16)
+            timeCheckCount *= 2;
+    }
+    lastTime = now;
+    ++count;
+
+    if (now - beginTime < maxElapsed)
+        return true;
+
+    --count;
+    return false;
+}
+
+UniValue benchmark::State::ToJSON() const
+{
+    UniValue result(UniValue::VOBJ);
+    result.push_back(Pair("name", name));
+    result.push_back(Pair("iterations", count));
+    if (count > 0) {
+        result.push_back(Pair("total", lastTime - beginTime));
+        result.push_back(Pair("min", minTime));
+        result.push_back(Pair("average", (lastTime - beginTime) / count));
+        result.push_back(Pair("max", maxTime));
+    }
+    return result;
+}
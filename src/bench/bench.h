@@ -0,0 +1,82 @@
+// Copyright (c) 2015 The Bitcoin Core developers
+// Copyright (c) 2019 The TRBO developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BENCH_BENCH_H
+#define BITCOIN_BENCH_BENCH_H
+
+#include <map>
+#include <string>
+
+#include <boost/function.hpp>
+#include <boost/preprocessor/cat.hpp>
+#include <boost/preprocessor/stringize.hpp>
+
+#include <stdint.h>
+
+class UniValue;
+
+/*
+ * A minimal benchmarking framework, after the subset of Google Benchmark
+ * that Bitcoin Core's bench_bitcoin uses. Usage:
+
+static void CODE_TO_TIME(benchmark::State& state)
+{
+    ... do any setup needed ...
+    while (state.KeepRunning()) {
+       ... do stuff you want to time ...
+    }
+    ... do any cleanup needed ...
+}
+
+BENCHMARK(CODE_TO_TIME);
+
+ * Each benchmark runs its loop for about -maxtime seconds. bench_trbo
+ * reports the results as JSON, so they can be compared between releases.
+ */
+
+namespace benchmark
+{
+/** Timing state of one running benchmark */
+class State
+{
+private:
+    std::string name;
+    double maxElapsed;
+    double beginTime;
+    double lastTime, minTime, maxTime;
+    int64_t count;
+    int64_t timeCheckCount;
+
+public:
+    State(const std::string& nameIn, double maxElapsedIn);
+
+    /** Whether to run the loop body (again). Time is measured from the first call. */
+    bool KeepRunning();
+
+    /** Timings in seconds per iteration, once KeepRunning returned false */
+    UniValue ToJSON() const;
+};
+
+typedef boost::function<void(State&)> BenchFunction;
+
+class BenchRunner
+{
+private:
+    typedef std::map<std::string, BenchFunction> BenchmarkMap;
+    static BenchmarkMap& Benchmarks();
+
+public:
+    BenchRunner(const std::string& name, BenchFunction func);
+
+    /** Run the benchmarks whose name contains strFilter, and return their results */
+    static UniValue RunAll(const std::string& strFilter, double elapsedTimeForOne);
+};
+}
+
+// BENCHMARK(foo) expands to:  benchmark::BenchRunner bench_11foo("foo", foo);
+#define BENCHMARK(n) \
+    benchmark::BenchRunner BOOST_PP_CAT(bench_, BOOST_PP_CAT(__LINE__, n))(BOOST_PP_STRINGIZE(n), n);
+
+#endif // BITCOIN_BENCH_BENCH_H
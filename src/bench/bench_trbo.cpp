@@ -0,0 +1,72 @@
+// Copyright (c) 2015 The Bitcoin Core developers
+// Copyright (c) 2019 The TRBO developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "chainsetup.h"
+
+#include "clientversion.h"
+#include "main.h"
+#include "ui_interface.h" // for _(...)
+#include "util.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <univalue.h>
+
+int main(int argc, char* argv[])
+{
+    ParseParameters(argc, argv);
+
+    if (mapArgs.count("-?") || mapArgs.count("-h") || mapArgs.count("-help")) {
+        std::string strUsage = _("TRBO bench_trbo utility version") + " " + FormatFullVersion() + "\n\n" +
+                               _("Usage:") + "\n" +
+                               "  bench_trbo [options]  " + _("Run the benchmarks and print their timings as JSON") + "\n";
+
+        strUsage += HelpMessageGroup(_("Options:"));
+        strUsage += HelpMessageOpt("-?", _("This help message"));
+        strUsage += HelpMessageOpt("-filter=<name>", _("Only run the benchmarks whose name contains <name>"));
+        strUsage += HelpMessageOpt("-maxtime=<n>", strprintf(_("Run each benchmark for about <n> seconds (default: %s)"), "1.0"));
+        strUsage += HelpMessageOpt("-output=<file>", _("Write the results to <file> instead of stdout"));
+        strUsage += HelpMessageOpt("-par=<n>", strprintf(_("Number of script verification threads used by block validation and mempool acceptance (default: %u)"), 1));
+
+        fprintf(stdout, "%s", strUsage.c_str());
+        return EXIT_SUCCESS;
+    }
+
+    SetupEnvironment();
+    fPrintToDebugLog = false; // don't want to write to debug.log file
+
+    double dMaxTime = atof(GetArg("-maxtime", "1.0").c_str());
+    UniValue result(UniValue::VOBJ);
+    try {
+        benchmark::ChainSetup chainSetup;
+        benchmark::pchainSetup = &chainSetup;
+
+        result.push_back(Pair("version", FormatFullVersion()));
+        result.push_back(Pair("maxtime", dMaxTime));
+        result.push_back(Pair("par", nScriptCheckThreads));
+        result.push_back(Pair("benchmarks", benchmark::BenchRunner::RunAll(GetArg("-filter", ""), dMaxTime)));
+
+        benchmark::pchainSetup = NULL;
+    } catch (const std::exception& e) {
+        fprintf(stderr, "Error: %s\n", e.what());
+        return EXIT_FAILURE;
+    }
+
+    std::string strResult = result.write(4) + "\n";
+    if (mapArgs.count("-output")) {
+        FILE* file = fopen(mapArgs["-output"].c_str(), "w");
+        if (!file) {
+            fprintf(stderr, "Error: cannot open %s for writing\n", mapArgs["-output"].c_str());
+            return EXIT_FAILURE;
+        }
+        fputs(strResult.c_str(), file);
+        fclose(file);
+    } else {
+        fputs(strResult.c_str(), stdout);
+    }
+    return EXIT_SUCCESS;
+}
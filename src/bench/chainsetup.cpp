@@ -0,0 +1,155 @@
+// Copyright (c) 2019 The TRBO developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "chainsetup.h"
+
+#include "chainparams.h"
+#include "consensus/validation.h"
+#include "main.h"
+#include "miner.h"
+#include "noui.h"
+#include "pow.h"
+#include "random.h"
+#include "script/sign.h"
+#include "script/standard.h"
+#include "txdb.h"
+#include "txmempool.h"
+#include "util.h"
+#include "utiltime.h"
+#ifdef ENABLE_WALLET
+#include "wallet/db.h"
+#endif
+
+#include <stdexcept>
+
+#include <boost/filesystem.hpp>
+#include <boost/scoped_ptr.hpp>
+
+benchmark::ChainSetup* benchmark::pchainSetup = NULL;
+
+benchmark::ChainSetup::ChainSetup() : nNextFanOut(0)
+{
+    SelectParams(CBaseChainParams::REGTEST);
+    noui_connect();
+#ifdef ENABLE_WALLET
+    bitdb.MakeMock();
+#endif
+    pathTemp = GetTempPath() / strprintf("bench_trbo_%lu_%i", (unsigned long)GetTime(), (int)(GetRand(100000)));
+    boost::filesystem::create_directories(pathTemp);
+    mapArgs["-datadir"] = pathTemp.string();
+    pblocktree = new CBlockTreeDB(1 << 20, true);
+    pcoinsdbview = new CCoinsViewDB(1 << 23, true);
+    pcoinsTip = new CCoinsViewCache(pcoinsdbview);
+    InitBlockIndex();
+
+    nScriptCheckThreads = GetArg("-par", 1);
+    for (int i = 0; i < nScriptCheckThreads - 1; i++)
+        threadGroup.create_thread(&ThreadScriptCheck);
+
+    coinbaseKey.MakeNewKey(true);
+    keystore.AddKey(coinbaseKey);
+    scriptPubKey = GetScriptForDestination(coinbaseKey.GetPubKey().GetID());
+
+    for (int i = 1; i < CHAIN_LENGTH; i++)
+        vCoinbase.push_back(MineBlock().vtx[0]);
+
+    // Split the oldest coinbases into outputs for FillMempool
+    for (int i = 0; i < FANOUT_TXS; i++) {
+        const CTransaction& txFrom = vCoinbase[i];
+        CMutableTransaction tx;
+        tx.vin.push_back(CTxIn(txFrom.GetHash(), 0));
+        CAmount nValue = (txFrom.vout[0].nValue - COIN) / FANOUT_OUTPUTS;
+        for (int j = 0; j < FANOUT_OUTPUTS; j++)
+            tx.vout.push_back(CTxOut(nValue, scriptPubKey));
+        if (!SignSignature(keystore, txFrom, tx, 0, SIGHASH_ALL))
+            throw std::runtime_error(strprintf("%s: failed to sign fan-out transaction", __func__));
+        vFanOut.push_back(tx);
+        mempool.addUnchecked(tx.GetHash(), CTxMemPoolEntry(tx, txFrom.vout[0].nValue - nValue * FANOUT_OUTPUTS, GetTime(), 0, chainActive.Height()));
+    }
+    vCoinbase.push_back(MineBlock().vtx[0]);
+    if (mempool.size() != 0)
+        throw std::runtime_error(strprintf("%s: fan-out transactions were not mined", __func__));
+}
+
+benchmark::ChainSetup::~ChainSetup()
+{
+    threadGroup.interrupt_all();
+    threadGroup.join_all();
+    mempool.clear();
+    delete pcoinsTip;
+    pcoinsTip = NULL;
+    delete pcoinsdbview;
+    pcoinsdbview = NULL;
+    delete pblocktree;
+    pblocktree = NULL;
+#ifdef ENABLE_WALLET
+    bitdb.Flush(true);
+#endif
+    boost::filesystem::remove_all(pathTemp);
+}
+
+CBlock benchmark::ChainSetup::MineBlock()
+{
+    boost::scoped_ptr<CBlockTemplate> pblocktemplate(CreateNewBlock(scriptPubKey, NULL, false));
+    if (!pblocktemplate)
+        throw std::runtime_error(strprintf("%s: CreateNewBlock failed", __func__));
+    CBlock block = pblocktemplate->block;
+    {
+        LOCK(cs_main);
+        CBlockIndex* pindexPrev = chainActive.Tip();
+        block.nTime = pindexPrev->nTime + BLOCK_SPACING;
+        block.nBits = GetNextWorkRequired(pindexPrev, &block);
+        unsigned int nExtraNonce = 0;
+        IncrementExtraNonce(&block, pindexPrev, nExtraNonce);
+    }
+    while (!CheckProofOfWork(block.GetHash(), block.nBits))
+        ++block.nNonce;
+
+    CValidationState state;
+    if (!ProcessNewBlock(state, NULL, &block) || !state.IsValid())
+        throw std::runtime_error(strprintf("%s: block rejected: %s", __func__, state.GetRejectReason()));
+    return block;
+}
+
+void benchmark::ChainSetup::FillMempool(unsigned int nTx)
+{
+    LOCK(cs_main);
+    if (nNextFanOut + nTx > vFanOut.size() * FANOUT_OUTPUTS)
+        throw std::runtime_error(strprintf("%s: only %u fan-out outputs left", __func__, vFanOut.size() * FANOUT_OUTPUTS - nNextFanOut));
+
+    for (unsigned int i = 0; i < nTx; i++, nNextFanOut++) {
+        const CTransaction& txFrom = vFanOut[nNextFanOut / FANOUT_OUTPUTS];
+        unsigned int nOut = nNextFanOut % FANOUT_OUTPUTS;
+        CMutableTransaction tx;
+        tx.vin.push_back(CTxIn(txFrom.GetHash(), nOut));
+        tx.vout.push_back(CTxOut(txFrom.vout[nOut].nValue - COIN / 1000, scriptPubKey));
+        if (!SignSignature(keystore, txFrom, tx, 0, SIGHASH_ALL))
+            throw std::runtime_error(strprintf("%s: failed to sign transaction", __func__));
+        mempool.addUnchecked(tx.GetHash(), CTxMemPoolEntry(tx, COIN / 1000, GetTime(), 0, chainActive.Height()));
+    }
+}
+
+CTransaction benchmark::ChainSetup::CreateConsolidation(unsigned int nInputs)
+{
+    LOCK(cs_main);
+    if (nNextFanOut + nInputs > vFanOut.size() * FANOUT_OUTPUTS)
+        throw std::runtime_error(strprintf("%s: only %u fan-out outputs left", __func__, vFanOut.size() * FANOUT_OUTPUTS - nNextFanOut));
+
+    CMutableTransaction tx;
+    CAmount nValueIn = 0;
+    std::vector<const CTransaction*> vTxFrom;
+    for (unsigned int i = 0; i < nInputs; i++, nNextFanOut++) {
+        const CTransaction& txFrom = vFanOut[nNextFanOut / FANOUT_OUTPUTS];
+        unsigned int nOut = nNextFanOut % FANOUT_OUTPUTS;
+        tx.vin.push_back(CTxIn(txFrom.GetHash(), nOut));
+        nValueIn += txFrom.vout[nOut].nValue;
+        vTxFrom.push_back(&txFrom);
+    }
+    tx.vout.push_back(CTxOut(nValueIn - COIN / 100, scriptPubKey));
+    for (unsigned int i = 0; i < nInputs; i++) {
+        if (!SignSignature(keystore, *vTxFrom[i], tx, i, SIGHASH_ALL))
+            throw std::runtime_error(strprintf("%s: failed to sign input %u", __func__, i));
+    }
+    return tx;
+}
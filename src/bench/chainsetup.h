@@ -0,0 +1,71 @@
+// Copyright (c) 2019 The TRBO developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BENCH_CHAINSETUP_H
+#define BITCOIN_BENCH_CHAINSETUP_H
+
+#include "key.h"
+#include "keystore.h"
+#include "primitives/block.h"
+#include "primitives/transaction.h"
+#include "script/script.h"
+
+#include <vector>
+
+#include <boost/filesystem/path.hpp>
+#include <boost/thread.hpp>
+
+namespace benchmark
+{
+/**
+ * Node state for the benchmarks that need a chain: regtest parameters, a
+ * temporary data directory with in-memory block tree and coin databases,
+ * and a chain mined at startup with one block every BLOCK_SPACING seconds,
+ * so that stake modifiers and difficulty behave as on a live network.
+ * Every coinbase pays to coinbaseKey. The last block fans some of them out
+ * into small outputs that FillMempool spends.
+ */
+class ChainSetup
+{
+private:
+    boost::filesystem::path pathTemp;
+    boost::thread_group threadGroup;
+
+    /** Spendable outputs created by the fan-out block, and the next one to use */
+    std::vector<CTransaction> vFanOut;
+    unsigned int nNextFanOut;
+
+    ChainSetup(const ChainSetup&);
+    void operator=(const ChainSetup&);
+
+public:
+    static const int CHAIN_LENGTH = 200;
+    static const int64_t BLOCK_SPACING = 60;
+    static const int FANOUT_TXS = 100;
+    static const int FANOUT_OUTPUTS = 50;
+
+    CKey coinbaseKey;
+    CBasicKeyStore keystore;
+    CScript scriptPubKey;
+    //! Coinbase transaction of each block, from height 1
+    std::vector<CTransaction> vCoinbase;
+
+    ChainSetup();
+    ~ChainSetup();
+
+    /** Mine a block on the tip with the mempool's transactions and connect it */
+    CBlock MineBlock();
+
+    /** Sign transactions spending unused fan-out outputs and put them in the mempool */
+    void FillMempool(unsigned int nTx);
+
+    /** Sign a transaction merging nInputs unused fan-out outputs into one, without submitting it */
+    CTransaction CreateConsolidation(unsigned int nInputs);
+};
+
+/** Set up by bench_trbo before running the benchmarks */
+extern ChainSetup* pchainSetup;
+}
+
+#endif // BITCOIN_BENCH_CHAINSETUP_H
@@ -0,0 +1,79 @@
+// Copyright (c) 2019 The TRBO developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "coins.h"
+#include "primitives/transaction.h"
+#include "random.h"
+#include "uint256.h"
+#include "script/script.h"
+#include "txdb.h"
+
+#include <assert.h>
+#include <vector>
+
+/* Coins fetched or written per iteration */
+static const int COINS_PER_ITERATION = 1000;
+
+/** The n-th of a series of distinct transactions with two pay-to-pubkey-hash outputs */
+static CTransaction CreateCoinTransaction(uint32_t n)
+{
+    static const std::vector<unsigned char> vchKeyID(20, 0x42);
+    CMutableTransaction tx;
+    tx.vin.push_back(CTxIn(uint256(), 0));
+    for (int i = 0; i < 2; i++)
+        tx.vout.push_back(CTxOut(COIN, CScript() << OP_DUP << OP_HASH160 << vchKeyID << OP_EQUALVERIFY << OP_CHECKSIG));
+    tx.nLockTime = n;
+    return tx;
+}
+
+static void AddCoins(CCoinsViewCache& cache, uint32_t& nNext, int nCoins, std::vector<uint256>* pvTxid)
+{
+    for (int i = 0; i < nCoins; i++) {
+        CTransaction tx = CreateCoinTransaction(nNext++);
+        *cache.ModifyCoins(tx.GetHash()) = CCoins(tx, 1);
+        if (pvTxid)
+            pvTxid->push_back(tx.GetHash());
+    }
+}
+
+/** Look up coins that are in the database but not in the cache */
+static void CoinsViewCacheFetch(benchmark::State& state)
+{
+    CCoinsViewDB db(1 << 23, true, true);
+    std::vector<uint256> vTxid;
+    uint32_t nTx = 0;
+    {
+        CCoinsViewCache cache(&db);
+        AddCoins(cache, nTx, 10 * COINS_PER_ITERATION, &vTxid);
+        cache.SetBestBlock(GetRandHash());
+        cache.Flush();
+    }
+
+    unsigned int nNext = 0;
+    while (state.KeepRunning()) {
+        CCoinsViewCache cache(&db);
+        for (int i = 0; i < COINS_PER_ITERATION; i++) {
+            const CCoins* coins = cache.AccessCoins(vTxid[nNext++ % vTxid.size()]);
+            assert(coins);
+        }
+    }
+}
+
+/** Write new coins from a cache to the database */
+static void CoinsViewCacheFlush(benchmark::State& state)
+{
+    CCoinsViewDB db(1 << 23, true, true);
+    uint32_t nTx = 0;
+    while (state.KeepRunning()) {
+        CCoinsViewCache cache(&db);
+        AddCoins(cache, nTx, COINS_PER_ITERATION, NULL);
+        cache.SetBestBlock(GetRandHash());
+        cache.Flush();
+    }
+}
+
+BENCHMARK(CoinsViewCacheFetch);
+BENCHMARK(CoinsViewCacheFlush);
@@ -0,0 +1,53 @@
+// Copyright (c) 2019 The TRBO developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "chainsetup.h"
+
+#include "coins.h"
+#include "consensus/validation.h"
+#include "main.h"
+#include "miner.h"
+#include "txmempool.h"
+
+#include <assert.h>
+
+#include <boost/scoped_ptr.hpp>
+
+/* Transactions in the connected block besides the coinbase */
+static const unsigned int BLOCK_TXS = 1000;
+
+/**
+ * Connect a block of pay-to-pubkey-hash spends on top of the tip, into a
+ * throwaway coins cache, as TestBlockValidity does. The transactions went
+ * through the mempool, so their signatures are in the signature cache, as
+ * they are for most blocks a synced node receives; ECDSAVerify measures
+ * the verification the cache saves.
+ */
+static void ConnectBlockMempool(benchmark::State& state)
+{
+    benchmark::ChainSetup& chainSetup = *benchmark::pchainSetup;
+    chainSetup.FillMempool(BLOCK_TXS);
+    CBlock block;
+    {
+        boost::scoped_ptr<CBlockTemplate> pblocktemplate(CreateNewBlock(chainSetup.scriptPubKey, NULL, false));
+        assert(pblocktemplate);
+        block = pblocktemplate->block;
+    }
+    mempool.clear();
+
+    LOCK(cs_main);
+    CBlockIndex* pindexPrev = chainActive.Tip();
+    while (state.KeepRunning()) {
+        CCoinsViewCache view(pcoinsTip);
+        CBlockIndex indexDummy(block);
+        indexDummy.pprev = pindexPrev;
+        indexDummy.nHeight = pindexPrev->nHeight + 1;
+        CValidationState stateConnect;
+        bool fConnected = ConnectBlock(block, stateConnect, &indexDummy, view, true);
+        assert(fConnected);
+    }
+}
+
+BENCHMARK(ConnectBlockMempool);
@@ -0,0 +1,54 @@
+// Copyright (c) 2016 The Bitcoin Core developers
+// Copyright (c) 2019 The TRBO developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "crypto/sha256.h"
+#include "hash.h"
+#include "primitives/block.h"
+#include "random.h"
+#include "uint256.h"
+
+#include <vector>
+
+/* Number of bytes to hash per iteration */
+static const uint64_t BUFFER_SIZE = 1000 * 1000;
+
+static void SHA256_1MB(benchmark::State& state)
+{
+    uint8_t hash[CSHA256::OUTPUT_SIZE];
+    std::vector<uint8_t> in(BUFFER_SIZE, 0);
+    while (state.KeepRunning())
+        CSHA256().Write(begin_ptr(in), in.size()).Finalize(hash);
+}
+
+/** Double SHA-256 of a 64 byte input, as in merkle tree and txid hashing */
+static void SHA256D_64b(benchmark::State& state)
+{
+    std::vector<uint8_t> in(64, 0);
+    while (state.KeepRunning()) {
+        uint256 hash = Hash(in.begin(), in.end());
+        in[0] = hash.begin()[0];
+    }
+}
+
+/** Proof-of-work hash of one block header */
+static void HashQuarkHeader(benchmark::State& state)
+{
+    CBlockHeader header;
+    header.nVersion = CBlockHeader::CURRENT_VERSION;
+    header.hashPrevBlock = GetRandHash();
+    header.hashMerkleRoot = GetRandHash();
+    header.nTime = 1524873600;
+    header.nBits = 0x207fffff;
+    while (state.KeepRunning()) {
+        header.GetHash();
+        header.nNonce++;
+    }
+}
+
+BENCHMARK(SHA256_1MB);
+BENCHMARK(SHA256D_64b);
+BENCHMARK(HashQuarkHeader);
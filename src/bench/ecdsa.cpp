@@ -0,0 +1,78 @@
+// Copyright (c) 2019 The TRBO developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "hash.h"
+#include "key.h"
+#include "pubkey.h"
+#include "random.h"
+#include "uint256.h"
+
+#include <assert.h>
+#include <vector>
+
+/* Distinct keys and messages to cycle through, so no single input is measured */
+static const int NUM_KEYS = 100;
+
+struct SignedMessage {
+    CPubKey pubkey;
+    uint256 hash;
+    std::vector<unsigned char> vchSig;
+    std::vector<unsigned char> vchCompactSig;
+};
+
+static std::vector<SignedMessage> CreateSignedMessages()
+{
+    std::vector<SignedMessage> vMessages(NUM_KEYS);
+    for (int i = 0; i < NUM_KEYS; i++) {
+        CKey key;
+        key.MakeNewKey(true);
+        vMessages[i].pubkey = key.GetPubKey();
+        vMessages[i].hash = GetRandHash();
+        bool fSigned = key.Sign(vMessages[i].hash, vMessages[i].vchSig) &&
+                       key.SignCompact(vMessages[i].hash, vMessages[i].vchCompactSig);
+        assert(fSigned);
+    }
+    return vMessages;
+}
+
+static void ECDSASign(benchmark::State& state)
+{
+    CKey key;
+    key.MakeNewKey(true);
+    uint256 hash = GetRandHash();
+    std::vector<unsigned char> vchSig;
+    while (state.KeepRunning()) {
+        key.Sign(hash, vchSig);
+        hash = Hash(vchSig.begin(), vchSig.end());
+    }
+}
+
+static void ECDSAVerify(benchmark::State& state)
+{
+    std::vector<SignedMessage> vMessages = CreateSignedMessages();
+    int i = 0;
+    while (state.KeepRunning()) {
+        const SignedMessage& msg = vMessages[i++ % NUM_KEYS];
+        bool fValid = msg.pubkey.Verify(msg.hash, msg.vchSig);
+        assert(fValid);
+    }
+}
+
+static void ECDSARecoverCompact(benchmark::State& state)
+{
+    std::vector<SignedMessage> vMessages = CreateSignedMessages();
+    int i = 0;
+    while (state.KeepRunning()) {
+        const SignedMessage& msg = vMessages[i++ % NUM_KEYS];
+        CPubKey pubkey;
+        bool fValid = pubkey.RecoverCompact(msg.hash, msg.vchCompactSig);
+        assert(fValid);
+    }
+}
+
+BENCHMARK(ECDSASign);
+BENCHMARK(ECDSAVerify);
+BENCHMARK(ECDSARecoverCompact);
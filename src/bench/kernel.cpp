@@ -0,0 +1,48 @@
+// Copyright (c) 2019 The TRBO developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "chainsetup.h"
+
+#include "kernel.h"
+#include "main.h"
+
+/* Hashes tried per sweep, as the staker does for each of its coins */
+static const unsigned int HASH_DRIFT = 60;
+
+/* A target no sweep will hit, so every sweep runs to the end */
+static const unsigned int KERNEL_BITS = 0x1a00ffff;
+
+static void StakeKernel(benchmark::State& state, bool fCheck)
+{
+    LOCK(cs_main);
+    // Old enough for a stake modifier to have been selected after it
+    const CBlockIndex* pindexFrom = chainActive[benchmark::ChainSetup::CHAIN_LENGTH / 4];
+    const CTransaction& txPrev = benchmark::pchainSetup->vCoinbase[pindexFrom->nHeight - 1];
+    COutPoint prevout(txPrev.GetHash(), 0);
+    unsigned int nTimeStart = pindexFrom->nTime + nStakeMinAge;
+
+    uint256 hashProofOfStake;
+    unsigned int i = 0;
+    while (state.KeepRunning()) {
+        unsigned int nTimeTx = nTimeStart + i++;
+        CheckStakeKernelHash(KERNEL_BITS, pindexFrom->GetBlockHash(), pindexFrom->nTime, txPrev.vout[0].nValue, prevout,
+            nTimeTx, HASH_DRIFT, fCheck, hashProofOfStake);
+    }
+}
+
+/** Validating the kernel of a received block */
+static void StakeKernelCheck(benchmark::State& state)
+{
+    StakeKernel(state, true);
+}
+
+/** Searching for a kernel when staking, HASH_DRIFT timestamps at a time */
+static void StakeKernelSweep(benchmark::State& state)
+{
+    StakeKernel(state, false);
+}
+
+BENCHMARK(StakeKernelCheck);
+BENCHMARK(StakeKernelSweep);
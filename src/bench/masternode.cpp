@@ -0,0 +1,84 @@
+// Copyright (c) 2019 The TRBO developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "chainsetup.h"
+
+#include "main.h"
+#include "masternode.h"
+#include "masternodeman.h"
+#include "random.h"
+#include "timedata.h"
+#include "version.h"
+
+#include <assert.h>
+#include <vector>
+
+/**
+ * Fill mnodeman with nCount enabled masternodes. They are marked as unit
+ * test nodes, so Check does not look their collateral up, and are old
+ * enough in every respect to be eligible for payment.
+ */
+static std::vector<CTxIn> AddMasternodes(int nCount)
+{
+    mnodeman.Clear();
+    std::vector<CTxIn> vVin;
+    int64_t nNow = GetAdjustedTime();
+    for (int i = 0; i < nCount; i++) {
+        CMasternode mn;
+        mn.vin = CTxIn(GetRandHash(), 0);
+        mn.protocolVersion = PROTOCOL_VERSION;
+        mn.sigTime = nNow - nCount * 3 * 60;
+        mn.lastPing.vin = mn.vin;
+        mn.lastPing.sigTime = nNow - 60;
+        mn.unitTest = true;
+        mn.activeState = CMasternode::MASTERNODE_ENABLED;
+        mn.cacheInputAge = nCount + 1;
+        mn.cacheInputAgeBlock = chainActive.Height();
+        bool fAdded = mnodeman.Add(mn);
+        assert(fAdded);
+        vVin.push_back(mn.vin);
+    }
+    return vVin;
+}
+
+static void MasternodeRank(benchmark::State& state, int nCount)
+{
+    LOCK(cs_main);
+    std::vector<CTxIn> vVin = AddMasternodes(nCount);
+    int nHeight = chainActive.Height();
+    int i = 0;
+    while (state.KeepRunning()) {
+        int nRank = mnodeman.GetMasternodeRank(vVin[i++ % nCount], nHeight, ActiveProtocol());
+        assert(nRank > 0);
+    }
+    mnodeman.Clear();
+}
+
+static void MasternodePayee(benchmark::State& state, int nCount)
+{
+    LOCK(cs_main);
+    AddMasternodes(nCount);
+    int nHeight = chainActive.Height() + 1;
+    while (state.KeepRunning()) {
+        int nEligible = 0;
+        CMasternode* pmn = mnodeman.GetNextMasternodeInQueueForPayment(nHeight, true, nEligible);
+        assert(pmn);
+    }
+    mnodeman.Clear();
+}
+
+static void MasternodeRank1k(benchmark::State& state) { MasternodeRank(state, 1000); }
+static void MasternodeRank5k(benchmark::State& state) { MasternodeRank(state, 5000); }
+static void MasternodeRank10k(benchmark::State& state) { MasternodeRank(state, 10000); }
+static void MasternodePayee1k(benchmark::State& state) { MasternodePayee(state, 1000); }
+static void MasternodePayee5k(benchmark::State& state) { MasternodePayee(state, 5000); }
+static void MasternodePayee10k(benchmark::State& state) { MasternodePayee(state, 10000); }
+
+BENCHMARK(MasternodeRank1k);
+BENCHMARK(MasternodeRank5k);
+BENCHMARK(MasternodeRank10k);
+BENCHMARK(MasternodePayee1k);
+BENCHMARK(MasternodePayee5k);
+BENCHMARK(MasternodePayee10k);
@@ -0,0 +1,44 @@
+// Copyright (c) 2019 The TRBO developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "chainsetup.h"
+
+#include "consensus/validation.h"
+#include "main.h"
+#include "txmempool.h"
+#include "util.h"
+
+#include <assert.h>
+#include <map>
+#include <string>
+
+/* Inputs of the relayed transaction, about what AutoCombineDust merges at once */
+static const unsigned int CONSOLIDATION_INPUTS = 100;
+
+/**
+ * Accept a relayed transaction merging many small outputs to the mempool.
+ * Its signatures are kept out of the signature cache, so every iteration
+ * verifies all of them, on the script check threads when -par is above 1.
+ */
+static void MempoolAcceptConsolidation(benchmark::State& state)
+{
+    benchmark::ChainSetup& chainSetup = *benchmark::pchainSetup;
+    CTransaction tx = chainSetup.CreateConsolidation(CONSOLIDATION_INPUTS);
+
+    std::map<std::string, std::string> mapArgsSaved = mapArgs;
+    mapArgs["-maxsigcachesize"] = "0";
+    {
+        LOCK(cs_main);
+        while (state.KeepRunning()) {
+            CValidationState stateAccept;
+            bool fAccepted = AcceptToMemoryPool(mempool, stateAccept, tx, false, NULL, false);
+            assert(fAccepted);
+            mempool.clear();
+        }
+    }
+    mapArgs = mapArgsSaved;
+}
+
+BENCHMARK(MempoolAcceptConsolidation);
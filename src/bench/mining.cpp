@@ -0,0 +1,31 @@
+// Copyright (c) 2019 The TRBO developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "chainsetup.h"
+
+#include "main.h"
+#include "miner.h"
+#include "txmempool.h"
+
+#include <assert.h>
+
+#include <boost/scoped_ptr.hpp>
+
+/* Transactions in the mempool CreateNewBlock picks from */
+static const unsigned int MEMPOOL_TXS = 1000;
+
+/** Assemble and validate a block template from a mempool of pay-to-pubkey-hash spends */
+static void CreateNewBlockMempool(benchmark::State& state)
+{
+    benchmark::ChainSetup& chainSetup = *benchmark::pchainSetup;
+    chainSetup.FillMempool(MEMPOOL_TXS);
+    while (state.KeepRunning()) {
+        boost::scoped_ptr<CBlockTemplate> pblocktemplate(CreateNewBlock(chainSetup.scriptPubKey, NULL, false));
+        assert(pblocktemplate && pblocktemplate->block.vtx.size() > 1);
+    }
+    mempool.clear();
+}
+
+BENCHMARK(CreateNewBlockMempool);
@@ -0,0 +1,97 @@
+// Copyright (c) 2019 The TRBO developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "primitives/block.h"
+#include "primitives/transaction.h"
+#include "random.h"
+#include "streams.h"
+#include "version.h"
+
+#include <assert.h>
+#include <vector>
+
+/* Transactions in the serialized block, about 225 bytes each */
+static const int BLOCK_TXS = 1000;
+
+/** A spend of one pay-to-pubkey-hash output into two, with signature and key sized junk */
+static CTransaction CreateTransaction()
+{
+    CMutableTransaction tx;
+    tx.vin.push_back(CTxIn(GetRandHash(), 0));
+    std::vector<unsigned char> vchSig(72), vchPubKey(33), vchKeyID(20);
+    GetRandBytes(&vchSig[0], vchSig.size());
+    GetRandBytes(&vchPubKey[0], vchPubKey.size());
+    GetRandBytes(&vchKeyID[0], vchKeyID.size());
+    tx.vin[0].scriptSig = CScript() << vchSig << vchPubKey;
+    for (int i = 0; i < 2; i++)
+        tx.vout.push_back(CTxOut(GetRand(100 * COIN), CScript() << OP_DUP << OP_HASH160 << vchKeyID << OP_EQUALVERIFY << OP_CHECKSIG));
+    return tx;
+}
+
+static CBlock CreateBlock()
+{
+    CBlock block;
+    block.hashPrevBlock = GetRandHash();
+    block.nTime = 1524873600;
+    block.nBits = 0x207fffff;
+    for (int i = 0; i < BLOCK_TXS; i++)
+        block.vtx.push_back(CreateTransaction());
+    block.hashMerkleRoot = block.BuildMerkleTree();
+    return block;
+}
+
+static void SerializeBlock(benchmark::State& state)
+{
+    CBlock block = CreateBlock();
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    while (state.KeepRunning()) {
+        stream << block;
+        stream.clear();
+    }
+}
+
+static void DeserializeBlock(benchmark::State& state)
+{
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    stream << CreateBlock();
+    size_t nSize = stream.size();
+    stream << (unsigned char)0; // reading to the end would clear the buffer and prevent rewinding
+    while (state.KeepRunning()) {
+        CBlock block;
+        stream >> block;
+        bool fRewound = stream.Rewind(nSize);
+        assert(fRewound);
+    }
+}
+
+static void SerializeTx(benchmark::State& state)
+{
+    CTransaction tx = CreateTransaction();
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    while (state.KeepRunning()) {
+        stream << tx;
+        stream.clear();
+    }
+}
+
+static void DeserializeTx(benchmark::State& state)
+{
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    stream << CreateTransaction();
+    size_t nSize = stream.size();
+    stream << (unsigned char)0; // reading to the end would clear the buffer and prevent rewinding
+    while (state.KeepRunning()) {
+        CTransaction tx;
+        stream >> tx;
+        bool fRewound = stream.Rewind(nSize);
+        assert(fRewound);
+    }
+}
+
+BENCHMARK(SerializeBlock);
+BENCHMARK(DeserializeBlock);
+BENCHMARK(SerializeTx);
+BENCHMARK(DeserializeTx);
@@ -0,0 +1,69 @@
+// Copyright (c) 2019 The TRBO developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "chainsetup.h"
+
+#include "main.h"
+#include "util.h"
+#include "wallet/wallet.h"
+
+#include <assert.h>
+#include <map>
+#include <string>
+#include <vector>
+
+/* Keys written per keypool refill */
+static const int KEYPOOL_SIZE = 100;
+
+/** Replace the keypool of an HD wallet, writing all keys as one database transaction */
+static void WalletKeypoolRefill(benchmark::State& state)
+{
+    CWallet wallet("wallet_keypool.dat");
+    bool fFirstRun;
+    wallet.LoadWallet(fFirstRun);
+    {
+        LOCK(wallet.cs_wallet);
+        wallet.SetMinVersion(FEATURE_LATEST);
+        wallet.GenerateNewHDChain(std::vector<std::string>());
+    }
+
+    std::map<std::string, std::string> mapArgsSaved = mapArgs;
+    mapArgs["-keypool"] = itostr(KEYPOOL_SIZE);
+    while (state.KeepRunning()) {
+        bool fRefilled = wallet.NewKeyPool();
+        assert(fRefilled);
+    }
+    mapArgs = mapArgsSaved;
+}
+
+/** Rescan the whole chain for a wallet holding the key all coinbases pay to */
+static void WalletRescan(benchmark::State& state)
+{
+    const benchmark::ChainSetup& chainSetup = *benchmark::pchainSetup;
+    CWallet wallet("wallet_rescan.dat");
+    bool fFirstRun;
+    wallet.LoadWallet(fFirstRun);
+    {
+        LOCK(wallet.cs_wallet);
+        CPubKey pubkey = chainSetup.coinbaseKey.GetPubKey();
+        wallet.mapKeyMetadata[pubkey.GetID()].nCreateTime = 1;
+        bool fAdded = wallet.AddKeyPubKey(chainSetup.coinbaseKey, pubkey);
+        assert(fAdded);
+        wallet.nTimeFirstKey = 1; // 0 would be considered 'no value'
+    }
+
+    CBlockIndex* pindexGenesis;
+    {
+        LOCK(cs_main);
+        pindexGenesis = chainActive.Genesis();
+    }
+    while (state.KeepRunning()) {
+        int nFound = wallet.ScanForWalletTransactions(pindexGenesis, true);
+        assert(nFound > 0);
+    }
+}
+
+BENCHMARK(WalletKeypoolRefill);
+BENCHMARK(WalletRescan);
@@ -0,0 +1,302 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockfilter.h"
+
+#include "crypto/common.h"
+#include "hash.h"
+#include "main.h"
+#include "primitives/block.h"
+#include "script/script.h"
+#include "streams.h"
+#include "undo.h"
+
+#include <algorithm>
+#include <map>
+
+#include <boost/foreach.hpp>
+
+/// SerType used to serialize parameters in GCS filter encoding.
+static const int GCS_SER_TYPE = SER_NETWORK;
+
+/// Protocol version used to serialize parameters in GCS filter encoding.
+static const int GCS_SER_VERSION = 0;
+
+static const std::string strBasicFilterName = "basic";
+static const std::string strEmptyName;
+
+template <typename OStream>
+static void GolombRiceEncode(BitStreamWriter<OStream>& bitwriter, uint8_t P, uint64_t x)
+{
+    // Write quotient as unary-encoded: q 1's followed by one 0.
+    uint64_t q = x >> P;
+    while (q > 0) {
+        int nbits = q <= 64 ? static_cast<int>(q) : 64;
+        bitwriter.Write(~0ULL, nbits);
+        q -= nbits;
+    }
+    bitwriter.Write(0, 1);
+
+    // Write the remainder in P bits. Since the remainder is just the bottom
+    // P bits of x, there is no need to mask first.
+    bitwriter.Write(x, P);
+}
+
+template <typename IStream>
+static uint64_t GolombRiceDecode(BitStreamReader<IStream>& bitreader, uint8_t P)
+{
+    // Read unary-encoded quotient: q 1's followed by one 0.
+    uint64_t q = 0;
+    while (bitreader.Read(1) == 1) {
+        ++q;
+    }
+
+    uint64_t r = bitreader.Read(P);
+
+    return (q << P) + r;
+}
+
+// Map a value x that is uniformly distributed in the range [0, 2^64) to a
+// value uniformly distributed in [0, n) by returning the upper 64 bits of
+// x * n.
+//
+// See: https://lemire.me/blog/2016/06/27/a-fast-alternative-to-the-modulo-reduction/
+static uint64_t MapIntoRange(uint64_t x, uint64_t n)
+{
+#ifdef __SIZEOF_INT128__
+    return (static_cast<unsigned __int128>(x) * static_cast<unsigned __int128>(n)) >> 64;
+#else
+    // To perform the calculation on 64-bit numbers without losing the
+    // result to overflow, split the numbers into the most significant and
+    // least significant 32 bits and perform multiplication piece-wise.
+    //
+    // See: https://stackoverflow.com/a/26855440
+    uint64_t x_hi = x >> 32;
+    uint64_t x_lo = x & 0xFFFFFFFF;
+    uint64_t n_hi = n >> 32;
+    uint64_t n_lo = n & 0xFFFFFFFF;
+
+    uint64_t ac = x_hi * n_hi;
+    uint64_t ad = x_hi * n_lo;
+    uint64_t bc = x_lo * n_hi;
+    uint64_t bd = x_lo * n_lo;
+
+    uint64_t mid34 = (bd >> 32) + (bc & 0xFFFFFFFF) + (ad & 0xFFFFFFFF);
+    uint64_t upper64 = ac + (bc >> 32) + (ad >> 32) + (mid34 >> 32);
+    return upper64;
+#endif
+}
+
+uint64_t CGCSFilter::HashToRange(const Element& element) const
+{
+    uint64_t hash = CSipHasher(params.nSipHashK0, params.nSipHashK1)
+                        .Write(element.empty() ? NULL : &element[0], element.size())
+                        .Finalize();
+    return MapIntoRange(hash, nF);
+}
+
+std::vector<uint64_t> CGCSFilter::BuildHashedSet(const ElementSet& elements) const
+{
+    std::vector<uint64_t> vHashed;
+    vHashed.reserve(elements.size());
+    BOOST_FOREACH (const Element& element, elements) {
+        vHashed.push_back(HashToRange(element));
+    }
+    std::sort(vHashed.begin(), vHashed.end());
+    return vHashed;
+}
+
+CGCSFilter::CGCSFilter(const Params& paramsIn)
+    : params(paramsIn), nN(0), nF(0)
+{
+    CDataStream stream(GCS_SER_TYPE, GCS_SER_VERSION);
+    WriteCompactSize(stream, nN);
+    vEncoded.assign(stream.begin(), stream.end());
+}
+
+CGCSFilter::CGCSFilter(const Params& paramsIn, const std::vector<unsigned char>& vEncodedIn)
+    : params(paramsIn), vEncoded(vEncodedIn)
+{
+    CDataStream stream(vEncoded, GCS_SER_TYPE, GCS_SER_VERSION);
+
+    uint64_t N = ReadCompactSize(stream);
+    nN = static_cast<uint32_t>(N);
+    if (nN != N)
+        throw std::ios_base::failure("N must be <2^32");
+    nF = static_cast<uint64_t>(nN) * static_cast<uint64_t>(params.nM);
+
+    // Verify that the encoded filter contains exactly N elements. If it has too much or too little
+    // data, a std::ios_base::failure exception will be raised.
+    BitStreamReader<CDataStream> bitreader(stream);
+    for (uint64_t i = 0; i < nN; ++i) {
+        GolombRiceDecode(bitreader, params.nP);
+    }
+    if (!stream.empty())
+        throw std::ios_base::failure("encoded_filter contains excess data");
+}
+
+CGCSFilter::CGCSFilter(const Params& paramsIn, const ElementSet& elements)
+    : params(paramsIn)
+{
+    size_t N = elements.size();
+    nN = static_cast<uint32_t>(N);
+    if (nN != N)
+        throw std::invalid_argument("N must be <2^32");
+    nF = static_cast<uint64_t>(nN) * static_cast<uint64_t>(params.nM);
+
+    CDataStream stream(GCS_SER_TYPE, GCS_SER_VERSION);
+    WriteCompactSize(stream, nN);
+
+    if (!elements.empty()) {
+        BitStreamWriter<CDataStream> bitwriter(stream);
+
+        uint64_t last_value = 0;
+        BOOST_FOREACH (uint64_t value, BuildHashedSet(elements)) {
+            uint64_t delta = value - last_value;
+            GolombRiceEncode(bitwriter, params.nP, delta);
+            last_value = value;
+        }
+
+        bitwriter.Flush();
+    }
+
+    vEncoded.assign(stream.begin(), stream.end());
+}
+
+bool CGCSFilter::MatchInternal(const uint64_t* pElementHashes, size_t nSize) const
+{
+    CDataStream stream(vEncoded, GCS_SER_TYPE, GCS_SER_VERSION);
+
+    // Seek forward by size of N
+    uint64_t N = ReadCompactSize(stream);
+    assert(N == nN);
+
+    BitStreamReader<CDataStream> bitreader(stream);
+
+    uint64_t value = 0;
+    size_t hashes_index = 0;
+    for (uint32_t i = 0; i < nN; ++i) {
+        uint64_t delta = GolombRiceDecode(bitreader, params.nP);
+        value += delta;
+
+        while (true) {
+            if (hashes_index == nSize) {
+                return false;
+            } else if (pElementHashes[hashes_index] == value) {
+                return true;
+            } else if (pElementHashes[hashes_index] > value) {
+                break;
+            }
+
+            hashes_index++;
+        }
+    }
+
+    return false;
+}
+
+bool CGCSFilter::Match(const Element& element) const
+{
+    uint64_t query = HashToRange(element);
+    return MatchInternal(&query, 1);
+}
+
+bool CGCSFilter::MatchAny(const ElementSet& elements) const
+{
+    const std::vector<uint64_t> queries = BuildHashedSet(elements);
+    if (queries.empty())
+        return false;
+    return MatchInternal(&queries[0], queries.size());
+}
+
+const std::string& BlockFilterTypeName(BlockFilterType filterType)
+{
+    switch (filterType) {
+    case BLOCK_FILTER_BASIC:
+        return strBasicFilterName;
+    default:
+        return strEmptyName;
+    }
+}
+
+bool BlockFilterTypeByName(const std::string& name, BlockFilterType& filterType)
+{
+    if (name == strBasicFilterName) {
+        filterType = BLOCK_FILTER_BASIC;
+        return true;
+    }
+    return false;
+}
+
+static void AddScriptElement(CGCSFilter::ElementSet& elements, const CScript& script)
+{
+    if (script.empty() || script[0] == OP_RETURN)
+        return;
+    elements.insert(CGCSFilter::Element(script.begin(), script.end()));
+}
+
+// The basic filter holds every output script the block creates and every
+// output script it spends, the latter taken from the block's undo data.
+static CGCSFilter::ElementSet BasicFilterElements(const CBlock& block, const CBlockUndo& blockundo)
+{
+    CGCSFilter::ElementSet elements;
+
+    BOOST_FOREACH (const CTransaction& tx, block.vtx) {
+        BOOST_FOREACH (const CTxOut& txout, tx.vout) {
+            AddScriptElement(elements, txout.scriptPubKey);
+        }
+    }
+
+    BOOST_FOREACH (const CTxUndo& txundo, blockundo.vtxundo) {
+        BOOST_FOREACH (const CTxInUndo& txinundo, txundo.vprevout) {
+            AddScriptElement(elements, txinundo.txout.scriptPubKey);
+        }
+    }
+
+    return elements;
+}
+
+CBlockFilter::CBlockFilter(BlockFilterType filterTypeIn, const uint256& hashBlockIn, const std::vector<unsigned char>& vEncodedIn)
+    : filterType(filterTypeIn), hashBlock(hashBlockIn)
+{
+    CGCSFilter::Params paramsNew;
+    if (!BuildParams(paramsNew))
+        throw std::invalid_argument("unknown filter_type");
+    filter = CGCSFilter(paramsNew, vEncodedIn);
+}
+
+CBlockFilter::CBlockFilter(BlockFilterType filterTypeIn, const CBlock& block, const CBlockUndo& blockundo)
+    : filterType(filterTypeIn), hashBlock(block.GetHash())
+{
+    CGCSFilter::Params paramsNew;
+    if (!BuildParams(paramsNew))
+        throw std::invalid_argument("unknown filter_type");
+    filter = CGCSFilter(paramsNew, BasicFilterElements(block, blockundo));
+}
+
+bool CBlockFilter::BuildParams(CGCSFilter::Params& paramsOut) const
+{
+    switch (filterType) {
+    case BLOCK_FILTER_BASIC:
+        paramsOut.nSipHashK0 = ReadLE64(hashBlock.begin());
+        paramsOut.nSipHashK1 = ReadLE64(hashBlock.begin() + 8);
+        paramsOut.nP = BASIC_FILTER_P;
+        paramsOut.nM = BASIC_FILTER_M;
+        return true;
+    default:
+        return false;
+    }
+}
+
+uint256 CBlockFilter::GetHash() const
+{
+    const std::vector<unsigned char>& vData = GetEncodedFilter();
+    return Hash(vData.begin(), vData.end());
+}
+
+uint256 CBlockFilter::ComputeHeader(const uint256& prevHeader) const
+{
+    const uint256 filterHash = GetHash();
+    return Hash(filterHash.begin(), filterHash.end(), prevHeader.begin(), prevHeader.end());
+}
@@ -0,0 +1,163 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BLOCKFILTER_H
+#define BITCOIN_BLOCKFILTER_H
+
+#include "serialize.h"
+#include "uint256.h"
+
+#include <ios>
+#include <set>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+class CBlock;
+class CBlockUndo;
+
+/**
+ * This implements a Golomb-coded set as defined in BIP 158. It is a
+ * compact, probabilistic data structure for testing set membership.
+ */
+class CGCSFilter
+{
+public:
+    typedef std::vector<unsigned char> Element;
+    typedef std::set<Element> ElementSet;
+
+    struct Params {
+        uint64_t nSipHashK0;
+        uint64_t nSipHashK1;
+        uint8_t nP; //!< Golomb-Rice coding parameter
+        uint32_t nM; //!< Inverse false positive rate
+
+        Params(uint64_t nSipHashK0In = 0, uint64_t nSipHashK1In = 0, uint8_t nPIn = 0, uint32_t nMIn = 1)
+            : nSipHashK0(nSipHashK0In), nSipHashK1(nSipHashK1In), nP(nPIn), nM(nMIn)
+        {
+        }
+    };
+
+private:
+    Params params;
+    uint32_t nN; //!< Number of elements in the filter
+    uint64_t nF; //!< Range of element hashes, F = N * M
+    std::vector<unsigned char> vEncoded;
+
+    /** Hash a data element to an integer in the range [0, N * M). */
+    uint64_t HashToRange(const Element& element) const;
+
+    std::vector<uint64_t> BuildHashedSet(const ElementSet& elements) const;
+
+    /** Helper method used to implement Match and MatchAny */
+    bool MatchInternal(const uint64_t* pElementHashes, size_t nSize) const;
+
+public:
+    /** Constructs an empty filter. */
+    explicit CGCSFilter(const Params& paramsIn = Params());
+
+    /** Reconstructs an already-created filter from an encoding. Throws std::ios_base::failure
+     *  when the encoding is malformed. */
+    CGCSFilter(const Params& paramsIn, const std::vector<unsigned char>& vEncodedIn);
+
+    /** Builds a new filter from the params and set of elements. */
+    CGCSFilter(const Params& paramsIn, const ElementSet& elements);
+
+    uint32_t GetN() const { return nN; }
+    const Params& GetParams() const { return params; }
+    const std::vector<unsigned char>& GetEncoded() const { return vEncoded; }
+
+    /**
+     * Checks if the element may be in the set. False positives are possible
+     * with probability 1/M.
+     */
+    bool Match(const Element& element) const;
+
+    /**
+     * Checks if any of the given elements may be in the set. False positives
+     * are possible with probability 1/M per element checked. This is more
+     * efficient than checking Match on multiple elements separately.
+     */
+    bool MatchAny(const ElementSet& elements) const;
+};
+
+static const uint8_t BASIC_FILTER_P = 19;
+static const uint32_t BASIC_FILTER_M = 784931;
+
+enum BlockFilterType {
+    BLOCK_FILTER_BASIC = 0,
+    BLOCK_FILTER_INVALID = 255,
+};
+
+/** Get the human-readable name for a filter type. Returns empty string for unknown types. */
+const std::string& BlockFilterTypeName(BlockFilterType filterType);
+
+/** Find a filter type by its human-readable name. */
+bool BlockFilterTypeByName(const std::string& name, BlockFilterType& filterType);
+
+/**
+ * Complete block filter struct as defined in BIP 157. Serialization matches
+ * payload of "cfilter" messages.
+ */
+class CBlockFilter
+{
+private:
+    BlockFilterType filterType;
+    uint256 hashBlock;
+    CGCSFilter filter;
+
+    bool BuildParams(CGCSFilter::Params& paramsOut) const;
+
+public:
+    CBlockFilter() : filterType(BLOCK_FILTER_INVALID) {}
+
+    //! Reconstruct a BlockFilter from parts.
+    CBlockFilter(BlockFilterType filterTypeIn, const uint256& hashBlockIn, const std::vector<unsigned char>& vEncodedIn);
+
+    //! Construct a new BlockFilter of the specified type from a block.
+    CBlockFilter(BlockFilterType filterTypeIn, const CBlock& block, const CBlockUndo& blockundo);
+
+    BlockFilterType GetFilterType() const { return filterType; }
+    const uint256& GetBlockHash() const { return hashBlock; }
+    const CGCSFilter& GetFilter() const { return filter; }
+    const std::vector<unsigned char>& GetEncodedFilter() const { return filter.GetEncoded(); }
+
+    //! Compute the filter hash.
+    uint256 GetHash() const;
+
+    //! Compute the filter header given the previous one.
+    uint256 ComputeHeader(const uint256& prevHeader) const;
+
+    unsigned int GetSerializeSize(int nType, int nVersion) const
+    {
+        return 1 + ::GetSerializeSize(hashBlock, nType, nVersion) + ::GetSerializeSize(filter.GetEncoded(), nType, nVersion);
+    }
+
+    template <typename Stream>
+    void Serialize(Stream& s, int nType, int nVersion) const
+    {
+        ::Serialize(s, (unsigned char)filterType, nType, nVersion);
+        ::Serialize(s, hashBlock, nType, nVersion);
+        ::Serialize(s, filter.GetEncoded(), nType, nVersion);
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s, int nType, int nVersion)
+    {
+        unsigned char nFilterType;
+        std::vector<unsigned char> vEncodedFilter;
+        ::Unserialize(s, nFilterType, nType, nVersion);
+        ::Unserialize(s, hashBlock, nType, nVersion);
+        ::Unserialize(s, vEncodedFilter, nType, nVersion);
+
+        filterType = static_cast<BlockFilterType>(nFilterType);
+
+        CGCSFilter::Params paramsNew;
+        if (!BuildParams(paramsNew))
+            throw std::ios_base::failure("unknown filter_type");
+        filter = CGCSFilter(paramsNew, vEncodedFilter);
+    }
+};
+
+#endif // BITCOIN_BLOCKFILTER_H
@@ -0,0 +1,185 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockfilterindex.h"
+
+#include "main.h"
+#include "util.h"
+#include "utiltime.h"
+
+#include <boost/thread.hpp>
+
+using namespace std;
+
+/**
+ * The index database stores three items for each block in the active chain
+ * at the time it was connected:
+ * - 'F' + block hash -> encoded filter
+ * - 'H' + block hash -> CBlockFilterHeader
+ * and a single 'B' -> block hash of a block whose ancestors are all indexed,
+ * used to resume the sync thread.
+ */
+static const char DB_FILTER = 'F';
+static const char DB_FILTER_HEADER = 'H';
+static const char DB_BEST_BLOCK = 'B';
+
+CBlockFilterIndex* pblockfilterindex = NULL;
+
+CBlockFilterIndex::CBlockFilterIndex(BlockFilterType filterTypeIn, size_t nCacheSize, bool fMemory, bool fWipe)
+    : filterType(filterTypeIn),
+      db(GetDataDir() / "blockfilter" / BlockFilterTypeName(filterTypeIn), nCacheSize, fMemory, fWipe)
+{
+}
+
+bool CBlockFilterIndex::WriteFilter(const CBlockFilter& filter, const uint256& prevHeader)
+{
+    CBlockFilterHeader entry;
+    entry.hashFilter = filter.GetHash();
+    entry.header = filter.ComputeHeader(prevHeader);
+
+    CLevelDBBatch batch;
+    batch.Write(make_pair(DB_FILTER, filter.GetBlockHash()), filter.GetEncodedFilter());
+    batch.Write(make_pair(DB_FILTER_HEADER, filter.GetBlockHash()), entry);
+    batch.Write(DB_BEST_BLOCK, filter.GetBlockHash());
+    return db.WriteBatch(batch);
+}
+
+bool CBlockFilterIndex::BlockConnected(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex)
+{
+    uint256 prevHeader;
+    if (pindex->pprev && !LookupFilterHeader(pindex->pprev, prevHeader))
+        return true; // still syncing, the sync thread will get to this block
+
+    return WriteFilter(CBlockFilter(filterType, block, blockundo), prevHeader);
+}
+
+void CBlockFilterIndex::Sync()
+{
+    const CBlockIndex* pindex = NULL;
+    {
+        LOCK(cs_main);
+        uint256 hashBest;
+        if (db.Read(DB_BEST_BLOCK, hashBest)) {
+            BlockMap::iterator mi = mapBlockIndex.find(hashBest);
+            if (mi != mapBlockIndex.end())
+                pindex = chainActive.FindFork(mi->second);
+        }
+    }
+
+    LogPrintf("%s: syncing %s block filters from height %d\n", __func__, BlockFilterTypeName(filterType), pindex ? pindex->nHeight + 1 : 0);
+
+    int64_t nStart = GetTimeMillis();
+    int64_t nLastLog = GetTime();
+    unsigned int nIndexed = 0;
+    while (true) {
+        boost::this_thread::interruption_point();
+
+        const CBlockIndex* pindexNext = NULL;
+        CDiskBlockPos posUndo;
+        {
+            LOCK(cs_main);
+            if (pindex && !chainActive.Contains(pindex))
+                pindex = chainActive.FindFork(pindex);
+            pindexNext = pindex ? chainActive.Next(pindex) : chainActive.Genesis();
+            if (pindexNext == NULL)
+                break;
+            posUndo = pindexNext->GetUndoPos();
+        }
+
+        uint256 header;
+        if (!LookupFilterHeader(pindexNext, header)) {
+            CBlock block;
+            if (!ReadBlockFromDisk(block, pindexNext)) {
+                error("%s: failed to read block %s", __func__, pindexNext->GetBlockHash().ToString());
+                return;
+            }
+
+            CBlockUndo blockundo;
+            uint256 prevHeader;
+            if (pindexNext->pprev) {
+                if (posUndo.IsNull() || !blockundo.ReadFromDisk(posUndo, pindexNext->pprev->GetBlockHash())) {
+                    error("%s: failed to read undo data of block %s", __func__, pindexNext->GetBlockHash().ToString());
+                    return;
+                }
+                if (!LookupFilterHeader(pindexNext->pprev, prevHeader)) {
+                    error("%s: missing filter header of block %s", __func__, pindexNext->pprev->GetBlockHash().ToString());
+                    return;
+                }
+            }
+
+            if (!WriteFilter(CBlockFilter(filterType, block, blockundo), prevHeader)) {
+                error("%s: failed to write filter of block %s", __func__, pindexNext->GetBlockHash().ToString());
+                return;
+            }
+            nIndexed++;
+        }
+        pindex = pindexNext;
+
+        if (GetTime() - nLastLog >= 30) {
+            LogPrintf("%s: %s block filters synced up to height %d\n", __func__, BlockFilterTypeName(filterType), pindex->nHeight);
+            nLastLog = GetTime();
+        }
+    }
+
+    LogPrintf("%s: %s block filters synced, %u blocks indexed in %dms\n", __func__, BlockFilterTypeName(filterType), nIndexed, GetTimeMillis() - nStart);
+}
+
+bool CBlockFilterIndex::LookupFilter(const CBlockIndex* pindex, CBlockFilter& filterOut) const
+{
+    std::vector<unsigned char> vEncoded;
+    if (!db.Read(make_pair(DB_FILTER, pindex->GetBlockHash()), vEncoded))
+        return false;
+
+    try {
+        filterOut = CBlockFilter(filterType, pindex->GetBlockHash(), vEncoded);
+    } catch (const std::exception& e) {
+        return error("%s: failed to decode filter of block %s: %s", __func__, pindex->GetBlockHash().ToString(), e.what());
+    }
+    return true;
+}
+
+bool CBlockFilterIndex::LookupFilterHeader(const CBlockIndex* pindex, uint256& headerOut) const
+{
+    CBlockFilterHeader entry;
+    if (!db.Read(make_pair(DB_FILTER_HEADER, pindex->GetBlockHash()), entry))
+        return false;
+
+    headerOut = entry.header;
+    return true;
+}
+
+bool CBlockFilterIndex::LookupFilterRange(int nStartHeight, const CBlockIndex* pindexStop, std::vector<CBlockFilter>& filtersOut) const
+{
+    if (nStartHeight < 0 || pindexStop == NULL || nStartHeight > pindexStop->nHeight)
+        return false;
+
+    filtersOut.resize(pindexStop->nHeight - nStartHeight + 1);
+    for (const CBlockIndex* pindex = pindexStop; pindex && pindex->nHeight >= nStartHeight; pindex = pindex->pprev) {
+        if (!LookupFilter(pindex, filtersOut[pindex->nHeight - nStartHeight]))
+            return false;
+    }
+    return true;
+}
+
+bool CBlockFilterIndex::LookupFilterHashRange(int nStartHeight, const CBlockIndex* pindexStop, std::vector<uint256>& hashesOut) const
+{
+    if (nStartHeight < 0 || pindexStop == NULL || nStartHeight > pindexStop->nHeight)
+        return false;
+
+    hashesOut.resize(pindexStop->nHeight - nStartHeight + 1);
+    for (const CBlockIndex* pindex = pindexStop; pindex && pindex->nHeight >= nStartHeight; pindex = pindex->pprev) {
+        CBlockFilterHeader entry;
+        if (!db.Read(make_pair(DB_FILTER_HEADER, pindex->GetBlockHash()), entry))
+            return false;
+        hashesOut[pindex->nHeight - nStartHeight] = entry.hashFilter;
+    }
+    return true;
+}
+
+void ThreadBlockFilterIndexSync()
+{
+    RenameThread("trbo-blockfilter");
+    if (pblockfilterindex)
+        pblockfilterindex->Sync();
+}
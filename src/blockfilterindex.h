@@ -0,0 +1,83 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BLOCKFILTERINDEX_H
+#define BITCOIN_BLOCKFILTERINDEX_H
+
+#include "blockfilter.h"
+#include "leveldbwrapper.h"
+
+#include <vector>
+
+class CBlock;
+class CBlockIndex;
+class CBlockUndo;
+
+/** Default for -blockfilterindex */
+static const bool DEFAULT_BLOCKFILTERINDEX = false;
+/** Default for -peerblockfilters */
+static const bool DEFAULT_PEERBLOCKFILTERS = false;
+
+/** Filter hash and header of a block, kept apart from the filter itself so
+ *  that header requests do not have to read the filters. */
+struct CBlockFilterHeader {
+    uint256 hashFilter;
+    uint256 header;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        READWRITE(hashFilter);
+        READWRITE(header);
+    }
+};
+
+/**
+ * Persistent index of compact block filters (BIP 157/158) of one filter
+ * type, keyed by block hash so entries survive reorganizations. Filters of
+ * newly connected blocks are written from ConnectBlock; blocks that were
+ * connected before the index existed are filled in by the sync thread.
+ */
+class CBlockFilterIndex
+{
+private:
+    BlockFilterType filterType;
+    CLevelDBWrapper db;
+
+    CBlockFilterIndex(const CBlockFilterIndex&);
+    void operator=(const CBlockFilterIndex&);
+
+    bool WriteFilter(const CBlockFilter& filter, const uint256& prevHeader);
+
+public:
+    CBlockFilterIndex(BlockFilterType filterTypeIn, size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+
+    BlockFilterType GetFilterType() const { return filterType; }
+
+    /** Index the filter of a block ConnectBlock just connected. Blocks whose
+     *  parent is not indexed yet are left to the sync thread. */
+    bool BlockConnected(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex);
+
+    /** Index every block of the active chain that is still missing. Runs until
+     *  it reaches the tip or the thread is interrupted. */
+    void Sync();
+
+    bool LookupFilter(const CBlockIndex* pindex, CBlockFilter& filterOut) const;
+    bool LookupFilterHeader(const CBlockIndex* pindex, uint256& headerOut) const;
+
+    /** Get filters for blocks from nStartHeight up to and including pindexStop */
+    bool LookupFilterRange(int nStartHeight, const CBlockIndex* pindexStop, std::vector<CBlockFilter>& filtersOut) const;
+
+    /** Get filter hashes for blocks from nStartHeight up to and including pindexStop */
+    bool LookupFilterHashRange(int nStartHeight, const CBlockIndex* pindexStop, std::vector<uint256>& hashesOut) const;
+};
+
+/** The basic filter index, NULL unless -blockfilterindex is set */
+extern CBlockFilterIndex* pblockfilterindex;
+
+void ThreadBlockFilterIndexSync();
+
+#endif // BITCOIN_BLOCKFILTERINDEX_H
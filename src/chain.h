@@ -98,6 +98,8 @@ enum BlockStatus {
     BLOCK_FAILED_MASK        =   BLOCK_FAILED_VALID | BLOCK_FAILED_CHILD,
 
     BLOCK_OPT_WITNESS       =   128, //! block data in blk*.data was received with a witness-enforcing client
+
+    BLOCK_SNAPSHOT          =   256, //! entry was loaded from a chainstate snapshot, block and undo data were never downloaded
 };
 
 /** The block chain is a tree shaped structure starting with the
@@ -5,10 +5,14 @@
 #ifndef BITCOIN_CHECKQUEUE_H
 #define BITCOIN_CHECKQUEUE_H
 
+#include "utiltime.h"
+
 #include <algorithm>
+#include <atomic>
+#include <deque>
+#include <stdint.h>
 #include <vector>
 
-#include <boost/foreach.hpp>
 #include <boost/thread/condition_variable.hpp>
 #include <boost/thread/locks.hpp>
 #include <boost/thread/mutex.hpp>
@@ -16,7 +20,29 @@
 template <typename T>
 class CCheckQueueControl;
 
-/** 
+/** How the threads of a CCheckQueue spent the last round of work, from the first Add to Wait returning */
+struct CCheckQueueStats {
+    //! Wall clock time of the round, in microseconds
+    int64_t nTimeWall;
+    //! Time spent evaluating checks, summed over all threads, in microseconds
+    int64_t nTimeBusy;
+    //! Checks evaluated; after a failure the rest are skipped
+    uint64_t nChecks;
+    //! Batches taken from another thread's deque
+    uint64_t nSteals;
+    //! Threads that could take part, including the master
+    int nThreads;
+
+    CCheckQueueStats() : nTimeWall(0), nTimeBusy(0), nChecks(0), nSteals(0), nThreads(0) {}
+
+    /** Fraction of the available thread time spent evaluating checks */
+    double Utilization() const
+    {
+        return nTimeWall > 0 && nThreads > 0 ? (double)nTimeBusy / ((double)nTimeWall * nThreads) : 0.0;
+    }
+};
+
+/**
  * Queue for verifications that have to be performed.
   * The verifications are represented by a type T, which must provide an
   * operator(), returning a bool.
@@ -25,12 +51,35 @@ class CCheckQueueControl;
   * onto the queue, where they are processed by N-1 worker threads. When
   * the master is done adding work, it temporarily joins the worker pool
   * as an N'th worker, until all jobs are done.
+  *
+  * Every thread has its own deque, and Add spreads the verifications over
+  * them. A thread takes batches from the back of its own deque, and when
+  * that is empty steals half of another thread's deque from the front, so
+  * the only lock taken per batch is that of a single deque, which is rarely
+  * contended. The shared mutex is only used by threads going to sleep or
+  * waking others. Batches get smaller as a deque empties, so all threads
+  * finish at about the same time, and once a verification fails the rest
+  * are discarded without being evaluated.
   */
 template <typename T>
 class CCheckQueue
 {
 private:
-    //! Mutex to protect the inner state
+    //! Deques, with slot 0 for the master and the others for worker threads
+    static const int MAX_SLOTS = 128;
+
+    struct WorkerDeque {
+        boost::mutex mutex;
+        std::deque<T> checks;
+        //! Size of checks, readable without the lock to skip empty deques when stealing
+        std::atomic<size_t> nSize;
+
+        WorkerDeque() : nSize(0) {}
+    };
+
+    std::vector<WorkerDeque> vDeques;
+
+    //! Mutex for sleeping and waking up threads
     boost::mutex mutex;
 
     //! Worker threads block on this when out of work
@@ -39,122 +88,220 @@ private:
     //! Master thread blocks on this when out of work
     boost::condition_variable condMaster;
 
-    //! The queue of elements to be processed.
-    //! As the order of booleans doesn't matter, it is used as a LIFO (stack)
-    std::vector<T> queue;
+    //! The number of worker threads that have started, not counting the master.
+    std::atomic<int> nWorkers;
 
-    //! The number of workers (including the master) that are idle.
-    int nIdle;
-
-    //! The total number of workers (including the master).
-    int nTotal;
+    //! The number of worker threads that are waiting for work.
+    std::atomic<int> nIdle;
 
     //! The temporary evaluation result.
-    bool fAllOk;
+    std::atomic<bool> fAllOk;
 
     /**
      * Number of verifications that haven't completed yet.
-     * This includes elements that are not anymore in queue, but still in
-     * worker's own batches.
+     * This includes elements that are not anymore in a deque, but still in
+     * a thread's own batch.
      */
-    unsigned int nTodo;
+    std::atomic<unsigned int> nTodo;
 
-    //! Whether we're shutting down.
-    bool fQuit;
+    //! Number of verifications still in one of the deques
+    std::atomic<unsigned int> nQueued;
 
     //! The maximum number of elements to be processed in one batch
     unsigned int nBatchSize;
 
-    /** Internal function that does bulk of the verification work. */
-    bool Loop(bool fMaster = false)
+    //! Deque the next Add starts with (master only)
+    int nNextSlot;
+
+    //! Statistics of the current round; nRoundStart is 0 between rounds (master only)
+    int64_t nRoundStart;
+    std::atomic<int64_t> nRoundBusy;
+    std::atomic<uint64_t> nRoundChecks;
+    std::atomic<uint64_t> nRoundSteals;
+
+    //! Statistics of the last finished round, protected by mutex
+    CCheckQueueStats statsLast;
+
+    int NumSlots() const
     {
-        boost::condition_variable& cond = fMaster ? condMaster : condWorker;
-        std::vector<T> vChecks;
-        vChecks.reserve(nBatchSize);
-        unsigned int nNow = 0;
-        bool fOk = true;
-        do {
-            {
-                boost::unique_lock<boost::mutex> lock(mutex);
-                // first do the clean-up of the previous loop run (allowing us to do it in the same critsect)
-                if (nNow) {
-                    fAllOk &= fOk;
-                    nTodo -= nNow;
-                    if (nTodo == 0 && !fMaster)
-                        // We processed the last element; inform the master he can exit and return the result
-                        condMaster.notify_one();
-                } else {
-                    // first iteration
-                    nTotal++;
-                }
-                // logically, the do loop starts here
-                while (queue.empty()) {
-                    if ((fMaster || fQuit) && nTodo == 0) {
-                        nTotal--;
-                        bool fRet = fAllOk;
-                        // reset the status for new work later
-                        if (fMaster)
-                            fAllOk = true;
-                        // return the current status
-                        return fRet;
-                    }
-                    nIdle++;
-                    cond.wait(lock); // wait
-                    nIdle--;
-                }
-                // Decide how many work units to process now.
-                // * Do not try to do everything at once, but aim for increasingly smaller batches so
-                //   all workers finish approximately simultaneously.
-                // * Try to account for idle jobs which will instantly start helping.
-                // * Don't do batches smaller than 1 (duh), or larger than nBatchSize.
-                nNow = std::max(1U, std::min(nBatchSize, (unsigned int)queue.size() / (nTotal + nIdle + 1)));
-                vChecks.resize(nNow);
-                for (unsigned int i = 0; i < nNow; i++) {
-                    // We want the lock on the mutex to be as short as possible, so swap jobs from the global
-                    // queue to the local batch vector instead of copying.
-                    vChecks[i].swap(queue.back());
-                    queue.pop_back();
+        return 1 + std::min(nWorkers.load(), MAX_SLOTS - 1);
+    }
+
+    /** Move nNow checks from the back (fBack) or front of a deque into vChecks. Requires wd.mutex. */
+    void Take(WorkerDeque& wd, unsigned int nNow, bool fBack, std::vector<T>& vChecks)
+    {
+        for (unsigned int i = 0; i < nNow; i++) {
+            vChecks.push_back(T());
+            if (fBack) {
+                vChecks.back().swap(wd.checks.back());
+                wd.checks.pop_back();
+            } else {
+                vChecks.back().swap(wd.checks.front());
+                wd.checks.pop_front();
+            }
+        }
+        wd.nSize = wd.checks.size();
+        nQueued -= nNow;
+    }
+
+    /** Take a batch from the thread's own deque, leaving at least half of it for others to steal */
+    bool PopLocal(int nSlot, std::vector<T>& vChecks)
+    {
+        WorkerDeque& wd = vDeques[nSlot];
+        if (wd.nSize.load(std::memory_order_relaxed) == 0)
+            return false;
+        boost::unique_lock<boost::mutex> lock(wd.mutex);
+        if (wd.checks.empty())
+            return false;
+        Take(wd, std::max(1U, std::min(nBatchSize, (unsigned int)wd.checks.size() / 2)), true, vChecks);
+        return true;
+    }
+
+    /** Take half of the first non-empty deque of another thread */
+    bool Steal(int nSlot, std::vector<T>& vChecks)
+    {
+        int nSlots = NumSlots();
+        for (int i = 1; i < nSlots; i++) {
+            WorkerDeque& wd = vDeques[(nSlot + i) % nSlots];
+            if (wd.nSize.load(std::memory_order_relaxed) == 0)
+                continue;
+            boost::unique_lock<boost::mutex> lock(wd.mutex);
+            if (wd.checks.empty())
+                continue;
+            Take(wd, std::max(1U, std::min(nBatchSize, ((unsigned int)wd.checks.size() + 1) / 2)), false, vChecks);
+            nRoundSteals++;
+            return true;
+        }
+        return false;
+    }
+
+    /** Evaluate a batch, or only discard it once a verification has failed */
+    void Execute(std::vector<T>& vChecks)
+    {
+        unsigned int nNow = vChecks.size();
+        if (fAllOk.load(std::memory_order_relaxed)) {
+            int64_t nTimeStart = GetTimeMicros();
+            unsigned int nDone = 0;
+            bool fOk = true;
+            for (T& check : vChecks) {
+                nDone++;
+                if (!check()) {
+                    fOk = false;
+                    break;
                 }
-                // Check whether we need to do work at all
-                fOk = fAllOk;
+                if (!fAllOk.load(std::memory_order_relaxed))
+                    break;
             }
-            // execute work
-            BOOST_FOREACH (T& check, vChecks)
-                if (fOk)
-                    fOk = check();
-            vChecks.clear();
-        } while (true);
+            if (!fOk)
+                fAllOk = false;
+            nRoundBusy += GetTimeMicros() - nTimeStart;
+            nRoundChecks += nDone;
+        }
+        vChecks.clear();
+
+        if (nTodo.fetch_sub(nNow) == nNow) {
+            // We processed the last element; inform the master he can exit and return the result
+            boost::unique_lock<boost::mutex> lock(mutex);
+            condMaster.notify_one();
+        }
     }
 
 public:
     //! Create a new check queue
-    CCheckQueue(unsigned int nBatchSizeIn) : nIdle(0), nTotal(0), fAllOk(true), nTodo(0), fQuit(false), nBatchSize(nBatchSizeIn) {}
+    CCheckQueue(unsigned int nBatchSizeIn) : vDeques(MAX_SLOTS), nWorkers(0), nIdle(0), fAllOk(true), nTodo(0), nQueued(0), nBatchSize(nBatchSizeIn), nNextSlot(0), nRoundStart(0), nRoundBusy(0), nRoundChecks(0), nRoundSteals(0) {}
 
     //! Worker thread
     void Thread()
     {
-        Loop();
+        int nSlot = 1 + (nWorkers++ % (MAX_SLOTS - 1));
+        std::vector<T> vChecks;
+        vChecks.reserve(nBatchSize);
+        while (true) {
+            if (PopLocal(nSlot, vChecks) || Steal(nSlot, vChecks)) {
+                Execute(vChecks);
+                continue;
+            }
+            boost::unique_lock<boost::mutex> lock(mutex);
+            // Announce going idle before looking at nQueued, so Add either sees
+            // this thread idle and wakes it, or queued its work before the check.
+            nIdle++;
+            while (nQueued == 0)
+                condWorker.wait(lock); // wait
+            nIdle--;
+        }
     }
 
     //! Wait until execution finishes, and return whether all evaluations where successful.
     bool Wait()
     {
-        return Loop(true);
+        std::vector<T> vChecks;
+        vChecks.reserve(nBatchSize);
+        while (true) {
+            if (PopLocal(0, vChecks) || Steal(0, vChecks)) {
+                Execute(vChecks);
+                continue;
+            }
+            boost::unique_lock<boost::mutex> lock(mutex);
+            if (nTodo == 0) {
+                statsLast = CCheckQueueStats();
+                if (nRoundStart) {
+                    statsLast.nTimeWall = GetTimeMicros() - nRoundStart;
+                    statsLast.nTimeBusy = nRoundBusy;
+                    statsLast.nChecks = nRoundChecks;
+                    statsLast.nSteals = nRoundSteals;
+                    statsLast.nThreads = NumSlots();
+                }
+                nRoundStart = 0;
+                nRoundBusy = 0;
+                nRoundChecks = 0;
+                nRoundSteals = 0;
+                bool fRet = fAllOk;
+                // reset the status for new work later
+                fAllOk = true;
+                // return the current status
+                return fRet;
+            }
+            // The remaining work is in other threads' batches
+            if (nQueued == 0)
+                condMaster.wait(lock);
+        }
     }
 
     //! Add a batch of checks to the queue
     void Add(std::vector<T>& vChecks)
     {
-        boost::unique_lock<boost::mutex> lock(mutex);
-        BOOST_FOREACH (T& check, vChecks) {
-            queue.push_back(T());
-            check.swap(queue.back());
+        if (vChecks.empty())
+            return;
+        if (nRoundStart == 0)
+            nRoundStart = GetTimeMicros();
+
+        // Spread the checks over the deques in equal chunks, continuing
+        // where the previous Add left off, so that even one check per Add
+        // keeps all threads busy.
+        int nSlots = NumSlots();
+        unsigned int nSize = vChecks.size();
+        unsigned int nChunk = std::max(1U, nSize / nSlots);
+        nTodo += nSize;
+        for (unsigned int nStart = 0; nStart < nSize; nStart += nChunk) {
+            WorkerDeque& wd = vDeques[nNextSlot];
+            nNextSlot = (nNextSlot + 1) % nSlots;
+            unsigned int nEnd = std::min(nSize, nStart + nChunk);
+            boost::unique_lock<boost::mutex> lock(wd.mutex);
+            for (unsigned int i = nStart; i < nEnd; i++) {
+                wd.checks.push_back(T());
+                vChecks[i].swap(wd.checks.back());
+            }
+            wd.nSize = wd.checks.size();
+            nQueued += nEnd - nStart;
+        }
+
+        if (nIdle > 0) {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            if (nSize == 1)
+                condWorker.notify_one();
+            else
+                condWorker.notify_all();
         }
-        nTodo += vChecks.size();
-        if (vChecks.size() == 1)
-            condWorker.notify_one();
-        else if (vChecks.size() > 1)
-            condWorker.notify_all();
     }
 
     ~CCheckQueue()
@@ -164,11 +311,18 @@ public:
     bool IsIdle()
     {
         boost::unique_lock<boost::mutex> lock(mutex);
-        return (nTotal == nIdle && nTodo == 0 && fAllOk == true);
+        return (nTodo == 0 && fAllOk == true);
+    }
+
+    //! Statistics of the last round of work the master waited for
+    CCheckQueueStats GetStats()
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        return statsLast;
     }
 };
 
-/** 
+/**
  * RAII-style controller object for a CCheckQueue that guarantees the passed
  * queue is finished before continuing.
  */
@@ -0,0 +1,230 @@
+// Copyright (c) 2019 The TRBO developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "coinstatsindex.h"
+
+#include "main.h"
+#include "streams.h"
+#include "txdb.h"
+#include "undo.h"
+#include "util.h"
+#include "utiltime.h"
+
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread.hpp>
+
+using namespace std;
+
+/**
+ * The index database stores, for each block in the active chain at the time
+ * it was connected:
+ * - 's' + block hash -> CCoinStatsIndexEntry
+ * and a single 'B' -> block hash of a block whose ancestors are all indexed,
+ * used to resume the sync thread.
+ */
+static const char DB_STATS = 's';
+static const char DB_BEST_BLOCK = 'B';
+
+CCoinStatsIndex* pcoinstatsindex = NULL;
+
+/** Size an unspent output takes in a simple, database independent layout */
+static uint64_t GetBogoSize(const CTxOut& txout)
+{
+    return 32 /* txid */ + 4 /* vout index */ + 4 /* height + coinbase */ + 8 /* amount */ +
+           2 /* scriptPubKey len */ + txout.scriptPubKey.size() /* scriptPubKey */;
+}
+
+static void UpdateCoinStats(CCoinStatsIndexEntry& entry, const COutPoint& outpoint, const CTxOut& txout, bool fAdd)
+{
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << outpoint << txout;
+    const unsigned char* pch = (const unsigned char*)&ss[0];
+    if (fAdd) {
+        entry.muhash.Insert(pch, ss.size());
+        entry.nTransactionOutputs++;
+        entry.nBogoSize += GetBogoSize(txout);
+        entry.nTotalAmount += txout.nValue;
+    } else {
+        entry.muhash.Remove(pch, ss.size());
+        entry.nTransactionOutputs--;
+        entry.nBogoSize -= GetBogoSize(txout);
+        entry.nTotalAmount -= txout.nValue;
+    }
+}
+
+bool ApplyBlockToCoinStats(CCoinStatsIndexEntry& entry, const CBlock& block, const CBlockUndo& blockundo)
+{
+    // ConnectBlock keeps one undo entry per transaction but the coinbase
+    if (block.vtx.empty() || blockundo.vtxundo.size() != block.vtx.size() - 1)
+        return false;
+
+    for (unsigned int i = 0; i < block.vtx.size(); i++) {
+        const CTransaction& tx = block.vtx[i];
+        if (i > 0) {
+            const CTxUndo& txundo = blockundo.vtxundo[i - 1];
+            if (txundo.vprevout.size() != tx.vin.size())
+                return false;
+            for (unsigned int j = 0; j < tx.vin.size(); j++)
+                UpdateCoinStats(entry, tx.vin[j].prevout, txundo.vprevout[j].txout, false);
+        }
+
+        // Outputs that can never be spent are not added to the coin database either
+        const uint256 hash = tx.GetHash();
+        for (unsigned int j = 0; j < tx.vout.size(); j++) {
+            if (!tx.vout[j].scriptPubKey.IsUnspendable())
+                UpdateCoinStats(entry, COutPoint(hash, j), tx.vout[j], true);
+        }
+    }
+    return true;
+}
+
+CCoinStatsIndex::CCoinStatsIndex(size_t nCacheSize, bool fMemory, bool fWipe)
+    : db(GetDataDir() / "coinstats", nCacheSize, fMemory, fWipe)
+{
+}
+
+bool ComputeCoinStats(CCoinsViewDB* pcoinsdb, CCoinStatsIndexEntry& entry)
+{
+    boost::scoped_ptr<CCoinsViewDBCursor> pcursor(pcoinsdb->Cursor());
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        CCoins coins;
+        if (!pcursor->GetCoins(coins))
+            return error("%s : Deserialize or I/O error", __func__);
+        for (unsigned int i = 0; i < coins.vout.size(); i++) {
+            if (!coins.vout[i].IsNull())
+                UpdateCoinStats(entry, COutPoint(pcursor->GetTxid(), i), coins.vout[i], true);
+        }
+        pcursor->Next();
+    }
+    return true;
+}
+
+bool CCoinStatsIndex::WriteStats(const uint256& hashBlock, const CCoinStatsIndexEntry& entry)
+{
+    CLevelDBBatch batch;
+    batch.Write(make_pair(DB_STATS, hashBlock), entry);
+    batch.Write(DB_BEST_BLOCK, hashBlock);
+    return db.WriteBatch(batch);
+}
+
+bool CCoinStatsIndex::SeedFromCoins(CCoinsViewDB* pcoinsdb)
+{
+    CCoinStatsIndexEntry entry;
+    if (!ComputeCoinStats(pcoinsdb, entry))
+        return false;
+    LogPrintf("%s: coin stats start at block %s with %u outputs\n", __func__, pcoinsdb->GetBestBlock().ToString(), entry.nTransactionOutputs);
+    return WriteStats(pcoinsdb->GetBestBlock(), entry);
+}
+
+void CCoinStatsIndex::Stall(const CBlockIndex* pindex, const std::string& strReason)
+{
+    error("%s: coin stats sync stalled at height %d: %s", __func__, pindex->nHeight, strReason);
+    LOCK(cs);
+    strStalled = strprintf("stalled at height %d: %s", pindex->nHeight, strReason);
+}
+
+std::string CCoinStatsIndex::GetStalledReason() const
+{
+    LOCK(cs);
+    return strStalled;
+}
+
+bool CCoinStatsIndex::BlockConnected(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex)
+{
+    CCoinStatsIndexEntry entry;
+    if (pindex->pprev && !LookupStats(pindex->pprev, entry))
+        return true; // still syncing, the sync thread will get to this block
+
+    if (!ApplyBlockToCoinStats(entry, block, blockundo))
+        return error("%s: undo data of block %s does not match its transactions", __func__, pindex->GetBlockHash().ToString());
+    return WriteStats(pindex->GetBlockHash(), entry);
+}
+
+void CCoinStatsIndex::Sync()
+{
+    const CBlockIndex* pindex = NULL;
+    {
+        LOCK(cs_main);
+        uint256 hashBest;
+        if (db.Read(DB_BEST_BLOCK, hashBest)) {
+            BlockMap::iterator mi = mapBlockIndex.find(hashBest);
+            if (mi != mapBlockIndex.end())
+                pindex = chainActive.FindFork(mi->second);
+        }
+    }
+
+    LogPrintf("%s: syncing coin stats from height %d\n", __func__, pindex ? pindex->nHeight + 1 : 0);
+
+    int64_t nStart = GetTimeMillis();
+    int64_t nLastLog = GetTime();
+    unsigned int nIndexed = 0;
+    while (true) {
+        boost::this_thread::interruption_point();
+
+        const CBlockIndex* pindexNext = NULL;
+        CDiskBlockPos posUndo;
+        {
+            LOCK(cs_main);
+            if (pindex && !chainActive.Contains(pindex))
+                pindex = chainActive.FindFork(pindex);
+            pindexNext = pindex ? chainActive.Next(pindex) : chainActive.Genesis();
+            if (pindexNext == NULL)
+                break;
+            posUndo = pindexNext->GetUndoPos();
+        }
+
+        CCoinStatsIndexEntry entry;
+        if (!LookupStats(pindexNext, entry)) {
+            // The genesis block does not touch the UTXO set
+            if (pindexNext->pprev) {
+                if (!LookupStats(pindexNext->pprev, entry)) {
+                    Stall(pindexNext, strprintf("missing coin stats of block %s", pindexNext->pprev->GetBlockHash().ToString()));
+                    return;
+                }
+
+                CBlock block;
+                if (!ReadBlockFromDisk(block, pindexNext)) {
+                    Stall(pindexNext, strprintf("failed to read block %s", pindexNext->GetBlockHash().ToString()));
+                    return;
+                }
+                CBlockUndo blockundo;
+                if (posUndo.IsNull() || !blockundo.ReadFromDisk(posUndo, pindexNext->pprev->GetBlockHash())) {
+                    Stall(pindexNext, strprintf("failed to read undo data of block %s", pindexNext->GetBlockHash().ToString()));
+                    return;
+                }
+                if (!ApplyBlockToCoinStats(entry, block, blockundo)) {
+                    Stall(pindexNext, strprintf("undo data of block %s does not match its transactions", pindexNext->GetBlockHash().ToString()));
+                    return;
+                }
+            }
+
+            if (!WriteStats(pindexNext->GetBlockHash(), entry)) {
+                Stall(pindexNext, strprintf("failed to write coin stats of block %s", pindexNext->GetBlockHash().ToString()));
+                return;
+            }
+            nIndexed++;
+        }
+        pindex = pindexNext;
+
+        if (GetTime() - nLastLog >= 30) {
+            LogPrintf("%s: coin stats synced up to height %d\n", __func__, pindex->nHeight);
+            nLastLog = GetTime();
+        }
+    }
+
+    LogPrintf("%s: coin stats synced, %u blocks indexed in %dms\n", __func__, nIndexed, GetTimeMillis() - nStart);
+}
+
+bool CCoinStatsIndex::LookupStats(const CBlockIndex* pindex, CCoinStatsIndexEntry& entry) const
+{
+    return db.Read(make_pair(DB_STATS, pindex->GetBlockHash()), entry);
+}
+
+void ThreadCoinStatsIndexSync()
+{
+    RenameThread("trbo-coinstats");
+    if (pcoinstatsindex)
+        pcoinstatsindex->Sync();
+}
@@ -0,0 +1,123 @@
+// Copyright (c) 2019 The TRBO developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_COINSTATSINDEX_H
+#define BITCOIN_COINSTATSINDEX_H
+
+#include "amount.h"
+#include "crypto/muhash.h"
+#include "leveldbwrapper.h"
+#include "serialize.h"
+#include "sync.h"
+#include "uint256.h"
+
+#include <string>
+
+class CBlock;
+class CBlockIndex;
+class CBlockUndo;
+class CCoinsViewDB;
+
+/** Default for -coinstatsindex */
+static const bool DEFAULT_COINSTATSINDEX = false;
+
+/** Statistics of the UTXO set after connecting a block */
+struct CCoinStatsIndexEntry {
+    MuHash3072 muhash; //!< Set hash over (outpoint, txout) of every unspent output
+    uint64_t nTransactionOutputs;
+    uint64_t nBogoSize; //!< Database independent size estimate, see GetBogoSize
+    CAmount nTotalAmount;
+
+    CCoinStatsIndexEntry() : nTransactionOutputs(0), nBogoSize(0), nTotalAmount(0) {}
+
+    unsigned int GetSerializeSize(int nType, int nVersion) const
+    {
+        return MuHash3072::SERIALIZED_SIZE + 3 * 8;
+    }
+
+    template <typename Stream>
+    void Serialize(Stream& s, int nType, int nVersion) const
+    {
+        unsigned char vch[MuHash3072::SERIALIZED_SIZE];
+        muhash.ToBytes(vch);
+        ::Serialize(s, FLATDATA(vch), nType, nVersion);
+        ::Serialize(s, nTransactionOutputs, nType, nVersion);
+        ::Serialize(s, nBogoSize, nType, nVersion);
+        ::Serialize(s, nTotalAmount, nType, nVersion);
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s, int nType, int nVersion)
+    {
+        unsigned char vch[MuHash3072::SERIALIZED_SIZE];
+        ::Unserialize(s, FLATDATA(vch), nType, nVersion);
+        muhash.FromBytes(vch);
+        ::Unserialize(s, nTransactionOutputs, nType, nVersion);
+        ::Unserialize(s, nBogoSize, nType, nVersion);
+        ::Unserialize(s, nTotalAmount, nType, nVersion);
+    }
+};
+
+/**
+ * Persistent index of UTXO set statistics by block, so that gettxoutsetinfo
+ * does not have to scan the coin database and can answer for any block of
+ * the active chain. The statistics of a block are those of its parent
+ * updated with the outputs the block creates and spends (the latter taken
+ * from its undo data). Entries are keyed by block hash, so disconnecting a
+ * block needs no update: the parent's entry is still there.
+ *
+ * A node started from a chainstate snapshot has no blocks or undo data below
+ * the snapshot. The index then starts at the snapshot's block, seeded from
+ * the loaded coins by SeedFromCoins, and blocks below it are never indexed.
+ * If -coinstatsindex is turned on only later, the sync stalls at height 1.
+ */
+class CCoinStatsIndex
+{
+private:
+    CLevelDBWrapper db;
+
+    mutable CCriticalSection cs;
+    //! Why Sync stopped before the tip, empty unless it did
+    std::string strStalled;
+
+    CCoinStatsIndex(const CCoinStatsIndex&);
+    void operator=(const CCoinStatsIndex&);
+
+    bool WriteStats(const uint256& hashBlock, const CCoinStatsIndexEntry& entry);
+    /** Log why the sync cannot go on and keep the reason for GetStalledReason */
+    void Stall(const CBlockIndex* pindex, const std::string& strReason);
+
+public:
+    CCoinStatsIndex(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+
+    /** Start the index at the best block of the coin database, with the
+     *  statistics of all the coins in it. Used after loading a snapshot. */
+    bool SeedFromCoins(CCoinsViewDB* pcoinsdb);
+
+    /** Index the statistics of a block ConnectBlock just connected. Blocks
+     *  whose parent is not indexed yet are left to the sync thread. */
+    bool BlockConnected(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex);
+
+    /** Index every block of the active chain that is still missing. Runs until
+     *  it reaches the tip or the thread is interrupted. */
+    void Sync();
+
+    bool LookupStats(const CBlockIndex* pindex, CCoinStatsIndexEntry& entry) const;
+
+    /** Why the sync stopped before reaching the tip, empty if it did not */
+    std::string GetStalledReason() const;
+};
+
+/** Apply the outputs a block creates and spends to the statistics of its parent */
+bool ApplyBlockToCoinStats(CCoinStatsIndexEntry& entry, const CBlock& block, const CBlockUndo& blockundo);
+
+/** Statistics of every coin in the coin database, by a full scan */
+bool ComputeCoinStats(CCoinsViewDB* pcoinsdb, CCoinStatsIndexEntry& entry);
+
+/** The UTXO statistics index, NULL unless -coinstatsindex is set */
+extern CCoinStatsIndex* pcoinstatsindex;
+
+void ThreadCoinStatsIndexSync();
+
+#endif // BITCOIN_COINSTATSINDEX_H
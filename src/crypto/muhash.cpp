@@ -0,0 +1,183 @@
+// Copyright (c) 2017-2019 The Bitcoin Core developers
+// Copyright (c) 2019 The TRBO developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "crypto/muhash.h"
+
+#include "crypto/common.h"
+#include "crypto/sha256.h"
+#include "crypto/sha512.h"
+
+#include <string.h>
+
+Num3072::Num3072()
+{
+    memset(limbs, 0, sizeof(limbs));
+    limbs[0] = 1;
+}
+
+Num3072::Num3072(const unsigned char (&data)[BYTE_SIZE])
+{
+    for (int i = 0; i < LIMBS; ++i)
+        limbs[i] = ReadLE32(data + 4 * i);
+    // Only values in [2^3072 - 1103717, 2^3072) need reducing
+    if (IsOverflow())
+        FullReduce();
+}
+
+void Num3072::ToBytes(unsigned char (&out)[BYTE_SIZE]) const
+{
+    for (int i = 0; i < LIMBS; ++i)
+        WriteLE32(out + 4 * i, limbs[i]);
+}
+
+/** Whether the value is at least the modulus 2^3072 - MAX_PRIME_DIFF */
+bool Num3072::IsOverflow() const
+{
+    if (limbs[0] <= 0xFFFFFFFFU - MAX_PRIME_DIFF)
+        return false;
+    for (int i = 1; i < LIMBS; ++i) {
+        if (limbs[i] != 0xFFFFFFFFU)
+            return false;
+    }
+    return true;
+}
+
+/** Subtract the modulus once, by adding MAX_PRIME_DIFF and dropping the carry out of the top limb */
+void Num3072::FullReduce()
+{
+    uint64_t c = MAX_PRIME_DIFF;
+    for (int i = 0; i < LIMBS; ++i) {
+        c += limbs[i];
+        limbs[i] = (uint32_t)c;
+        c >>= 32;
+    }
+}
+
+void Num3072::Multiply(const Num3072& a)
+{
+    // Schoolbook product into 6144 bits
+    uint32_t t[2 * LIMBS];
+    memset(t, 0, sizeof(t));
+    for (int i = 0; i < LIMBS; ++i) {
+        uint64_t carry = 0;
+        for (int j = 0; j < LIMBS; ++j) {
+            uint64_t cur = (uint64_t)limbs[i] * a.limbs[j] + t[i + j] + carry;
+            t[i + j] = (uint32_t)cur;
+            carry = cur >> 32;
+        }
+        t[i + LIMBS] = (uint32_t)carry;
+    }
+
+    // Fold the upper half into the lower one, as 2^3072 == MAX_PRIME_DIFF (mod p)
+    uint64_t carry = 0;
+    for (int i = 0; i < LIMBS; ++i) {
+        uint64_t cur = (uint64_t)t[i + LIMBS] * MAX_PRIME_DIFF + t[i] + carry;
+        limbs[i] = (uint32_t)cur;
+        carry = cur >> 32;
+    }
+
+    // Whatever is left above 3072 bits is small; fold it in until nothing is
+    while (carry) {
+        uint64_t c = carry * MAX_PRIME_DIFF;
+        for (int i = 0; i < LIMBS && c; ++i) {
+            c += limbs[i];
+            limbs[i] = (uint32_t)c;
+            c >>= 32;
+        }
+        carry = c;
+    }
+
+    if (IsOverflow())
+        FullReduce();
+}
+
+Num3072 Num3072::GetInverse() const
+{
+    // By Fermat's little theorem a^(p-2) is the inverse of a modulo the prime p.
+    // All limbs of p - 2 but the lowest are set.
+    Num3072 r;
+    for (int i = LIMBS - 1; i >= 0; --i) {
+        uint32_t e = i == 0 ? 0xFFFFFFFFU - MAX_PRIME_DIFF - 1 : 0xFFFFFFFFU;
+        for (int bit = 31; bit >= 0; --bit) {
+            r.Multiply(r);
+            if ((e >> bit) & 1)
+                r.Multiply(*this);
+        }
+    }
+    return r;
+}
+
+void Num3072::Divide(const Num3072& a)
+{
+    Multiply(a.GetInverse());
+}
+
+Num3072 MuHash3072::ToNum3072(const unsigned char* data, size_t len)
+{
+    // Expand the SHA256 of the element to 3072 bits with SHA512 in counter mode
+    unsigned char key[CSHA256::OUTPUT_SIZE];
+    CSHA256().Write(data, len).Finalize(key);
+
+    unsigned char expanded[Num3072::BYTE_SIZE];
+    for (unsigned int i = 0; i < Num3072::BYTE_SIZE / CSHA512::OUTPUT_SIZE; ++i) {
+        unsigned char counter = i;
+        CSHA512().Write(key, sizeof(key)).Write(&counter, 1).Finalize(expanded + i * CSHA512::OUTPUT_SIZE);
+    }
+    return Num3072(expanded);
+}
+
+MuHash3072& MuHash3072::Insert(const unsigned char* data, size_t len)
+{
+    numerator.Multiply(ToNum3072(data, len));
+    return *this;
+}
+
+MuHash3072& MuHash3072::Remove(const unsigned char* data, size_t len)
+{
+    denominator.Multiply(ToNum3072(data, len));
+    return *this;
+}
+
+MuHash3072& MuHash3072::operator*=(const MuHash3072& mul)
+{
+    numerator.Multiply(mul.numerator);
+    denominator.Multiply(mul.denominator);
+    return *this;
+}
+
+MuHash3072& MuHash3072::operator/=(const MuHash3072& div)
+{
+    numerator.Multiply(div.denominator);
+    denominator.Multiply(div.numerator);
+    return *this;
+}
+
+void MuHash3072::Finalize(unsigned char hash[OUTPUT_SIZE]) const
+{
+    Num3072 result = numerator;
+    result.Divide(denominator);
+
+    unsigned char data[Num3072::BYTE_SIZE];
+    result.ToBytes(data);
+    CSHA256().Write(data, sizeof(data)).Finalize(hash);
+}
+
+void MuHash3072::ToBytes(unsigned char (&out)[SERIALIZED_SIZE]) const
+{
+    unsigned char num[Num3072::BYTE_SIZE], den[Num3072::BYTE_SIZE];
+    numerator.ToBytes(num);
+    denominator.ToBytes(den);
+    memcpy(out, num, sizeof(num));
+    memcpy(out + sizeof(num), den, sizeof(den));
+}
+
+void MuHash3072::FromBytes(const unsigned char (&in)[SERIALIZED_SIZE])
+{
+    unsigned char num[Num3072::BYTE_SIZE], den[Num3072::BYTE_SIZE];
+    memcpy(num, in, sizeof(num));
+    memcpy(den, in + sizeof(num), sizeof(den));
+    numerator = Num3072(num);
+    denominator = Num3072(den);
+}
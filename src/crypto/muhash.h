@@ -0,0 +1,75 @@
+// Copyright (c) 2017-2019 The Bitcoin Core developers
+// Copyright (c) 2019 The TRBO developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_CRYPTO_MUHASH_H
+#define BITCOIN_CRYPTO_MUHASH_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/** An element of the multiplicative group of integers modulo 2^3072 - 1103717 */
+class Num3072
+{
+public:
+    static const int LIMBS = 96;
+    static const int BYTE_SIZE = LIMBS * 4;
+    static const uint32_t MAX_PRIME_DIFF = 1103717;
+
+    uint32_t limbs[LIMBS];
+
+    Num3072();
+    explicit Num3072(const unsigned char (&data)[BYTE_SIZE]);
+
+    void Multiply(const Num3072& a);
+    void Divide(const Num3072& a);
+    void ToBytes(unsigned char (&out)[BYTE_SIZE]) const;
+
+private:
+    bool IsOverflow() const;
+    void FullReduce();
+    Num3072 GetInverse() const;
+};
+
+/**
+ * A rolling hash of a set of byte strings (MuHash). Elements are hashed to
+ * numbers modulo a 3072-bit prime and multiplied together; removal divides
+ * them out again. The order of insertions and removals does not matter, so
+ * the hash of a set can be updated as elements come and go instead of being
+ * recomputed from all of them.
+ *
+ * Division is deferred by keeping a numerator and a denominator, which makes
+ * Insert and Remove one multiplication each. Finalize performs the single
+ * modular inverse.
+ */
+class MuHash3072
+{
+private:
+    Num3072 numerator;
+    Num3072 denominator;
+
+    static Num3072 ToNum3072(const unsigned char* data, size_t len);
+
+public:
+    static const size_t OUTPUT_SIZE = 32;
+    static const size_t SERIALIZED_SIZE = 2 * Num3072::BYTE_SIZE;
+
+    /** The hash of the empty set */
+    MuHash3072() {}
+
+    MuHash3072& Insert(const unsigned char* data, size_t len);
+    MuHash3072& Remove(const unsigned char* data, size_t len);
+
+    /** Add or remove all elements of another set */
+    MuHash3072& operator*=(const MuHash3072& mul);
+    MuHash3072& operator/=(const MuHash3072& div);
+
+    void Finalize(unsigned char hash[OUTPUT_SIZE]) const;
+
+    /** Raw state, for storing an unfinalized hash */
+    void ToBytes(unsigned char (&out)[SERIALIZED_SIZE]) const;
+    void FromBytes(const unsigned char (&in)[SERIALIZED_SIZE]);
+};
+
+#endif // BITCOIN_CRYPTO_MUHASH_H
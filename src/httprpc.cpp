@@ -12,6 +12,7 @@
 #include "ui_interface.h"
 
 #include <boost/algorithm/string.hpp> // boost::trim
+#include <boost/bind.hpp>
 
 /** Simple one-shot callback timer to be used by the RPC mechanism to e.g.
  * re-lock the wellet.
@@ -117,24 +118,31 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
         if (!valRequest.read(req->ReadBody()))
             throw JSONRPCError(RPC_PARSE_ERROR, "Parse error");
 
-        std::string strReply;
         // singleton request
         if (valRequest.isObject()) {
             jreq.parse(valRequest);
 
             UniValue result = tableRPC.execute(jreq.strMethod, jreq.params);
 
-            // Send reply
-            strReply = JSONRPCReply(result, NullUniValue, jreq.id);
+            // Send reply, streamed so that large results are never copied into one string
+            req->WriteHeader("Content-Type", "application/json");
+            HTTPReplyStream reply(req, HTTP_OK);
+            CJSONStreamWriter writer(boost::bind(&HTTPReplyStream::Write, &reply, _1));
+            JSONRPCWriteReply(writer, result, NullUniValue, jreq.id);
+            reply.Finish();
 
         // array of requests
-        } else if (valRequest.isArray())
-            strReply = JSONRPCExecBatch(valRequest.get_array());
-        else
+        } else if (valRequest.isArray()) {
+            UniValue replies = JSONRPCExecBatch(valRequest.get_array());
+
+            req->WriteHeader("Content-Type", "application/json");
+            HTTPReplyStream reply(req, HTTP_OK);
+            CJSONStreamWriter writer(boost::bind(&HTTPReplyStream::Write, &reply, _1));
+            writer.Write(replies);
+            writer.Finish();
+            reply.Finish();
+        } else
             throw JSONRPCError(RPC_PARSE_ERROR, "Top-level object parse error");
-
-        req->WriteHeader("Content-Type", "application/json");
-        req->WriteReply(HTTP_OK, strReply);
     } catch (const UniValue& objError) {
         JSONErrorReply(req, objError, jreq.id);
         return false;
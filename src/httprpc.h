@@ -22,6 +22,9 @@ void InterruptHTTPRPC();
  */
 void StopHTTPRPC();
 
+/** Default for -restmaxresponse, in megabytes */
+static const unsigned int DEFAULT_REST_MAX_RESPONSE = 32;
+
 /** Start HTTP REST subsystem.
  * Precondition; HTTP and RPC has been started.
  */
@@ -61,6 +61,22 @@ private:
     HTTPRequestHandler func;
 };
 
+/** Work item running an arbitrary task on a worker thread */
+class HTTPTaskItem : public HTTPClosure
+{
+public:
+    HTTPTaskItem(const boost::function<void(void)>& func): func(func)
+    {
+    }
+    void operator()()
+    {
+        func();
+    }
+
+private:
+    boost::function<void(void)> func;
+};
+
 /** Simple work queue for distributing work over multiple threads.
  * Work items are simply callable objects.
  */
@@ -186,6 +202,8 @@ struct evhttp* eventHTTP = 0;
 static std::vector<CSubNet> rpc_allow_subnets;
 //! Work queue for handling longer requests off the event loop thread
 static WorkQueue<HTTPClosure>* workQueue = 0;
+//! Number of threads serving the work queue
+static int nWorkerThreads = 0;
 //! Handlers for (sub)paths
 std::vector<HTTPPathHandler> pathHandlers;
 std::vector<evhttp_bound_socket *> boundSockets;
@@ -447,6 +465,7 @@ bool StartHTTPServer()
     LogPrint("http", "Starting HTTP server\n");
     int rpcThreads = std::max((long)GetArg("-rpcthreads", DEFAULT_HTTP_THREADS), 1L);
     LogPrintf("HTTP: starting %d worker threads\n", rpcThreads);
+    nWorkerThreads = rpcThreads;
     threadHTTP = boost::thread(boost::bind(&ThreadHTTP, eventBase, eventHTTP));
 
     for (int i = 0; i < rpcThreads; i++)
@@ -474,6 +493,8 @@ void StopHTTPServer()
         LogPrint("http", "Waiting for HTTP worker threads to exit\n");
         workQueue->WaitExit();
         delete workQueue;
+        workQueue = 0;
+        nWorkerThreads = 0;
     }
     MilliSleep(500); // Avoid race condition while the last HTTP-thread is exiting
     if (eventBase) {
@@ -537,12 +558,16 @@ void HTTPEvent::trigger(struct timeval* tv)
         evtimer_add(ev, tv); // trigger after timeval passed
 }
 HTTPRequest::HTTPRequest(struct evhttp_request* req) : req(req),
-                                                       replySent(false)
+                                                       replySent(false),
+                                                       chunked(false)
 {
 }
 HTTPRequest::~HTTPRequest()
 {
-    if (!replySent) {
+    if (chunked && !replySent) {
+        LogPrintf("%s: Unfinished chunked reply\n", __func__);
+        AbortChunkedReply();
+    } else if (!replySent) {
         // Keep track of whether reply was sent to avoid request leaks
         LogPrintf("%s: Unhandled request\n", __func__);
         WriteReply(HTTP_INTERNAL, "Unhandled request");
@@ -607,6 +632,154 @@ void HTTPRequest::WriteReply(int nStatus, const std::string& strReply)
     req = 0; // transferred back to main thread
 }
 
+/** Pass a chunk to evhttp in the main http thread. evhttp copies the data,
+ * so the buffer is freed right away.
+ */
+static void http_send_reply_chunk(struct evhttp_request* req, struct evbuffer* evb)
+{
+    evhttp_send_reply_chunk(req, evb);
+    evbuffer_free(evb);
+}
+
+void HTTPRequest::StartChunkedReply(int nStatus)
+{
+    assert(!replySent && !chunked && req);
+    HTTPEvent* ev = new HTTPEvent(eventBase, true,
+        boost::bind(evhttp_send_reply_start, req, nStatus, (const char*)NULL));
+    ev->trigger(0);
+    chunked = true;
+}
+
+void HTTPRequest::WriteReplyChunk(const std::string& strChunk)
+{
+    assert(!replySent && chunked && req);
+    if (strChunk.empty()) // an empty chunk would end the reply
+        return;
+    struct evbuffer* evb = evbuffer_new();
+    assert(evb);
+    evbuffer_add(evb, strChunk.data(), strChunk.size());
+    HTTPEvent* ev = new HTTPEvent(eventBase, true, boost::bind(http_send_reply_chunk, req, evb));
+    ev->trigger(0);
+}
+
+bool HTTPRequest::WriteReplyFileChunk(FILE* file, const std::vector<HTTPFileRange>& vRanges)
+{
+    assert(!replySent && chunked && req && file);
+    struct evbuffer* evb = evbuffer_new();
+    assert(evb);
+    bool fOk = true;
+#if !defined(WIN32) && LIBEVENT_VERSION_NUMBER >= 0x02010100
+    // One segment covering all the pieces, so a single descriptor stays open
+    // until evhttp has sent the last of them
+    int64_t nBegin = 0, nEnd = 0;
+    BOOST_FOREACH (const HTTPFileRange& range, vRanges) {
+        if (range.nLength <= 0)
+            continue;
+        if (nEnd == 0 || range.nOffset < nBegin)
+            nBegin = range.nOffset;
+        nEnd = std::max(nEnd, range.nOffset + range.nLength);
+    }
+    struct evbuffer_file_segment* seg = NULL;
+    if (nEnd > 0) {
+        int fd = dup(fileno(file));
+        if (fd >= 0 && (seg = evbuffer_file_segment_new(fd, nBegin, nEnd - nBegin, EVBUF_FS_CLOSE_ON_FREE)) == NULL)
+            close(fd);
+        fOk = seg != NULL;
+    }
+    for (std::vector<HTTPFileRange>::const_iterator it = vRanges.begin(); fOk && it != vRanges.end(); ++it) {
+        evbuffer_add(evb, it->strPrefix.data(), it->strPrefix.size());
+        if (it->nLength > 0 && evbuffer_add_file_segment(evb, seg, it->nOffset - nBegin, it->nLength) != 0)
+            fOk = false;
+    }
+    if (seg)
+        evbuffer_file_segment_free(seg); // evb holds its own references
+#else
+    // No file segments to hand to evhttp here, read the data instead
+    std::string strData;
+    for (std::vector<HTTPFileRange>::const_iterator it = vRanges.begin(); fOk && it != vRanges.end(); ++it) {
+        evbuffer_add(evb, it->strPrefix.data(), it->strPrefix.size());
+        if (it->nLength <= 0)
+            continue;
+        strData.resize(it->nLength);
+        if (fseek(file, it->nOffset, SEEK_SET) != 0 || fread(&strData[0], 1, it->nLength, file) != (size_t)it->nLength)
+            fOk = false;
+        else
+            evbuffer_add(evb, strData.data(), strData.size());
+    }
+#endif
+    fclose(file);
+    if (!fOk) {
+        LogPrintf("%s: failed to add the file to the reply\n", __func__);
+        evbuffer_free(evb);
+        return false;
+    }
+    if (evbuffer_get_length(evb) == 0) { // an empty chunk would end the reply
+        evbuffer_free(evb);
+        return true;
+    }
+    HTTPEvent* ev = new HTTPEvent(eventBase, true, boost::bind(http_send_reply_chunk, req, evb));
+    ev->trigger(0);
+    return true;
+}
+
+void HTTPRequest::EndChunkedReply()
+{
+    assert(!replySent && chunked && req);
+    HTTPEvent* ev = new HTTPEvent(eventBase, true, boost::bind(evhttp_send_reply_end, req));
+    ev->trigger(0);
+    replySent = true;
+    req = 0; // transferred back to main thread
+}
+
+/** Drop the connection of a request in the main http thread. evhttp frees the
+ * request with it, and the client sees the chunked body was never finished.
+ */
+static void http_abort_reply(struct evhttp_request* req)
+{
+    struct evhttp_connection* evcon = evhttp_request_get_connection(req);
+    if (evcon)
+        evhttp_connection_free(evcon);
+}
+
+void HTTPRequest::AbortChunkedReply()
+{
+    assert(!replySent && chunked && req);
+    HTTPEvent* ev = new HTTPEvent(eventBase, true, boost::bind(http_abort_reply, req));
+    ev->trigger(0);
+    replySent = true;
+    req = 0; // transferred back to main thread
+}
+
+HTTPReplyStream::HTTPReplyStream(HTTPRequest* reqIn, int nStatusIn) : req(reqIn),
+                                                                      nStatus(nStatusIn),
+                                                                      fChunked(false)
+{
+}
+
+void HTTPReplyStream::Write(const std::string& strData)
+{
+    if (!fChunked && strPending.empty()) {
+        // Hold back the first piece, it may turn out to be the whole body
+        strPending = strData;
+        return;
+    }
+    if (!fChunked) {
+        req->StartChunkedReply(nStatus);
+        req->WriteReplyChunk(strPending);
+        strPending.clear();
+        fChunked = true;
+    }
+    req->WriteReplyChunk(strData);
+}
+
+void HTTPReplyStream::Finish()
+{
+    if (fChunked)
+        req->EndChunkedReply();
+    else
+        req->WriteReply(nStatus, strPending);
+}
+
 CService HTTPRequest::GetPeer()
 {
     evhttp_connection* con = evhttp_request_get_connection(req);
@@ -647,6 +820,22 @@ HTTPRequest::RequestMethod HTTPRequest::GetRequestMethod()
     }
 }
 
+bool HTTPEnqueueTask(const boost::function<void(void)>& func)
+{
+    if (!workQueue)
+        return false;
+    std::unique_ptr<HTTPTaskItem> item(new HTTPTaskItem(func));
+    if (!workQueue->Enqueue(item.get()))
+        return false;
+    item.release(); /* if true, queue took ownership */
+    return true;
+}
+
+int HTTPWorkerThreads()
+{
+    return nWorkerThreads;
+}
+
 void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPRequestHandler &handler)
 {
     LogPrint("http", "Registering HTTP handler for %s (exactmatch %d)\n", prefix, exactMatch);
@@ -6,7 +6,9 @@
 #define BITCOIN_HTTPSERVER_H
 
 #include <string>
+#include <vector>
 #include <stdint.h>
+#include <stdio.h>
 #include <boost/thread.hpp>
 #include <boost/scoped_ptr.hpp>
 #include <boost/function.hpp>
@@ -21,6 +23,16 @@ struct event_base;
 class CService;
 class HTTPRequest;
 
+/** A piece of a file sent by HTTPRequest::WriteReplyFileChunk, after strPrefix */
+struct HTTPFileRange
+{
+    std::string strPrefix;
+    int64_t nOffset;
+    int64_t nLength;
+
+    HTTPFileRange(const std::string& strPrefixIn, int64_t nOffsetIn, int64_t nLengthIn) : strPrefix(strPrefixIn), nOffset(nOffsetIn), nLength(nLengthIn) {}
+};
+
 /** Initialize HTTP server.
  * Call this before RegisterHTTPHandler or EventBase().
  */
@@ -45,6 +57,13 @@ void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPR
 /** Unregister handler for prefix */
 void UnregisterHTTPHandler(const std::string &prefix, bool exactMatch);
 
+/** Run a task on one of the HTTP worker threads. Returns false if the work
+ * queue is not running or is full, in which case the task was not queued.
+ */
+bool HTTPEnqueueTask(const boost::function<void(void)>& func);
+/** Number of HTTP worker threads (-rpcthreads), 0 if the server is not running */
+int HTTPWorkerThreads();
+
 /** Return evhttp event base. This can be used by submodules to
  * queue timers or custom events.
  */
@@ -58,6 +77,7 @@ class HTTPRequest
 private:
     struct evhttp_request* req;
     bool replySent;
+    bool chunked;
 
 public:
     HTTPRequest(struct evhttp_request* req);
@@ -113,6 +133,51 @@ public:
      * main thread, do not call any other HTTPRequest methods after calling this.
      */
     void WriteReply(int nStatus, const std::string& strReply = "");
+
+    /**
+     * Start a reply whose body follows in pieces with WriteReplyChunk, sent
+     * with chunked transfer encoding. The reply is completed by
+     * EndChunkedReply, after which the same restrictions as for WriteReply
+     * apply.
+     */
+    void StartChunkedReply(int nStatus);
+    void WriteReplyChunk(const std::string& strChunk);
+    /**
+     * Send pieces of file as the next chunk, each preceded by its prefix.
+     * evhttp sends the data straight from the file, using sendfile or mmap
+     * where the platform supports it, through a single descriptor for all
+     * the pieces. Takes ownership of file. Returns false, having sent
+     * nothing, if the file could not be handed over or read.
+     */
+    bool WriteReplyFileChunk(FILE* file, const std::vector<HTTPFileRange>& vRanges);
+    void EndChunkedReply();
+    /**
+     * Give up on a chunked reply that failed half way. The connection is
+     * dropped without the final chunk, so the client sees the body was cut
+     * off instead of taking it for a complete one. The same restrictions as
+     * for WriteReply apply afterwards.
+     */
+    void AbortChunkedReply();
+};
+
+/** Sends a reply body that is produced in pieces. The body goes out with
+ * chunked transfer encoding once it grows beyond the first piece; bodies
+ * that fit in one piece are sent as an ordinary reply.
+ */
+class HTTPReplyStream
+{
+private:
+    HTTPRequest* req;
+    int nStatus;
+    bool fChunked;
+    std::string strPending;
+
+public:
+    HTTPReplyStream(HTTPRequest* reqIn, int nStatusIn);
+
+    void Write(const std::string& strData);
+    /** Complete the reply. Call once, after the last Write */
+    void Finish();
 };
 
 /** Event handler closure.
@@ -15,7 +15,9 @@
 #include "activemasternode.h"
 #include "addrman.h"
 #include "amount.h"
+#include "blockfilterindex.h"
 #include "checkpoints.h"
+#include "coinstatsindex.h"
 #include "compat/sanity.h"
 #include "consensus/validation.h"
 #include "httpserver.h"
@@ -23,14 +25,18 @@
 #include "key.h"
 #include "main.h"
 #include "masternode-budget.h"
+#include "masternode-collateral.h"
 #include "masternode-payments.h"
+#include "masternode-tasks.h"
 #include "masternodeconfig.h"
 #include "masternodeman.h"
 #include "miner.h"
+#include "mnstoredb.h"
 #include "net.h"
 #include "rpcserver.h"
 #include "script/standard.h"
 #include "scheduler.h"
+#include "snapshot.h"
 #include "spork.h"
 #include "sporkdb.h"
 #include "txdb.h"
@@ -161,7 +167,6 @@ public:
     // Writes do not need similar protection, as failure to write is handled by the caller.
 };
 
-static CCoinsViewDB* pcoinsdbview = NULL;
 static CCoinsViewErrorCatcher* pcoinscatcher = NULL;
 
 void Interrupt(boost::thread_group& threadGroup)
@@ -201,9 +206,12 @@ void PrepareShutdown()
     GenerateBitcoins(false, NULL, 0);
 #endif
     StopNode();
+    // The scheduler thread is not joined when init failed part of the way
+    StopMasternodeTasks();
     DumpMasternodes();
     DumpBudgets();
     DumpMasternodePayments();
+    CloseMasternodeStore();
     UnregisterNodeSignals(GetNodeSignals());
 
     if (fFeeEstimatesInitialized) {
@@ -234,6 +242,10 @@ void PrepareShutdown()
         pblocktree = NULL;
         delete pSporkDB;
         pSporkDB = NULL;
+        delete pblockfilterindex;
+        pblockfilterindex = NULL;
+        delete pcoinstatsindex;
+        pcoinstatsindex = NULL;
     }
 #ifdef ENABLE_WALLET
     if (pwalletMain)
@@ -280,6 +292,7 @@ void Shutdown()
     pwalletMain = NULL;
 #endif
     LogPrintf("%s: done\n", __func__);
+    StopLogWriter();
 }
 
 /**
@@ -351,6 +364,7 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-datadir=<dir>", _("Specify data directory"));
     strUsage += HelpMessageOpt("-dbcache=<n>", strprintf(_("Set database cache size in megabytes (%d to %d, default: %d)"), nMinDbCache, nMaxDbCache, nDefaultDbCache));
     strUsage += HelpMessageOpt("-loadblock=<file>", _("Imports blocks from external blk000??.dat file") + " " + _("on startup"));
+    strUsage += HelpMessageOpt("-loadsnapshot=<file>", _("Start from a chainstate snapshot written by dumpsnapshot instead of downloading the block chain (only with an empty data directory)"));
     strUsage += HelpMessageOpt("-maxreorg=<n>", strprintf(_("Set the Maximum reorg depth (default: %u)"), Params(CBaseChainParams::MAIN).MaxReorganizationDepth()));
     strUsage += HelpMessageOpt("-maxorphantx=<n>", strprintf(_("Keep at most <n> unconnectable transactions in memory (default: %u)"), DEFAULT_MAX_ORPHAN_TRANSACTIONS));
     strUsage += HelpMessageOpt("-par=<n>", strprintf(_("Set the number of script verification threads (%u to %d, 0 = auto, <0 = leave that many cores free, default: %d)"), -(int)boost::thread::hardware_concurrency(), MAX_SCRIPTCHECK_THREADS, DEFAULT_SCRIPTCHECK_THREADS));
@@ -360,10 +374,14 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-reindex", _("Rebuild block chain index from current blk000??.dat files") + " " + _("on startup"));
     strUsage += HelpMessageOpt("-reindexmoneysupply", _("Reindex the TRBO and zTRBO money supply statistics") + " " + _("on startup"));
     strUsage += HelpMessageOpt("-resync", _("Delete blockchain folders and resync from scratch") + " " + _("on startup"));
+    strUsage += HelpMessageOpt("-snapshothash=<hex>", _("Refuse a -loadsnapshot file unless its UTXO set hash (hash_serialized of gettxoutsetinfo) matches"));
 #if !defined(WIN32)
     strUsage += HelpMessageOpt("-sysperms", _("Create new files with system default permissions, instead of umask 077 (only effective with disabled wallet functionality)"));
 #endif
+    strUsage += HelpMessageOpt("-txcachesize=<n>", strprintf(_("Keep at most <n> recently looked up transactions in memory (default: %u)"), DEFAULT_TX_CACHE_SIZE));
     strUsage += HelpMessageOpt("-txindex", strprintf(_("Maintain a full transaction index, used by the getrawtransaction rpc call (default: %u)"), 0));
+    strUsage += HelpMessageOpt("-blockfilterindex", strprintf(_("Maintain an index of compact block filters by block, used by the getcfilters p2p messages and the /rest/blockfilter/ endpoint (default: %u)"), DEFAULT_BLOCKFILTERINDEX));
+    strUsage += HelpMessageOpt("-coinstatsindex", strprintf(_("Maintain UTXO set statistics by block, used by the gettxoutsetinfo rpc call (default: %u)"), DEFAULT_COINSTATSINDEX));
     strUsage += HelpMessageOpt("-addrindex", strprintf(_("Maintain a full address index, used by the searchrawtransactions rpc call (default: %u)"), 0));
     strUsage += HelpMessageOpt("-forcestart", _("Attempt to force blockchain corruption recovery") + " " + _("on startup"));
 
@@ -387,6 +405,7 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-onlynet=<net>", _("Only connect to nodes in network <net> (ipv4, ipv6 or onion)"));
     strUsage += HelpMessageOpt("-permitbaremultisig", strprintf(_("Relay non-P2SH multisig (default: %u)"), 1));
     strUsage += HelpMessageOpt("-peerbloomfilters", strprintf(_("Support filtering of blocks and transaction with bloom filters (default: %u)"), DEFAULT_PEERBLOOMFILTERS));
+    strUsage += HelpMessageOpt("-peerblockfilters", strprintf(_("Serve compact block filters to peers per BIP 157 (default: %u)"), DEFAULT_PEERBLOCKFILTERS));
     strUsage += HelpMessageOpt("-port=<port>", strprintf(_("Listen for connections on <port> (default: %u or testnet: %u)"), 9533, 9544));
     strUsage += HelpMessageOpt("-proxy=<ip:port>", _("Connect through SOCKS5 proxy"));
     strUsage += HelpMessageOpt("-proxyrandomize", strprintf(_("Randomize credentials for every proxy connection. This enables Tor stream isolation (default: %u)"), 1));
@@ -479,6 +498,7 @@ std::string HelpMessage(HelpMessageMode mode)
 #endif
     strUsage += HelpMessageOpt("-help-debug", _("Show all debugging options (usage: --help -help-debug)"));
     strUsage += HelpMessageOpt("-logips", strprintf(_("Include IP addresses in debug output (default: %u)"), 0));
+    strUsage += HelpMessageOpt("-logthread", strprintf(_("Write debug.log from a separate thread, dropping -debug output rather than slowing down the node when it falls behind (default: %u)"), 1));
     strUsage += HelpMessageOpt("-logtimestamps", strprintf(_("Prepend debug output with timestamp (default: %u)"), 1));
     if (GetBoolArg("-help-debug", false)) {
         strUsage += HelpMessageOpt("-limitfreerelay=<n>", strprintf(_("Continuously rate-limit free transactions to <n>*1000 bytes per minute (default:%u)"), 15));
@@ -537,6 +557,7 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageGroup(_("RPC server options:"));
     strUsage += HelpMessageOpt("-server", _("Accept command line and JSON-RPC commands"));
     strUsage += HelpMessageOpt("-rest", strprintf(_("Accept public REST requests (default: %u)"), 0));
+    strUsage += HelpMessageOpt("-restmaxresponse=<n>", strprintf(_("Maximum size in megabytes of a REST block or undo range response (default: %u)"), DEFAULT_REST_MAX_RESPONSE));
     strUsage += HelpMessageOpt("-rpcbind=<addr>", _("Bind to given address to listen for JSON-RPC connections. Use [host]:port notation for IPv6. This option can be specified multiple times (default: bind to all interfaces)"));
     strUsage += HelpMessageOpt("-rpccookiefile=<loc>", _("Location of the auth cookie (default: data dir)"));
     strUsage += HelpMessageOpt("-rpcuser=<user>", _("Username for JSON-RPC connections"));
@@ -858,11 +879,21 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler, const std
 
     // ********************************************************* Step 3: parameter-to-internal-flags
 
-    fDebug = !mapMultiArgs["-debug"].empty();
-    // Special-case: if -debug=0/-nodebug is set, turn off debugging messages
+    uint64_t nLogCategories = LOG_NONE;
     const vector<string>& categories = mapMultiArgs["-debug"];
-    if (GetBoolArg("-nodebug", false) || find(categories.begin(), categories.end(), string("0")) != categories.end())
-        fDebug = false;
+    // Special-case: if -debug=0/-nodebug is set, turn off debugging messages
+    if (!GetBoolArg("-nodebug", false) && find(categories.begin(), categories.end(), string("0")) == categories.end()) {
+        for (const string& category : categories) {
+            uint64_t flags;
+            if (!GetLogCategory(category, flags)) {
+                InitWarning(strprintf(_("Unsupported logging category %s=%s."), "-debug", category));
+                continue;
+            }
+            nLogCategories |= flags;
+        }
+    }
+    logCategories = nLogCategories;
+    fDebug = nLogCategories != LOG_NONE;
 
     // Check for -debugnet
     if (GetBoolArg("-debugnet", false))
@@ -981,6 +1012,12 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler, const std
     if (GetBoolArg("-peerbloomfilters", DEFAULT_PEERBLOOMFILTERS))
         nLocalServices |= NODE_BLOOM;
 
+    if (GetBoolArg("-peerblockfilters", DEFAULT_PEERBLOCKFILTERS)) {
+        if (!GetBoolArg("-blockfilterindex", DEFAULT_BLOCKFILTERINDEX))
+            return InitError(_("Cannot set -peerblockfilters without -blockfilterindex."));
+        nLocalServices |= NODE_COMPACT_FILTERS;
+    }
+
     // ********************************************************* Step 4: application initialization: dir lock, daemonize, pidfile, debug log
 
     // Sanity check
@@ -1008,6 +1045,8 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler, const std
 #endif
     if (GetBoolArg("-shrinkdebugfile", !fDebug))
         ShrinkDebugFile();
+    if (GetBoolArg("-logthread", true))
+        StartLogWriter();
     LogPrintf("\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n");
     LogPrintf("TRBO version %s (%s)\n", FormatFullVersion(), CLIENT_DATE);
     LogPrintf("Using OpenSSL version %s\n", SSLeay_version(SSLEAY_VERSION));
@@ -1363,9 +1402,20 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler, const std
     if (nBlockTreeDBCache > (1 << 21) && !GetBoolArg("-txindex", true) && !GetBoolArg("-addrindex", true))
         nBlockTreeDBCache = (1 << 21); // block tree db cache shouldn't be larger than 2 MiB
     nTotalCache -= nBlockTreeDBCache;
+    size_t nBlockFilterIndexCache = 0;
+    if (GetBoolArg("-blockfilterindex", DEFAULT_BLOCKFILTERINDEX)) {
+        nBlockFilterIndexCache = std::min(nTotalCache / 8, (size_t)(64 << 20)); // filter index cache shouldn't be larger than 64 MiB
+        nTotalCache -= nBlockFilterIndexCache;
+    }
+    size_t nCoinStatsIndexCache = 0;
+    if (GetBoolArg("-coinstatsindex", DEFAULT_COINSTATSINDEX)) {
+        nCoinStatsIndexCache = std::min(nTotalCache / 8, (size_t)(8 << 20)); // entries are only read back for rpc calls, 8 MiB is plenty
+        nTotalCache -= nCoinStatsIndexCache;
+    }
     size_t nCoinDBCache = nTotalCache / 2; // use half of the remaining cache for coindb cache
     nTotalCache -= nCoinDBCache;
     nCoinCacheSize = nTotalCache / 300; // coins in memory require around 300 bytes
+    nTxCacheSize = std::max((int64_t)0, GetArg("-txcachesize", DEFAULT_TX_CACHE_SIZE));
 
     bool fLoaded = false;
     while (!fLoaded) {
@@ -1383,10 +1433,18 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler, const std
                 delete pcoinscatcher;
                 delete pblocktree;
                 delete pSporkDB;
+                delete pblockfilterindex;
+                pblockfilterindex = NULL;
+                delete pcoinstatsindex;
+                pcoinstatsindex = NULL;
 
                 pSporkDB = new CSporkDB(0, false, false);
 
                 pblocktree = new CBlockTreeDB(nBlockTreeDBCache, false, fReindex);
+                if (GetBoolArg("-blockfilterindex", DEFAULT_BLOCKFILTERINDEX))
+                    pblockfilterindex = new CBlockFilterIndex(BLOCK_FILTER_BASIC, nBlockFilterIndexCache, false, fReindex);
+                if (GetBoolArg("-coinstatsindex", DEFAULT_COINSTATSINDEX))
+                    pcoinstatsindex = new CCoinStatsIndex(nCoinStatsIndexCache, false, fReindex);
                 pcoinsdbview = new CCoinsViewDB(nCoinDBCache, false, fReindex);
                 pcoinscatcher = new CCoinsViewErrorCatcher(pcoinsdbview);
                 pcoinsTip = new CCoinsViewCache(pcoinscatcher);
@@ -1394,6 +1452,31 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler, const std
                 if (fReindex)
                     pblocktree->WriteReindexing(true);
 
+                // Bootstrap an empty chainstate from a snapshot
+                if (mapArgs.count("-loadsnapshot")) {
+                    if (fReindex || pcoinsdbview->GetBestBlock() != 0) {
+                        LogPrintf("Chainstate is not empty, ignoring -loadsnapshot\n");
+                    } else {
+                        uiInterface.InitMessage(_("Loading chainstate snapshot..."));
+                        boost::filesystem::path pathSnapshot = GetArg("-loadsnapshot", "");
+                        if (!pathSnapshot.is_complete())
+                            pathSnapshot = GetDataDir() / pathSnapshot;
+                        uint256 hashExpected(0);
+                        if (mapArgs.count("-snapshothash")) {
+                            if (!IsHex(mapArgs["-snapshothash"]) || mapArgs["-snapshothash"].size() != 64)
+                                return InitError(_("Invalid -snapshothash, expected a 64 character hex hash"));
+                            hashExpected.SetHex(mapArgs["-snapshothash"]);
+                        }
+                        CChainStateSnapshotInfo info;
+                        std::string strSnapshotError;
+                        if (!LoadChainStateSnapshot(pathSnapshot, hashExpected, info, strSnapshotError))
+                            return InitError(strprintf(_("Unable to load chainstate snapshot %s: %s"), pathSnapshot.string(), strSnapshotError));
+                        // There are no blocks below the snapshot to build the coin stats from
+                        if (pcoinstatsindex && !pcoinstatsindex->SeedFromCoins(pcoinsdbview))
+                            return InitError(_("Unable to start the coin stats index from the snapshot"));
+                    }
+                }
+
                 // TRBO: load previous sessions sporks if we have them.
                 uiInterface.InitMessage(_("Loading sporks..."));
                 LoadSporksFromDB();
@@ -1428,9 +1511,13 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler, const std
                     break;
                 }
 
-                // Recalculate money supply
-                if (GetBoolArg("-reindexmoneysupply", false)) {
-                    RecalculateTRBOSupply(1);
+                // Recalculate money supply, or finish a recalculation that was interrupted
+                if (GetBoolArg("-reindexmoneysupply", false) || IsSupplyRecalculationPending()) {
+                    uiInterface.InitMessage(_("Recalculating money supply..."));
+                    if (!RecalculateTRBOSupply(1)) {
+                        strLoadError = _("Error recalculating money supply");
+                        break;
+                    }
                 }
 
                 if (!fReindex) {
@@ -1692,56 +1779,34 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler, const std
             MilliSleep(10);
     }
 
-    // ********************************************************* Step 10: setup ObfuScation
+    // Index the block filters of blocks connected before -blockfilterindex was enabled
+    if (pblockfilterindex)
+        threadGroup.create_thread(boost::bind(&ThreadBlockFilterIndexSync));
 
-    uiInterface.InitMessage(_("Loading masternode cache..."));
+    // Likewise for the UTXO statistics
+    if (pcoinstatsindex)
+        threadGroup.create_thread(boost::bind(&ThreadCoinStatsIndexSync));
 
-    CMasternodeDB mndb;
-    CMasternodeDB::ReadResult readResult = mndb.Read(mnodeman);
-    if (readResult == CMasternodeDB::FileError)
-        LogPrintf("Missing masternode cache file - mncache.dat, will try to recreate\n");
-    else if (readResult != CMasternodeDB::Ok) {
-        LogPrintf("Error reading mncache.dat: ");
-        if (readResult == CMasternodeDB::IncorrectFormat)
-            LogPrintf("magic is ok but data has invalid format, will try to recreate\n");
-        else
-            LogPrintf("file format is unknown or invalid, please fix it manually\n");
-    }
+    // ********************************************************* Step 10: setup ObfuScation
 
-    uiInterface.InitMessage(_("Loading budget cache..."));
+    if (!OpenMasternodeStore())
+        return InitError(_("Error opening the masternode store"));
 
-    CBudgetDB budgetdb;
-    CBudgetDB::ReadResult readResult2 = budgetdb.Read(budget);
+    uiInterface.InitMessage(_("Loading masternode cache..."));
+    if (!LoadMasternodes())
+        LogPrintf("Error reading the masternode list from the masternode store, will try to recreate\n");
 
-    if (readResult2 == CBudgetDB::FileError)
-        LogPrintf("Missing budget cache - budget.dat, will try to recreate\n");
-    else if (readResult2 != CBudgetDB::Ok) {
-        LogPrintf("Error reading budget.dat: ");
-        if (readResult2 == CBudgetDB::IncorrectFormat)
-            LogPrintf("magic is ok but data has invalid format, will try to recreate\n");
-        else
-            LogPrintf("file format is unknown or invalid, please fix it manually\n");
-    }
+    uiInterface.InitMessage(_("Loading budget cache..."));
+    if (!LoadBudgets())
+        LogPrintf("Error reading the budgets from the masternode store, will try to recreate\n");
 
     //flag our cached items so we send them to our peers
     budget.ResetSync();
     budget.ClearSeen();
 
-
     uiInterface.InitMessage(_("Loading masternode payment cache..."));
-
-    CMasternodePaymentDB mnpayments;
-    CMasternodePaymentDB::ReadResult readResult3 = mnpayments.Read(masternodePayments);
-
-    if (readResult3 == CMasternodePaymentDB::FileError)
-        LogPrintf("Missing masternode payment cache - mnpayments.dat, will try to recreate\n");
-    else if (readResult3 != CMasternodePaymentDB::Ok) {
-        LogPrintf("Error reading mnpayments.dat: ");
-        if (readResult3 == CMasternodePaymentDB::IncorrectFormat)
-            LogPrintf("magic is ok but data has invalid format, will try to recreate\n");
-        else
-            LogPrintf("file format is unknown or invalid, please fix it manually\n");
-    }
+    if (!LoadMasternodePayments())
+        LogPrintf("Error reading the masternode payments from the masternode store, will try to recreate\n");
 
     fMasterNode = GetBoolArg("-masternode", false);
 
@@ -1835,7 +1900,9 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler, const std
 
     obfuScationPool.InitCollateralAddress();
 
-    threadGroup.create_thread(boost::bind(&ThreadCheckObfuScationPool));
+    if (!fLiteMode)
+        RegisterValidationInterface(&collateralWatcher);
+    StartMasternodeTasks(scheduler);
 
     // ********************************************************* Step 11: start node
 
@@ -7,6 +7,9 @@
 
 #include "main.h"
 
+#include <list>
+#include <map>
+
 
 // MODIFIER_INTERVAL: time to elapse before new modifier is computed
 static const unsigned int MODIFIER_INTERVAL = 60;
@@ -26,10 +29,55 @@ bool ComputeNextStakeModifier(const CBlockIndex* pindexPrev, uint64_t& nStakeMod
 uint256 stakeHash(unsigned int nTimeTx, CDataStream ss, unsigned int prevoutIndex, uint256 prevoutHash, unsigned int nTimeBlockFrom);
 bool stakeTargetHit(uint256 hashProofOfStake, int64_t nValueIn, uint256 bnTargetPerCoinDay);
 bool CheckStakeKernelHash(unsigned int nBits, const CBlock blockFrom, const CTransaction txPrev, const COutPoint prevout, unsigned int& nTimeTx, unsigned int nHashDrift, bool fCheck, uint256& hashProofOfStake, bool fPrintProofOfStake = false);
+bool CheckStakeKernelHash(unsigned int nBits, const uint256& hashBlockFrom, unsigned int nTimeBlockFrom, int64_t nValueIn, const COutPoint& prevout, unsigned int& nTimeTx, unsigned int nHashDrift, bool fCheck, uint256& hashProofOfStake, bool fPrintProofOfStake = false);
+
+/**
+ * Bounded LRU of coinstake kernels that already passed CheckProofOfStake,
+ * keyed by block hash, so a block that is re-announced or re-accepted after
+ * a reorg does not have its kernel and signature checked again.
+ */
+class CStakeKernelCache
+{
+private:
+    typedef std::list<std::pair<uint256, uint256> > EntryList;
+    EntryList listEntries; //! most recently used first
+    std::map<uint256, EntryList::iterator> mapEntries;
+    size_t nMaxSize;
+
+public:
+    CStakeKernelCache(size_t nMaxSizeIn) : nMaxSize(nMaxSizeIn) {}
+
+    bool Get(const uint256& hashBlock, uint256& hashProofOfStake)
+    {
+        std::map<uint256, EntryList::iterator>::iterator it = mapEntries.find(hashBlock);
+        if (it == mapEntries.end())
+            return false;
+        listEntries.splice(listEntries.begin(), listEntries, it->second);
+        hashProofOfStake = it->second->second;
+        return true;
+    }
+
+    void Insert(const uint256& hashBlock, const uint256& hashProofOfStake)
+    {
+        uint256 hashCached;
+        if (Get(hashBlock, hashCached))
+            return;
+        listEntries.push_front(std::make_pair(hashBlock, hashProofOfStake));
+        mapEntries[hashBlock] = listEntries.begin();
+        while (listEntries.size() > nMaxSize) {
+            mapEntries.erase(listEntries.back().first);
+            listEntries.pop_back();
+        }
+    }
+};
+
+static const size_t STAKE_KERNEL_CACHE_SIZE = 5000;
+extern CStakeKernelCache stakeKernelCache;
 
 // Check kernel hash target and coinstake signature
-// Sets hashProofOfStake on success return
-bool CheckProofOfStake(const CBlock block, uint256& hashProofOfStake);
+// Sets hashProofOfStake on success return. pindexPrev is the block's parent;
+// when it is the active tip the stake input is taken from the chainstate.
+bool CheckProofOfStake(const CBlock& block, const CBlockIndex* pindexPrev, uint256& hashProofOfStake);
 
 // Check whether the coinstake timestamp meets protocol
 bool CheckCoinStakeTimestamp(int64_t nTimeBlock, int64_t nTimeTx);
@@ -2,6 +2,10 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#if defined(HAVE_CONFIG_H)
+#include "config/trbo-config.h"
+#endif
+
 #include "key.h"
 
 #include "crypto/hmac_sha512.h"
@@ -16,12 +20,21 @@
 //! anonymous namespace
 namespace
 {
+    /**
+     * Builds libsecp256k1's precomputed tables once for the life of the
+     * process: the signing table, and with USE_SECP256K1 also the table
+     * CPubKey uses to verify and recover.
+     */
     class CSecp256k1Init
     {
     public:
         CSecp256k1Init()
         {
+#ifdef USE_SECP256K1
+            secp256k1_start(SECP256K1_START_SIGN | SECP256K1_START_VERIFY);
+#else
             secp256k1_start(SECP256K1_START_SIGN);
+#endif
         }
         ~CSecp256k1Init()
         {
@@ -238,11 +251,10 @@ void CExtKey::Decode(const unsigned char code[74])
 
 bool ECC_InitSanityCheck()
 {
-#if !defined(USE_SECP256K1)
+    // OpenSSL still verifies signatures that are not strict DER
     if (!CECKey::SanityCheck()) {
         return false;
     }
-#endif
     CKey key;
     key.MakeNewKey(true);
     CPubKey pubkey = key.GetPubKey();
@@ -79,6 +79,7 @@ bool CBasicKeyStore::AddKeyPubKey(const CKey& key, const CPubKey& pubkey)
 {
     LOCK(cs_KeyStore);
     mapKeys[pubkey.GetID()] = key;
+    nKeyStoreGeneration++;
     ImplicitlyLearnRelatedKeyScripts(pubkey);
     return true;
 }
@@ -90,6 +91,7 @@ bool CBasicKeyStore::AddCScript(const CScript& redeemScript)
 
     LOCK(cs_KeyStore);
     mapScripts[CScriptID(redeemScript)] = redeemScript;
+    nKeyStoreGeneration++;
     return true;
 }
 
@@ -114,6 +116,7 @@ bool CBasicKeyStore::AddWatchOnly(const CScript& dest)
 {
     LOCK(cs_KeyStore);
     setWatchOnly.insert(dest);
+    nKeyStoreGeneration++;
     CPubKey pubKey;
     if (ExtractPubKey(dest, pubKey)) {
         mapWatchKeys[pubKey.GetID()] = pubKey;
@@ -126,6 +129,7 @@ bool CBasicKeyStore::RemoveWatchOnly(const CScript& dest)
 {
     LOCK(cs_KeyStore);
     setWatchOnly.erase(dest);
+    nKeyStoreGeneration++;
     CPubKey pubKey;
     if (ExtractPubKey(dest, pubKey)) {
         mapWatchKeys.erase(pubKey.GetID());
@@ -157,6 +161,7 @@ bool CBasicKeyStore::AddMultiSig(const CScript& dest)
 {
     LOCK(cs_KeyStore);
     setMultiSig.insert(dest);
+    nKeyStoreGeneration++;
     return true;
 }
 
@@ -164,6 +169,7 @@ bool CBasicKeyStore::RemoveMultiSig(const CScript& dest)
 {
     LOCK(cs_KeyStore);
     setMultiSig.erase(dest);
+    nKeyStoreGeneration++;
     return true;
 }
 
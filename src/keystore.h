@@ -72,10 +72,14 @@ protected:
     WatchOnlySet setWatchOnly;
     CHDChain hdChain; /* the HD chain data model*/
     MultiSigScriptSet setMultiSig;
+    //! Bumped under cs_KeyStore by every change to the keys, scripts, watch-only and multisig sets
+    size_t nKeyStoreGeneration;
 
     void ImplicitlyLearnRelatedKeyScripts(const CPubKey& pubkey);
 
 public:
+    CBasicKeyStore() : nKeyStoreGeneration(0) {}
+
     bool AddKeyPubKey(const CKey& key, const CPubKey& pubkey) override;
     bool GetPubKey(const CKeyID &address, CPubKey &vchPubKeyOut) const override;
     bool HaveKey(const CKeyID& address) const override 
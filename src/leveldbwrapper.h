@@ -168,6 +168,21 @@ public:
     {
         return pdb->NewIterator(iteroptions);
     }
+
+    /** Approximate on-disk size of the records with keys in [key_begin, key_end) */
+    template <typename K>
+    uint64_t EstimateSize(const K& key_begin, const K& key_end) const
+    {
+        CDataStream ssKeyBegin(SER_DISK, CLIENT_VERSION);
+        ssKeyBegin << key_begin;
+        CDataStream ssKeyEnd(SER_DISK, CLIENT_VERSION);
+        ssKeyEnd << key_end;
+        leveldb::Range range(leveldb::Slice(&ssKeyBegin[0], ssKeyBegin.size()), leveldb::Slice(&ssKeyEnd[0], ssKeyEnd.size()));
+
+        uint64_t nSize = 0;
+        pdb->GetApproximateSizes(&range, 1, &nSize);
+        return nSize;
+    }
 };
 
 #endif // BITCOIN_LEVELDBWRAPPER_H
@@ -0,0 +1,419 @@
+// Copyright (c) 2009-2010 Satoshi Nakamoto
+// Copyright (c) 2009-2014 The Bitcoin developers
+// Copyright (c) 2019 The TRBO developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "logging.h"
+
+#include "chainparamsbase.h"
+#include "util.h"
+#include "utiltime.h"
+
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+
+#include <boost/filesystem/path.hpp>
+#include <boost/thread.hpp>
+
+std::atomic<uint64_t> logCategories(LOG_NONE);
+
+struct CLogCategoryDesc {
+    uint64_t flag;
+    const char* category;
+};
+
+static const CLogCategoryDesc LogCategories[] = {
+    {LOG_ADDRMAN, "addrman"},
+    {LOG_ALERT, "alert"},
+    {LOG_BENCH, "bench"},
+    {LOG_COINDB, "coindb"},
+    {LOG_DB, "db"},
+    {LOG_DEBUG, "debug"},
+    {LOG_ESTIMATEFEE, "estimatefee"},
+    {LOG_HTTP, "http"},
+    {LOG_LIBEVENT, "libevent"},
+    {LOG_LOCK, "lock"},
+    {LOG_MAP, "map"},
+    {LOG_MASTERNODE, "masternode"},
+    {LOG_MEMPOOL, "mempool"},
+    {LOG_MEMPOOLREJ, "mempoolrej"},
+    {LOG_MNBUDGET, "mnbudget"},
+    {LOG_MNPAYMENTS, "mnpayments"},
+    {LOG_NET, "net"},
+    {LOG_OBFUSCATION, "obfuscation"},
+    {LOG_PRECOMPUTE, "precompute"},
+    {LOG_PROXY, "proxy"},
+    {LOG_QT, "qt"},
+    {LOG_RAND, "rand"},
+    {LOG_REINDEX, "reindex"},
+    {LOG_RPC, "rpc"},
+    {LOG_SELECTCOINS, "selectcoins"},
+    {LOG_STAKING, "staking"},
+    {LOG_SWIFTX, "swiftx"},
+    {LOG_TOR, "tor"},
+    {LOG_TRBO, "trbo"},
+    {LOG_WALLET, "wallet"},
+    {LOG_ZERO, "zero"},
+    {LOG_ZMQ, "zmq"},
+};
+
+uint64_t LogCategoryFlag(const char* category)
+{
+    if (category == NULL)
+        return LOG_ALL;
+    for (const CLogCategoryDesc& desc : LogCategories) {
+        if (strcmp(desc.category, category) == 0)
+            return desc.flag;
+    }
+    return LOG_NONE;
+}
+
+bool GetLogCategory(const std::string& str, uint64_t& flags)
+{
+    if (str.empty() || str == "1") {
+        flags = LOG_ALL;
+        return true;
+    }
+    flags = LogCategoryFlag(str.c_str());
+    return flags != LOG_NONE;
+}
+
+std::string ListLogCategories()
+{
+    std::string strList;
+    for (const CLogCategoryDesc& desc : LogCategories) {
+        if (!strList.empty())
+            strList += ", ";
+        strList += desc.category;
+    }
+    return strList;
+}
+
+CLogQueue::CLogQueue(size_t nSizeIn) : nDropped(0), fPushing(false), fOrphaned(false), fStartedNewLine(true), vRing(nSizeIn), nHead(0), nTail(0)
+{
+}
+
+bool CLogQueue::Push(Entry& entry, bool fDroppable)
+{
+    uint64_t nPos = nHead.load(std::memory_order_relaxed);
+    if (nPos - nTail.load(std::memory_order_acquire) >= vRing.size()) {
+        if (fDroppable)
+            nDropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    std::swap(vRing[nPos % vRing.size()], entry);
+    nHead.store(nPos + 1, std::memory_order_release);
+    return true;
+}
+
+size_t CLogQueue::Pop(std::vector<Entry>& vEntries)
+{
+    uint64_t nPos = nTail.load(std::memory_order_relaxed);
+    uint64_t nEnd = nHead.load(std::memory_order_acquire);
+    for (uint64_t i = nPos; i != nEnd; i++) {
+        Entry& entry = vRing[i % vRing.size()];
+        vEntries.push_back(std::move(entry));
+        entry.str.clear();
+    }
+    nTail.store(nEnd, std::memory_order_release);
+    return nEnd - nPos;
+}
+
+size_t CLogQueue::Size() const
+{
+    return nHead.load(std::memory_order_acquire) - nTail.load(std::memory_order_acquire);
+}
+
+/**
+ * LogPrintf() has been broken a couple of times now
+ * by well-meaning people adding mutexes in the most straightforward way.
+ * It breaks because it may be called by global destructors during shutdown.
+ * Since the order of destruction of static/global objects is undefined,
+ * defining a mutex as a global object doesn't work (the mutex gets
+ * destroyed, and then some later destructor calls OutputDebugStringF,
+ * maybe indirectly, and you get a core dump at shutdown trying to lock
+ * the mutex).
+ */
+
+static boost::once_flag debugPrintInitFlag = BOOST_ONCE_INIT;
+/**
+ * We use boost::call_once() to make sure these are initialized
+ * in a thread-safe manner the first time called:
+ */
+static FILE* fileout = NULL;
+static boost::mutex* mutexDebugLog = NULL;
+/** Queues of all threads that logged while the writer ran, guarded by mutexLogQueues */
+static std::vector<CLogQueue*>* pvLogQueues = NULL;
+static boost::mutex* mutexLogQueues = NULL;
+static boost::thread_specific_ptr<CLogQueue>* ptrLogQueue = NULL;
+/** Wakes the writer thread, guarded by mutexLogWriter */
+static boost::condition_variable* condLogWriter = NULL;
+static boost::mutex* mutexLogWriter = NULL;
+
+static boost::thread* pthreadLogWriter = NULL;
+/** True while messages are queued for the writer thread rather than written by the caller */
+static std::atomic<bool> fLogWriterRunning(false);
+static std::atomic<bool> fLogWriterIdle(false);
+static std::atomic<bool> fStopLogWriter(false);
+/** Orders the messages of different threads */
+static std::atomic<uint64_t> nLogSequence(0);
+/** Messages dropped by threads whose queue was freed since */
+static std::atomic<uint64_t> nLogDroppedOrphaned(0);
+
+/** Called when a thread that logged exits; the queue may still hold messages for the writer */
+static void OrphanLogQueue(CLogQueue* queue)
+{
+    queue->fOrphaned = true;
+}
+
+static void DebugPrintInit()
+{
+    assert(fileout == NULL);
+    assert(mutexDebugLog == NULL);
+
+    boost::filesystem::path pathDebug = GetDataDir() / "debug.log";
+    fileout = fopen(pathDebug.string().c_str(), "a");
+    if (fileout) setbuf(fileout, NULL); // unbuffered
+
+    mutexDebugLog = new boost::mutex();
+    pvLogQueues = new std::vector<CLogQueue*>();
+    mutexLogQueues = new boost::mutex();
+    ptrLogQueue = new boost::thread_specific_ptr<CLogQueue>(OrphanLogQueue);
+    condLogWriter = new boost::condition_variable();
+    mutexLogWriter = new boost::mutex();
+}
+
+/** Reopen the log file, if requested. Requires mutexDebugLog. */
+static void ReopenDebugLog()
+{
+    if (fReopenDebugLog) {
+        fReopenDebugLog = false;
+        boost::filesystem::path pathDebug = GetDataDir() / "debug.log";
+        if (freopen(pathDebug.string().c_str(), "a", fileout) != NULL)
+            setbuf(fileout, NULL); // unbuffered
+    }
+}
+
+static void WakeLogWriter()
+{
+    if (fLogWriterIdle.exchange(false)) {
+        boost::unique_lock<boost::mutex> lock(*mutexLogWriter);
+        condLogWriter->notify_one();
+    }
+}
+
+/**
+ * Hand str to the writer thread. Returns false if the writer is not
+ * running and the caller has to write it itself.
+ */
+static bool QueueLogMessage(const std::string& str, bool fDroppable, int& ret)
+{
+    if (!fLogWriterRunning.load(std::memory_order_relaxed))
+        return false;
+
+    CLogQueue* queue = ptrLogQueue->get();
+    if (queue == NULL) {
+        queue = new CLogQueue();
+        ptrLogQueue->reset(queue);
+        boost::unique_lock<boost::mutex> lock(*mutexLogQueues);
+        pvLogQueues->push_back(queue);
+    }
+
+    // StopLogWriter clears fLogWriterRunning and then waits for fPushing to
+    // be unset, so a message is either queued before the final pass of the
+    // writer or written by the caller.
+    queue->fPushing = true;
+    if (!fLogWriterRunning) {
+        queue->fPushing = false;
+        return false;
+    }
+
+    CLogQueue::Entry entry;
+    entry.nSequence = nLogSequence.fetch_add(1, std::memory_order_relaxed);
+    entry.nTime = GetTime();
+    entry.fStartsLine = queue->fStartedNewLine;
+    entry.str = str;
+    queue->fStartedNewLine = !str.empty() && str[str.size() - 1] == '\n';
+
+    ret = 0;
+    while (!queue->Push(entry, fDroppable)) {
+        if (fDroppable) {
+            queue->fPushing = false;
+            return true;
+        }
+        // Only LogPrintf and error output waits for room, which is rare
+        // enough not to hold up anything.
+        WakeLogWriter();
+        boost::this_thread::yield();
+    }
+    ret = str.size();
+
+    if (!fDroppable || queue->Size() > LOG_QUEUE_SIZE / 2)
+        WakeLogWriter();
+    queue->fPushing = false;
+    return true;
+}
+
+/** Write out the messages of all queues, in the order they were logged */
+static void WriteLogQueues(std::vector<CLogQueue::Entry>& vEntries)
+{
+    static uint64_t nDroppedReported = 0;
+
+    vEntries.clear();
+    uint64_t nDropped = nLogDroppedOrphaned;
+    {
+        boost::unique_lock<boost::mutex> lock(*mutexLogQueues);
+        std::vector<CLogQueue*>::iterator it = pvLogQueues->begin();
+        while (it != pvLogQueues->end()) {
+            CLogQueue* queue = *it;
+            bool fOrphaned = queue->fOrphaned;
+            queue->Pop(vEntries);
+            nDropped += queue->nDropped;
+            if (fOrphaned) {
+                nLogDroppedOrphaned += queue->nDropped;
+                delete queue;
+                it = pvLogQueues->erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    if (vEntries.empty() && nDropped == nDroppedReported)
+        return;
+
+    std::sort(vEntries.begin(), vEntries.end(), [](const CLogQueue::Entry& a, const CLogQueue::Entry& b) {
+        return a.nSequence < b.nSequence;
+    });
+
+    std::string strOut;
+    int64_t nTimeFormatted = -1;
+    std::string strTime;
+    for (const CLogQueue::Entry& entry : vEntries) {
+        if (fLogTimestamps && entry.fStartsLine) {
+            if (entry.nTime != nTimeFormatted) {
+                nTimeFormatted = entry.nTime;
+                strTime = DateTimeStrFormat("%Y-%m-%d %H:%M:%S", entry.nTime) + " ";
+            }
+            strOut += strTime;
+        }
+        strOut += entry.str;
+    }
+    if (nDropped != nDroppedReported) {
+        if (fLogTimestamps)
+            strOut += DateTimeStrFormat("%Y-%m-%d %H:%M:%S", GetTime()) + " ";
+        strOut += strprintf("Dropped %u debug log messages, as their threads logged faster than debug.log was written\n", nDropped - nDroppedReported);
+        nDroppedReported = nDropped;
+    }
+
+    boost::mutex::scoped_lock scoped_lock(*mutexDebugLog);
+    ReopenDebugLog();
+    fwrite(strOut.data(), 1, strOut.size(), fileout);
+}
+
+static void ThreadLogWriter()
+{
+    RenameThread("trbo-logwriter");
+    std::vector<CLogQueue::Entry> vEntries;
+    while (true) {
+        // Read the flag before draining, so the last pass sees every message queued before the stop
+        bool fStop = fStopLogWriter;
+        WriteLogQueues(vEntries);
+        if (fStop)
+            break;
+
+        boost::unique_lock<boost::mutex> lock(*mutexLogWriter);
+        fLogWriterIdle = true;
+        if (!fStopLogWriter)
+            condLogWriter->timed_wait(lock, boost::posix_time::milliseconds(LOG_WRITER_INTERVAL));
+        fLogWriterIdle = false;
+    }
+}
+
+bool StartLogWriter()
+{
+    if (fPrintToConsole || !fPrintToDebugLog || !AreBaseParamsConfigured())
+        return false;
+    boost::call_once(&DebugPrintInit, debugPrintInitFlag);
+    if (fileout == NULL || pthreadLogWriter != NULL)
+        return false;
+
+    fStopLogWriter = false;
+    fLogWriterRunning = true;
+    pthreadLogWriter = new boost::thread(&ThreadLogWriter);
+    return true;
+}
+
+void StopLogWriter()
+{
+    if (pthreadLogWriter == NULL)
+        return;
+
+    fLogWriterRunning = false;
+    while (true) {
+        bool fBusy = false;
+        {
+            boost::unique_lock<boost::mutex> lock(*mutexLogQueues);
+            for (CLogQueue* queue : *pvLogQueues)
+                fBusy |= queue->fPushing;
+        }
+        if (!fBusy)
+            break;
+        MilliSleep(1);
+    }
+
+    {
+        boost::unique_lock<boost::mutex> lock(*mutexLogWriter);
+        fStopLogWriter = true;
+        condLogWriter->notify_one();
+    }
+    pthreadLogWriter->join();
+    delete pthreadLogWriter;
+    pthreadLogWriter = NULL;
+}
+
+uint64_t GetLogMessagesDropped()
+{
+    if (mutexLogQueues == NULL)
+        return 0;
+    uint64_t nDropped = nLogDroppedOrphaned;
+    boost::unique_lock<boost::mutex> lock(*mutexLogQueues);
+    for (const CLogQueue* queue : *pvLogQueues)
+        nDropped += queue->nDropped;
+    return nDropped;
+}
+
+int LogPrintStr(const std::string& str, bool fDroppable)
+{
+    int ret = 0; // Returns total number of characters written
+    if (fPrintToConsole) {
+        // print to console
+        ret = fwrite(str.data(), 1, str.size(), stdout);
+        fflush(stdout);
+    } else if (fPrintToDebugLog && AreBaseParamsConfigured()) {
+        static bool fStartedNewLine = true;
+        boost::call_once(&DebugPrintInit, debugPrintInitFlag);
+
+        if (fileout == NULL)
+            return ret;
+
+        if (QueueLogMessage(str, fDroppable, ret))
+            return ret;
+
+        boost::mutex::scoped_lock scoped_lock(*mutexDebugLog);
+        ReopenDebugLog();
+
+        // Debug print useful for profiling
+        if (fLogTimestamps && fStartedNewLine)
+            ret += fprintf(fileout, "%s ", DateTimeStrFormat("%Y-%m-%d %H:%M:%S", GetTime()).c_str());
+        if (!str.empty() && str[str.size() - 1] == '\n')
+            fStartedNewLine = true;
+        else
+            fStartedNewLine = false;
+
+        ret = fwrite(str.data(), 1, str.size(), fileout);
+    }
+
+    return ret;
+}
@@ -0,0 +1,149 @@
+// Copyright (c) 2009-2010 Satoshi Nakamoto
+// Copyright (c) 2009-2014 The Bitcoin developers
+// Copyright (c) 2019 The TRBO developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/**
+ * Debug log categories and the debug.log writer
+ */
+#ifndef BITCOIN_LOGGING_H
+#define BITCOIN_LOGGING_H
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/** Debug log categories, enabled with -debug=<category> */
+enum LogFlags : uint64_t {
+    LOG_NONE = 0,
+    LOG_ADDRMAN = (1ULL << 0),
+    LOG_ALERT = (1ULL << 1),
+    LOG_BENCH = (1ULL << 2),
+    LOG_COINDB = (1ULL << 3),
+    LOG_DB = (1ULL << 4),
+    LOG_DEBUG = (1ULL << 5),
+    LOG_ESTIMATEFEE = (1ULL << 6),
+    LOG_HTTP = (1ULL << 7),
+    LOG_LIBEVENT = (1ULL << 8),
+    LOG_LOCK = (1ULL << 9),
+    LOG_MAP = (1ULL << 10),
+    LOG_MASTERNODE = (1ULL << 11),
+    LOG_MEMPOOL = (1ULL << 12),
+    LOG_MEMPOOLREJ = (1ULL << 13),
+    LOG_MNBUDGET = (1ULL << 14),
+    LOG_MNPAYMENTS = (1ULL << 15),
+    LOG_NET = (1ULL << 16),
+    LOG_OBFUSCATION = (1ULL << 17),
+    LOG_PRECOMPUTE = (1ULL << 18),
+    LOG_PROXY = (1ULL << 19),
+    LOG_QT = (1ULL << 20),
+    LOG_RAND = (1ULL << 21),
+    LOG_REINDEX = (1ULL << 22),
+    LOG_RPC = (1ULL << 23),
+    LOG_SELECTCOINS = (1ULL << 24),
+    LOG_STAKING = (1ULL << 25),
+    LOG_SWIFTX = (1ULL << 26),
+    LOG_TOR = (1ULL << 27),
+    LOG_WALLET = (1ULL << 28),
+    LOG_ZERO = (1ULL << 29),
+    LOG_ZMQ = (1ULL << 30),
+    // "trbo" is a composite category enabling all TRBO-related debug output
+    LOG_TRBO = (LOG_OBFUSCATION | LOG_SWIFTX | LOG_MASTERNODE | LOG_MNPAYMENTS | LOG_ZERO | LOG_MNBUDGET | LOG_PRECOMPUTE | LOG_STAKING),
+    LOG_ALL = ~(uint64_t)0,
+};
+
+/** Categories enabled with -debug, set once during init */
+extern std::atomic<uint64_t> logCategories;
+
+/** Return the flag of a category name, LOG_NONE if there is no such category, or LOG_ALL for NULL, which is always logged */
+uint64_t LogCategoryFlag(const char* category);
+/** Parse a -debug value: a category name, "trbo", or "" and "1" for all categories */
+bool GetLogCategory(const std::string& str, uint64_t& flags);
+/** Comma separated names of all categories */
+std::string ListLogCategories();
+
+/**
+ * Return true if log accepts a flag returned by LogCategoryFlag. With -debug
+ * unset this is a single load, so LogPrint costs nothing for the categories
+ * nobody asked for.
+ */
+static inline bool LogAcceptFlag(uint64_t flag)
+{
+    if (flag == LOG_ALL)
+        return true;
+    uint64_t flags = logCategories.load(std::memory_order_relaxed);
+    return flags == LOG_ALL || (flags & flag) != 0;
+}
+
+/** Return true if log accepts specified category */
+static inline bool LogAcceptCategory(const char* category)
+{
+    return LogAcceptFlag(LogCategoryFlag(category));
+}
+
+/** Messages a thread can have waiting for the writer before its LogPrint output is dropped */
+static const size_t LOG_QUEUE_SIZE = 4096;
+/** Milliseconds the writer thread sleeps between passes when nothing wakes it */
+static const int LOG_WRITER_INTERVAL = 100;
+
+/**
+ * Ring of log messages with a single producer, the thread that owns it, and
+ * a single consumer, the writer thread. Neither side takes a lock.
+ */
+class CLogQueue
+{
+public:
+    struct Entry {
+        uint64_t nSequence;
+        int64_t nTime;
+        bool fStartsLine;
+        std::string str;
+    };
+
+    /** Messages dropped because the queue was full */
+    std::atomic<uint64_t> nDropped;
+    /** Set by the owner while it queues a message, so the writer can be stopped safely */
+    std::atomic<bool> fPushing;
+    /** Set when the owning thread exits; the writer frees the queue once drained */
+    std::atomic<bool> fOrphaned;
+    /** Whether the next message of the owner starts a new line (owner only) */
+    bool fStartedNewLine;
+
+    explicit CLogQueue(size_t nSizeIn = LOG_QUEUE_SIZE);
+
+    /**
+     * Move entry into the queue, or return false if it is full. A full queue
+     * counts fDroppable entries as dropped; others are for the caller to retry
+     * (owner only).
+     */
+    bool Push(Entry& entry, bool fDroppable = false);
+    /** Move all queued messages to the end of vEntries and return their number (writer only) */
+    size_t Pop(std::vector<Entry>& vEntries);
+    size_t Size() const;
+
+private:
+    std::vector<Entry> vRing;
+    /** Number of messages ever pushed, written by the owner */
+    std::atomic<uint64_t> nHead;
+    /** Number of messages ever popped, written by the writer */
+    std::atomic<uint64_t> nTail;
+};
+
+/** Send a string to the log output. fDroppable output is dropped rather than waited on when the queue is full. */
+int LogPrintStr(const std::string& str, bool fDroppable = false);
+
+/**
+ * Start the thread that writes debug.log. From then on LogPrintStr only
+ * queues the message, and -debug output is dropped and counted, instead of
+ * stalling the caller, when the writer falls behind.
+ */
+bool StartLogWriter();
+/** Write out everything queued and stop the writer thread; logging is synchronous again afterwards */
+void StopLogWriter();
+/** Number of LogPrint messages dropped because a queue was full */
+uint64_t GetLogMessagesDropped();
+
+#endif // BITCOIN_LOGGING_H
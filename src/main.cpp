@@ -13,15 +13,18 @@
 #include "alert.h"
 #include "banned.h"
 #include "base58.h"
+#include "blockfilterindex.h"
 #include "chainparams.h"
 #include "checkpoints.h"
 #include "checkqueue.h"
+#include "coinstatsindex.h"
 #include "consensus/merkle.h"
 #include "consensus/validation.h"
 #include "init.h"
 #include "kernel.h"
 #include "masternode-budget.h"
 #include "masternode-payments.h"
+#include "masternode-tasks.h"
 #include "masternodeman.h"
 #include "merkleblock.h"
 #include "net.h"
@@ -41,6 +44,7 @@
 #include "wallet/wallet.h"
 #endif
 
+#include <limits>
 #include <sstream>
 
 #include <boost/algorithm/string/replace.hpp>
@@ -91,6 +95,7 @@ bool fIsBareMultisigStd = true;
 bool fCheckBlockIndex = false;
 bool fVerifyingBlocks = false;
 unsigned int nCoinCacheSize = 5000;
+unsigned int nTxCacheSize = DEFAULT_TX_CACHE_SIZE;
 unsigned int nBytesPerSigOp = DEFAULT_BYTES_PER_SIGOP;
 bool fAlerts = DEFAULT_ALERTS;
 
@@ -549,6 +554,7 @@ CBlockIndex* FindForkInGlobalIndex(const CChain& chain, const CBlockLocator& loc
     return chain.Genesis();
 }
 
+CCoinsViewDB* pcoinsdbview = NULL;
 CCoinsViewCache* pcoinsTip = NULL;
 CBlockTreeDB* pblocktree = NULL;
 CSporkDB* pSporkDB = NULL;
@@ -857,10 +863,7 @@ int GetInputAgeIX(uint256 nTXHash, CTxIn& vin)
     if (nResult < 0) nResult = 0;
 
     if (nResult < 6) {
-        std::map<uint256, CTransactionLock>::iterator i = mapTxLocks.find(nTXHash);
-        if (i != mapTxLocks.end()) {
-            sigs = (*i).second.CountSignatures();
-        }
+        sigs = txLockManager.CountSignatures(nTXHash);
         if (sigs >= SWIFTTX_SIGNATURES_REQUIRED) {
             return nSwiftTXDepth + nResult;
         }
@@ -871,12 +874,7 @@ int GetInputAgeIX(uint256 nTXHash, CTxIn& vin)
 
 int GetIXConfirmations(uint256 nTXHash)
 {
-    int sigs = 0;
-
-    std::map<uint256, CTransactionLock>::iterator i = mapTxLocks.find(nTXHash);
-    if (i != mapTxLocks.end()) {
-        sigs = (*i).second.CountSignatures();
-    }
+    int sigs = txLockManager.CountSignatures(nTXHash);
     if (sigs >= SWIFTTX_SIGNATURES_REQUIRED) {
         return nSwiftTXDepth;
     }
@@ -1087,14 +1085,11 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState& state, const CTransa
 
     // ----------- swiftTX transaction scanning -----------
     string reason;
-    BOOST_FOREACH (const CTxIn& in, tx.vin) {
-        if (mapLockedInputs.count(in.prevout)) {
-            if (mapLockedInputs[in.prevout] != tx.GetHash()) {
-                return state.DoS(0,
-                    error("AcceptToMemoryPool : conflicts with existing transaction lock: %s", reason),
-                    REJECT_INVALID, "tx-lock-conflict");
-            }
-        }
+    uint256 hashLock;
+    if (txLockManager.IsConflicting(tx, hashLock)) {
+        return state.DoS(0,
+            error("AcceptToMemoryPool : conflicts with existing transaction lock: %s", hashLock.ToString()),
+            REJECT_INVALID, "tx-lock-conflict");
     }
 
     // Don't accept witness transactions before the final threshold passes
@@ -1327,14 +1322,11 @@ bool AcceptableInputs(CTxMemPool& pool, CValidationState& state, const CTransact
 
     // ----------- swiftTX transaction scanning -----------
 
-    BOOST_FOREACH (const CTxIn& in, tx.vin) {
-        if (mapLockedInputs.count(in.prevout)) {
-            if (mapLockedInputs[in.prevout] != tx.GetHash()) {
-                return state.DoS(0,
-                    error("AcceptableInputs : conflicts with existing transaction lock: %s", reason),
-                    REJECT_INVALID, "tx-lock-conflict");
-            }
-        }
+    uint256 hashLock;
+    if (txLockManager.IsConflicting(tx, hashLock)) {
+        return state.DoS(0,
+            error("AcceptableInputs : conflicts with existing transaction lock: %s", hashLock.ToString()),
+            REJECT_INVALID, "tx-lock-conflict");
     }
 
     {
@@ -1476,42 +1468,141 @@ bool AcceptableInputs(CTxMemPool& pool, CValidationState& state, const CTransact
     return true;
 }
 
+namespace
+{
+/**
+ * Confirmed transactions recently returned by GetTransaction, most recently
+ * used first. Explorers and RPC clients tend to ask for the same txids over
+ * and over, each of which would otherwise cost a tx index lookup and a block
+ * file read. The cache is emptied whenever a block is disconnected; the
+ * generation counter stops a lookup that raced with that from inserting a
+ * block hash that is no longer valid.
+ */
+class CTransactionCache
+{
+private:
+    struct CEntry {
+        uint256 txid;
+        CTransaction tx;
+        uint256 hashBlock;
+    };
+    typedef std::list<CEntry> EntryList;
+
+    mutable CCriticalSection cs;
+    EntryList listEntries;
+    std::map<uint256, EntryList::iterator> mapEntries;
+    uint64_t nGeneration;
+
+public:
+    CTransactionCache() : nGeneration(0) {}
+
+    bool Get(const uint256& txid, CTransaction& txOut, uint256& hashBlock)
+    {
+        LOCK(cs);
+        std::map<uint256, EntryList::iterator>::iterator it = mapEntries.find(txid);
+        if (it == mapEntries.end())
+            return false;
+        listEntries.splice(listEntries.begin(), listEntries, it->second);
+        txOut = it->second->tx;
+        hashBlock = it->second->hashBlock;
+        return true;
+    }
+
+    uint64_t GetGeneration() const
+    {
+        LOCK(cs);
+        return nGeneration;
+    }
+
+    void Insert(const CTransaction& tx, const uint256& hashBlock, uint64_t nGenerationIn)
+    {
+        LOCK(cs);
+        if (nGenerationIn != nGeneration || nTxCacheSize == 0 || mapEntries.count(tx.GetHash()))
+            return;
+        CEntry entry;
+        entry.txid = tx.GetHash();
+        entry.tx = tx;
+        entry.hashBlock = hashBlock;
+        listEntries.push_front(entry);
+        mapEntries[entry.txid] = listEntries.begin();
+        while (listEntries.size() > nTxCacheSize) {
+            mapEntries.erase(listEntries.back().txid);
+            listEntries.pop_back();
+        }
+    }
+
+    void Clear()
+    {
+        LOCK(cs);
+        listEntries.clear();
+        mapEntries.clear();
+        nGeneration++;
+    }
+};
+
+CTransactionCache txCache;
+} // anon namespace
+
 /** Return transaction in tx, and if it was found inside a block, its hash is placed in hashBlock */
 bool GetTransaction(const uint256& hash, CTransaction& txOut, uint256& hashBlock, bool fAllowSlow)
 {
-    CBlockIndex* pindexSlow = NULL;
-    {
-        LOCK(cs_main);
-        {
-            if (mempool.lookup(hash, txOut)) {
-                return true;
-            }
-        }
+    // The mempool, the tx index and the block files all have their own
+    // locking, so a lookup through the index does not need cs_main.
+    if (mempool.lookup(hash, txOut))
+        return true;
 
-        if (fTxIndex) {
-            CDiskTxPos postx;
-            if (pblocktree->ReadTxIndex(hash, postx)) {
-                CAutoFile file(OpenBlockFile(postx, true), SER_DISK, CLIENT_VERSION);
-                if (file.IsNull())
-                    return error("%s: OpenBlockFile failed", __func__);
-                CBlockHeader header;
-                try {
-                    file >> header;
-                    fseek(file.Get(), postx.nTxOffset, SEEK_CUR);
-                    file >> txOut;
-                } catch (std::exception& e) {
-                    return error("%s : Deserialize or I/O error - %s", __func__, e.what());
-                }
-                hashBlock = header.GetHash();
-                if (txOut.GetHash() != hash)
-                    return error("%s : txid mismatch", __func__);
-                return true;
-            }
+    if (fTxIndex) {
+        if (txCache.Get(hash, txOut, hashBlock))
+            return true;
+        uint64_t nGeneration = txCache.GetGeneration();
 
+        // Entries written since the height was added to the index carry it;
+        // older ones still decode as a plain position.
+        CExtDiskTxPos postx;
+        bool fHaveHeight = pblocktree->ReadTxIndex(hash, postx);
+        if (!fHaveHeight && !pblocktree->ReadTxIndex(hash, static_cast<CDiskTxPos&>(postx))) {
             // transaction not found in the index, nothing more can be done
             return false;
         }
 
+        CAutoFile file(OpenBlockFile(postx, true), SER_DISK, CLIENT_VERSION);
+        if (file.IsNull())
+            return error("%s: OpenBlockFile failed", __func__);
+        CBlockHeader header;
+        try {
+            file >> header;
+            fseek(file.Get(), postx.nTxOffset, SEEK_CUR);
+            file >> txOut;
+        } catch (std::exception& e) {
+            return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+        }
+        if (txOut.GetHash() != hash)
+            return error("%s : txid mismatch", __func__);
+
+        // Take the block hash from the index when the recorded height still
+        // points at the block holding the transaction. Never wait for cs_main
+        // for this; hashing the header is the fallback.
+        bool fFoundHash = false;
+        if (fHaveHeight) {
+            TRY_LOCK(cs_main, lockMain);
+            if (lockMain) {
+                CBlockIndex* pindex = chainActive[postx.nHeight];
+                if (pindex && pindex->GetBlockPos() == static_cast<const CDiskBlockPos&>(postx)) {
+                    hashBlock = pindex->GetBlockHash();
+                    fFoundHash = true;
+                }
+            }
+        }
+        if (!fFoundHash)
+            hashBlock = header.GetHash();
+
+        txCache.Insert(txOut, hashBlock, nGeneration);
+        return true;
+    }
+
+    CBlockIndex* pindexSlow = NULL;
+    {
+        LOCK(cs_main);
         if (fAllowSlow) { // use coin database to locate block that contains transaction, and scan it
             int nHeight = -1;
             {
@@ -1839,6 +1930,15 @@ bool CScriptCheck::operator()()
     return true;
 }
 
+static CCheckQueue<CScriptCheck> scriptcheckqueue(128);
+
+/**
+ * Transactions checked on their own, for the mempool or a block template,
+ * have their scripts verified on the script check threads from this many
+ * inputs on. For fewer, waking the threads costs more than it saves.
+ */
+static const unsigned int MIN_PARALLEL_SCRIPT_CHECKS = 4;
+
 bool CheckInputs(const CTransaction& tx, CValidationState& state, const CCoinsViewCache& inputs, bool fScriptChecks, unsigned int flags, bool cacheStore, std::vector<CScriptCheck>* pvChecks)
 {
     if (!tx.IsCoinBase()) {
@@ -1900,6 +2000,29 @@ bool CheckInputs(const CTransaction& tx, CValidationState& state, const CCoinsVi
         // before the last block chain checkpoint. This is safe because block merkle hashes are
         // still computed and checked, and any change will be caught at the next checkpoint.
         if (fScriptChecks) {
+            // Callers like ConnectBlock collect the checks of many transactions
+            // themselves. Otherwise, spread the inputs over the script check
+            // threads, and only fall through to the serial checks below to
+            // find out why an input failed.
+            if (!pvChecks && nScriptCheckThreads && tx.vin.size() >= MIN_PARALLEL_SCRIPT_CHECKS) {
+                // scriptcheckqueue takes one controller at a time, which
+                // holding cs_main guarantees, as it does for ConnectBlock
+                AssertLockHeld(cs_main);
+                std::vector<CScriptCheck> vChecks;
+                vChecks.reserve(tx.vin.size());
+                for (unsigned int i = 0; i < tx.vin.size(); i++) {
+                    const CCoins* coins = inputs.AccessCoins(tx.vin[i].prevout.hash);
+                    assert(coins);
+                    CScriptCheck check(*coins, tx, i, flags, cacheStore);
+                    vChecks.push_back(CScriptCheck());
+                    check.swap(vChecks.back());
+                }
+                CCheckQueueControl<CScriptCheck> control(&scriptcheckqueue);
+                control.Add(vChecks);
+                if (control.Wait())
+                    return true;
+            }
+
             for (unsigned int i = 0; i < tx.vin.size(); i++) {
                 const COutPoint& prevout = tx.vin[i].prevout;
                 const CCoins* coins = inputs.AccessCoins(prevout.hash);
@@ -2057,65 +2180,179 @@ void static FlushBlockFile(bool fFinalize = false)
 
 bool FindUndoPos(CValidationState& state, int nFile, CDiskBlockPos& pos, unsigned int nAddSize);
 
-static CCheckQueue<CScriptCheck> scriptcheckqueue(128);
-
 void ThreadScriptCheck()
 {
     RenameThread("trbo-scriptch");
     scriptcheckqueue.Thread();
 }
 
-bool RecalculateTRBOSupply(int nHeightStart)
-{
-    if (nHeightStart > chainActive.Height())
-        return false;
+/** Number of blocks whose supply is recalculated and written back per batch */
+static const int SUPPLY_RECALC_CHUNK = 10000;
 
-    CBlockIndex* pindex = chainActive[nHeightStart];
-    CAmount nSupplyPrev = pindex->pprev->nMoneySupply;
+/** Name of the block tree int holding the last height a supply recalculation has written */
+static const std::string SUPPLY_RECALC_PROGRESS = "supplyrecalc";
 
-    while (true) {
-        if (pindex->nHeight % 1000 == 0)
-            LogPrintf("%s : block %d...\n", __func__, pindex->nHeight);
+/**
+ * Computes how much one block changes the money supply: the value of its
+ * outputs minus the value of the outputs it spends. The spent values come
+ * from the block's undo data, so no lookups of previous transactions are
+ * needed and blocks can be processed in any order.
+ */
+class CSupplyDeltaCheck
+{
+private:
+    const CBlockIndex* pindex;
+    CDiskBlockPos posUndo;
+    CAmount* pnDelta;
+
+public:
+    CSupplyDeltaCheck() : pindex(NULL), pnDelta(NULL) {}
+    CSupplyDeltaCheck(const CBlockIndex* pindexIn, CAmount* pnDeltaIn) : pindex(pindexIn), posUndo(pindexIn->GetUndoPos()), pnDelta(pnDeltaIn) {}
 
+    bool operator()()
+    {
         CBlock block;
-        assert(ReadBlockFromDisk(block, pindex));
+        if (!ReadBlockFromDisk(block, pindex))
+            return error("RecalculateTRBOSupply() : failed to read block %s", pindex->GetBlockHash().ToString());
+        CBlockUndo blockundo;
+        if (posUndo.IsNull() || !blockundo.ReadFromDisk(posUndo, pindex->pprev->GetBlockHash()))
+            return error("RecalculateTRBOSupply() : failed to read undo data of block %s", pindex->GetBlockHash().ToString());
+        if (blockundo.vtxundo.size() + 1 != block.vtx.size())
+            return error("RecalculateTRBOSupply() : undo data of block %s does not match its transactions", pindex->GetBlockHash().ToString());
 
         CAmount nValueIn = 0;
-        CAmount nValueOut = 0;
-        for (const CTransaction& tx : block.vtx) {
-            for (unsigned int i = 0; i < tx.vin.size(); i++) {
-                if (tx.IsCoinBase())
-                    break;
-
-                COutPoint prevout = tx.vin[i].prevout;
-                CTransaction txPrev;
-                uint256 hashBlock;
-                assert(GetTransaction(prevout.hash, txPrev, hashBlock, true));
-                nValueIn += txPrev.vout[prevout.n].nValue;
-            }
+        BOOST_FOREACH (const CTxUndo& txundo, blockundo.vtxundo) {
+            BOOST_FOREACH (const CTxInUndo& undo, txundo.vprevout)
+                nValueIn += undo.txout.nValue;
+        }
 
+        CAmount nValueOut = 0;
+        BOOST_FOREACH (const CTransaction& tx, block.vtx) {
             for (unsigned int i = 0; i < tx.vout.size(); i++) {
                 if (i == 0 && tx.IsCoinStake())
                     continue;
-
                 nValueOut += tx.vout[i].nValue;
             }
         }
 
-        // Rewrite money supply
-        pindex->nMoneySupply = nSupplyPrev + nValueOut - nValueIn;
-        nSupplyPrev = pindex->nMoneySupply;
+        *pnDelta = nValueOut - nValueIn;
+        return true;
+    }
 
-        assert(pblocktree->WriteBlockIndex(CDiskBlockIndex(pindex)));
+    void swap(CSupplyDeltaCheck& check)
+    {
+        std::swap(pindex, check.pindex);
+        std::swap(posUndo, check.posUndo);
+        std::swap(pnDelta, check.pnDelta);
+    }
+};
 
-        if (pindex->nHeight < chainActive.Height())
-            pindex = chainActive.Next(pindex);
-        else
-            break;
+static void ThreadRecalculateSupply(CCheckQueue<CSupplyDeltaCheck>* pqueue)
+{
+    RenameThread("trbo-supply");
+    pqueue->Thread();
+}
+
+static bool RecalculateSupplyChunks(CCheckQueue<CSupplyDeltaCheck>& queue, int nHeightStart)
+{
+    int nHeightEnd;
+    CAmount nSupplyPrev;
+    {
+        LOCK(cs_main);
+        nHeightEnd = chainActive.Height();
+        nSupplyPrev = chainActive[nHeightStart]->pprev->nMoneySupply;
+    }
+
+    std::vector<CBlockIndex*> vpindex;
+    std::vector<CAmount> vDelta;
+    std::vector<CSupplyDeltaCheck> vChecks;
+    for (int nHeight = nHeightStart; nHeight <= nHeightEnd; nHeight += vpindex.size()) {
+        if (ShutdownRequested()) {
+            LogPrintf("%s : interrupted at block %d, will resume on next start\n", __func__, nHeight);
+            return true;
+        }
+        LogPrintf("%s : block %d...\n", __func__, nHeight);
+
+        vpindex.clear();
+        {
+            LOCK(cs_main);
+            for (int i = nHeight; i <= nHeightEnd && i < nHeight + SUPPLY_RECALC_CHUNK; i++)
+                vpindex.push_back(chainActive[i]);
+        }
+
+        // Per block deltas are independent of each other; compute them in parallel
+        vDelta.assign(vpindex.size(), 0);
+        {
+            CCheckQueueControl<CSupplyDeltaCheck> control(&queue);
+            for (unsigned int i = 0; i < vpindex.size(); i++)
+                vChecks.push_back(CSupplyDeltaCheck(vpindex[i], &vDelta[i]));
+            control.Add(vChecks);
+            vChecks.clear();
+            if (!control.Wait())
+                return false;
+        }
+
+        // The supply of each block is the prefix sum of the deltas
+        {
+            LOCK(cs_main);
+            for (unsigned int i = 0; i < vpindex.size(); i++) {
+                nSupplyPrev += vDelta[i];
+                vpindex[i]->nMoneySupply = nSupplyPrev;
+            }
+        }
+
+        // Remember how far we got in the same batch, so an interrupted run resumes from here
+        int nHeightLast = nHeight + vpindex.size() - 1;
+        if (!pblocktree->WriteBlockIndexRange(vpindex, SUPPLY_RECALC_PROGRESS, nHeightLast < nHeightEnd ? nHeightLast : -1))
+            return error("%s : failed to write block index", __func__);
     }
     return true;
 }
 
+bool IsSupplyRecalculationPending()
+{
+    int nHeight;
+    return pblocktree->ReadInt(SUPPLY_RECALC_PROGRESS, nHeight);
+}
+
+bool RecalculateTRBOSupply(int nHeightStart)
+{
+    int64_t nStart = GetTimeMillis();
+    {
+        LOCK(cs_main);
+        // Pick up after the last chunk an interrupted run wrote
+        int nHeightDone;
+        if (pblocktree->ReadInt(SUPPLY_RECALC_PROGRESS, nHeightDone) && nHeightDone >= nHeightStart && nHeightDone < chainActive.Height()) {
+            LogPrintf("%s : resuming after block %d\n", __func__, nHeightDone);
+            nHeightStart = nHeightDone + 1;
+        }
+        // The genesis block has no undo data and its outputs are not spendable
+        nHeightStart = std::max(nHeightStart, 1);
+        if (nHeightStart > chainActive.Height())
+            return pblocktree->Erase(std::make_pair('I', SUPPLY_RECALC_PROGRESS), true);
+    }
+
+    // Read and sum on the calling thread plus the same number of helpers as -par allows for script checks
+    CCheckQueue<CSupplyDeltaCheck> queue(128);
+    boost::thread_group threadGroup;
+    for (int i = 0; i < nScriptCheckThreads - 1; i++)
+        threadGroup.create_thread(boost::bind(&ThreadRecalculateSupply, &queue));
+
+    bool fRet;
+    try {
+        fRet = RecalculateSupplyChunks(queue, nHeightStart);
+    } catch (...) {
+        threadGroup.interrupt_all();
+        threadGroup.join_all();
+        throw;
+    }
+    threadGroup.interrupt_all();
+    threadGroup.join_all();
+
+    LogPrintf("%s : done in %dms\n", __func__, GetTimeMillis() - nStart);
+    return fRet;
+}
+
 static int64_t nTimeVerify = 0;
 static int64_t nTimeConnect = 0;
 static int64_t nTimeIndex = 0;
@@ -2217,7 +2454,7 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
     int nInputs = 0;
     int64_t nSigOpsCost = 0;
     CExtDiskTxPos pos(CDiskTxPos(pindex->GetBlockPos(), GetSizeOfCompactSize(block.vtx.size())), pindex->nHeight);
-    std::vector<std::pair<uint256, CDiskTxPos> > vPosTxid;
+    std::vector<std::pair<uint256, CExtDiskTxPos> > vPosTxid;
     std::vector<std::pair<uint160, CExtDiskTxPos> > vPosAddrid;
         if (fTxIndex)
         vPosTxid.reserve(block.vtx.size());
@@ -2314,6 +2551,10 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
     int64_t nTime2 = GetTimeMicros();
     nTimeVerify += nTime2 - nTimeStart;
     LogPrint("bench", "    - Verify %u txins: %.2fms (%.3fms/txin) [%.2fs]\n", nInputs - 1, 0.001 * (nTime2 - nTimeStart), nInputs <= 1 ? 0 : 0.001 * (nTime2 - nTimeStart) / (nInputs - 1), nTimeVerify * 0.000001);
+    if (fScriptChecks && nScriptCheckThreads) {
+        CCheckQueueStats stats = scriptcheckqueue.GetStats();
+        LogPrint("bench", "      - Script check queue: %u checks on %d threads in %.2fms, %.1f%% utilization, %u steals\n", stats.nChecks, stats.nThreads, 0.001 * stats.nTimeWall, 100.0 * stats.Utilization(), stats.nSteals);
+    }
 
     //IMPORTANT NOTE: Nothing before this point should actually store to disk (or even memory)
     if (fJustCheck)
@@ -2345,6 +2586,12 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
         if (!pblocktree->AddAddrIndex(vPosAddrid))
             return state.Error("Failed to write address index");
 
+    if (pblockfilterindex && !pblockfilterindex->BlockConnected(block, blockundo, pindex))
+        return state.Error("Failed to write block filter index");
+
+    if (pcoinstatsindex && !pcoinstatsindex->BlockConnected(block, blockundo, pindex))
+        return state.Error("Failed to write coin stats index");
+
     // add new entries
     for (const CTransaction& tx: block.vtx) {
         if (tx.IsCoinBase())
@@ -2527,13 +2774,14 @@ bool static DisconnectTip(CValidationState& state, bool fBare)
         mempool.check(pcoinsTip);
     }
 
+    // Transactions of the disconnected block may now be unconfirmed or in another block
+    txCache.Clear();
+
     // Update chainActive and related variables.
     UpdateTip(pindexDelete->pprev);
     // Let wallets know transactions went from 1-confirmed to
     // 0-confirmed or conflicted:
-    BOOST_FOREACH (const CTransaction& tx, block.vtx) {
-        SyncWithWallets(tx, NULL);
-    }
+    SyncWithWallets(block.vtx, NULL);
     return true;
 }
 
@@ -2610,9 +2858,7 @@ bool static ConnectTip(CValidationState& state, CBlockIndex* pindexNew, CBlock*
         SyncWithWallets(tx, NULL);
     }
     // ... and about transactions that got confirmed:
-    BOOST_FOREACH (const CTransaction& tx, pblock->vtx) {
-        SyncWithWallets(tx, pblock);
-    }
+    SyncWithWallets(pblock->vtx, pblock);
 
     int64_t nTime6 = GetTimeMicros();
     nTimePostConnect += nTime6 - nTime5;
@@ -3280,15 +3526,12 @@ bool CheckBlock(const CBlock& block, CValidationState& state, bool fCheckPOW, bo
         BOOST_FOREACH (const CTransaction& tx, block.vtx) {
             if (!tx.IsCoinBase()) {
                 //only reject blocks when it's based on complete consensus
-                BOOST_FOREACH (const CTxIn& in, tx.vin) {
-                    if (mapLockedInputs.count(in.prevout)) {
-                        if (mapLockedInputs[in.prevout] != tx.GetHash()) {
-                            mapRejectedBlocks.insert(make_pair(block.GetHash(), GetTime()));
-                            LogPrintf("CheckBlock() : found conflicting transaction with transaction lock %s %s\n", mapLockedInputs[in.prevout].ToString(), tx.GetHash().ToString());
-                            return state.DoS(0, error("CheckBlock() : found conflicting transaction with transaction lock"),
-                                REJECT_INVALID, "conflicting-tx-ix");
-                        }
-                    }
+                uint256 hashLock;
+                if (txLockManager.IsConflicting(tx, hashLock)) {
+                    mapRejectedBlocks.insert(make_pair(block.GetHash(), GetTime()));
+                    LogPrintf("CheckBlock() : found conflicting transaction with transaction lock %s %s\n", hashLock.ToString(), tx.GetHash().ToString());
+                    return state.DoS(0, error("CheckBlock() : found conflicting transaction with transaction lock"),
+                        REJECT_INVALID, "conflicting-tx-ix");
                 }
             }
         }
@@ -3357,7 +3600,7 @@ bool CheckWork(const CBlock block, CBlockIndex* const pindexPrev)
         uint256 hashProofOfStake;
         uint256 hash = block.GetHash();
 
-        if(!CheckProofOfStake(block, hashProofOfStake)) {
+        if(!CheckProofOfStake(block, pindexPrev, hashProofOfStake)) {
             LogPrintf("WARNING: ProcessBlock(): check proof-of-stake failed for block %s\n", hash.ToString().c_str());
             return false;
         }
@@ -3875,6 +4118,7 @@ bool ProcessNewBlock(CValidationState& state, CNode* pfrom, CBlock* pblock, CDis
             masternodePayments.ProcessBlock(GetHeight() + 10);
             budget.NewBlock();
         }
+        TriggerMasternodeTasks(MN_TASK_EVENT_NEW_BLOCK);
     }
 
     if (pwalletMain) {
@@ -4006,23 +4250,32 @@ CBlockIndex* InsertBlockIndex(uint256 hash)
 
 bool static LoadBlockIndexDB(string& strError)
 {
+    int64_t nTimeStart = GetTimeMicros();
     if (!pblocktree->LoadBlockIndexGuts())
         return false;
 
     boost::this_thread::interruption_point();
 
-    // Calculate nChainWork
-    vector<pair<int, CBlockIndex*> > vSortedByHeight;
-    vSortedByHeight.reserve(mapBlockIndex.size());
-    for (const std::pair<const uint256, CBlockIndex*>& item : mapBlockIndex) {
-        CBlockIndex* pindex = item.second;
-        vSortedByHeight.push_back(make_pair(pindex->nHeight, pindex));
-    }
-    sort(vSortedByHeight.begin(), vSortedByHeight.end());
-    BOOST_FOREACH (const PAIRTYPE(int, CBlockIndex*) & item, vSortedByHeight) {
-        CBlockIndex* pindex = item.second;
+    // Bucket the entries by height (counting sort), so that every pprev is visited before its children
+    int64_t nTimeLoaded = GetTimeMicros();
+    int nMaxHeight = 0;
+    for (const std::pair<const uint256, CBlockIndex*>& item : mapBlockIndex)
+        nMaxHeight = std::max(nMaxHeight, item.second->nHeight);
+    vector<unsigned int> vHeightOffset(nMaxHeight + 2, 0);
+    for (const std::pair<const uint256, CBlockIndex*>& item : mapBlockIndex)
+        vHeightOffset[item.second->nHeight + 1]++;
+    for (int nHeight = 1; nHeight <= nMaxHeight + 1; nHeight++)
+        vHeightOffset[nHeight] += vHeightOffset[nHeight - 1];
+    vector<CBlockIndex*> vSortedByHeight(mapBlockIndex.size());
+    for (const std::pair<const uint256, CBlockIndex*>& item : mapBlockIndex)
+        vSortedByHeight[vHeightOffset[item.second->nHeight]++] = item.second;
+
+    // Calculate nChainWork and skip pointers in a single sweep over the height buckets
+    int64_t nTimeSorted = GetTimeMicros();
+    BOOST_FOREACH (CBlockIndex* pindex, vSortedByHeight) {
         pindex->nChainWork = (pindex->pprev ? pindex->pprev->nChainWork : 0) + GetBlockProof(*pindex);
-        if (pindex->nStatus & BLOCK_HAVE_DATA) {
+        // Blocks below a loaded snapshot count as connected although their data is not on disk
+        if (pindex->nStatus & (BLOCK_HAVE_DATA | BLOCK_SNAPSHOT)) {
             if (pindex->pprev) {
                 if (pindex->pprev->nChainTx) {
                     pindex->nChainTx = pindex->pprev->nChainTx + pindex->nTx;
@@ -4043,6 +4296,9 @@ bool static LoadBlockIndexDB(string& strError)
         if (pindex->IsValid(BLOCK_VALID_TREE) && (pindexBestHeader == NULL || CBlockIndexWorkComparator()(pindexBestHeader, pindex)))
             pindexBestHeader = pindex;
     }
+    int64_t nTimeSwept = GetTimeMicros();
+    LogPrintf("%s: block index loaded in %.2fms (records %.2fms, height buckets %.2fms, chain work and skip list %.2fms)\n", __func__,
+        0.001 * (nTimeSwept - nTimeStart), 0.001 * (nTimeLoaded - nTimeStart), 0.001 * (nTimeSorted - nTimeLoaded), 0.001 * (nTimeSwept - nTimeSorted));
 
     // Load block file info
     pblocktree->ReadLastBlockFile(nLastBlockFile);
@@ -4146,6 +4402,9 @@ bool CVerifyDB::VerifyDB(CCoinsView* coinsview, int nCheckLevel, int nCheckDepth
         uiInterface.ShowProgress(_("Verifying blocks..."), std::max(1, std::min(99, (int)(((double)(chainActive.Height() - pindex->nHeight)) / (double)nCheckDepth * (nCheckLevel >= 4 ? 50 : 100)))));
         if (pindex->nHeight < chainActive.Height() - nCheckDepth)
             break;
+        // nothing to verify below a loaded chainstate snapshot
+        if (!(pindex->nStatus & BLOCK_HAVE_DATA))
+            break;
         CBlock block;
         // check level 0: read from disk
         if (!ReadBlockFromDisk(block, pindex))
@@ -4471,7 +4730,7 @@ void static CheckBlockIndex()
     while (pindex != NULL) {
         nNodes++;
         if (pindexFirstInvalid == NULL && pindex->nStatus & BLOCK_FAILED_VALID) pindexFirstInvalid = pindex;
-        if (pindexFirstMissing == NULL && !(pindex->nStatus & BLOCK_HAVE_DATA)) pindexFirstMissing = pindex;
+        if (pindexFirstMissing == NULL && !(pindex->nStatus & (BLOCK_HAVE_DATA | BLOCK_SNAPSHOT))) pindexFirstMissing = pindex;
         if (pindex->pprev != NULL && pindexFirstNotTreeValid == NULL && (pindex->nStatus & BLOCK_VALID_MASK) < BLOCK_VALID_TREE) pindexFirstNotTreeValid = pindex;
         if (pindex->pprev != NULL && pindexFirstNotChainValid == NULL && (pindex->nStatus & BLOCK_VALID_MASK) < BLOCK_VALID_CHAIN) pindexFirstNotChainValid = pindex;
         if (pindex->pprev != NULL && pindexFirstNotScriptsValid == NULL && (pindex->nStatus & BLOCK_VALID_MASK) < BLOCK_VALID_SCRIPTS) pindexFirstNotScriptsValid = pindex;
@@ -4483,7 +4742,7 @@ void static CheckBlockIndex()
             assert(pindex == chainActive.Genesis());                       // The current active chain's genesis block must be this block.
         }
         // HAVE_DATA is equivalent to VALID_TRANSACTIONS and equivalent to nTx > 0 (we stored the number of transactions in the block)
-        assert(!(pindex->nStatus & BLOCK_HAVE_DATA) == (pindex->nTx == 0));
+        assert(!(pindex->nStatus & (BLOCK_HAVE_DATA | BLOCK_SNAPSHOT)) == (pindex->nTx == 0));
         assert(((pindex->nStatus & BLOCK_VALID_MASK) >= BLOCK_VALID_TRANSACTIONS) == (pindex->nTx > 0));
         if (pindex->nChainTx == 0) assert(pindex->nSequenceId == 0); // nSequenceId can't be set for blocks that aren't linked
         // All parents having data is equivalent to all parents being VALID_TRANSACTIONS, which is equivalent to nChainTx being set.
@@ -4517,7 +4776,7 @@ void static CheckBlockIndex()
             }
             rangeUnlinked.first++;
         }
-        if (pindex->pprev && pindex->nStatus & BLOCK_HAVE_DATA && pindexFirstMissing != NULL) {
+        if (pindex->pprev && pindex->nStatus & (BLOCK_HAVE_DATA | BLOCK_SNAPSHOT) && pindexFirstMissing != NULL) {
             if (pindexFirstInvalid == NULL) { // If this block has block data available, some parent doesn't, and has no invalid parents, it must be in mapBlocksUnlinked.
                 assert(foundInUnlinked);
             }
@@ -4644,14 +4903,13 @@ bool static AlreadyHave(const CInv& inv)
     case MSG_WITNESS_BLOCK:
         return mapBlockIndex.count(inv.hash);
     case MSG_TXLOCK_REQUEST:
-        return mapTxLockReq.count(inv.hash) ||
-               mapTxLockReqRejected.count(inv.hash);
+        return txLockManager.HaveRequest(inv.hash);
     case MSG_TXLOCK_VOTE:
-        return mapTxLockVote.count(inv.hash);
+        return txLockManager.HaveVote(inv.hash);
     case MSG_SPORK:
         return mapSporks.count(inv.hash);
     case MSG_MASTERNODE_WINNER:
-        if (masternodePayments.mapMasternodePayeeVotes.count(inv.hash)) {
+        if (masternodePayments.HasVote(inv.hash)) {
             masternodeSync.AddedMasternodeWinner(inv.hash);
             return true;
         }
@@ -4792,19 +5050,21 @@ void static ProcessGetData(CNode* pfrom)
                     }
                 }
                 if (!pushed && inv.type == MSG_TXLOCK_VOTE) {
-                    if (mapTxLockVote.count(inv.hash)) {
+                    CConsensusVote vote;
+                    if (txLockManager.GetVote(inv.hash, vote)) {
                         CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
                         ss.reserve(1000);
-                        ss << mapTxLockVote[inv.hash];
+                        ss << vote;
                         pfrom->PushMessage(NetMsgType::TXLVOTE, ss);
                         pushed = true;
                     }
                 }
                 if (!pushed && inv.type == MSG_TXLOCK_REQUEST) {
-                    if (mapTxLockReq.count(inv.hash)) {
+                    CTransaction tx;
+                    if (txLockManager.GetRequest(inv.hash, tx)) {
                         CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
                         ss.reserve(1000);
-                        ss << mapTxLockReq[inv.hash];
+                        ss << tx;
                         pfrom->PushMessage(NetMsgType::IX, ss);
                         pushed = true;
                     }
@@ -4819,10 +5079,11 @@ void static ProcessGetData(CNode* pfrom)
                     }
                 }
                 if (!pushed && inv.type == MSG_MASTERNODE_WINNER) {
-                    if (masternodePayments.mapMasternodePayeeVotes.count(inv.hash)) {
+                    CMasternodePaymentWinner winner;
+                    if (masternodePayments.GetVote(inv.hash, winner)) {
                         CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
                         ss.reserve(1000);
-                        ss << masternodePayments.mapMasternodePayeeVotes[inv.hash];
+                        ss << winner;
                         pfrom->PushMessage(NetMsgType::MNW, ss);
                         pushed = true;
                     }
@@ -4927,6 +5188,51 @@ void static ProcessGetData(CNode* pfrom)
 }
 
 bool fRequestedSporksIDB = false;
+/**
+ * Validate a getcfilters, getcfheaders or getcfcheckpt request and look up
+ * its stop block. Peers sending requests we never serve are disconnected.
+ */
+static bool PrepareBlockFilterRequest(CNode* pfrom, unsigned char nFilterType, uint32_t nStartHeight, const uint256& hashStop, uint32_t nMaxHeightDiff, const CBlockIndex*& pindexStop)
+{
+    if (!(nLocalServices & NODE_COMPACT_FILTERS) || !pblockfilterindex || nFilterType != pblockfilterindex->GetFilterType()) {
+        LogPrint("net", "peer %d requested unsupported block filter type: %d\n", pfrom->id, nFilterType);
+        pfrom->fDisconnect = true;
+        return false;
+    }
+
+    {
+        LOCK(cs_main);
+        BlockMap::iterator mi = mapBlockIndex.find(hashStop);
+        if (mi == mapBlockIndex.end()) {
+            LogPrint("net", "peer %d requested invalid block hash: %s\n", pfrom->id, hashStop.ToString());
+            pfrom->fDisconnect = true;
+            return false;
+        }
+        // Only filters of the active chain are served; the peer may have
+        // asked before a reorg, so this is not a reason to disconnect.
+        if (!chainActive.Contains(mi->second)) {
+            LogPrint("net", "peer %d requested filters of block %s which is not in the active chain\n", pfrom->id, hashStop.ToString());
+            return false;
+        }
+        pindexStop = mi->second;
+    }
+
+    uint32_t nStopHeight = pindexStop->nHeight;
+    if (nStartHeight > nStopHeight) {
+        LogPrint("net", "peer %d sent invalid getcfilters/getcfheaders with start height %d and stop height %d\n",
+            pfrom->id, nStartHeight, nStopHeight);
+        pfrom->fDisconnect = true;
+        return false;
+    }
+    if (nStopHeight - nStartHeight >= nMaxHeightDiff) {
+        LogPrint("net", "peer %d requested too many cfilters/cfheaders: %d / %d\n",
+            pfrom->id, nStopHeight - nStartHeight + 1, nMaxHeightDiff);
+        pfrom->fDisconnect = true;
+        return false;
+    }
+    return true;
+}
+
 bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv, int64_t nTimeReceived)
 {
     if (fDebug)
@@ -5092,6 +5398,8 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
             LOCK(cs_main);
             State(pfrom->GetId())->fCurrentlyConnected = true;
         }
+
+        TriggerMasternodeTasks(MN_TASK_EVENT_NEW_PEER);
     }
 
 
@@ -5353,6 +5661,7 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
 
                 ignoreFees = true;
                 pmn->allowFreeTx = false;
+                mnodeman.SetChanged(pmn->vin);
 
                 if (!mapObfuscationBroadcastTxes.count(tx.GetHash())) {
                     CObfuscationBroadcastTx dstx;
@@ -5778,6 +6087,67 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
     }
 
 
+    else if (strCommand == NetMsgType::GETCFILTERS) {
+        unsigned char nFilterType;
+        uint32_t nStartHeight;
+        uint256 hashStop;
+        vRecv >> nFilterType >> nStartHeight >> hashStop;
+
+        const CBlockIndex* pindexStop = NULL;
+        if (PrepareBlockFilterRequest(pfrom, nFilterType, nStartHeight, hashStop, MAX_GETCFILTERS_SIZE, pindexStop)) {
+            std::vector<CBlockFilter> vFilters;
+            if (!pblockfilterindex->LookupFilterRange(nStartHeight, pindexStop, vFilters)) {
+                LogPrint("net", "Failed to find block filter in index: start height=%d, stop hash=%s\n", nStartHeight, hashStop.ToString());
+            } else {
+                BOOST_FOREACH (const CBlockFilter& filter, vFilters)
+                    pfrom->PushMessage(NetMsgType::CFILTER, filter);
+            }
+        }
+    }
+
+
+    else if (strCommand == NetMsgType::GETCFHEADERS) {
+        unsigned char nFilterType;
+        uint32_t nStartHeight;
+        uint256 hashStop;
+        vRecv >> nFilterType >> nStartHeight >> hashStop;
+
+        const CBlockIndex* pindexStop = NULL;
+        if (PrepareBlockFilterRequest(pfrom, nFilterType, nStartHeight, hashStop, MAX_GETCFHEADERS_SIZE, pindexStop)) {
+            uint256 prevHeader;
+            std::vector<uint256> vFilterHashes;
+            if (nStartHeight > 0 && !pblockfilterindex->LookupFilterHeader(pindexStop->GetAncestor(nStartHeight - 1), prevHeader)) {
+                LogPrint("net", "Failed to find block filter header in index: height=%d, stop hash=%s\n", nStartHeight - 1, hashStop.ToString());
+            } else if (!pblockfilterindex->LookupFilterHashRange(nStartHeight, pindexStop, vFilterHashes)) {
+                LogPrint("net", "Failed to find block filter hashes in index: start height=%d, stop hash=%s\n", nStartHeight, hashStop.ToString());
+            } else {
+                pfrom->PushMessage(NetMsgType::CFHEADERS, nFilterType, hashStop, prevHeader, vFilterHashes);
+            }
+        }
+    }
+
+
+    else if (strCommand == NetMsgType::GETCFCHECKPT) {
+        unsigned char nFilterType;
+        uint256 hashStop;
+        vRecv >> nFilterType >> hashStop;
+
+        const CBlockIndex* pindexStop = NULL;
+        if (PrepareBlockFilterRequest(pfrom, nFilterType, 0, hashStop, std::numeric_limits<uint32_t>::max(), pindexStop)) {
+            std::vector<uint256> vHeaders(pindexStop->nHeight / CFCHECKPT_INTERVAL);
+            bool fFound = true;
+            for (unsigned int i = 0; i < vHeaders.size() && fFound; i++) {
+                const CBlockIndex* pindex = pindexStop->GetAncestor((i + 1) * CFCHECKPT_INTERVAL);
+                fFound = pblockfilterindex->LookupFilterHeader(pindex, vHeaders[i]);
+            }
+            if (!fFound)
+                LogPrint("net", "Failed to find block filter checkpoints in index: stop hash=%s\n", hashStop.ToString());
+            else
+                pfrom->PushMessage(NetMsgType::CFCHECKPT, nFilterType, hashStop, vHeaders);
+        }
+    }
+
+
     else if (strCommand == NetMsgType::REJECT) {
         if (fDebug) {
             try {
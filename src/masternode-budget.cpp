@@ -13,6 +13,7 @@
 #include "masternode.h"
 #include "masternodeman.h"
 #include "obfuscation.h"
+#include "syncsketch.h"
 #include "util.h"
 #include <boost/filesystem.hpp>
 
@@ -285,6 +286,12 @@ CBudgetDB::CBudgetDB()
     strMagicMessage = "MasternodeBudget";
 }
 
+CBudgetDB::CBudgetDB(const boost::filesystem::path& pathIn)
+{
+    pathDB = pathIn;
+    strMagicMessage = "MasternodeBudget";
+}
+
 bool CBudgetDB::Write(const CBudgetManager& objToSave)
 {
     LOCK(objToSave.cs);
@@ -403,31 +410,19 @@ CBudgetDB::ReadResult CBudgetDB::Read(CBudgetManager& objToLoad, bool fDryRun)
     return Ok;
 }
 
-void DumpBudgets()
+bool LoadBudgets()
 {
-    int64_t nStart = GetTimeMillis();
-
-    CBudgetDB budgetdb;
-    CBudgetManager tempBudget;
-
-    LogPrint("mnbudget","Verifying budget.dat format...\n");
-    CBudgetDB::ReadResult readResult = budgetdb.Read(tempBudget, true);
-    // there was an error and it was not an error on file opening => do not proceed
-    if (readResult == CBudgetDB::FileError)
-        LogPrint("mnbudget","Missing budgets file - budget.dat, will try to recreate\n");
-    else if (readResult != CBudgetDB::Ok) {
-        LogPrint("mnbudget","Error reading budget.dat: ");
-        if (readResult == CBudgetDB::IncorrectFormat)
-            LogPrint("mnbudget","magic is ok but data has invalid format, will try to recreate\n");
-        else {
-            LogPrint("mnbudget","file format is unknown or invalid, please fix it manually\n");
-            return;
-        }
-    }
-    LogPrint("mnbudget","Writting info to budget.dat...\n");
-    budgetdb.Write(budget);
+    if (pmnstore == NULL)
+        return false;
+    if (ImportCacheFile<CBudgetDB>("budget.dat", budget))
+        return true;
+    return budget.ReadStore(*pmnstore);
+}
 
-    LogPrint("mnbudget","Budget dump finished  %dms\n", GetTimeMillis() - nStart);
+void DumpBudgets()
+{
+    if (pmnstore != NULL)
+        budget.WriteStore(*pmnstore);
 }
 
 bool CBudgetManager::AddFinalizedBudget(CFinalizedBudget& finalizedBudget)
@@ -440,6 +435,7 @@ bool CBudgetManager::AddFinalizedBudget(CFinalizedBudget& finalizedBudget)
     }
 
     mapFinalizedBudgets.insert(make_pair(finalizedBudget.GetHash(), finalizedBudget));
+    changedFinalizedBudgets.Add(finalizedBudget.GetHash());
     return true;
 }
 
@@ -457,6 +453,7 @@ bool CBudgetManager::AddProposal(CBudgetProposal& budgetProposal)
     }
 
     mapProposals.insert(make_pair(budgetProposal.GetHash(), budgetProposal));
+    changedProposals.Add(budgetProposal.GetHash());
     LogPrint("mnbudget","CBudgetManager::AddProposal - proposal %s added\n", budgetProposal.GetName ().c_str ());
     return true;
 }
@@ -498,7 +495,10 @@ void CBudgetManager::CheckAndRemove()
         }
 
         if (pfinalizedBudget->fValid) {
+            bool fAutoChecked = pfinalizedBudget->IsAutoChecked();
             pfinalizedBudget->CheckAndVote();
+            if (pfinalizedBudget->IsAutoChecked() != fAutoChecked)
+                changedFinalizedBudgets.Add((*it).first);
             tmpMapFinalizedBudgets.insert(make_pair(pfinalizedBudget->GetHash(), *pfinalizedBudget));
         }
 
@@ -528,6 +528,14 @@ void CBudgetManager::CheckAndRemove()
     mapFinalizedBudgets.swap(tmpMapFinalizedBudgets);
     mapProposals.swap(tmpMapProposals);
 
+    // The maps now hold the entries before the cleanup, so these were removed
+    for (it = tmpMapFinalizedBudgets.begin(); it != tmpMapFinalizedBudgets.end(); ++it)
+        if (!mapFinalizedBudgets.count((*it).first))
+            changedFinalizedBudgets.Add((*it).first);
+    for (it2 = tmpMapProposals.begin(); it2 != tmpMapProposals.end(); ++it2)
+        if (!mapProposals.count((*it2).first))
+            changedProposals.Add((*it2).first);
+
     LogPrint("mnbudget", "CBudgetManager::CheckAndRemove - mapFinalizedBudgets cleanup - size after: %d\n", mapFinalizedBudgets.size());
     LogPrint("mnbudget", "CBudgetManager::CheckAndRemove - mapProposals cleanup - size after: %d\n", mapProposals.size());
     LogPrint("mnbudget","CBudgetManager::CheckAndRemove - PASSED\n");
@@ -741,7 +749,8 @@ std::vector<CBudgetProposal*> CBudgetManager::GetAllProposals()
 
     std::map<uint256, CBudgetProposal>::iterator it = mapProposals.begin();
     while (it != mapProposals.end()) {
-        (*it).second.CleanAndRemove(false);
+        if ((*it).second.CleanAndRemove(false))
+            changedProposals.Add((*it).first);
 
         CBudgetProposal* pbudgetProposal = &((*it).second);
         vBudgetProposalRet.push_back(pbudgetProposal);
@@ -775,7 +784,8 @@ std::vector<CBudgetProposal*> CBudgetManager::GetBudget()
 
     std::map<uint256, CBudgetProposal>::iterator it = mapProposals.begin();
     while (it != mapProposals.end()) {
-        (*it).second.CleanAndRemove(false);
+        if ((*it).second.CleanAndRemove(false))
+            changedProposals.Add((*it).first);
         vBudgetPorposalsSort.push_back(make_pair(&((*it).second), (*it).second.GetYeas() - (*it).second.GetNays()));
         ++it;
     }
@@ -964,14 +974,16 @@ void CBudgetManager::NewBlock()
     LogPrint("mnbudget","CBudgetManager::NewBlock - mapProposals cleanup - size: %d\n", mapProposals.size());
     std::map<uint256, CBudgetProposal>::iterator it2 = mapProposals.begin();
     while (it2 != mapProposals.end()) {
-        (*it2).second.CleanAndRemove(false);
+        if ((*it2).second.CleanAndRemove(false))
+            changedProposals.Add((*it2).first);
         ++it2;
     }
 
     LogPrint("mnbudget","CBudgetManager::NewBlock - mapFinalizedBudgets cleanup - size: %d\n", mapFinalizedBudgets.size());
     std::map<uint256, CFinalizedBudget>::iterator it3 = mapFinalizedBudgets.begin();
     while (it3 != mapFinalizedBudgets.end()) {
-        (*it3).second.CleanAndRemove(false);
+        if ((*it3).second.CleanAndRemove(false))
+            changedFinalizedBudgets.Add((*it3).first);
         ++it3;
     }
 
@@ -1055,6 +1067,28 @@ void CBudgetManager::ProcessMessage(CNode* pfrom, std::string& strCommand, CData
         LogPrint("mnbudget", "mnvs - Sent Masternode votes to peer %i\n", pfrom->GetId());
     }
 
+    if (strCommand == NetMsgType::MNVSSKETCH) { //Masternode vote sync of what the peer is missing
+        CSyncSketch sketch;
+        vRecv >> sketch;
+
+        if (!sketch.IsWithinSizeConstraints()) {
+            Misbehaving(pfrom->GetId(), 100);
+            return;
+        }
+
+        if (Params().NetworkID() == CBaseChainParams::MAIN) {
+            if (pfrom->HasFulfilledRequest(NetMsgType::MNVS)) {
+                LogPrint("mnbudget","mnvssketch - peer already asked me for the list\n");
+                Misbehaving(pfrom->GetId(), 20);
+                return;
+            }
+            pfrom->FulfilledRequest(NetMsgType::MNVS);
+        }
+
+        SyncMissing(pfrom, sketch);
+        LogPrint("mnbudget", "mnvssketch - Sent Masternode votes to peer %i\n", pfrom->GetId());
+    }
+
     if (strCommand == NetMsgType::MPROP) { //Masternode Proposal
         CBudgetProposalBroadcast budgetProposalBroadcast;
         vRecv >> budgetProposalBroadcast;
@@ -1357,6 +1391,96 @@ void CBudgetManager::Sync(CNode* pfrom, uint256 nProp, bool fPartial)
     LogPrint("mnbudget", "CBudgetManager::Sync - sent %d items\n", nInvCount);
 }
 
+void CBudgetManager::GetSyncInventory(std::vector<CInv>& vInv, size_t& nProposalItems)
+{
+    LOCK(cs);
+
+    vInv.clear();
+    std::map<uint256, CBudgetProposalBroadcast>::iterator it1 = mapSeenMasternodeBudgetProposals.begin();
+    while (it1 != mapSeenMasternodeBudgetProposals.end()) {
+        CBudgetProposal* pbudgetProposal = FindProposal((*it1).first);
+        if (pbudgetProposal && pbudgetProposal->fValid) {
+            vInv.push_back(CInv(MSG_BUDGET_PROPOSAL, (*it1).second.GetHash()));
+            std::map<uint256, CBudgetVote>::iterator it2 = pbudgetProposal->mapVotes.begin();
+            while (it2 != pbudgetProposal->mapVotes.end()) {
+                if ((*it2).second.fValid)
+                    vInv.push_back(CInv(MSG_BUDGET_VOTE, (*it2).second.GetHash()));
+                ++it2;
+            }
+        }
+        ++it1;
+    }
+    nProposalItems = vInv.size();
+
+    std::map<uint256, CFinalizedBudgetBroadcast>::iterator it3 = mapSeenFinalizedBudgets.begin();
+    while (it3 != mapSeenFinalizedBudgets.end()) {
+        CFinalizedBudget* pfinalizedBudget = FindFinalizedBudget((*it3).first);
+        if (pfinalizedBudget && pfinalizedBudget->fValid) {
+            vInv.push_back(CInv(MSG_BUDGET_FINALIZED, (*it3).second.GetHash()));
+            std::map<uint256, CFinalizedBudgetVote>::iterator it4 = pfinalizedBudget->mapVotes.begin();
+            while (it4 != pfinalizedBudget->mapVotes.end()) {
+                if ((*it4).second.fValid)
+                    vInv.push_back(CInv(MSG_BUDGET_FINALIZED_VOTE, (*it4).second.GetHash()));
+                ++it4;
+            }
+        }
+        ++it3;
+    }
+}
+
+void CBudgetManager::SyncMissing(CNode* pfrom, const CSyncSketch& sketch)
+{
+    LOCK(cs);
+
+    std::vector<CInv> vInv;
+    size_t nProposalItems;
+    GetSyncInventory(vInv, nProposalItems);
+
+    std::vector<uint256> vHashes;
+    BOOST_FOREACH (const CInv& inv, vInv)
+        vHashes.push_back(inv.hash);
+
+    std::vector<size_t> vMissing;
+    if (!sketch.GetMissing(vHashes, vMissing)) {
+        LogPrint("mnbudget", "CBudgetManager::SyncMissing - could not decode the difference with peer %i, sending all %d items\n", pfrom->GetId(), vInv.size());
+        Sync(pfrom, 0);
+        return;
+    }
+
+    // The counts are reported separately, as Sync does
+    int nInvCountProp = 0, nInvCountFin = 0;
+    BOOST_FOREACH (size_t i, vMissing) {
+        pfrom->PushInventory(vInv[i]);
+        if (i < nProposalItems)
+            nInvCountProp++;
+        else
+            nInvCountFin++;
+    }
+    pfrom->PushMessage(NetMsgType::SSC, MASTERNODE_SYNC_BUDGET_PROP, nInvCountProp);
+    pfrom->PushMessage(NetMsgType::SSC, MASTERNODE_SYNC_BUDGET_FIN, nInvCountFin);
+    LogPrint("mnbudget", "CBudgetManager::SyncMissing - sent %d of %d items\n", nInvCountProp + nInvCountFin, vInv.size());
+}
+
+void CBudgetManager::RequestSync(CNode* pnode)
+{
+    std::vector<CInv> vInv;
+    size_t nProposalItems;
+    if (pnode->nVersion >= SYNC_SKETCH_VERSION)
+        GetSyncInventory(vInv, nProposalItems);
+
+    if (vInv.empty()) {
+        uint256 n = 0;
+        pnode->PushMessage(NetMsgType::MNVS, n); //sync masternode votes
+        return;
+    }
+
+    std::vector<uint256> vHashes;
+    BOOST_FOREACH (const CInv& inv, vInv)
+        vHashes.push_back(inv.hash);
+    pnode->PushMessage(NetMsgType::MNVSSKETCH, CSyncSketch::ForKeys(vHashes));
+    pnode->FulfilledRequest(NetMsgType::MNVSSKETCH);
+}
+
 bool CBudgetManager::UpdateProposal(CBudgetVote& vote, CNode* pfrom, std::string& strError)
 {
     LOCK(cs);
@@ -1381,7 +1505,10 @@ bool CBudgetManager::UpdateProposal(CBudgetVote& vote, CNode* pfrom, std::string
     }
 
 
-    return mapProposals[vote.nProposalHash].AddOrUpdateVote(vote, strError);
+    if (!mapProposals[vote.nProposalHash].AddOrUpdateVote(vote, strError))
+        return false;
+    changedProposals.Add(vote.nProposalHash);
+    return true;
 }
 
 bool CBudgetManager::UpdateFinalizedBudget(CFinalizedBudgetVote& vote, CNode* pfrom, std::string& strError)
@@ -1407,7 +1534,10 @@ bool CBudgetManager::UpdateFinalizedBudget(CFinalizedBudgetVote& vote, CNode* pf
         return false;
     }
     LogPrint("mnbudget","CBudgetManager::UpdateFinalizedBudget - Finalized Proposal %s added\n", vote.nBudgetHash.ToString());
-    return mapFinalizedBudgets[vote.nBudgetHash].AddOrUpdateVote(vote, strError);
+    if (!mapFinalizedBudgets[vote.nBudgetHash].AddOrUpdateVote(vote, strError))
+        return false;
+    changedFinalizedBudgets.Add(vote.nBudgetHash);
+    return true;
 }
 
 CBudgetProposal::CBudgetProposal()
@@ -1557,14 +1687,20 @@ bool CBudgetProposal::AddOrUpdateVote(CBudgetVote& vote, std::string& strError)
 }
 
 // If masternode voted for a proposal, but is now invalid -- remove the vote
-void CBudgetProposal::CleanAndRemove(bool fSignatureCheck)
+bool CBudgetProposal::CleanAndRemove(bool fSignatureCheck)
 {
+    bool fChanged = false;
     std::map<uint256, CBudgetVote>::iterator it = mapVotes.begin();
 
     while (it != mapVotes.end()) {
-        (*it).second.fValid = (*it).second.SignatureValid(fSignatureCheck);
+        bool fValidVote = (*it).second.SignatureValid(fSignatureCheck);
+        if (fValidVote != (*it).second.fValid) {
+            (*it).second.fValid = fValidVote;
+            fChanged = true;
+        }
         ++it;
     }
+    return fChanged;
 }
 
 double CBudgetProposal::GetRatio()
@@ -1931,14 +2067,20 @@ void CFinalizedBudget::CheckAndVote()
 }
 
 // Remove votes from masternodes which are not valid/existent anymore
-void CFinalizedBudget::CleanAndRemove(bool fSignatureCheck)
+bool CFinalizedBudget::CleanAndRemove(bool fSignatureCheck)
 {
+    bool fChanged = false;
     std::map<uint256, CFinalizedBudgetVote>::iterator it = mapVotes.begin();
 
     while (it != mapVotes.end()) {
-        (*it).second.fValid = (*it).second.SignatureValid(fSignatureCheck);
+        bool fValidVote = (*it).second.SignatureValid(fSignatureCheck);
+        if (fValidVote != (*it).second.fValid) {
+            (*it).second.fValid = fValidVote;
+            fChanged = true;
+        }
         ++it;
     }
+    return fChanged;
 }
 
 CAmount CFinalizedBudget::GetTotalPayout()
@@ -2294,6 +2436,73 @@ bool CFinalizedBudgetVote::SignatureValid(bool fSignatureCheck)
     return true;
 }
 
+void CBudgetManager::SetAllChanged(const CMasternodeStoreDB& db)
+{
+    std::vector<uint256> vStored;
+    db.ReadKeys(DB_BUDGET_PROPOSAL, vStored);
+    BOOST_FOREACH (const uint256& hash, vStored)
+        changedProposals.Add(hash);
+    db.ReadKeys(DB_FINALIZED_BUDGET, vStored);
+    BOOST_FOREACH (const uint256& hash, vStored)
+        changedFinalizedBudgets.Add(hash);
+
+    LOCK(cs);
+    for (std::map<uint256, CBudgetProposal>::iterator it = mapProposals.begin(); it != mapProposals.end(); ++it)
+        changedProposals.Add((*it).first);
+    for (std::map<uint256, CFinalizedBudget>::iterator it = mapFinalizedBudgets.begin(); it != mapFinalizedBudgets.end(); ++it)
+        changedFinalizedBudgets.Add((*it).first);
+}
+
+bool CBudgetManager::ReadStore(const CMasternodeStoreDB& db)
+{
+    int64_t nStart = GetTimeMillis();
+
+    std::vector<std::pair<uint256, CBudgetProposal> > vProposals;
+    std::vector<std::pair<uint256, CFinalizedBudget> > vFinalizedBudgets;
+    if (!db.ReadRecords(DB_BUDGET_PROPOSAL, vProposals) || !db.ReadRecords(DB_FINALIZED_BUDGET, vFinalizedBudgets))
+        return false;
+
+    {
+        LOCK(cs);
+        Clear();
+        mapProposals.insert(vProposals.begin(), vProposals.end());
+        mapFinalizedBudgets.insert(vFinalizedBudgets.begin(), vFinalizedBudgets.end());
+    }
+
+    LogPrint("mnbudget", "Loaded %u proposals and %u finalized budgets from the masternode store  %dms\n", vProposals.size(), vFinalizedBudgets.size(), GetTimeMillis() - nStart);
+    LogPrint("mnbudget", "Budget manager - cleaning....\n");
+    CheckAndRemove();
+    LogPrint("mnbudget", "Budget manager - result:\n");
+    LogPrint("mnbudget", "  %s\n", ToString());
+    return true;
+}
+
+bool CBudgetManager::WriteStore(CMasternodeStoreDB& db)
+{
+    int64_t nStart = GetTimeMillis();
+
+    std::set<uint256> setProposals, setFinalizedBudgets;
+    changedProposals.Take(setProposals);
+    changedFinalizedBudgets.Take(setFinalizedBudgets);
+
+    CLevelDBBatch batch;
+    unsigned int nWritten = 0, nRemoved = 0;
+    {
+        LOCK(cs);
+        BatchChanges(batch, DB_BUDGET_PROPOSAL, setProposals, mapProposals, nWritten, nRemoved);
+        BatchChanges(batch, DB_FINALIZED_BUDGET, setFinalizedBudgets, mapFinalizedBudgets, nWritten, nRemoved);
+    }
+
+    if (!db.WriteChanges(batch)) {
+        changedProposals.Restore(setProposals);
+        changedFinalizedBudgets.Restore(setFinalizedBudgets);
+        return error("%s : Failed to write %u budget objects to the masternode store", __func__, setProposals.size() + setFinalizedBudgets.size());
+    }
+
+    LogPrint("mnbudget", "Written %u changed and %u removed budget objects to the masternode store  %dms\n", nWritten, nRemoved, GetTimeMillis() - nStart);
+    return true;
+}
+
 std::string CBudgetManager::ToString() const
 {
     std::ostringstream info;
@@ -11,6 +11,7 @@
 #include "key.h"
 #include "main.h"
 #include "masternode.h"
+#include "mnstoredb.h"
 #include "net.h"
 #include "sync.h"
 #include "util.h"
@@ -25,6 +26,7 @@ class CFinalizedBudget;
 class CBudgetProposal;
 class CBudgetProposalBroadcast;
 class CTxBudgetPayment;
+class CSyncSketch;
 
 #define VOTE_ABSTAIN 0
 #define VOTE_YES 1
@@ -45,6 +47,9 @@ extern std::vector<CFinalizedBudgetBroadcast> vecImmatureFinalizedBudgets;
 static map<uint256, int> mapPayment_History;
 
 extern CBudgetManager budget;
+/** Load the proposals and finalized budgets from the masternode store, or budget.dat if there is one */
+bool LoadBudgets();
+/** Write the proposals and finalized budgets that changed to the masternode store */
 void DumpBudgets();
 
 // Define amount of blocks in budget payment cycle
@@ -151,7 +156,8 @@ public:
     }
 };
 
-/** Save Budget Manager (budget.dat)
+/** Flat file of the Budget Manager (budget.dat), which older versions and
+ *  chainstate snapshots use
  */
 class CBudgetDB
 {
@@ -171,6 +177,7 @@ public:
     };
 
     CBudgetDB();
+    explicit CBudgetDB(const boost::filesystem::path& pathIn);
     bool Write(const CBudgetManager& objToSave);
     ReadResult Read(CBudgetManager& objToLoad, bool fDryRun = false);
 };
@@ -186,6 +193,13 @@ private:
     // XX42    map<uint256, CTransaction> mapCollateral;
     map<uint256, uint256> mapCollateralTxids;
 
+    // Proposals and finalized budgets changed since the masternode store was last written
+    CStoreChangeSet<uint256> changedProposals;
+    CStoreChangeSet<uint256> changedFinalizedBudgets;
+
+    /** Inventory of a full sync: proposals and their votes, the first nProposalItems, then finalized budgets and theirs */
+    void GetSyncInventory(std::vector<CInv>& vInv, size_t& nProposalItems);
+
 public:
     // critical section to protect the inner data structures
     mutable CCriticalSection cs;
@@ -221,6 +235,10 @@ public:
     void ResetSync();
     void MarkSynced();
     void Sync(CNode* node, uint256 nProp, bool fPartial = false);
+    /** Send the proposals, finalized budgets and votes missing from the peer's sketch */
+    void SyncMissing(CNode* node, const CSyncSketch& sketch);
+    /** Ask a peer for all budgets, with a sketch of ours if it understands one */
+    void RequestSync(CNode* node);
 
     void Calculate();
     void ProcessMessage(CNode* pfrom, std::string& strCommand, CDataStream& vRecv);
@@ -265,6 +283,13 @@ public:
     void CheckAndRemove();
     std::string ToString() const;
 
+    /// Mark everything in memory and in the store as changed, so the next dump replaces the stored budgets
+    void SetAllChanged(const CMasternodeStoreDB& db);
+    /// Load the proposals and finalized budgets, with their votes, from the masternode store
+    bool ReadStore(const CMasternodeStoreDB& db);
+    /// Write the proposals and finalized budgets that changed to the masternode store
+    bool WriteStore(CMasternodeStoreDB& db);
+
 
     ADD_SERIALIZE_METHODS;
 
@@ -333,7 +358,10 @@ public:
     CFinalizedBudget();
     CFinalizedBudget(const CFinalizedBudget& other);
 
-    void CleanAndRemove(bool fSignatureCheck);
+    bool IsAutoChecked() const { return fAutoChecked; }
+
+    /** Check the signatures of the votes again, returning true if one of them became valid or invalid */
+    bool CleanAndRemove(bool fSignatureCheck);
     bool AddOrUpdateVote(CFinalizedBudgetVote& vote, std::string& strError);
     double GetScore();
     bool HasMinimumRequiredSupport();
@@ -526,7 +554,8 @@ public:
     void SetAllotted(CAmount nAllotedIn) { nAlloted = nAllotedIn; }
     CAmount GetAllotted() { return nAlloted; }
 
-    void CleanAndRemove(bool fSignatureCheck);
+    /** Check the signatures of the votes again, returning true if one of them became valid or invalid */
+    bool CleanAndRemove(bool fSignatureCheck);
 
     uint256 GetHash() const
     {
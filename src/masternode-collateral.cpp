@@ -0,0 +1,151 @@
+// Copyright (c) 2019 The TRBO developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "masternode-collateral.h"
+
+#include "coins.h"
+#include "main.h"
+#include "masternodeman.h"
+#include "txmempool.h"
+#include "util.h"
+
+#include <set>
+
+CCollateralWatcher collateralWatcher;
+
+/** Whether the outpoint is spent in the chain or by a transaction in the mempool */
+static bool IsSpentInChainOrMempool(const COutPoint& outpoint)
+{
+    AssertLockHeld(cs_main);
+
+    {
+        LOCK(mempool.cs);
+        if (mempool.mapNextTx.count(outpoint))
+            return true;
+        // a collateral made by a transaction not in a block yet
+        CTransaction tx;
+        if (mempool.lookup(outpoint.hash, tx))
+            return outpoint.n >= tx.vout.size();
+    }
+
+    const CCoins* coins = pcoinsTip->AccessCoins(outpoint.hash);
+    return coins == NULL || !coins->IsAvailable(outpoint.n);
+}
+
+void CCollateralWatcher::Update(const std::vector<CTransaction>& vtx)
+{
+    std::set<COutPoint> setTouched;
+    {
+        LOCK(cs);
+        if (mapWatched.empty())
+            return;
+        for (const CTransaction& tx : vtx) {
+            for (const CTxIn& txin : tx.vin) {
+                if (mapWatched.count(txin.prevout))
+                    setTouched.insert(txin.prevout);
+            }
+        }
+    }
+    if (setTouched.empty())
+        return;
+
+    // Whether a transaction entered the mempool, or a block was connected or
+    // disconnected, the chain state and the mempool tell what is spent now
+    std::vector<COutPoint> vSpent;
+    {
+        LOCK(cs_main);
+        std::map<COutPoint, CollateralState> mapStates;
+        for (const COutPoint& outpoint : setTouched)
+            mapStates[outpoint] = IsSpentInChainOrMempool(outpoint) ? COLLATERAL_SPENT : COLLATERAL_UNSPENT;
+
+        LOCK(cs);
+        for (const std::pair<const COutPoint, CollateralState>& item : mapStates) {
+            std::map<COutPoint, CollateralState>::iterator it = mapWatched.find(item.first);
+            if (it == mapWatched.end())
+                continue;
+            if (item.second == COLLATERAL_SPENT && it->second != COLLATERAL_SPENT)
+                vSpent.push_back(item.first);
+            it->second = item.second;
+        }
+    }
+
+    for (const COutPoint& outpoint : vSpent) {
+        LogPrint("masternode", "CCollateralWatcher::Update - collateral %s spent\n", outpoint.ToStringShort());
+        mnodeman.CollateralSpent(outpoint);
+    }
+}
+
+void CCollateralWatcher::SyncTransaction(const CTransaction& tx, const CBlock* pblock)
+{
+    Update(std::vector<CTransaction>(1, tx));
+}
+
+void CCollateralWatcher::SyncTransactions(const std::vector<CTransaction>& vtx, const CBlock* pblock)
+{
+    Update(vtx);
+}
+
+void CCollateralWatcher::Watch(const COutPoint& outpoint)
+{
+    LOCK(cs);
+    mapWatched.insert(std::make_pair(outpoint, COLLATERAL_UNCHECKED));
+}
+
+void CCollateralWatcher::SetWatched(const std::vector<COutPoint>& vOutpoints)
+{
+    LOCK(cs);
+    std::map<COutPoint, CollateralState> mapNew;
+    for (const COutPoint& outpoint : vOutpoints) {
+        std::map<COutPoint, CollateralState>::const_iterator it = mapWatched.find(outpoint);
+        mapNew[outpoint] = it == mapWatched.end() ? COLLATERAL_UNCHECKED : it->second;
+    }
+    mapWatched.swap(mapNew);
+}
+
+void CCollateralWatcher::Clear()
+{
+    LOCK(cs);
+    mapWatched.clear();
+}
+
+void CCollateralWatcher::CheckUnchecked()
+{
+    std::vector<COutPoint> vUnchecked;
+    {
+        LOCK(cs);
+        for (const std::pair<const COutPoint, CollateralState>& item : mapWatched) {
+            if (item.second == COLLATERAL_UNCHECKED)
+                vUnchecked.push_back(item.first);
+        }
+    }
+    if (vUnchecked.empty())
+        return;
+
+    // cs_main is held until the states are stored, so no transaction spending
+    // one of them is processed in between
+    LOCK(cs_main);
+    std::vector<std::pair<COutPoint, CollateralState> > vStates;
+    for (const COutPoint& outpoint : vUnchecked)
+        vStates.push_back(std::make_pair(outpoint, IsSpentInChainOrMempool(outpoint) ? COLLATERAL_SPENT : COLLATERAL_UNSPENT));
+
+    LOCK(cs);
+    for (const std::pair<COutPoint, CollateralState>& item : vStates) {
+        std::map<COutPoint, CollateralState>::iterator it = mapWatched.find(item.first);
+        if (it != mapWatched.end() && it->second == COLLATERAL_UNCHECKED)
+            it->second = item.second;
+    }
+}
+
+bool CCollateralWatcher::IsSpent(const COutPoint& outpoint) const
+{
+    LOCK(cs);
+    std::map<COutPoint, CollateralState>::const_iterator it = mapWatched.find(outpoint);
+    return it != mapWatched.end() && it->second == COLLATERAL_SPENT;
+}
+
+size_t CCollateralWatcher::size() const
+{
+    LOCK(cs);
+    return mapWatched.size();
+}
@@ -0,0 +1,63 @@
+// Copyright (c) 2019 The TRBO developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef MASTERNODE_COLLATERAL_H
+#define MASTERNODE_COLLATERAL_H
+
+#include "primitives/transaction.h"
+#include "sync.h"
+#include "validationinterface.h"
+
+#include <map>
+#include <vector>
+
+class CCollateralWatcher;
+
+extern CCollateralWatcher collateralWatcher;
+
+/**
+ * Keeps track of whether the collaterals of the masternodes in the list are
+ * spent, from the transactions of connected and disconnected blocks and the
+ * ones entering the mempool, so checking a masternode is a plain read that
+ * never waits for cs_main. A collateral is looked up in the chain state once
+ * when it starts being watched, by CheckUnchecked, and on every transaction
+ * spending it after that.
+ */
+class CCollateralWatcher : public CValidationInterface
+{
+private:
+    enum CollateralState {
+        COLLATERAL_UNCHECKED,
+        COLLATERAL_UNSPENT,
+        COLLATERAL_SPENT
+    };
+
+    //! Never held while taking another lock
+    mutable CCriticalSection cs;
+    std::map<COutPoint, CollateralState> mapWatched;
+
+    /** Update the state of the watched collaterals the transactions spend, and flip the masternodes of the spent ones */
+    void Update(const std::vector<CTransaction>& vtx);
+
+protected:
+    void SyncTransaction(const CTransaction& tx, const CBlock* pblock);
+    void SyncTransactions(const std::vector<CTransaction>& vtx, const CBlock* pblock);
+
+public:
+    /** Start watching a collateral; it is unchecked until CheckUnchecked or a transaction spending it */
+    void Watch(const COutPoint& outpoint);
+    /** Watch exactly these collaterals, keeping what is known about the ones already watched */
+    void SetWatched(const std::vector<COutPoint>& vOutpoints);
+    void Clear();
+
+    /** Look up the collaterals not checked yet in the chain state and the mempool; takes cs_main */
+    void CheckUnchecked();
+
+    /** Whether the collateral is known to be spent */
+    bool IsSpent(const COutPoint& outpoint) const;
+
+    size_t size() const;
+};
+
+#endif
@@ -10,17 +10,22 @@
 #include "masternodeman.h"
 #include "obfuscation.h"
 #include "protocol.h"
+#include "random.h"
 #include "spork.h"
 #include "sync.h"
+#include "syncsketch.h"
 #include "util.h"
 #include "utilmoneystr.h"
+
+#include <algorithm>
+#include <limits>
+
 #include <boost/filesystem.hpp>
 
 /** Object for who's going to get paid on which blocks */
 CMasternodePayments masternodePayments;
 
 CCriticalSection cs_vecPayments;
-CCriticalSection cs_mapMasternodeBlocks;
 CCriticalSection cs_mapMasternodePayeeVotes;
 
 //
@@ -33,6 +38,12 @@ CMasternodePaymentDB::CMasternodePaymentDB()
     strMagicMessage = "MasternodePayments";
 }
 
+CMasternodePaymentDB::CMasternodePaymentDB(const boost::filesystem::path& pathIn)
+{
+    pathDB = pathIn;
+    strMagicMessage = "MasternodePayments";
+}
+
 bool CMasternodePaymentDB::Write(const CMasternodePayments& objToSave)
 {
     int64_t nStart = GetTimeMillis();
@@ -146,31 +157,19 @@ CMasternodePaymentDB::ReadResult CMasternodePaymentDB::Read(CMasternodePayments&
     return Ok;
 }
 
-void DumpMasternodePayments()
+bool LoadMasternodePayments()
 {
-    int64_t nStart = GetTimeMillis();
-
-    CMasternodePaymentDB paymentdb;
-    CMasternodePayments tempPayments;
-
-    LogPrint("masternode","Verifying mnpayments.dat format...\n");
-    CMasternodePaymentDB::ReadResult readResult = paymentdb.Read(tempPayments, true);
-    // there was an error and it was not an error on file opening => do not proceed
-    if (readResult == CMasternodePaymentDB::FileError)
-        LogPrint("masternode","Missing budgets file - mnpayments.dat, will try to recreate\n");
-    else if (readResult != CMasternodePaymentDB::Ok) {
-        LogPrint("masternode","Error reading mnpayments.dat: ");
-        if (readResult == CMasternodePaymentDB::IncorrectFormat)
-            LogPrint("masternode","magic is ok but data has invalid format, will try to recreate\n");
-        else {
-            LogPrint("masternode","file format is unknown or invalid, please fix it manually\n");
-            return;
-        }
-    }
-    LogPrint("masternode","Writting info to mnpayments.dat...\n");
-    paymentdb.Write(masternodePayments);
+    if (pmnstore == NULL)
+        return false;
+    if (ImportCacheFile<CMasternodePaymentDB>("mnpayments.dat", masternodePayments))
+        return true;
+    return masternodePayments.ReadStore(*pmnstore);
+}
 
-    LogPrint("masternode","Budget dump finished  %dms\n", GetTimeMillis() - nStart);
+void DumpMasternodePayments()
+{
+    if (pmnstore != NULL)
+        masternodePayments.WriteStore(*pmnstore);
 }
 
 bool IsBlockValueValid(const CBlock& block, CAmount nExpectedValue, CAmount nMinted)
@@ -370,6 +369,27 @@ void CMasternodePayments::ProcessMessageMasternodePayments(CNode* pfrom, std::st
         pfrom->FulfilledRequest(NetMsgType::MNGET);
         masternodePayments.Sync(pfrom, nCountNeeded);
         LogPrint("mnpayments", "mnget - Sent Masternode winners to peer %i\n", pfrom->GetId());
+    } else if (strCommand == NetMsgType::MNGETSKETCH) { //Masternode Payments Request Sync of what the peer is missing
+        int nCountNeeded;
+        CSyncSketch sketch;
+        vRecv >> nCountNeeded >> sketch;
+
+        if (!sketch.IsWithinSizeConstraints()) {
+            Misbehaving(pfrom->GetId(), 100);
+            return;
+        }
+
+        if (Params().NetworkID() == CBaseChainParams::MAIN) {
+            if (pfrom->HasFulfilledRequest(NetMsgType::MNGET)) {
+                LogPrintf("CMasternodePayments::ProcessMessageMasternodePayments() : mngetsketch - peer already asked me for the list\n");
+                Misbehaving(pfrom->GetId(), 20);
+                return;
+            }
+        }
+
+        pfrom->FulfilledRequest(NetMsgType::MNGET);
+        masternodePayments.Sync(pfrom, nCountNeeded, &sketch);
+        LogPrint("mnpayments", "mngetsketch - Sent Masternode winners to peer %i\n", pfrom->GetId());
     } else if (strCommand == NetMsgType::MNW) { //Masternode Payments Declare Winner
         //this is required in litemodef
         CMasternodePaymentWinner winner;
@@ -384,7 +404,7 @@ void CMasternodePayments::ProcessMessageMasternodePayments(CNode* pfrom, std::st
             nHeight = chainActive.Tip()->nHeight;
         }
 
-        if (masternodePayments.mapMasternodePayeeVotes.count(winner.GetHash())) {
+        if (masternodePayments.HasVote(winner.GetHash())) {
             LogPrint("mnpayments", "mnw - Already seen - %s bestHeight %d\n", winner.GetHash().ToString().c_str(), nHeight);
             masternodeSync.AddedMasternodeWinner(winner.GetHash());
             return;
@@ -447,20 +467,186 @@ bool CMasternodePaymentWinner::Sign(CKey& keyMasternode, CPubKey& pubKeyMasterno
     return true;
 }
 
-bool CMasternodePayments::GetBlockPayee(int nBlockHeight, CScript& payee)
+CMasternodePaymentVotes::PayeeHasher::PayeeHasher() : k0(GetRand(std::numeric_limits<uint64_t>::max())), k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
+
+size_t CMasternodePaymentVotes::PayeeHasher::operator()(const CScript& payee) const
+{
+    return CSipHasher(k0, k1).Write(payee.data(), payee.size()).Finalize();
+}
+
+CMasternodePaymentVotes::CMasternodePaymentVotes() : vRing(MNPAYMENTS_VOTE_RING_SIZE) {}
+
+CMasternodePaymentVotes::Bucket* CMasternodePaymentVotes::GetBucket(int nHeight)
+{
+    return const_cast<Bucket*>(static_cast<const CMasternodePaymentVotes*>(this)->GetBucket(nHeight));
+}
+
+const CMasternodePaymentVotes::Bucket* CMasternodePaymentVotes::GetBucket(int nHeight) const
+{
+    if (nHeight < 0) return NULL;
+    const Bucket& bucket = vRing[nHeight % vRing.size()];
+    if (bucket.vVotes.empty() || bucket.payees.nBlockHeight != nHeight) return NULL;
+    return &bucket;
+}
+
+bool CMasternodePaymentVotes::Reserve(int nHeight)
+{
+    if (nHeight < 0) return false;
+
+    unsigned int nSpan = 1;
+    if (!setHeights.empty())
+        nSpan = std::max(nHeight, *setHeights.rbegin()) - std::min(nHeight, *setHeights.begin()) + 1;
+    if (nSpan <= vRing.size()) return true;
+
+    unsigned int nSize = vRing.size();
+    while (nSize < nSpan)
+        nSize *= 2;
+    if (nSize > MNPAYMENTS_VOTE_RING_MAX_SIZE) return false;
+
+    std::vector<Bucket> vNewRing(nSize);
+    for (std::set<int>::const_iterator it = setHeights.begin(); it != setHeights.end(); ++it)
+        std::swap(vNewRing[*it % nSize], vRing[*it % vRing.size()]);
+    vRing.swap(vNewRing);
+    return true;
+}
+
+void CMasternodePaymentVotes::SetLeading(const CScript& payee, int nHeight, bool fLeading)
+{
+    if (fLeading) {
+        mapLeading[payee].push_back(nHeight);
+        return;
+    }
+
+    boost::unordered_map<CScript, std::vector<int>, PayeeHasher>::iterator it = mapLeading.find(payee);
+    if (it == mapLeading.end()) return;
+    std::vector<int>& vHeights = (*it).second;
+    vHeights.erase(std::remove(vHeights.begin(), vHeights.end(), nHeight), vHeights.end());
+    if (vHeights.empty())
+        mapLeading.erase(it);
+}
+
+bool CMasternodePaymentVotes::Add(const uint256& hash, const CMasternodePaymentWinner& winner)
 {
-    if (mapMasternodeBlocks.count(nBlockHeight)) {
-        return mapMasternodeBlocks[nBlockHeight].GetPayee(payee);
+    if (mapVotes.count(hash) || !Reserve(winner.nBlockHeight)) return false;
+
+    int nHeight = winner.nBlockHeight;
+    mapVotes.insert(std::make_pair(hash, winner));
+    Bucket& bucket = vRing[nHeight % vRing.size()];
+    if (bucket.vVotes.empty()) {
+        bucket.payees = CMasternodeBlockPayees(nHeight);
+        setHeights.insert(nHeight);
     }
+    bucket.vVotes.push_back(hash);
+    bucket.payees.AddPayee(winner.payee, 1);
+
+    CScript leader;
+    bucket.payees.GetPayee(leader);
+    if (bucket.vVotes.size() == 1 || leader != bucket.leader) {
+        if (bucket.vVotes.size() > 1)
+            SetLeading(bucket.leader, nHeight, false);
+        SetLeading(leader, nHeight, true);
+        bucket.leader = leader;
+    }
+    return true;
+}
 
+bool CMasternodePaymentVotes::Get(const uint256& hash, CMasternodePaymentWinner& winner) const
+{
+    VoteMap::const_iterator it = mapVotes.find(hash);
+    if (it == mapVotes.end()) return false;
+    winner = (*it).second;
+    return true;
+}
+
+CMasternodeBlockPayees* CMasternodePaymentVotes::GetBlock(int nHeight)
+{
+    Bucket* pbucket = GetBucket(nHeight);
+    return pbucket ? &pbucket->payees : NULL;
+}
+
+bool CMasternodePaymentVotes::IsLeading(const CScript& payee, int nFirstHeight, int nLastHeight, int nNotHeight) const
+{
+    boost::unordered_map<CScript, std::vector<int>, PayeeHasher>::const_iterator it = mapLeading.find(payee);
+    if (it == mapLeading.end()) return false;
+    BOOST_FOREACH (int nHeight, (*it).second) {
+        if (nHeight >= nFirstHeight && nHeight <= nLastHeight && nHeight != nNotHeight)
+            return true;
+    }
     return false;
 }
 
+void CMasternodePaymentVotes::GetHashes(int nFirstHeight, int nLastHeight, std::vector<uint256>& vHashes) const
+{
+    for (std::set<int>::const_iterator it = setHeights.lower_bound(nFirstHeight); it != setHeights.end() && *it <= nLastHeight; ++it) {
+        const Bucket* pbucket = GetBucket(*it);
+        vHashes.insert(vHashes.end(), pbucket->vVotes.begin(), pbucket->vVotes.end());
+    }
+}
+
+void CMasternodePaymentVotes::EraseBefore(int nHeight, std::vector<uint256>& vErased)
+{
+    while (!setHeights.empty() && *setHeights.begin() < nHeight) {
+        int nBucketHeight = *setHeights.begin();
+        Bucket& bucket = vRing[nBucketHeight % vRing.size()];
+        BOOST_FOREACH (const uint256& hash, bucket.vVotes) {
+            mapVotes.erase(hash);
+            vErased.push_back(hash);
+        }
+        SetLeading(bucket.leader, nBucketHeight, false);
+        bucket = Bucket();
+        setHeights.erase(setHeights.begin());
+    }
+}
+
+void CMasternodePaymentVotes::Clear()
+{
+    vRing.assign(MNPAYMENTS_VOTE_RING_SIZE, Bucket());
+    setHeights.clear();
+    mapVotes.clear();
+    mapLeading.clear();
+}
+
+int CMasternodePaymentVotes::GetOldestHeight() const
+{
+    return setHeights.empty() ? std::numeric_limits<int>::max() : *setHeights.begin();
+}
+
+int CMasternodePaymentVotes::GetNewestHeight() const
+{
+    return setHeights.empty() ? 0 : *setHeights.rbegin();
+}
+
+bool CMasternodePayments::HasVote(const uint256& hash)
+{
+    LOCK(cs_mapMasternodePayeeVotes);
+    return votes.Has(hash);
+}
+
+bool CMasternodePayments::GetVote(const uint256& hash, CMasternodePaymentWinner& winner)
+{
+    LOCK(cs_mapMasternodePayeeVotes);
+    return votes.Get(hash, winner);
+}
+
+bool CMasternodePayments::HasPayeeWithVotes(int nBlockHeight, const CScript& payee, int nVotesReq)
+{
+    LOCK(cs_mapMasternodePayeeVotes);
+    CMasternodeBlockPayees* pblock = votes.GetBlock(nBlockHeight);
+    return pblock != NULL && pblock->HasPayeeWithVotes(payee, nVotesReq);
+}
+
+bool CMasternodePayments::GetBlockPayee(int nBlockHeight, CScript& payee)
+{
+    LOCK(cs_mapMasternodePayeeVotes);
+    CMasternodeBlockPayees* pblock = votes.GetBlock(nBlockHeight);
+    return pblock != NULL && pblock->GetPayee(payee);
+}
+
 // Is this masternode scheduled to get paid soon?
 // -- Only look ahead up to 8 blocks to allow for propagation of the latest 2 winners
 bool CMasternodePayments::IsScheduled(CMasternode& mn, int nNotBlockHeight)
 {
-    LOCK(cs_mapMasternodeBlocks);
+    LOCK(cs_mapMasternodePayeeVotes);
 
     int nHeight;
     {
@@ -472,19 +658,7 @@ bool CMasternodePayments::IsScheduled(CMasternode& mn, int nNotBlockHeight)
     CScript mnpayee;
     mnpayee = GetScriptForDestination(mn.pubKeyCollateralAddress.GetID());
 
-    CScript payee;
-    for (int64_t h = nHeight; h <= nHeight + 8; h++) {
-        if (h == nNotBlockHeight) continue;
-        if (mapMasternodeBlocks.count(h)) {
-            if (mapMasternodeBlocks[h].GetPayee(payee)) {
-                if (mnpayee == payee) {
-                    return true;
-                }
-            }
-        }
-    }
-
-    return false;
+    return votes.IsLeading(mnpayee, nHeight, nHeight + 8, nNotBlockHeight);
 }
 
 bool CMasternodePayments::AddWinningMasternode(CMasternodePaymentWinner& winnerIn)
@@ -494,22 +668,15 @@ bool CMasternodePayments::AddWinningMasternode(CMasternodePaymentWinner& winnerI
         return false;
     }
 
+    uint256 hash = winnerIn.GetHash();
     {
-        LOCK2(cs_mapMasternodePayeeVotes, cs_mapMasternodeBlocks);
+        LOCK(cs_mapMasternodePayeeVotes);
 
-        if (mapMasternodePayeeVotes.count(winnerIn.GetHash())) {
+        if (!votes.Add(hash, winnerIn)) {
             return false;
         }
-
-        mapMasternodePayeeVotes[winnerIn.GetHash()] = winnerIn;
-
-        if (!mapMasternodeBlocks.count(winnerIn.nBlockHeight)) {
-            CMasternodeBlockPayees blockPayees(winnerIn.nBlockHeight);
-            mapMasternodeBlocks[winnerIn.nBlockHeight] = blockPayees;
-        }
     }
-
-    mapMasternodeBlocks[winnerIn.nBlockHeight].AddPayee(winnerIn.payee, 1);
+    changedVotes.Add(hash);
 
     return true;
 }
@@ -597,10 +764,11 @@ std::string CMasternodeBlockPayees::GetRequiredPaymentsString()
 
 std::string CMasternodePayments::GetRequiredPaymentsString(int nBlockHeight)
 {
-    LOCK(cs_mapMasternodeBlocks);
+    LOCK(cs_mapMasternodePayeeVotes);
 
-    if (mapMasternodeBlocks.count(nBlockHeight)) {
-        return mapMasternodeBlocks[nBlockHeight].GetRequiredPaymentsString();
+    CMasternodeBlockPayees* pblock = votes.GetBlock(nBlockHeight);
+    if (pblock != NULL) {
+        return pblock->GetRequiredPaymentsString();
     }
 
     return "Unknown";
@@ -608,10 +776,11 @@ std::string CMasternodePayments::GetRequiredPaymentsString(int nBlockHeight)
 
 bool CMasternodePayments::IsTransactionValid(const CTransaction& txNew, int nBlockHeight)
 {
-    LOCK(cs_mapMasternodeBlocks);
+    LOCK(cs_mapMasternodePayeeVotes);
 
-    if (mapMasternodeBlocks.count(nBlockHeight)) {
-        return mapMasternodeBlocks[nBlockHeight].IsTransactionValid(txNew);
+    CMasternodeBlockPayees* pblock = votes.GetBlock(nBlockHeight);
+    if (pblock != NULL) {
+        return pblock->IsTransactionValid(txNew);
     }
 
     return true;
@@ -619,7 +788,11 @@ bool CMasternodePayments::IsTransactionValid(const CTransaction& txNew, int nBlo
 
 void CMasternodePayments::CleanPaymentList()
 {
-    LOCK2(cs_mapMasternodePayeeVotes, cs_mapMasternodeBlocks);
+    //keep up to five cycles for historical sake
+    //(counted before taking the votes lock, as mnodeman takes it while holding its own)
+    int nLimit = std::max(int(mnodeman.size() * 1.25), 1000);
+
+    LOCK(cs_mapMasternodePayeeVotes);
 
     int nHeight;
     {
@@ -628,22 +801,16 @@ void CMasternodePayments::CleanPaymentList()
         nHeight = chainActive.Tip()->nHeight;
     }
 
-    //keep up to five cycles for historical sake
-    int nLimit = std::max(int(mnodeman.size() * 1.25), 1000);
-
-    std::map<uint256, CMasternodePaymentWinner>::iterator it = mapMasternodePayeeVotes.begin();
-    while (it != mapMasternodePayeeVotes.end()) {
-        CMasternodePaymentWinner winner = (*it).second;
+    // whole blocks of votes go at once
+    std::vector<uint256> vErased;
+    votes.EraseBefore(nHeight - nLimit, vErased);
+    if (vErased.empty()) return;
 
-        if (nHeight - winner.nBlockHeight > nLimit) {
-            LogPrint("mnpayments", "CMasternodePayments::CleanPaymentList - Removing old Masternode payment - block %d\n", winner.nBlockHeight);
-            masternodeSync.mapSeenSyncMNW.erase((*it).first);
-            mapMasternodePayeeVotes.erase(it++);
-            mapMasternodeBlocks.erase(winner.nBlockHeight);
-        } else {
-            ++it;
-        }
+    BOOST_FOREACH (const uint256& hash, vErased) {
+        masternodeSync.mapSeenSyncMNW.erase(hash);
+        changedVotes.Add(hash);
     }
+    LogPrint("mnpayments", "CMasternodePayments::CleanPaymentList - Removed %u old Masternode payments before block %d\n", vErased.size(), nHeight - nLimit);
 }
 
 bool CMasternodePaymentWinner::IsValid(CNode* pnode, std::string& strError)
@@ -774,8 +941,17 @@ bool CMasternodePaymentWinner::SignatureValid()
     return false;
 }
 
-void CMasternodePayments::Sync(CNode* node, int nCountNeeded)
+/** Hashes of the votes a sync of the last nCountNeeded blocks sends. Requires cs_mapMasternodePayeeVotes. */
+static void GetSyncVotes(const CMasternodePaymentVotes& votes, int nHeight, int nCountNeeded, std::vector<uint256>& vHashes)
+{
+    votes.GetHashes(nHeight - nCountNeeded, nHeight + 20, vHashes);
+}
+
+void CMasternodePayments::Sync(CNode* node, int nCountNeeded, const CSyncSketch* psketch)
 {
+    int nCount = (mnodeman.CountEnabled() * 1.25);
+    if (nCountNeeded > nCount) nCountNeeded = nCount;
+
     LOCK(cs_mapMasternodePayeeVotes);
 
     int nHeight;
@@ -785,63 +961,128 @@ void CMasternodePayments::Sync(CNode* node, int nCountNeeded)
         nHeight = chainActive.Tip()->nHeight;
     }
 
-    int nCount = (mnodeman.CountEnabled() * 1.25);
-    if (nCountNeeded > nCount) nCountNeeded = nCount;
+    std::vector<uint256> vHashes;
+    GetSyncVotes(votes, nHeight, nCountNeeded, vHashes);
+
+    // Only the votes missing from the peer's sketch, if the difference can be decoded
+    std::vector<size_t> vMissing;
+    if (psketch != NULL && !psketch->GetMissing(vHashes, vMissing)) {
+        LogPrint("mnpayments", "CMasternodePayments::Sync - could not decode the difference with peer %i, sending all %d votes\n", node->GetId(), vHashes.size());
+        psketch = NULL;
+    }
 
     int nInvCount = 0;
-    std::map<uint256, CMasternodePaymentWinner>::iterator it = mapMasternodePayeeVotes.begin();
-    while (it != mapMasternodePayeeVotes.end()) {
-        CMasternodePaymentWinner winner = (*it).second;
-        if (winner.nBlockHeight >= nHeight - nCountNeeded && winner.nBlockHeight <= nHeight + 20) {
-            node->PushInventory(CInv(MSG_MASTERNODE_WINNER, winner.GetHash()));
+    if (psketch == NULL) {
+        BOOST_FOREACH (const uint256& hash, vHashes) {
+            node->PushInventory(CInv(MSG_MASTERNODE_WINNER, hash));
+            nInvCount++;
+        }
+    } else {
+        BOOST_FOREACH (size_t i, vMissing) {
+            node->PushInventory(CInv(MSG_MASTERNODE_WINNER, vHashes[i]));
             nInvCount++;
         }
-        ++it;
     }
     node->PushMessage(NetMsgType::SSC, MASTERNODE_SYNC_MNW, nInvCount);
 }
 
-std::string CMasternodePayments::ToString() const
+void CMasternodePayments::RequestSync(CNode* node, int nCountNeeded)
 {
-    std::ostringstream info;
-
-    info << "Votes: " << (int)mapMasternodePayeeVotes.size() << ", Blocks: " << (int)mapMasternodeBlocks.size();
+    std::vector<uint256> vHashes;
+    if (node->nVersion >= SYNC_SKETCH_VERSION) {
+        LOCK(cs_mapMasternodePayeeVotes);
+        TRY_LOCK(cs_main, locked);
+        if (locked && chainActive.Tip() != NULL)
+            GetSyncVotes(votes, chainActive.Tip()->nHeight, nCountNeeded, vHashes);
+    }
 
-    return info.str();
+    if (vHashes.empty()) {
+        node->PushMessage(NetMsgType::MNGET, nCountNeeded);
+        return;
+    }
+    node->PushMessage(NetMsgType::MNGETSKETCH, nCountNeeded, CSyncSketch::ForKeys(vHashes));
+    node->FulfilledRequest(NetMsgType::MNGETSKETCH);
 }
 
+void CMasternodePayments::SetAllChanged(const CMasternodeStoreDB& db)
+{
+    std::vector<uint256> vStored;
+    db.ReadKeys(DB_PAYEE_VOTE, vStored);
+    BOOST_FOREACH (const uint256& hash, vStored)
+        changedVotes.Add(hash);
 
-int CMasternodePayments::GetOldestBlock()
+    LOCK(cs_mapMasternodePayeeVotes);
+    const CMasternodePaymentVotes::VoteMap& mapVotes = votes.GetVotes();
+    for (CMasternodePaymentVotes::VoteMap::const_iterator it = mapVotes.begin(); it != mapVotes.end(); ++it)
+        changedVotes.Add((*it).first);
+}
+
+bool CMasternodePayments::ReadStore(const CMasternodeStoreDB& db)
 {
-    LOCK(cs_mapMasternodeBlocks);
+    int64_t nStart = GetTimeMillis();
 
-    int nOldestBlock = std::numeric_limits<int>::max();
+    std::vector<std::pair<uint256, CMasternodePaymentWinner> > vRecords;
+    if (!db.ReadRecords(DB_PAYEE_VOTE, vRecords))
+        return false;
 
-    std::map<int, CMasternodeBlockPayees>::iterator it = mapMasternodeBlocks.begin();
-    while (it != mapMasternodeBlocks.end()) {
-        if ((*it).first < nOldestBlock) {
-            nOldestBlock = (*it).first;
-        }
-        it++;
+    {
+        LOCK(cs_mapMasternodePayeeVotes);
+        votes.Clear();
+        // The payees of a block are the count of the votes for it, as in AddWinningMasternode
+        for (unsigned int i = 0; i < vRecords.size(); i++)
+            votes.Add(vRecords[i].first, vRecords[i].second);
     }
 
-    return nOldestBlock;
+    LogPrint("masternode", "Loaded %u payee votes from the masternode store  %dms\n", vRecords.size(), GetTimeMillis() - nStart);
+    LogPrint("masternode", "Masternode payments manager - cleaning....\n");
+    CleanPaymentList();
+    LogPrint("masternode", "Masternode payments manager - result:\n");
+    LogPrint("masternode", "  %s\n", ToString());
+    return true;
 }
 
-
-int CMasternodePayments::GetNewestBlock()
+bool CMasternodePayments::WriteStore(CMasternodeStoreDB& db)
 {
-    LOCK(cs_mapMasternodeBlocks);
+    int64_t nStart = GetTimeMillis();
 
-    int nNewestBlock = 0;
+    std::set<uint256> setChanged;
+    changedVotes.Take(setChanged);
 
-    std::map<int, CMasternodeBlockPayees>::iterator it = mapMasternodeBlocks.begin();
-    while (it != mapMasternodeBlocks.end()) {
-        if ((*it).first > nNewestBlock) {
-            nNewestBlock = (*it).first;
-        }
-        it++;
+    CLevelDBBatch batch;
+    unsigned int nWritten = 0, nRemoved = 0;
+    {
+        LOCK(cs_mapMasternodePayeeVotes);
+        BatchChanges(batch, DB_PAYEE_VOTE, setChanged, votes.GetVotes(), nWritten, nRemoved);
+    }
+
+    if (!db.WriteChanges(batch)) {
+        changedVotes.Restore(setChanged);
+        return error("%s : Failed to write %u payee votes to the masternode store", __func__, setChanged.size());
     }
 
-    return nNewestBlock;
+    LogPrint("masternode", "Written %u new and %u removed payee votes to the masternode store  %dms\n", nWritten, nRemoved, GetTimeMillis() - nStart);
+    return true;
+}
+
+std::string CMasternodePayments::ToString() const
+{
+    std::ostringstream info;
+
+    info << "Votes: " << (int)votes.size() << ", Blocks: " << (int)votes.CountBlocks();
+
+    return info.str();
+}
+
+
+int CMasternodePayments::GetOldestBlock()
+{
+    LOCK(cs_mapMasternodePayeeVotes);
+    return votes.GetOldestHeight();
+}
+
+
+int CMasternodePayments::GetNewestBlock()
+{
+    LOCK(cs_mapMasternodePayeeVotes);
+    return votes.GetNewestHeight();
 }
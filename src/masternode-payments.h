@@ -9,31 +9,42 @@
 #include "key.h"
 #include "main.h"
 #include "masternode.h"
+#include "mnstoredb.h"
+
+#include <boost/unordered_map.hpp>
 
 using namespace std;
 
 extern CCriticalSection cs_vecPayments;
-extern CCriticalSection cs_mapMasternodeBlocks;
 extern CCriticalSection cs_mapMasternodePayeeVotes;
 
 class CMasternodePayments;
 class CMasternodePaymentWinner;
 class CMasternodeBlockPayees;
+class CSyncSketch;
 
 extern CMasternodePayments masternodePayments;
 
 #define MNPAYMENTS_SIGNATURES_REQUIRED 6
 #define MNPAYMENTS_SIGNATURES_TOTAL 10
 
+//! Heights the ring of payee vote buckets starts with, and the most it grows to
+static const unsigned int MNPAYMENTS_VOTE_RING_SIZE = 2048;
+static const unsigned int MNPAYMENTS_VOTE_RING_MAX_SIZE = 1 << 16;
+
 void ProcessMessageMasternodePayments(CNode* pfrom, std::string& strCommand, CDataStream& vRecv);
 bool IsBlockPayeeValid(const CBlock& block, int nBlockHeight);
 std::string GetRequiredPaymentsString(int nBlockHeight);
 bool IsBlockValueValid(const CBlock& block, CAmount nExpectedValue, CAmount nMinted);
 void FillBlockPayee(CMutableTransaction& txNew, CAmount nFees, bool fProofOfStake);
 
+/** Load the payee votes from the masternode store, or mnpayments.dat if there is one */
+bool LoadMasternodePayments();
+/** Write the payee votes that changed to the masternode store */
 void DumpMasternodePayments();
 
-/** Save Masternode Payment Data (mnpayments.dat)
+/** Flat file of Masternode Payment Data (mnpayments.dat), which older
+ *  versions and chainstate snapshots use
  */
 class CMasternodePaymentDB
 {
@@ -53,6 +64,7 @@ public:
     };
 
     CMasternodePaymentDB();
+    explicit CMasternodePaymentDB(const boost::filesystem::path& pathIn);
     bool Write(const CMasternodePayments& objToSave);
     ReadResult Read(CMasternodePayments& objToLoad, bool fDryRun = false);
 };
@@ -224,6 +236,97 @@ public:
     }
 };
 
+/**
+ * The payee votes of recent and upcoming blocks. Every height with votes has a
+ * bucket in a ring, at the height modulo the ring size, holding the payee vote
+ * counts of that block and the hashes of its votes; the votes themselves are
+ * found by hash in an index. Old votes are dropped a whole bucket at a time,
+ * and the heights each payee leads the vote in are indexed, so whether a
+ * masternode is scheduled is a lookup instead of a probe of every height.
+ *
+ * Not locked itself; CMasternodePayments guards it with cs_mapMasternodePayeeVotes.
+ */
+class CMasternodePaymentVotes
+{
+public:
+    typedef boost::unordered_map<uint256, CMasternodePaymentWinner, CCoinsKeyHasher> VoteMap;
+
+private:
+    struct Bucket {
+        CMasternodeBlockPayees payees;
+        std::vector<uint256> vVotes;
+        //! The payee CMasternodeBlockPayees::GetPayee picks, if there are votes
+        CScript leader;
+    };
+
+    class PayeeHasher
+    {
+    private:
+        uint64_t k0, k1;
+
+    public:
+        PayeeHasher();
+        size_t operator()(const CScript& payee) const;
+    };
+
+    //! The ring is always larger than the span of heights with a bucket, so two never share a slot
+    std::vector<Bucket> vRing;
+    std::set<int> setHeights;
+    VoteMap mapVotes;
+    boost::unordered_map<CScript, std::vector<int>, PayeeHasher> mapLeading;
+
+    Bucket* GetBucket(int nHeight);
+    const Bucket* GetBucket(int nHeight) const;
+    /** Make room for a bucket at nHeight; false if the span of heights would not fit the largest ring */
+    bool Reserve(int nHeight);
+    void SetLeading(const CScript& payee, int nHeight, bool fLeading);
+
+public:
+    CMasternodePaymentVotes();
+
+    /** Add a vote and count it for its block; false if it is known, or its height does not fit */
+    bool Add(const uint256& hash, const CMasternodePaymentWinner& winner);
+    bool Has(const uint256& hash) const { return mapVotes.count(hash) > 0; }
+    bool Get(const uint256& hash, CMasternodePaymentWinner& winner) const;
+    /** The payee vote counts of a block, or NULL if it has no votes */
+    CMasternodeBlockPayees* GetBlock(int nHeight);
+    /** Whether the payee has the most votes of a block in [nFirstHeight, nLastHeight], other than nNotHeight */
+    bool IsLeading(const CScript& payee, int nFirstHeight, int nLastHeight, int nNotHeight) const;
+    /** Hashes of the votes for the blocks in [nFirstHeight, nLastHeight] */
+    void GetHashes(int nFirstHeight, int nLastHeight, std::vector<uint256>& vHashes) const;
+    /** Drop the votes of the blocks before nHeight, returning their hashes */
+    void EraseBefore(int nHeight, std::vector<uint256>& vErased);
+    void Clear();
+
+    const VoteMap& GetVotes() const { return mapVotes; }
+    size_t size() const { return mapVotes.size(); }
+    size_t CountBlocks() const { return setHeights.size(); }
+    /** The lowest and highest heights with votes, or INT_MAX and 0 without any */
+    int GetOldestHeight() const;
+    int GetNewestHeight() const;
+
+    ADD_SERIALIZE_METHODS;
+
+    /** The votes by hash and the payees by height, as mnpayments.dat always had them */
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        std::map<uint256, CMasternodePaymentWinner> mapVotesByHash(mapVotes.begin(), mapVotes.end());
+        std::map<int, CMasternodeBlockPayees> mapBlocks;
+        for (std::set<int>::const_iterator it = setHeights.begin(); it != setHeights.end(); ++it)
+            mapBlocks[*it] = GetBucket(*it)->payees;
+        READWRITE(mapVotesByHash);
+        READWRITE(mapBlocks);
+
+        // The payees of a block are counted from its votes again
+        if (ser_action.ForRead()) {
+            Clear();
+            for (std::map<uint256, CMasternodePaymentWinner>::const_iterator it = mapVotesByHash.begin(); it != mapVotesByHash.end(); ++it)
+                Add((*it).first, (*it).second);
+        }
+    }
+};
+
 //
 // Masternode Payments Class
 // Keeps track of who should get paid for which blocks
@@ -234,10 +337,12 @@ class CMasternodePayments
 private:
     int nSyncedFromPeer;
     int nLastBlockHeight;
+    // Votes added or removed since the masternode store was last written
+    CStoreChangeSet<uint256> changedVotes;
 
 public:
-    std::map<uint256, CMasternodePaymentWinner> mapMasternodePayeeVotes;
-    std::map<int, CMasternodeBlockPayees> mapMasternodeBlocks;
+    //! Guarded by cs_mapMasternodePayeeVotes
+    CMasternodePaymentVotes votes;
     std::map<uint256, int> mapMasternodesLastVote; //prevout.hash + prevout.n, nBlockHeight
 
     CMasternodePayments()
@@ -248,18 +353,23 @@ public:
 
     void Clear()
     {
-        LOCK2(cs_mapMasternodeBlocks, cs_mapMasternodePayeeVotes);
-        mapMasternodeBlocks.clear();
-        mapMasternodePayeeVotes.clear();
+        LOCK(cs_mapMasternodePayeeVotes);
+        votes.Clear();
     }
 
     bool AddWinningMasternode(CMasternodePaymentWinner& winner);
     bool ProcessBlock(int nBlockHeight);
 
-    void Sync(CNode* node, int nCountNeeded);
+    /** Send the votes of the last nCountNeeded blocks, or only those missing from the peer's sketch */
+    void Sync(CNode* node, int nCountNeeded, const CSyncSketch* psketch = NULL);
+    /** Ask a peer for the votes of the last nCountNeeded blocks, with a sketch of ours if it understands one */
+    void RequestSync(CNode* node, int nCountNeeded);
     void CleanPaymentList();
     int LastPayment(CMasternode& mn);
 
+    bool HasVote(const uint256& hash);
+    bool GetVote(const uint256& hash, CMasternodePaymentWinner& winner);
+    bool HasPayeeWithVotes(int nBlockHeight, const CScript& payee, int nVotesReq);
     bool GetBlockPayee(int nBlockHeight, CScript& payee);
     bool IsTransactionValid(const CTransaction& txNew, int nBlockHeight);
     bool IsScheduled(CMasternode& mn, int nNotBlockHeight);
@@ -287,13 +397,20 @@ public:
     int GetOldestBlock();
     int GetNewestBlock();
 
+    /// Mark every vote in memory and in the store as changed, so the next dump replaces the stored votes
+    void SetAllChanged(const CMasternodeStoreDB& db);
+    /// Load the votes from the masternode store and count them per block again
+    bool ReadStore(const CMasternodeStoreDB& db);
+    /// Write the votes that were added or removed to the masternode store
+    bool WriteStore(CMasternodeStoreDB& db);
+
     ADD_SERIALIZE_METHODS;
 
     template <typename Stream, typename Operation>
     inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
     {
-        READWRITE(mapMasternodePayeeVotes);
-        READWRITE(mapMasternodeBlocks);
+        LOCK(cs_mapMasternodePayeeVotes);
+        READWRITE(votes);
     }
 };
 
@@ -9,6 +9,7 @@
 #include "masternode-sync.h"
 #include "masternode-payments.h"
 #include "masternode-budget.h"
+#include "masternode-tasks.h"
 #include "masternode.h"
 #include "masternodeman.h"
 #include "spork.h"
@@ -98,7 +99,7 @@ void CMasternodeSync::AddedMasternodeList(uint256 hash)
 
 void CMasternodeSync::AddedMasternodeWinner(uint256 hash)
 {
-    if (masternodePayments.mapMasternodePayeeVotes.count(hash)) {
+    if (masternodePayments.HasVote(hash)) {
         if (mapSeenSyncMNW[hash] < MASTERNODE_SYNC_THRESHOLD) {
             lastMasternodeWinner = GetTime();
             mapSeenSyncMNW[hash]++;
@@ -191,29 +192,38 @@ void CMasternodeSync::ProcessMessage(CNode* pfrom, std::string& strCommand, CDat
 
         //this means we will receive no further communication
         switch (nItemID) {
+        // A peer answering a sketch only sends what we are missing, which
+        // may be nothing at all, so its answer counts as progress by itself
         case (MASTERNODE_SYNC_LIST):
             if (nItemID != RequestedMasternodeAssets) return;
             sumMasternodeList += nCount;
             countMasternodeList++;
+            if (pfrom->HasFulfilledRequest(NetMsgType::DSEGSKETCH)) lastMasternodeList = GetTime();
             break;
         case (MASTERNODE_SYNC_MNW):
             if (nItemID != RequestedMasternodeAssets) return;
             sumMasternodeWinner += nCount;
             countMasternodeWinner++;
+            if (pfrom->HasFulfilledRequest(NetMsgType::MNGETSKETCH)) lastMasternodeWinner = GetTime();
             break;
         case (MASTERNODE_SYNC_BUDGET_PROP):
             if (RequestedMasternodeAssets != MASTERNODE_SYNC_BUDGET) return;
             sumBudgetItemProp += nCount;
             countBudgetItemProp++;
+            if (pfrom->HasFulfilledRequest(NetMsgType::MNVSSKETCH)) lastBudgetItem = GetTime();
             break;
         case (MASTERNODE_SYNC_BUDGET_FIN):
             if (RequestedMasternodeAssets != MASTERNODE_SYNC_BUDGET) return;
             sumBudgetItemFin += nCount;
             countBudgetItemFin++;
+            if (pfrom->HasFulfilledRequest(NetMsgType::MNVSSKETCH)) lastBudgetItem = GetTime();
             break;
         }
 
         LogPrint("masternode", "CMasternodeSync:ProcessMessage - ssc - got inventory count %d %d\n", nItemID, nCount);
+
+        // take the next sync step without waiting for the next periodic one
+        TriggerMasternodeTasks(MN_TASK_EVENT_SYNC_STATUS);
     }
 }
 
@@ -227,14 +237,17 @@ void CMasternodeSync::ClearFulfilledRequest()
         pnode->ClearFulfilledRequest("mnsync");
         pnode->ClearFulfilledRequest("mnwsync");
         pnode->ClearFulfilledRequest("busync");
+        pnode->ClearFulfilledRequest(NetMsgType::DSEGSKETCH);
+        pnode->ClearFulfilledRequest(NetMsgType::MNGETSKETCH);
+        pnode->ClearFulfilledRequest(NetMsgType::MNVSSKETCH);
     }
 }
 
 void CMasternodeSync::Process()
 {
+    // Runs every MASTERNODE_SYNC_TIMEOUT seconds, and after the events that may let the sync advance
     static int tick = 0;
-
-    if (tick++ % MASTERNODE_SYNC_TIMEOUT != 0) return;
+    tick++;
 
     if (IsSynced()) {
         /* 
@@ -272,9 +285,8 @@ void CMasternodeSync::Process()
                 mnodeman.DsegUpdate(pnode);
             } else if (RequestedMasternodeAttempt < 6) {
                 int nMnCount = mnodeman.CountEnabled();
-                pnode->PushMessage(NetMsgType::MNGET, nMnCount); //sync payees
-                uint256 n = 0;
-                pnode->PushMessage(NetMsgType::MNVS, n); //sync masternode votes
+                masternodePayments.RequestSync(pnode, nMnCount); //sync payees
+                budget.RequestSync(pnode); //sync masternode votes
             } else {
                 RequestedMasternodeAssets = MASTERNODE_SYNC_FINISHED;
             }
@@ -358,7 +370,7 @@ void CMasternodeSync::Process()
                 if (pindexPrev == NULL) return;
 
                 int nMnCount = mnodeman.CountEnabled();
-                pnode->PushMessage(NetMsgType::MNGET, nMnCount); //sync payees
+                masternodePayments.RequestSync(pnode, nMnCount); //sync payees
                 RequestedMasternodeAttempt++;
 
                 return;
@@ -394,8 +406,7 @@ void CMasternodeSync::Process()
 
                 if (RequestedMasternodeAttempt >= MASTERNODE_SYNC_THRESHOLD * 3) return;
 
-                uint256 n = 0;
-                pnode->PushMessage(NetMsgType::MNVS, n); //sync masternode votes
+                budget.RequestSync(pnode); //sync masternode votes
                 RequestedMasternodeAttempt++;
 
                 return;
@@ -0,0 +1,221 @@
+// Copyright (c) 2019 The TRBO developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "masternode-tasks.h"
+
+#include "activemasternode.h"
+#include "masternode-budget.h"
+#include "masternode-collateral.h"
+#include "masternode-payments.h"
+#include "masternode-sync.h"
+#include "masternodeman.h"
+#include "obfuscation.h"
+#include "scheduler.h"
+#include "swifttx.h"
+#include "util.h"
+#include "utiltime.h"
+
+#include <algorithm>
+
+#include <boost/bind.hpp>
+
+CMasternodeTask::CMasternodeTask(const std::string& strName, boost::function<void()> funcIn, int64_t nInterval, int64_t nMinSpacingMillis) : pscheduler(NULL), func(funcIn), nMinSpacing(nMinSpacingMillis), nLastStart(0), fStopped(false)
+{
+    stats.strName = strName;
+    stats.nInterval = nInterval;
+}
+
+void CMasternodeTask::Schedule(int64_t nDelayMillis, bool fPeriodic)
+{
+    boost::chrono::system_clock::time_point t = boost::chrono::system_clock::now() + boost::chrono::milliseconds(nDelayMillis);
+    pscheduler->schedule(boost::bind(&CMasternodeTask::Run, this, GetTimeMicros() + nDelayMillis * 1000, fPeriodic), t);
+}
+
+void CMasternodeTask::Run(int64_t nDue, bool fPeriodic)
+{
+    LOCK(csRun);
+
+    int64_t nStart = GetTimeMicros();
+    {
+        LOCK(cs);
+        if (fStopped)
+            return;
+        if (!fPeriodic)
+            stats.fTriggered = false;
+        int64_t nDelay = std::max((int64_t)0, nStart - nDue);
+        stats.nDelayTotal += nDelay;
+        stats.nDelayMax = std::max(stats.nDelayMax, nDelay);
+        nLastStart = nStart;
+    }
+
+    try {
+        func();
+    } catch (std::exception& e) {
+        PrintExceptionContinue(&e, stats.strName.c_str());
+    } catch (...) {
+        PrintExceptionContinue(NULL, stats.strName.c_str());
+    }
+
+    int64_t nTime = GetTimeMicros() - nStart;
+    {
+        LOCK(cs);
+        stats.nRuns++;
+        stats.nTimeTotal += nTime;
+        stats.nTimeMax = std::max(stats.nTimeMax, nTime);
+        stats.nTimeLast = nTime;
+        stats.nLastRun = GetTime();
+        if (fPeriodic && !fStopped)
+            Schedule(stats.nInterval * 1000, true);
+    }
+}
+
+void CMasternodeTask::Start(CScheduler& scheduler)
+{
+    LOCK(cs);
+    pscheduler = &scheduler;
+    fStopped = false;
+    Schedule(stats.nInterval * 1000, true);
+}
+
+void CMasternodeTask::Trigger()
+{
+    LOCK(cs);
+    stats.nTriggers++;
+    if (pscheduler == NULL || stats.fTriggered)
+        return;
+    stats.fTriggered = true;
+    Schedule(std::max((int64_t)0, nLastStart / 1000 + nMinSpacing - GetTimeMicros() / 1000), false);
+}
+
+void CMasternodeTask::Stop()
+{
+    {
+        LOCK(cs);
+        fStopped = true;
+        pscheduler = NULL;
+    }
+    // Wait for a run that started before
+    LOCK(csRun);
+}
+
+CMasternodeTaskStats CMasternodeTask::GetStats() const
+{
+    LOCK(cs);
+    return stats;
+}
+
+static void ProcessMasternodeSync()
+{
+    // Only run on the scheduler thread, one run at a time
+    static bool fWasSynced = false;
+
+    masternodeSync.Process();
+
+    bool fSynced = masternodeSync.IsBlockchainSynced();
+    if (fSynced && !fWasSynced)
+        TriggerMasternodeTasks(MN_TASK_EVENT_BLOCKCHAIN_SYNCED);
+    fWasSynced = fSynced;
+}
+
+static void ManageActiveMasternode()
+{
+    if (!masternodeSync.IsBlockchainSynced()) return;
+    activeMasternode.ManageStatus();
+}
+
+static void CheckMasternodes()
+{
+    if (!masternodeSync.IsBlockchainSynced()) return;
+    // the one look at the chain state for collaterals that joined the list
+    // since the last run; transactions spending them are seen as they come
+    mnodeman.WatchCollaterals();
+    collateralWatcher.CheckUnchecked();
+    mnodeman.CheckAndRemove();
+    mnodeman.ProcessMasternodeConnections();
+}
+
+static void CleanMasternodeLists()
+{
+    if (!masternodeSync.IsBlockchainSynced()) return;
+    masternodePayments.CleanPaymentList();
+    CleanTransactionLocksList();
+}
+
+static void DumpMasternodeStore()
+{
+    if (!masternodeSync.IsBlockchainSynced()) return;
+    // only what changed since the last dump is written
+    DumpMasternodes();
+    DumpMasternodePayments();
+    DumpBudgets();
+}
+
+static void CheckObfuScationPool()
+{
+    if (!masternodeSync.IsBlockchainSynced()) return;
+    obfuScationPool.CheckTimeout();
+    obfuScationPool.CheckForCompleteQueue();
+}
+
+static void AutomaticDenominating()
+{
+    if (!masternodeSync.IsBlockchainSynced()) return;
+    if (obfuScationPool.GetState() == POOL_STATUS_IDLE)
+        obfuScationPool.DoAutomaticDenominating();
+}
+
+// try to sync from all available nodes, one step at a time, and take the
+// next step as soon as a peer connects or answers
+static CMasternodeTask taskSync("mnsync", ProcessMasternodeSync, MASTERNODE_SYNC_TIMEOUT, 1000);
+// check if we should activate or ping every few minutes, starting right after the blockchain is synced
+static CMasternodeTask taskActive("activemasternode", ManageActiveMasternode, MASTERNODE_PING_SECONDS, 1000);
+static CMasternodeTask taskCheck("mncheck", CheckMasternodes, 60, 1000);
+static CMasternodeTask taskClean("mnclean", CleanMasternodeLists, 60, 10000);
+static CMasternodeTask taskDump("mndump", DumpMasternodeStore, MASTERNODES_DUMP_SECONDS, 1000);
+static CMasternodeTask taskObfuScation("obfuscation", CheckObfuScationPool, 1, 1000);
+static CMasternodeTask taskDenominate("autodenominate", AutomaticDenominating, 15, 1000);
+
+static CMasternodeTask* const vTasks[] = {&taskSync, &taskActive, &taskCheck, &taskClean, &taskDump, &taskObfuScation, &taskDenominate};
+
+void StartMasternodeTasks(CScheduler& scheduler)
+{
+    if (fLiteMode) return; //disable all Obfuscation/Masternode related functionality
+
+    for (CMasternodeTask* ptask : vTasks)
+        ptask->Start(scheduler);
+}
+
+void StopMasternodeTasks()
+{
+    for (CMasternodeTask* ptask : vTasks)
+        ptask->Stop();
+}
+
+void TriggerMasternodeTasks(MasternodeTaskEvent event)
+{
+    switch (event) {
+    case MN_TASK_EVENT_NEW_BLOCK:
+        // the payment and lock lists are cleaned by block height
+        taskClean.Trigger();
+        if (!masternodeSync.IsSynced())
+            taskSync.Trigger();
+        break;
+    case MN_TASK_EVENT_NEW_PEER:
+    case MN_TASK_EVENT_SYNC_STATUS:
+        if (!masternodeSync.IsSynced())
+            taskSync.Trigger();
+        break;
+    case MN_TASK_EVENT_BLOCKCHAIN_SYNCED:
+        taskActive.Trigger();
+        break;
+    }
+}
+
+std::vector<CMasternodeTaskStats> GetMasternodeTaskStats()
+{
+    std::vector<CMasternodeTaskStats> vStats;
+    for (const CMasternodeTask* ptask : vTasks)
+        vStats.push_back(ptask->GetStats());
+    return vStats;
+}
@@ -0,0 +1,104 @@
+// Copyright (c) 2019 The TRBO developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef MASTERNODE_TASKS_H
+#define MASTERNODE_TASKS_H
+
+#include "sync.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <boost/function.hpp>
+
+class CScheduler;
+
+/** Events after which masternode tasks run without waiting for their next periodic run */
+enum MasternodeTaskEvent {
+    MN_TASK_EVENT_NEW_BLOCK,
+    MN_TASK_EVENT_NEW_PEER,
+    //! A peer finished answering a sync request (ssc)
+    MN_TASK_EVENT_SYNC_STATUS,
+    MN_TASK_EVENT_BLOCKCHAIN_SYNCED,
+};
+
+/** Run time statistics of a masternode task */
+struct CMasternodeTaskStats {
+    std::string strName;
+    //! Seconds between periodic runs
+    int64_t nInterval;
+    //! Runs, and events that asked for one; events coming in while a run is pending share it
+    uint64_t nRuns;
+    uint64_t nTriggers;
+    //! Time spent running, in microseconds
+    int64_t nTimeTotal;
+    int64_t nTimeMax;
+    int64_t nTimeLast;
+    //! How late runs started after they were due, in microseconds, as the scheduler was busy
+    int64_t nDelayTotal;
+    int64_t nDelayMax;
+    //! Time of the last run
+    int64_t nLastRun;
+    //! Whether a run for an event is waiting
+    bool fTriggered;
+
+    CMasternodeTaskStats() : nInterval(0), nRuns(0), nTriggers(0), nTimeTotal(0), nTimeMax(0), nTimeLast(0), nDelayTotal(0), nDelayMax(0), nLastRun(0), fTriggered(false) {}
+};
+
+/**
+ * A job of the masternode subsystem run on the scheduler thread, every
+ * nInterval seconds and soon after the events it depends on. Events coming
+ * in while a run for an earlier one is waiting share that run, and a run
+ * for an event starts at least nMinSpacing milliseconds after the previous
+ * run started, so a flood of events does not make the task run constantly.
+ */
+class CMasternodeTask
+{
+private:
+    mutable CCriticalSection cs;
+    //! Held while running, so the task never runs on two threads at once
+    CCriticalSection csRun;
+    CScheduler* pscheduler;
+    boost::function<void()> func;
+    int64_t nMinSpacing;
+    int64_t nLastStart;
+    //! Set by Stop; runs already scheduled return without doing anything
+    bool fStopped;
+    CMasternodeTaskStats stats;
+
+    void Schedule(int64_t nDelayMillis, bool fPeriodic);
+    void Run(int64_t nDue, bool fPeriodic);
+
+public:
+    CMasternodeTask(const std::string& strName, boost::function<void()> funcIn, int64_t nInterval, int64_t nMinSpacingMillis);
+
+    /** Schedule the first periodic run, nInterval seconds from now */
+    void Start(CScheduler& scheduler);
+
+    /** Run soon, for an event; does nothing before Start or after Stop */
+    void Trigger();
+
+    /** Stop scheduling runs, and wait for a run in progress to finish */
+    void Stop();
+
+    CMasternodeTaskStats GetStats() const;
+};
+
+/** Schedule the masternode sync, status, cleanup, dump and obfuscation tasks */
+void StartMasternodeTasks(CScheduler& scheduler);
+
+/**
+ * Stop the tasks, waiting for those running on the scheduler thread, so the
+ * masternode store and managers can be written and closed safely even if the
+ * scheduler thread has not been joined
+ */
+void StopMasternodeTasks();
+
+/** Run the tasks that depend on an event */
+void TriggerMasternodeTasks(MasternodeTaskEvent event);
+
+std::vector<CMasternodeTaskStats> GetMasternodeTaskStats();
+
+#endif
@@ -6,6 +6,7 @@
 #include "masternode.h"
 #include "addrman.h"
 #include "consensus/validation.h"
+#include "masternode-collateral.h"
 #include "masternodeman.h"
 #include "obfuscation.h"
 #include "sync.h"
@@ -213,22 +214,10 @@ void CMasternode::Check(bool forceCheck)
     	return;
     }
 
-    if (!unitTest) {
-        CValidationState state;
-        CMutableTransaction tx = CMutableTransaction();
-        CTxOut vout = CTxOut(9999.99 * COIN, obfuScationPool.collateralPubKey);
-        tx.vin.push_back(vin);
-        tx.vout.push_back(vout);
-
-        {
-            TRY_LOCK(cs_main, lockMain);
-            if (!lockMain) return;
-
-            if (!AcceptableInputs(mempool, state, CTransaction(tx), false, NULL)) {
-                activeState = MASTERNODE_VIN_SPENT;
-                return;
-            }
-        }
+    // the collateral watcher follows the chain and the mempool, so this never waits for cs_main
+    if (!unitTest && collateralWatcher.IsSpent(vin.prevout)) {
+        activeState = MASTERNODE_VIN_SPENT;
+        return;
     }
 
     activeState = MASTERNODE_ENABLED; // OK
@@ -280,14 +269,12 @@ int64_t CMasternode::GetLastPaid()
         }
         n++;
 
-        if (masternodePayments.mapMasternodeBlocks.count(BlockReading->nHeight)) {
-            /*
-                Search for this payee, with at least 2 votes. This will aid in consensus allowing the network
-                to converge on the same payees quickly, then keep the same schedule.
-            */
-            if (masternodePayments.mapMasternodeBlocks[BlockReading->nHeight].HasPayeeWithVotes(mnpayee, 2)) {
-                return BlockReading->nTime + nOffset;
-            }
+        /*
+            Search for this payee, with at least 2 votes. This will aid in consensus allowing the network
+            to converge on the same payees quickly, then keep the same schedule.
+        */
+        if (masternodePayments.HasPayeeWithVotes(BlockReading->nHeight, mnpayee, 2)) {
+            return BlockReading->nTime + nOffset;
         }
 
         if (BlockReading->pprev == NULL) {
@@ -558,6 +545,7 @@ bool CMasternodeBroadcast::CheckAndUpdate(int& nDos)
         //take the newest entry
         LogPrint("masternode","mnb - Got updated entry for %s\n", vin.prevout.hash.ToString());
         if (pmn->UpdateFromNewBroadcast((*this))) {
+            mnodeman.SetChanged(pmn->vin);
             pmn->Check();
             if (pmn->IsEnabled()) Relay();
         }
@@ -804,6 +792,7 @@ bool CMasternodePing::CheckAndUpdate(int& nDos, bool fRequireEnabled, bool fChec
             }
 
             pmn->lastPing = *this;
+            mnodeman.SetChanged(pmn->vin);
 
             //mnodeman.mapSeenMasternodeBroadcast.lastPing is probably outdated, so we'll update it
             CMasternodeBroadcast mnb(*pmn);
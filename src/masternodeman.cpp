@@ -8,8 +8,10 @@
 #include "addrman.h"
 #include "consensus/validation.h"
 #include "masternode.h"
+#include "masternode-collateral.h"
 #include "obfuscation.h"
 #include "spork.h"
+#include "syncsketch.h"
 #include "util.h"
 #include <boost/filesystem.hpp>
 
@@ -52,6 +54,12 @@ CMasternodeDB::CMasternodeDB()
     strMagicMessage = "MasternodeCache";
 }
 
+CMasternodeDB::CMasternodeDB(const boost::filesystem::path& pathIn)
+{
+    pathMN = pathIn;
+    strMagicMessage = "MasternodeCache";
+}
+
 bool CMasternodeDB::Write(const CMasternodeMan& mnodemanToSave)
 {
     int64_t nStart = GetTimeMillis();
@@ -166,31 +174,19 @@ CMasternodeDB::ReadResult CMasternodeDB::Read(CMasternodeMan& mnodemanToLoad, bo
     return Ok;
 }
 
-void DumpMasternodes()
+bool LoadMasternodes()
 {
-    int64_t nStart = GetTimeMillis();
-
-    CMasternodeDB mndb;
-    CMasternodeMan tempMnodeman;
-
-    LogPrint("masternode","Verifying mncache.dat format...\n");
-    CMasternodeDB::ReadResult readResult = mndb.Read(tempMnodeman, true);
-    // there was an error and it was not an error on file opening => do not proceed
-    if (readResult == CMasternodeDB::FileError)
-        LogPrint("masternode","Missing masternode cache file - mncache.dat, will try to recreate\n");
-    else if (readResult != CMasternodeDB::Ok) {
-        LogPrint("masternode","Error reading mncache.dat: ");
-        if (readResult == CMasternodeDB::IncorrectFormat)
-            LogPrint("masternode","magic is ok but data has invalid format, will try to recreate\n");
-        else {
-            LogPrint("masternode","file format is unknown or invalid, please fix it manually\n");
-            return;
-        }
-    }
-    LogPrint("masternode","Writting info to mncache.dat...\n");
-    mndb.Write(mnodeman);
+    if (pmnstore == NULL)
+        return false;
+    if (ImportCacheFile<CMasternodeDB>("mncache.dat", mnodeman))
+        return true;
+    return mnodeman.ReadStore(*pmnstore);
+}
 
-    LogPrint("masternode","Masternode dump finished  %dms\n", GetTimeMillis() - nStart);
+void DumpMasternodes()
+{
+    if (pmnstore != NULL)
+        mnodeman.WriteStore(*pmnstore);
 }
 
 CMasternodeMan::CMasternodeMan()
@@ -209,6 +205,8 @@ bool CMasternodeMan::Add(CMasternode& mn)
     if (pmn == NULL) {
         LogPrint("masternode", "CMasternodeMan: Adding new Masternode %s - %i now\n", mn.vin.prevout.hash.ToString(), size() + 1);
         vMasternodes.push_back(mn);
+        SetChanged(mn.vin);
+        collateralWatcher.Watch(mn.vin.prevout);
         return true;
     }
 
@@ -240,6 +238,28 @@ void CMasternodeMan::Check()
     }
 }
 
+void CMasternodeMan::WatchCollaterals()
+{
+    LOCK(cs);
+
+    std::vector<COutPoint> vOutpoints;
+    BOOST_FOREACH (const CMasternode& mn, vMasternodes)
+        vOutpoints.push_back(mn.vin.prevout);
+    collateralWatcher.SetWatched(vOutpoints);
+}
+
+void CMasternodeMan::CollateralSpent(const COutPoint& outpoint)
+{
+    LOCK(cs);
+
+    BOOST_FOREACH (CMasternode& mn, vMasternodes) {
+        if (mn.vin.prevout == outpoint && mn.activeState != CMasternode::MASTERNODE_VIN_SPENT) {
+            mn.activeState = CMasternode::MASTERNODE_VIN_SPENT;
+            SetChanged(mn.vin);
+        }
+    }
+}
+
 void CMasternodeMan::CheckAndRemove(bool forceExpiredRemoval)
 {
     Check();
@@ -278,6 +298,7 @@ void CMasternodeMan::CheckAndRemove(bool forceExpiredRemoval)
                 }
             }
 
+            SetChanged((*it).vin);
             it = vMasternodes.erase(it);
         } else {
             ++it;
@@ -340,6 +361,7 @@ void CMasternodeMan::Clear()
 {
     LOCK(cs);
     vMasternodes.clear();
+    collateralWatcher.Clear();
     mAskedUsForMasternodeList.clear();
     mWeAskedForMasternodeList.clear();
     mWeAskedForMasternodeListEntry.clear();
@@ -430,11 +452,64 @@ void CMasternodeMan::DsegUpdate(CNode* pnode)
         }
     }
 
-    pnode->PushMessage(NetMsgType::DSEG, CTxIn());
+    std::vector<CMasternode*> vpmn;
+    std::vector<uint256> vKeys;
+    if (pnode->nVersion >= SYNC_SKETCH_VERSION)
+        GetSyncList(vpmn, vKeys);
+    if (!vKeys.empty()) {
+        pnode->PushMessage(NetMsgType::DSEGSKETCH, CSyncSketch::ForKeys(vKeys));
+        pnode->FulfilledRequest(NetMsgType::DSEGSKETCH);
+    } else {
+        pnode->PushMessage(NetMsgType::DSEG, CTxIn());
+    }
     int64_t askAgain = GetTime() + MASTERNODES_DSEG_SECONDS;
     mWeAskedForMasternodeList[pnode->addr] = askAgain;
 }
 
+/** Key of a masternode in a dseg sketch, which changes with every new ping */
+static uint256 GetSyncKey(const CMasternode& mn)
+{
+    CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
+    ss << mn.vin.prevout << mn.lastPing.sigTime;
+    return ss.GetHash();
+}
+
+void CMasternodeMan::GetSyncList(std::vector<CMasternode*>& vpmn, std::vector<uint256>& vKeys)
+{
+    LOCK(cs);
+
+    vpmn.clear();
+    vKeys.clear();
+    BOOST_FOREACH (CMasternode& mn, vMasternodes) {
+        if (mn.addr.IsRFC1918()) continue; //local network
+        if (mn.IsEnabled()) {
+            vpmn.push_back(&mn);
+            vKeys.push_back(GetSyncKey(mn));
+        }
+    }
+}
+
+bool CMasternodeMan::AllowListRequest(CNode* pfrom)
+{
+    //local network
+    bool isLocal = (pfrom->addr.IsRFC1918() || pfrom->addr.IsLocal());
+
+    if (!isLocal && Params().NetworkID() == CBaseChainParams::MAIN) {
+        std::map<CNetAddr, int64_t>::iterator i = mAskedUsForMasternodeList.find(pfrom->addr);
+        if (i != mAskedUsForMasternodeList.end()) {
+            int64_t t = (*i).second;
+            if (GetTime() < t) {
+                LogPrintf("CMasternodeMan::ProcessMessage() : dseg - peer already asked me for the list\n");
+                Misbehaving(pfrom->GetId(), 34);
+                return false;
+            }
+        }
+        int64_t askAgain = GetTime() + MASTERNODES_DSEG_SECONDS;
+        mAskedUsForMasternodeList[pfrom->addr] = askAgain;
+    }
+    return true;
+}
+
 CMasternode* CMasternodeMan::Find(const CScript& payee)
 {
     LOCK(cs);
@@ -757,7 +832,7 @@ void CMasternodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CData
         }
 
         // make sure it's still unspent
-        //  - this is checked later by .check() in many places and by ThreadCheckObfuScationPool()
+        //  - this is checked later by .check() in many places and by the mncheck task
         if (mnb.CheckInputsAndAdd(nDoS)) {
             // use this as a peer
             addrman.Add(CAddress(mnb.addr), pfrom->addr, 2 * 60 * 60);
@@ -802,22 +877,7 @@ void CMasternodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CData
         vRecv >> vin;
 
         if (vin == CTxIn()) { //only should ask for this once
-            //local network
-            bool isLocal = (pfrom->addr.IsRFC1918() || pfrom->addr.IsLocal());
-
-            if (!isLocal && Params().NetworkID() == CBaseChainParams::MAIN) {
-                std::map<CNetAddr, int64_t>::iterator i = mAskedUsForMasternodeList.find(pfrom->addr);
-                if (i != mAskedUsForMasternodeList.end()) {
-                    int64_t t = (*i).second;
-                    if (GetTime() < t) {
-                        LogPrintf("CMasternodeMan::ProcessMessage() : dseg - peer already asked me for the list\n");
-                        Misbehaving(pfrom->GetId(), 34);
-                        return;
-                    }
-                }
-                int64_t askAgain = GetTime() + MASTERNODES_DSEG_SECONDS;
-                mAskedUsForMasternodeList[pfrom->addr] = askAgain;
-            }
+            if (!AllowListRequest(pfrom)) return;
         } //else, asking for a specific node which is ok
 
 
@@ -848,6 +908,53 @@ void CMasternodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CData
             pfrom->PushMessage(NetMsgType::SSC, MASTERNODE_SYNC_LIST, nInvCount);
             LogPrint("masternode", "dseg - Sent %d Masternode entries to peer %i\n", nInvCount, pfrom->GetId());
         }
+    } else if (strCommand == NetMsgType::DSEGSKETCH) { //Get the Masternode entries missing from a sketch of the peer's list
+
+        CSyncSketch sketch;
+        vRecv >> sketch;
+
+        if (!sketch.IsWithinSizeConstraints()) {
+            Misbehaving(pfrom->GetId(), 100);
+            return;
+        }
+        LOCK(cs);
+        if (!AllowListRequest(pfrom)) return;
+
+        std::vector<CMasternode*> vpmn;
+        std::vector<uint256> vKeys;
+        GetSyncList(vpmn, vKeys);
+
+        // Send the entries whose collateral or last ping the peer does not
+        // have, with the ping, or everything like dseg if the lists differ
+        // too much to tell
+        std::vector<size_t> vMissing;
+        bool fDelta = sketch.GetMissing(vKeys, vMissing);
+        if (!fDelta) {
+            LogPrint("masternode", "dsegsketch - could not decode the difference with peer %i, sending all %d entries\n", pfrom->GetId(), vpmn.size());
+            vMissing.clear();
+            for (size_t i = 0; i < vpmn.size(); i++)
+                vMissing.push_back(i);
+        }
+
+        int nInvCount = 0;
+        BOOST_FOREACH (size_t i, vMissing) {
+            CMasternode& mn = *vpmn[i];
+            CMasternodeBroadcast mnb = CMasternodeBroadcast(mn);
+            uint256 hash = mnb.GetHash();
+            pfrom->PushInventory(CInv(MSG_MASTERNODE_ANNOUNCE, hash));
+            nInvCount++;
+
+            if (!mapSeenMasternodeBroadcast.count(hash)) mapSeenMasternodeBroadcast.insert(make_pair(hash, mnb));
+
+            if (fDelta && !(mn.lastPing == CMasternodePing())) {
+                uint256 hashPing = mn.lastPing.GetHash();
+                pfrom->PushInventory(CInv(MSG_MASTERNODE_PING, hashPing));
+                if (!mapSeenMasternodePing.count(hashPing)) mapSeenMasternodePing.insert(make_pair(hashPing, mn.lastPing));
+            }
+        }
+
+        pfrom->PushMessage(NetMsgType::SSC, MASTERNODE_SYNC_LIST, nInvCount);
+        LogPrint("masternode", "dsegsketch - Sent %d of %d Masternode entries to peer %i\n", nInvCount, vpmn.size(), pfrom->GetId());
     }
     /*
      * IT'S SAFE TO REMOVE THIS IN FURTHER VERSIONS
@@ -953,6 +1060,7 @@ void CMasternodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CData
                     }
                     pmn->nLastDsee = sigTime;
                     pmn->Check();
+                    SetChanged(pmn->vin);
                     if (pmn->IsEnabled()) {
                         TRY_LOCK(cs_vNodes, lockNodes);
                         if (!lockNodes) return;
@@ -984,7 +1092,7 @@ void CMasternodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CData
         LogPrint("masternode", "dsee - Got NEW OLD Masternode entry %s\n", vin.prevout.hash.ToString());
 
         // make sure it's still unspent
-        //  - this is checked later by .check() in many places and by ThreadCheckObfuScationPool()
+        //  - this is checked later by .check() in many places and by the mncheck task
 
         CValidationState state;
         CMutableTransaction tx = CMutableTransaction();
@@ -1111,6 +1219,7 @@ void CMasternodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CData
                 if (pmn->protocolVersion < GETHEADERS_VERSION) pmn->lastPing = CMasternodePing(vin);
                 pmn->nLastDseep = sigTime;
                 pmn->Check();
+                SetChanged(pmn->vin);
                 if (pmn->IsEnabled()) {
                     TRY_LOCK(cs_vNodes, lockNodes);
                     if (!lockNodes) return;
@@ -1141,6 +1250,7 @@ void CMasternodeMan::Remove(CTxIn vin)
     while (it != vMasternodes.end()) {
         if ((*it).vin == vin) {
             LogPrint("masternode", "CMasternodeMan: Removing Masternode %s - %i now\n", (*it).vin.prevout.hash.ToString(), size() - 1);
+            SetChanged((*it).vin);
             vMasternodes.erase(it);
             break;
         }
@@ -1162,7 +1272,85 @@ void CMasternodeMan::UpdateMasternodeList(CMasternodeBroadcast mnb)
         Add(mn);
     } else {
     	pmn->UpdateFromNewBroadcast(mnb);
+        SetChanged(pmn->vin);
+    }
+}
+
+void CMasternodeMan::SetAllChanged(const CMasternodeStoreDB& db)
+{
+    std::vector<COutPoint> vStored;
+    db.ReadKeys(DB_MASTERNODE, vStored);
+    BOOST_FOREACH (const COutPoint& outpoint, vStored)
+        changedMasternodes.Add(outpoint);
+
+    LOCK(cs);
+    BOOST_FOREACH (const CMasternode& mn, vMasternodes)
+        SetChanged(mn.vin);
+}
+
+bool CMasternodeMan::ReadStore(const CMasternodeStoreDB& db)
+{
+    int64_t nStart = GetTimeMillis();
+
+    std::vector<std::pair<COutPoint, CMasternode> > vRecords;
+    if (!db.ReadRecords(DB_MASTERNODE, vRecords))
+        return false;
+
+    {
+        LOCK(cs);
+        Clear();
+        vMasternodes.reserve(vRecords.size());
+        for (unsigned int i = 0; i < vRecords.size(); i++) {
+            const CMasternode& mn = vRecords[i].second;
+            vMasternodes.push_back(mn);
+            // Answer getdata for the entries we announce, as if the broadcasts had just been received
+            CMasternodeBroadcast mnb(mn);
+            mapSeenMasternodeBroadcast.insert(make_pair(mnb.GetHash(), mnb));
+        }
+        db.Read(DB_DSQ_COUNT, nDsqCount);
+    }
+
+    LogPrint("masternode", "Loaded %u masternodes from the masternode store  %dms\n", vRecords.size(), GetTimeMillis() - nStart);
+    LogPrint("masternode", "Masternode manager - cleaning....\n");
+    CheckAndRemove(true);
+    LogPrint("masternode", "Masternode manager - result:\n");
+    LogPrint("masternode", "  %s\n", ToString());
+    return true;
+}
+
+bool CMasternodeMan::WriteStore(CMasternodeStoreDB& db)
+{
+    int64_t nStart = GetTimeMillis();
+
+    std::set<COutPoint> setChanged;
+    changedMasternodes.Take(setChanged);
+
+    CLevelDBBatch batch;
+    unsigned int nWritten = 0;
+    std::set<COutPoint> setRemoved = setChanged;
+    {
+        LOCK(cs);
+        if (!setRemoved.empty()) {
+            BOOST_FOREACH (const CMasternode& mn, vMasternodes) {
+                if (setRemoved.erase(mn.vin.prevout)) {
+                    batch.Write(make_pair(DB_MASTERNODE, mn.vin.prevout), mn);
+                    nWritten++;
+                }
+            }
+        }
+        // What is left is no longer in the list
+        BOOST_FOREACH (const COutPoint& outpoint, setRemoved)
+            batch.Erase(make_pair(DB_MASTERNODE, outpoint));
+        batch.Write(DB_DSQ_COUNT, nDsqCount);
+    }
+
+    if (!db.WriteChanges(batch)) {
+        changedMasternodes.Restore(setChanged);
+        return error("%s : Failed to write %u masternodes to the masternode store", __func__, setChanged.size());
     }
+
+    LogPrint("masternode", "Written %u changed and %u removed masternodes to the masternode store  %dms\n", nWritten, setRemoved.size(), GetTimeMillis() - nStart);
+    return true;
 }
 
 std::string CMasternodeMan::ToString() const
@@ -10,11 +10,12 @@
 #include "key.h"
 #include "main.h"
 #include "masternode.h"
+#include "mnstoredb.h"
 #include "net.h"
 #include "sync.h"
 #include "util.h"
 
-#define MASTERNODES_DUMP_SECONDS (15 * 60)
+#define MASTERNODES_DUMP_SECONDS 60
 #define MASTERNODES_DSEG_SECONDS (3 * 60 * 60)
 
 #define MINIMUM_PROTOCOL_VERSION_OLD_PING 70003
@@ -24,9 +25,13 @@ using namespace std;
 class CMasternodeMan;
 
 extern CMasternodeMan mnodeman;
+/** Load the masternode list from the masternode store, or mncache.dat if there is one */
+bool LoadMasternodes();
+/** Write the masternodes that changed to the masternode store */
 void DumpMasternodes();
 
-/** Access to the MN database (mncache.dat)
+/** Access to the flat MN cache file (mncache.dat), which older versions and
+ *  chainstate snapshots use
  */
 class CMasternodeDB
 {
@@ -46,6 +51,7 @@ public:
     };
 
     CMasternodeDB();
+    explicit CMasternodeDB(const boost::filesystem::path& pathIn);
     bool Write(const CMasternodeMan& mnodemanToSave);
     ReadResult Read(CMasternodeMan& mnodemanToLoad, bool fDryRun = false);
 };
@@ -67,6 +73,14 @@ private:
     std::map<CNetAddr, int64_t> mWeAskedForMasternodeList;
     // which Masternodes we've asked for
     std::map<COutPoint, int64_t> mWeAskedForMasternodeListEntry;
+    // Masternodes changed since the masternode store was last written
+    CStoreChangeSet<COutPoint> changedMasternodes;
+
+    /// Whether a peer may ask for the whole list again, recording that it did
+    bool AllowListRequest(CNode* pfrom);
+
+    /// The masternodes a dseg sends, and the key of each in a dseg sketch
+    void GetSyncList(std::vector<CMasternode*>& vpmn, std::vector<uint256>& vKeys);
 
 public:
     // Keep track of all broadcasts I've seen
@@ -108,6 +122,12 @@ public:
     /// Check all Masternodes and remove inactive
     void CheckAndRemove(bool forceExpiredRemoval = false);
 
+    /// Have the collateral watcher follow the collaterals of the list, and only those
+    void WatchCollaterals();
+
+    /// Mark the Masternode with this collateral as spent; called by the collateral watcher
+    void CollateralSpent(const COutPoint& outpoint);
+
     /// Clear Masternode vector
     void Clear();
 
@@ -115,6 +135,7 @@ public:
 
     void CountNetworks(int protocolVersion, int& ipv4, int& ipv6, int& onion);
 
+    /// Ask a peer for the masternode list, only for what we are missing if it understands dsegsketch
     void DsegUpdate(CNode* pnode);
 
     /// Find an entry
@@ -159,6 +180,18 @@ public:
 
     /// Update masternode list and maps using provided CMasternodeBroadcast
     void UpdateMasternodeList(CMasternodeBroadcast mnb);
+
+    /// Record that an entry was added, changed or removed, to be written with the next dump
+    void SetChanged(const CTxIn& vin) { changedMasternodes.Add(vin.prevout); }
+
+    /// Mark every entry in memory and in the store as changed, so the next dump replaces the stored list
+    void SetAllChanged(const CMasternodeStoreDB& db);
+
+    /// Load the list from the masternode store
+    bool ReadStore(const CMasternodeStoreDB& db);
+
+    /// Write the entries that changed to the masternode store
+    bool WriteStore(CMasternodeStoreDB& db);
 };
 
 #endif
@@ -0,0 +1,47 @@
+// Copyright (c) 2019 The TRBO developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "mnstoredb.h"
+
+#include "util.h"
+
+CMasternodeStoreDB* pmnstore = NULL;
+
+CMasternodeStoreDB::CMasternodeStoreDB(size_t nCacheSize, bool fMemory, bool fWipe) : CLevelDBWrapper(GetDataDir() / "mnstore", nCacheSize, fMemory, fWipe) {}
+
+bool CMasternodeStoreDB::WriteChanges(CLevelDBBatch& batch)
+{
+    try {
+        return WriteBatch(batch);
+    } catch (const leveldb_error& e) {
+        return error("%s : %s", __func__, e.what());
+    }
+}
+
+bool OpenMasternodeStore()
+{
+    try {
+        pmnstore = new CMasternodeStoreDB(MNSTORE_CACHE_SIZE);
+        int nVersion = 0;
+        if (pmnstore->Read(DB_STORE_VERSION, nVersion) && nVersion != MNSTORE_VERSION) {
+            // Everything in the store is rebuilt from the network anyway
+            LogPrintf("Masternode store has version %d, wiping it\n", nVersion);
+            delete pmnstore;
+            pmnstore = new CMasternodeStoreDB(MNSTORE_CACHE_SIZE, false, true);
+        }
+        if (nVersion != MNSTORE_VERSION && !pmnstore->Write(DB_STORE_VERSION, MNSTORE_VERSION))
+            return error("%s : Failed to write the masternode store version", __func__);
+    } catch (const std::exception& e) {
+        delete pmnstore;
+        pmnstore = NULL;
+        return error("%s : %s", __func__, e.what());
+    }
+    return true;
+}
+
+void CloseMasternodeStore()
+{
+    delete pmnstore;
+    pmnstore = NULL;
+}
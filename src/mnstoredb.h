@@ -0,0 +1,206 @@
+// Copyright (c) 2019 The TRBO developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_MNSTOREDB_H
+#define BITCOIN_MNSTOREDB_H
+
+#include "leveldbwrapper.h"
+#include "sync.h"
+
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <boost/scoped_ptr.hpp>
+
+/**
+ * The masternode store keeps one record per entry of the masternode
+ * managers, so that saving them costs in proportion to what changed:
+ * - 'm' + collateral outpoint -> CMasternode
+ * - 'd' -> obfuscation queue count of the masternode list
+ * - 'w' + vote hash -> CMasternodePaymentWinner
+ * - 'p' + proposal hash -> CBudgetProposal, with its votes
+ * - 'f' + budget hash -> CFinalizedBudget, with its votes
+ * and a single 'V' -> store version.
+ */
+static const char DB_MASTERNODE = 'm';
+static const char DB_DSQ_COUNT = 'd';
+static const char DB_PAYEE_VOTE = 'w';
+static const char DB_BUDGET_PROPOSAL = 'p';
+static const char DB_FINALIZED_BUDGET = 'f';
+static const char DB_STORE_VERSION = 'V';
+
+/** Version of the records above; a store with another version is wiped */
+static const int MNSTORE_VERSION = 1;
+
+/** LevelDB cache of the masternode store */
+static const size_t MNSTORE_CACHE_SIZE = 4 << 20;
+
+/**
+ * Keys of the entries of one kind that changed since they were last written
+ * to the store. The managers add a key wherever they add, change or remove
+ * an entry; writing the store takes the keys and writes the current version
+ * of each entry, or erases it if it is gone.
+ */
+template <typename K>
+class CStoreChangeSet
+{
+private:
+    mutable CCriticalSection cs;
+    std::set<K> setChanged;
+
+public:
+    void Add(const K& key)
+    {
+        LOCK(cs);
+        setChanged.insert(key);
+    }
+
+    /** Move the changed keys to setOut, leaving the set empty */
+    void Take(std::set<K>& setOut)
+    {
+        LOCK(cs);
+        setOut.clear();
+        setOut.swap(setChanged);
+    }
+
+    /** Put back keys that could not be written */
+    void Restore(const std::set<K>& setIn)
+    {
+        LOCK(cs);
+        setChanged.insert(setIn.begin(), setIn.end());
+    }
+
+    size_t size() const
+    {
+        LOCK(cs);
+        return setChanged.size();
+    }
+};
+
+/**
+ * Add the changes to entries of a map (ordered or not) to a batch: the current
+ * value of every changed key that is still in the map, and an erase for the others.
+ */
+template <typename K, typename M>
+void BatchChanges(CLevelDBBatch& batch, char chType, const std::set<K>& setChanged, const M& mapEntries, unsigned int& nWritten, unsigned int& nRemoved)
+{
+    for (typename std::set<K>::const_iterator it = setChanged.begin(); it != setChanged.end(); ++it) {
+        typename M::const_iterator mi = mapEntries.find(*it);
+        if (mi != mapEntries.end()) {
+            batch.Write(std::make_pair(chType, *it), (*mi).second);
+            nWritten++;
+        } else {
+            batch.Erase(std::make_pair(chType, *it));
+            nRemoved++;
+        }
+    }
+}
+
+/** Access to the masternode store (<datadir>/mnstore) */
+class CMasternodeStoreDB : public CLevelDBWrapper
+{
+public:
+    CMasternodeStoreDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+
+private:
+    CMasternodeStoreDB(const CMasternodeStoreDB&);
+    void operator=(const CMasternodeStoreDB&);
+
+    /** Call fn with the key and value stream of every record of a type, in key order */
+    template <typename Fn>
+    bool ForEachRecord(char chType, Fn fn) const
+    {
+        boost::scoped_ptr<leveldb::Iterator> pcursor(const_cast<CMasternodeStoreDB*>(this)->NewIterator());
+        pcursor->Seek(std::string(1, chType));
+        try {
+            for (; pcursor->Valid(); pcursor->Next()) {
+                leveldb::Slice slKey = pcursor->key();
+                if (slKey.size() == 0 || slKey[0] != chType)
+                    break;
+                CDataStream ssKey(slKey.data() + 1, slKey.data() + slKey.size(), SER_DISK, CLIENT_VERSION);
+                leveldb::Slice slValue = pcursor->value();
+                CDataStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
+                fn(ssKey, ssValue);
+            }
+        } catch (const std::exception& e) {
+            return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+        }
+        return true;
+    }
+
+public:
+    /** Write a batch of changes, returning false rather than throwing on a database error */
+    bool WriteChanges(CLevelDBBatch& batch);
+
+    /** Read all records of a type */
+    template <typename K, typename V>
+    bool ReadRecords(char chType, std::vector<std::pair<K, V> >& vRecords) const
+    {
+        vRecords.clear();
+        return ForEachRecord(chType, [&vRecords](CDataStream& ssKey, CDataStream& ssValue) {
+            vRecords.push_back(std::pair<K, V>());
+            ssKey >> vRecords.back().first;
+            ssValue >> vRecords.back().second;
+        });
+    }
+
+    /** Read the keys of all records of a type, without decoding the values */
+    template <typename K>
+    bool ReadKeys(char chType, std::vector<K>& vKeys) const
+    {
+        vKeys.clear();
+        return ForEachRecord(chType, [&vKeys](CDataStream& ssKey, CDataStream& ssValue) {
+            vKeys.push_back(K());
+            ssKey >> vKeys.back();
+        });
+    }
+};
+
+/** The open masternode store, or NULL outside of init and shutdown */
+extern CMasternodeStoreDB* pmnstore;
+
+/** Open the masternode store, wiping it if it was written in another format */
+bool OpenMasternodeStore();
+/** Close the masternode store; the managers must have been dumped before */
+void CloseMasternodeStore();
+
+/**
+ * Import a flat cache file (mncache.dat, mnpayments.dat or budget.dat) that
+ * an older version or a chainstate snapshot left in the data directory. It
+ * replaces the records of the manager in the store and is removed once
+ * written. Returns false if there is no such file or it cannot be read, in
+ * which case the manager is left empty, to be loaded from the store.
+ */
+template <typename FileDB, typename T>
+bool ImportCacheFile(const std::string& strFile, T& obj)
+{
+    boost::filesystem::path path = GetDataDir() / strFile;
+    if (pmnstore == NULL || !boost::filesystem::exists(path))
+        return false;
+
+    FileDB filedb;
+    if (filedb.Read(obj) != FileDB::Ok) {
+        LogPrintf("Error reading %s, loading the masternode store instead\n", strFile);
+        obj.Clear();
+        return false;
+    }
+
+    // Every record of the manager in the store is rewritten or erased. If
+    // that fails the changes are retried with the next dump, and the file
+    // is kept to be imported again at the next start.
+    obj.SetAllChanged(*pmnstore);
+    if (!obj.WriteStore(*pmnstore)) {
+        error("%s : Failed to write %s to the masternode store", __func__, strFile);
+        return true;
+    }
+    boost::filesystem::remove(path);
+    LogPrintf("Imported %s into the masternode store\n", strFile);
+    return true;
+}
+
+#endif // BITCOIN_MNSTOREDB_H
@@ -146,6 +146,7 @@ void CObfuscationPool::ProcessMessageObfuscation(CNode* pfrom, std::string& strC
             mnodeman.nDsqCount++;
             pmn->nLastDsq = mnodeman.nDsqCount;
             pmn->allowFreeTx = true;
+            mnodeman.SetChanged(pmn->vin);
 
             LogPrint("obfuscation", "dsq - new Obfuscation queue object - %s\n", addr.ToString());
             vecObfuscationQueue.push_back(dsq);
@@ -730,6 +731,7 @@ void CObfuscationPool::ChargeFees()
                 CWalletTx wtxCollateral = CWalletTx(pwalletMain, txCollateral);
 
                 // Broadcast
+                LOCK(cs_main);
                 if (!wtxCollateral.AcceptToMemoryPool(true)) {
                     // This must not fail. The transaction has already been signed and recorded.
                     LogPrintf("CObfuscationPool::ChargeFees() : Error: Transaction not valid");
@@ -750,6 +752,7 @@ void CObfuscationPool::ChargeFees()
                     CWalletTx wtxCollateral = CWalletTx(pwalletMain, v.collateral);
 
                     // Broadcast
+                    LOCK(cs_main);
                     if (!wtxCollateral.AcceptToMemoryPool(false)) {
                         // This must not fail. The transaction has already been signed and recorded.
                         LogPrintf("CObfuscationPool::ChargeFees() : Error: Transaction not valid");
@@ -787,6 +790,7 @@ void CObfuscationPool::ChargeRandomFees()
                 CWalletTx wtxCollateral = CWalletTx(pwalletMain, txCollateral);
 
                 // Broadcast
+                LOCK(cs_main);
                 if (!wtxCollateral.AcceptToMemoryPool(true)) {
                     // This must not fail. The transaction has already been signed and recorded.
                     LogPrintf("CObfuscationPool::ChargeRandomFees() : Error: Transaction not valid");
@@ -2259,45 +2263,3 @@ void CObfuscationPool::RelayCompletedTransaction(const int sessionID, const bool
         pnode->PushMessage(NetMsgType::DSC, sessionID, error, errorID);
 }
 
-//TODO: Rename/move to core
-void ThreadCheckObfuScationPool()
-{
-    if (fLiteMode) return; //disable all Obfuscation/Masternode related functionality
-
-    // Make this thread recognisable as the wallet flushing thread
-    RenameThread("trbo-obfuscation");
-
-    unsigned int c = 0;
-
-    while (true) {
-        MilliSleep(1000);
-        //LogPrintf("ThreadCheckObfuScationPool::check timeout\n");
-
-        // try to sync from all available nodes, one step at a time
-        masternodeSync.Process();
-
-        if (masternodeSync.IsBlockchainSynced()) {
-            c++;
-
-            // check if we should activate or ping every few minutes,
-            // start right after sync is considered to be done
-            if (c % MASTERNODE_PING_SECONDS == 1) activeMasternode.ManageStatus();
-
-            if (c % 60 == 0) {
-                mnodeman.CheckAndRemove();
-                mnodeman.ProcessMasternodeConnections();
-                masternodePayments.CleanPaymentList();
-                CleanTransactionLocksList();
-            }
-
-            //if(c % MASTERNODES_DUMP_SECONDS == 0) DumpMasternodes();
-
-            obfuScationPool.CheckTimeout();
-            obfuScationPool.CheckForCompleteQueue();
-
-            if (obfuScationPool.GetState() == POOL_STATUS_IDLE && c % 15 == 0) {
-                obfuScationPool.DoAutomaticDenominating();
-            }
-        }
-    }
-}
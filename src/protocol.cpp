@@ -51,6 +51,9 @@ const char *GETSPORK="getspork";
 const char *FBVOTE="fbvote";
 const char *SSC="ssc";
 const char *MNVS="mnvs";
+const char *DSEGSKETCH="dsegsketch";
+const char *MNGETSKETCH="mngetsketch";
+const char *MNVSSKETCH="mnvssketch";
 const char *HEADERS="headers";
 const char *BLOCK="block";
 const char *GETADDR="getaddr";
@@ -68,6 +71,12 @@ const char *SENDCMPCT="sendcmpct";
 const char *CMPCTBLOCK="cmpctblock";
 const char *GETBLOCKTXN="getblocktxn";
 const char *BLOCKTXN="blocktxn";
+const char *GETCFILTERS="getcfilters";
+const char *CFILTER="cfilter";
+const char *GETCFHEADERS="getcfheaders";
+const char *CFHEADERS="cfheaders";
+const char *GETCFCHECKPT="getcfcheckpt";
+const char *CFCHECKPT="cfcheckpt";
 } // namespace NetMsgType
 
 /** All known message types. Keep this in the same order as the list of
@@ -111,6 +120,9 @@ const static std::string allNetMessageTypes[] = {
     NetMsgType::FBVOTE,
     NetMsgType::SSC,
     NetMsgType::MNVS,
+    NetMsgType::DSEGSKETCH,
+    NetMsgType::MNGETSKETCH,
+    NetMsgType::MNVSSKETCH,
     NetMsgType::HEADERS,
     NetMsgType::BLOCK,
     NetMsgType::GETADDR,
@@ -127,7 +139,13 @@ const static std::string allNetMessageTypes[] = {
     NetMsgType::SENDCMPCT,
     NetMsgType::CMPCTBLOCK,
     NetMsgType::GETBLOCKTXN,
-    NetMsgType::BLOCKTXN
+    NetMsgType::BLOCKTXN,
+    NetMsgType::GETCFILTERS,
+    NetMsgType::CFILTER,
+    NetMsgType::GETCFHEADERS,
+    NetMsgType::CFHEADERS,
+    NetMsgType::GETCFCHECKPT,
+    NetMsgType::CFCHECKPT
 };
 
 static const char* ppszTypeName[] =
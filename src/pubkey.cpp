@@ -2,14 +2,51 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#if defined(HAVE_CONFIG_H)
+#include "config/trbo-config.h"
+#endif
+
 #include "pubkey.h"
 
 #include "eccryptoverify.h"
+#include "ecwrapper.h"
 
 #ifdef USE_SECP256K1
 #include <secp256k1.h>
-#else
-#include "ecwrapper.h"
+#endif
+
+#ifdef USE_SECP256K1
+/**
+ * Whether vchSig is a strict DER signature: BIP66 without the hash type byte.
+ * libsecp256k1 and OpenSSL reach the same verdict on those. Everything else
+ * (block signatures, or scripts without SCRIPT_VERIFY_DERSIG) is left to
+ * OpenSSL, whose lax parsing is part of consensus and which no re-encoding
+ * reproduces exactly.
+ */
+static bool IsStrictDERSignature(const std::vector<unsigned char>& sig)
+{
+    if (sig.size() < 8 || sig.size() > 72)
+        return false;
+    if (sig[0] != 0x30 || sig[1] != sig.size() - 2)
+        return false;
+    unsigned int lenR = sig[3];
+    if (5 + lenR >= sig.size())
+        return false;
+    unsigned int lenS = sig[5 + lenR];
+    if ((size_t)(lenR + lenS + 6) != sig.size())
+        return false;
+
+    // Both integers present, positive and without excess padding
+    if (sig[2] != 0x02 || lenR == 0 || (sig[4] & 0x80))
+        return false;
+    if (lenR > 1 && sig[4] == 0x00 && !(sig[5] & 0x80))
+        return false;
+    if (sig[lenR + 4] != 0x02 || lenS == 0 || (sig[lenR + 6] & 0x80))
+        return false;
+    if (lenS > 1 && sig[lenR + 6] == 0x00 && !(sig[lenR + 7] & 0x80))
+        return false;
+    return true;
+}
 #endif
 
 bool CPubKey::Verify(const uint256& hash, const std::vector<unsigned char>& vchSig) const
@@ -17,15 +54,14 @@ bool CPubKey::Verify(const uint256& hash, const std::vector<unsigned char>& vchS
     if (!IsValid())
         return false;
 #ifdef USE_SECP256K1
-    if (secp256k1_ecdsa_verify((const unsigned char*)&hash, 32, &vchSig[0], vchSig.size(), begin(), size()) != 1)
-        return false;
-#else
+    if (IsStrictDERSignature(vchSig))
+        return secp256k1_ecdsa_verify((const unsigned char*)&hash, 32, &vchSig[0], vchSig.size(), begin(), size()) == 1;
+#endif
     CECKey key;
     if (!key.SetPubKey(begin(), size()))
         return false;
     if (!key.Verify(hash, vchSig))
         return false;
-#endif
     return true;
 }
 
@@ -56,7 +92,7 @@ bool CPubKey::IsFullyValid() const
     if (!IsValid())
         return false;
 #ifdef USE_SECP256K1
-    if (!secp256k1_ecdsa_pubkey_verify(begin(), size()))
+    if (!secp256k1_ec_pubkey_verify(begin(), size()))
         return false;
 #else
     CECKey key;
@@ -72,8 +108,8 @@ bool CPubKey::Decompress()
         return false;
 #ifdef USE_SECP256K1
     int clen = size();
-    int ret = secp256k1_ecdsa_pubkey_decompress((unsigned char*)begin(), &clen);
-    assert(ret);
+    if (!secp256k1_ec_pubkey_decompress((unsigned char*)begin(), &clen))
+        return false;
     assert(clen == (int)size());
 #else
     CECKey key;
@@ -96,7 +132,7 @@ bool CPubKey::Derive(CPubKey& pubkeyChild, unsigned char ccChild[32], unsigned i
     memcpy(ccChild, out + 32, 32);
 #ifdef USE_SECP256K1
     pubkeyChild = *this;
-    bool ret = secp256k1_ecdsa_pubkey_tweak_add((unsigned char*)pubkeyChild.begin(), pubkeyChild.size(), out);
+    bool ret = secp256k1_ec_pubkey_tweak_add((unsigned char*)pubkeyChild.begin(), pubkeyChild.size(), out);
 #else
     CECKey key;
     bool ret = key.SetPubKey(begin(), size());
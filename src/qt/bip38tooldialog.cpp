@@ -208,6 +208,13 @@ void Bip38ToolDialog::on_importAddressButton_DEC_clicked()
         return;
     }
 
+    CWalletRescanReserver reserver(pwalletMain);
+    if (!reserver.Reserve()) {
+        ui->statusLabel_DEC->setStyleSheet("QLabel { color: red; }");
+        ui->statusLabel_DEC->setText(tr("Wallet is currently rescanning. Abort existing rescan or wait."));
+        return;
+    }
+
     CPubKey pubkey = key.GetPubKey();
 
     if (!IsValidDestinationString(ui->addressOut_DEC->text().toStdString())) {
@@ -244,7 +251,7 @@ void Bip38ToolDialog::on_importAddressButton_DEC_clicked()
 
         // whenever a key is imported, we need to scan the whole chain
         pwalletMain->nTimeFirstKey = 1; // 0 would be considered 'no value'
-        pwalletMain->ScanForWalletTransactions(chainActive.Genesis(), true);
+        pwalletMain->ScanForWalletTransactions(chainActive.Genesis(), true, &reserver);
     }
 
     ui->statusLabel_DEC->setStyleSheet("QLabel { color: green; }");
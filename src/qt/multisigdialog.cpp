@@ -220,6 +220,13 @@ void MultisigDialog::on_importAddressButton_clicked(){
         return;
     }
 
+    CWalletRescanReserver reserver(pwalletMain);
+    if (!reserver.Reserve()) {
+        ui->addMultisigStatus->setStyleSheet("QLabel { color: red; }");
+        ui->addMultisigStatus->setText(tr("Wallet is currently rescanning. Abort existing rescan or wait."));
+        return;
+    }
+
     vector<string> vRedeem;
     size_t pos = 0;
 
@@ -234,7 +241,7 @@ void MultisigDialog::on_importAddressButton_clicked(){
     addMultisig(stoi(vRedeem[0]), keys);
 
     // rescan to find txs associated with imported address
-    pwalletMain->ScanForWalletTransactions(chainActive.Genesis(), true);
+    pwalletMain->ScanForWalletTransactions(chainActive.Genesis(), true, &reserver);
     pwalletMain->ReacceptWalletTransactions();
 }
 
@@ -156,15 +156,19 @@ static void initTranslations(QTranslator& qtTranslatorBase, QTranslator& qtTrans
 #if QT_VERSION < 0x050000
 void DebugMessageHandler(QtMsgType type, const char* msg)
 {
-    const char* category = (type == QtDebugMsg) ? "qt" : NULL;
-    LogPrint(category, "GUI: %s\n", msg);
+    if (type == QtDebugMsg)
+        LogPrint("qt", "GUI: %s\n", msg);
+    else
+        LogPrintf("GUI: %s\n", msg);
 }
 #else
 void DebugMessageHandler(QtMsgType type, const QMessageLogContext& context, const QString& msg)
 {
     Q_UNUSED(context);
-    const char* category = (type == QtDebugMsg) ? "qt" : NULL;
-    LogPrint(category, "GUI: %s\n", msg.toStdString());
+    if (type == QtDebugMsg)
+        LogPrint("qt", "GUI: %s\n", msg.toStdString());
+    else
+        LogPrintf("GUI: %s\n", msg.toStdString());
 }
 #endif
 
@@ -3,7 +3,11 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include "blockfilterindex.h"
 #include "chain.h"
+#include "chainparams.h"
+#include "crypto/common.h"
+#include "httprpc.h"
 #include "primitives/block.h"
 #include "primitives/transaction.h"
 #include "main.h"
@@ -12,10 +16,13 @@
 #include "streams.h"
 #include "sync.h"
 #include "txmempool.h"
+#include "undo.h"
+#include "util.h"
 #include "utilstrencodings.h"
 #include "version.h"
 
 #include <boost/algorithm/string.hpp>
+#include <boost/bind.hpp>
 #include <boost/dynamic_bitset.hpp>
 
 #include <univalue.h>
@@ -23,6 +30,7 @@
 using namespace std;
 
 static const size_t MAX_GETUTXOS_OUTPOINTS = 15; //allow a max of 15 outpoints to be queried at once
+static const long MAX_REST_BLOCK_RANGE = 10000; //!< most blocks a /rest/blocks/ or /rest/blockundos/ request may ask for
 
 enum RetFormat {
     RF_UNDEF,
@@ -58,11 +66,32 @@ struct CCoin {
 };
 
 extern void TxToJSON(const CTransaction& tx, const uint256 hashBlock, UniValue& entry, bool include_hex, int serialize_flags);
-extern UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool txDetails = false);
+extern void blockToJSON(CJSONStreamWriter& writer, const CBlock& block, const CBlockIndex* blockindex, const CChainSnapshot& chain, bool txDetails = false);
 extern UniValue mempoolInfoToJSON();
-extern UniValue mempoolToJSON(bool fVerbose = false);
+extern void mempoolToJSON(CJSONStreamWriter& writer, bool fVerbose = false);
 extern void ScriptPubKeyToJSON(const CScript& scriptPubKey, UniValue& out, bool fIncludeHex);
-extern UniValue blockheaderToJSON(const CBlockIndex* blockindex);
+extern UniValue blockheaderToJSON(const CBlockIndex* blockindex, const CChainSnapshot& chain);
+
+//! Size of the pieces large replies are sent in
+static const size_t REST_CHUNK_SIZE = 64 * 1024;
+
+/** Send serialized data as binary or hex, in chunks instead of one string */
+static void WriteSerializedReply(HTTPRequest* req, const CDataStream& ss, RetFormat rf)
+{
+    assert(rf == RF_BINARY || rf == RF_HEX);
+    req->WriteHeader("Content-Type", rf == RF_HEX ? "text/plain" : "application/octet-stream");
+    HTTPReplyStream reply(req, HTTP_OK);
+    CDataStream::const_iterator it = ss.begin();
+    do {
+        size_t nSize = std::min(REST_CHUNK_SIZE, (size_t)(ss.end() - it));
+        string strChunk = rf == RF_HEX ? HexStr(it, it + nSize) : string(it, it + nSize);
+        it += nSize;
+        if (rf == RF_HEX && it == ss.end())
+            strChunk += "\n";
+        reply.Write(strChunk);
+    } while (it != ss.end());
+    reply.Finish();
+}
 
 static bool RESTERR(HTTPRequest* req, enum HTTPStatusCode status, string message)
 {
@@ -138,12 +167,87 @@ static bool rest_headers(HTTPRequest* req,
     if (!ParseHashStr(hashStr, hash))
         return RESTERR(req, HTTP_BAD_REQUEST, "Invalid hash: " + hashStr);
 
+    CChainSnapshot chain;
     std::vector<const CBlockIndex *> headers;
     headers.reserve(count);
+    const CBlockIndex *pindex = chain.Lookup(hash);
+    while (pindex != NULL && chain.Contains(pindex)) {
+        headers.push_back(pindex);
+        if (headers.size() == (unsigned long)count)
+            break;
+        pindex = chain.Next(pindex);
+    }
+
+    CDataStream ssHeader(SER_NETWORK, PROTOCOL_VERSION);
+    BOOST_FOREACH(const CBlockIndex *pindex, headers) {
+        ssHeader << pindex->GetBlockHeader();
+    }
+
+    switch (rf) {
+    case RF_BINARY: {
+        string binaryHeader = ssHeader.str();
+        req->WriteHeader("Content-Type", "application/octet-stream");
+        req->WriteReply(HTTP_OK, binaryHeader);
+        return true;
+    }
+
+    case RF_HEX: {
+        string strHex = HexStr(ssHeader.begin(), ssHeader.end()) + "\n";
+        req->WriteHeader("Content-Type", "text/plain");
+        req->WriteReply(HTTP_OK, strHex);
+        return true;
+    }
+    case RF_JSON: {
+        UniValue jsonHeaders(UniValue::VARR);
+        BOOST_FOREACH(const CBlockIndex *pindex, headers) {
+            jsonHeaders.push_back(blockheaderToJSON(pindex, chain));
+        }
+        string strJSON = jsonHeaders.write() + "\n";
+        req->WriteHeader("Content-Type", "application/json");
+        req->WriteReply(HTTP_OK, strJSON);
+        return true;
+    }
+    default: {
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: .bin, .hex)");
+    }
+    }
+
+    // not reached
+    return true; // continue to process further HTTP reqs on this cxn
+}
+
+static bool rest_filter_header(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    vector<string> params;
+    const RetFormat rf = ParseDataFormat(params, strURIPart);
+    vector<string> path;
+    boost::split(path, params[0], boost::is_any_of("/"));
+
+    if (path.size() != 3)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid URI format. Expected /rest/blockfilterheaders/<filtertype>/<count>/<blockhash>.<ext>");
+
+    BlockFilterType filterType;
+    if (!BlockFilterTypeByName(path[0], filterType))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Unknown filtertype " + path[0]);
+    if (!pblockfilterindex || pblockfilterindex->GetFilterType() != filterType)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Index is not enabled for filtertype " + path[0]);
+
+    long count = strtol(path[1].c_str(), NULL, 10);
+    if (count < 1 || count > (long)MAX_GETCFHEADERS_SIZE)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Header count out of range: " + path[1]);
+
+    uint256 hash;
+    if (!ParseHashStr(path[2], hash))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid hash: " + path[2]);
+
+    std::vector<const CBlockIndex*> headers;
+    headers.reserve(count);
     {
         LOCK(cs_main);
         BlockMap::const_iterator it = mapBlockIndex.find(hash);
-        const CBlockIndex *pindex = (it != mapBlockIndex.end()) ? it->second : NULL;
+        const CBlockIndex* pindex = (it != mapBlockIndex.end()) ? it->second : NULL;
         while (pindex != NULL && chainActive.Contains(pindex)) {
             headers.push_back(pindex);
             if (headers.size() == (unsigned long)count)
@@ -152,20 +256,34 @@ static bool rest_headers(HTTPRequest* req,
         }
     }
 
-    CDataStream ssHeader(SER_NETWORK, PROTOCOL_VERSION);
-    BOOST_FOREACH(const CBlockIndex *pindex, headers) {
-        ssHeader << pindex->GetBlockHeader();
+    // The index is read without cs_main; entries are keyed by block hash
+    std::vector<uint256> filterHeaders;
+    filterHeaders.reserve(headers.size());
+    BOOST_FOREACH(const CBlockIndex* pindex, headers) {
+        uint256 filterHeader;
+        if (!pblockfilterindex->LookupFilterHeader(pindex, filterHeader))
+            break;
+        filterHeaders.push_back(filterHeader);
     }
 
     switch (rf) {
     case RF_BINARY: {
+        CDataStream ssHeader(SER_NETWORK, PROTOCOL_VERSION);
+        BOOST_FOREACH(const uint256& header, filterHeaders) {
+            ssHeader << header;
+        }
+
         string binaryHeader = ssHeader.str();
         req->WriteHeader("Content-Type", "application/octet-stream");
         req->WriteReply(HTTP_OK, binaryHeader);
         return true;
     }
-
     case RF_HEX: {
+        CDataStream ssHeader(SER_NETWORK, PROTOCOL_VERSION);
+        BOOST_FOREACH(const uint256& header, filterHeaders) {
+            ssHeader << header;
+        }
+
         string strHex = HexStr(ssHeader.begin(), ssHeader.end()) + "\n";
         req->WriteHeader("Content-Type", "text/plain");
         req->WriteReply(HTTP_OK, strHex);
@@ -173,16 +291,90 @@ static bool rest_headers(HTTPRequest* req,
     }
     case RF_JSON: {
         UniValue jsonHeaders(UniValue::VARR);
-        BOOST_FOREACH(const CBlockIndex *pindex, headers) {
-            jsonHeaders.push_back(blockheaderToJSON(pindex));
+        BOOST_FOREACH(const uint256& header, filterHeaders) {
+            jsonHeaders.push_back(header.GetHex());
         }
+
         string strJSON = jsonHeaders.write() + "\n";
         req->WriteHeader("Content-Type", "application/json");
         req->WriteReply(HTTP_OK, strJSON);
         return true;
     }
     default: {
-        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: .bin, .hex)");
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: " + AvailableDataFormatsString() + ")");
+    }
+    }
+
+    // not reached
+    return true; // continue to process further HTTP reqs on this cxn
+}
+
+static bool rest_block_filter(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    vector<string> params;
+    const RetFormat rf = ParseDataFormat(params, strURIPart);
+
+    // request is sent over URI scheme /rest/blockfilter/filtertype/blockhash
+    vector<string> path;
+    boost::split(path, params[0], boost::is_any_of("/"));
+    if (path.size() != 2)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid URI format. Expected /rest/blockfilter/<filtertype>/<blockhash>");
+
+    uint256 hash;
+    if (!ParseHashStr(path[1], hash))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid hash: " + path[1]);
+
+    BlockFilterType filterType;
+    if (!BlockFilterTypeByName(path[0], filterType))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Unknown filtertype " + path[0]);
+    if (!pblockfilterindex || pblockfilterindex->GetFilterType() != filterType)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Index is not enabled for filtertype " + path[0]);
+
+    const CBlockIndex* pindex = NULL;
+    {
+        LOCK(cs_main);
+        BlockMap::const_iterator it = mapBlockIndex.find(hash);
+        if (it == mapBlockIndex.end())
+            return RESTERR(req, HTTP_NOT_FOUND, path[1] + " not found");
+        pindex = it->second;
+    }
+
+    // A single index read, no block or undo data is touched
+    CBlockFilter filter;
+    if (!pblockfilterindex->LookupFilter(pindex, filter))
+        return RESTERR(req, HTTP_NOT_FOUND, "Filter not found. Block filters are still being indexed or the block is not in the active chain.");
+
+    switch (rf) {
+    case RF_BINARY: {
+        CDataStream ssResp(SER_NETWORK, PROTOCOL_VERSION);
+        ssResp << filter;
+
+        string binaryResp = ssResp.str();
+        req->WriteHeader("Content-Type", "application/octet-stream");
+        req->WriteReply(HTTP_OK, binaryResp);
+        return true;
+    }
+    case RF_HEX: {
+        CDataStream ssResp(SER_NETWORK, PROTOCOL_VERSION);
+        ssResp << filter;
+
+        string strHex = HexStr(ssResp.begin(), ssResp.end()) + "\n";
+        req->WriteHeader("Content-Type", "text/plain");
+        req->WriteReply(HTTP_OK, strHex);
+        return true;
+    }
+    case RF_JSON: {
+        UniValue ret(UniValue::VOBJ);
+        ret.push_back(Pair("filter", HexStr(filter.GetEncodedFilter())));
+        string strJSON = ret.write() + "\n";
+        req->WriteHeader("Content-Type", "application/json");
+        req->WriteReply(HTTP_OK, strJSON);
+        return true;
+    }
+    default: {
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: " + AvailableDataFormatsString() + ")");
     }
     }
 
@@ -204,44 +396,37 @@ static bool rest_block(HTTPRequest* req,
     if (!ParseHashStr(hashStr, hash))
         return RESTERR(req, HTTP_BAD_REQUEST, "Invalid hash: " + hashStr);
 
+    CChainSnapshot chain;
+    const CBlockIndex* pblockindex = chain.Lookup(hash);
+    if (!pblockindex)
+        return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
+
     CBlock block;
-    CBlockIndex* pblockindex = NULL;
     {
         LOCK(cs_main);
-        if (mapBlockIndex.count(hash) == 0)
-            return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
-
-        pblockindex = mapBlockIndex[hash];
         if (!(pblockindex->nStatus & BLOCK_HAVE_DATA) && pblockindex->nTx > 0)
             return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not available (pruned data)");
-
-        if (!ReadBlockFromDisk(block, pblockindex))
-            return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
     }
 
-    CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
-    ssBlock << block;
+    if (!ReadBlockFromDisk(block, pblockindex))
+        return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
 
     switch (rf) {
-    case RF_BINARY: {
-        string binaryBlock = ssBlock.str();
-        req->WriteHeader("Content-Type", "application/octet-stream");
-        req->WriteReply(HTTP_OK, binaryBlock);
-        return true;
-    }
-
+    case RF_BINARY:
     case RF_HEX: {
-        string strHex = HexStr(ssBlock.begin(), ssBlock.end()) + "\n";
-        req->WriteHeader("Content-Type", "text/plain");
-        req->WriteReply(HTTP_OK, strHex);
+        CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
+        ssBlock << block;
+        WriteSerializedReply(req, ssBlock, rf);
         return true;
     }
 
     case RF_JSON: {
-        UniValue objBlock = blockToJSON(block, pblockindex, showTxDetails);
-        string strJSON = objBlock.write() + "\n";
         req->WriteHeader("Content-Type", "application/json");
-        req->WriteReply(HTTP_OK, strJSON);
+        HTTPReplyStream reply(req, HTTP_OK);
+        CJSONStreamWriter writer(boost::bind(&HTTPReplyStream::Write, &reply, _1), REST_CHUNK_SIZE);
+        blockToJSON(writer, block, pblockindex, chain, showTxDetails);
+        writer.Finish();
+        reply.Finish();
         return true;
     }
 
@@ -264,6 +449,182 @@ static bool rest_block_notxdetails(HTTPRequest* req, const std::string& strURIPa
     return rest_block(req, strURIPart, false);
 }
 
+/**
+ * Read the size of the record at pos in a block or undo file from the header
+ * in front of it. The file is left open for the next record of the same file.
+ */
+static bool ReadRawRecordSize(FILE*& file, int& nFile, const CDiskBlockPos& pos, bool fUndo, unsigned int& nSizeOut)
+{
+    if (file == NULL || nFile != pos.nFile) {
+        if (file)
+            fclose(file);
+        file = fUndo ? OpenUndoFile(pos, true) : OpenBlockFile(pos, true);
+        nFile = pos.nFile;
+        if (file == NULL)
+            return false;
+    }
+
+    unsigned char header[MESSAGE_START_SIZE + 4];
+    if (pos.nPos < sizeof(header) || fseek(file, pos.nPos - sizeof(header), SEEK_SET) != 0 ||
+        fread(header, 1, sizeof(header), file) != sizeof(header))
+        return false;
+    if (memcmp(header, Params().MessageStart(), MESSAGE_START_SIZE) != 0)
+        return false;
+    nSizeOut = ReadLE32(header + MESSAGE_START_SIZE);
+    return nSizeOut <= MAX_SIZE;
+}
+
+/** The 4-byte little-endian size in front of every record of a block range */
+static std::string SizePrefix(unsigned int nSize)
+{
+    unsigned char prefix[4];
+    WriteLE32(prefix, nSize);
+    return std::string((const char*)prefix, sizeof(prefix));
+}
+
+/** Read a whole record of a block or undo file, nSize bytes at pos */
+static bool ReadRawRecord(const CDiskBlockPos& pos, bool fUndo, unsigned int nSize, std::string& strData)
+{
+    FILE* file = fUndo ? OpenUndoFile(pos, true) : OpenBlockFile(pos, true);
+    if (file == NULL)
+        return false;
+    strData.resize(nSize);
+    size_t nRead = nSize > 0 ? fread(&strData[0], 1, nSize, file) : 0;
+    fclose(file);
+    return nRead == nSize;
+}
+
+/**
+ * Consecutive blocks or block undo data of the active chain, starting at a
+ * height. Every record is preceded by its size as a 4-byte little-endian
+ * integer; the genesis block has no undo data and gets an empty record. The
+ * records are sent straight from the block files as they were written to
+ * disk, and the response stops early once it would exceed -restmaxresponse.
+ */
+static bool rest_block_range(HTTPRequest* req, const std::string& strURIPart, bool fUndo)
+{
+    if (!CheckWarmup(req))
+        return false;
+    vector<string> params;
+    const RetFormat rf = ParseDataFormat(params, strURIPart);
+    if (rf != RF_BINARY && rf != RF_HEX)
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: bin, hex)");
+
+    vector<string> path;
+    boost::split(path, params[0], boost::is_any_of("/"));
+    if (path.size() != 2)
+        return RESTERR(req, HTTP_BAD_REQUEST, strprintf("No block count specified. Use /rest/%s/<start-height>/<count>.<ext>.", fUndo ? "blockundos" : "blocks"));
+
+    char* endp = NULL;
+    long nStart = strtol(path[0].c_str(), &endp, 10);
+    if (path[0].empty() || *endp != 0 || nStart < 0)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid start height: " + path[0]);
+    long count = strtol(path[1].c_str(), &endp, 10);
+    if (path[1].empty() || *endp != 0 || count < 1 || count > MAX_REST_BLOCK_RANGE)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Block count out of range: " + path[1]);
+
+    // Collect the positions under cs_main, the files are read without it
+    vector<CDiskBlockPos> vPos;
+    {
+        LOCK(cs_main);
+        if (nStart > chainActive.Height())
+            return RESTERR(req, HTTP_NOT_FOUND, "Start height out of range: " + path[0]);
+
+        for (long nHeight = nStart; nHeight <= chainActive.Height() && (long)vPos.size() < count; nHeight++) {
+            const CBlockIndex* pindex = chainActive[nHeight];
+            if (fUndo && pindex->pprev == NULL) {
+                vPos.push_back(CDiskBlockPos());
+                continue;
+            }
+            if (!(pindex->nStatus & (fUndo ? BLOCK_HAVE_UNDO : BLOCK_HAVE_DATA)))
+                return RESTERR(req, HTTP_NOT_FOUND, strprintf("Block at height %d not available (pruned data)", nHeight));
+            vPos.push_back(fUndo ? pindex->GetUndoPos() : pindex->GetBlockPos());
+        }
+    }
+
+    // Find the size of every record and cut the range off at the response limit
+    const uint64_t nMaxResponse = (uint64_t)std::max(GetArg("-restmaxresponse", DEFAULT_REST_MAX_RESPONSE), (int64_t)1) << 20;
+    vector<unsigned int> vSize;
+    uint64_t nTotal = 0;
+    {
+        FILE* file = NULL;
+        int nFile = -1;
+        BOOST_FOREACH (const CDiskBlockPos& pos, vPos) {
+            unsigned int nSize = 0;
+            if (!pos.IsNull() && !ReadRawRecordSize(file, nFile, pos, fUndo, nSize)) {
+                if (file)
+                    fclose(file);
+                return RESTERR(req, HTTP_INTERNAL_SERVER_ERROR, strprintf("Failed to read %s file %d", fUndo ? "undo" : "block", pos.nFile));
+            }
+            if (!vSize.empty() && nTotal + 4 + nSize > nMaxResponse)
+                break;
+            nTotal += 4 + nSize;
+            vSize.push_back(nSize);
+        }
+        if (file)
+            fclose(file);
+    }
+    vPos.resize(vSize.size());
+
+    // Blocks are stored with witness data, they have to be re-serialized if
+    // -rpcserialversion asks for a different format.
+    const bool fReserialize = !fUndo && RPCSerializationFlags() != 0;
+
+    req->WriteHeader("Content-Type", rf == RF_HEX ? "text/plain" : "application/octet-stream");
+    req->StartChunkedReply(HTTP_OK);
+    bool fOk = true;
+    unsigned int i = 0;
+    while (fOk && i < vPos.size()) {
+        if (rf == RF_BINARY && !fReserialize && !vPos[i].IsNull()) {
+            // The records of one file go out as one chunk, sent from the file
+            const int nFile = vPos[i].nFile;
+            FILE* file = fUndo ? OpenUndoFile(vPos[i], true) : OpenBlockFile(vPos[i], true);
+            vector<HTTPFileRange> vRanges;
+            for (; i < vPos.size() && !vPos[i].IsNull() && vPos[i].nFile == nFile; i++)
+                vRanges.push_back(HTTPFileRange(SizePrefix(vSize[i]), vPos[i].nPos, vSize[i]));
+            fOk = file != NULL && req->WriteReplyFileChunk(file, vRanges);
+            continue;
+        }
+
+        // Nothing of a record is written before all of it has been read
+        std::string strData;
+        if (fReserialize) {
+            CBlock block;
+            fOk = ReadBlockFromDisk(block, vPos[i]);
+            CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
+            ssBlock << block;
+            strData = ssBlock.str();
+        } else if (!vPos[i].IsNull()) {
+            fOk = ReadRawRecord(vPos[i], fUndo, vSize[i], strData);
+        }
+        if (!fOk)
+            break;
+        strData.insert(0, SizePrefix(strData.size()));
+        req->WriteReplyChunk(rf == RF_HEX ? HexStr(strData) : strData);
+        i++;
+    }
+    if (!fOk) {
+        // Too late for an error status, the client has to see the cut instead
+        LogPrintf("%s: failed to read %s file %d, dropping the connection\n", __func__, fUndo ? "undo" : "block", vPos[i].nFile);
+        req->AbortChunkedReply();
+        return false;
+    }
+    if (rf == RF_HEX)
+        req->WriteReplyChunk("\n");
+    req->EndChunkedReply();
+    return true;
+}
+
+static bool rest_blocks(HTTPRequest* req, const std::string& strURIPart)
+{
+    return rest_block_range(req, strURIPart, false);
+}
+
+static bool rest_blockundos(HTTPRequest* req, const std::string& strURIPart)
+{
+    return rest_block_range(req, strURIPart, true);
+}
+
 static bool rest_chaininfo(HTTPRequest* req, const std::string& strURIPart)
 {
     if (!CheckWarmup(req))
@@ -323,11 +684,12 @@ static bool rest_mempool_contents(HTTPRequest* req, const std::string& strURIPar
 
     switch (rf) {
     case RF_JSON: {
-        UniValue mempoolObject = mempoolToJSON(true);
-
-        string strJSON = mempoolObject.write() + "\n";
         req->WriteHeader("Content-Type", "application/json");
-        req->WriteReply(HTTP_OK, strJSON);
+        HTTPReplyStream reply(req, HTTP_OK);
+        CJSONStreamWriter writer(boost::bind(&HTTPReplyStream::Write, &reply, _1), REST_CHUNK_SIZE);
+        mempoolToJSON(writer, true);
+        writer.Finish();
+        reply.Finish();
         return true;
     }
     default: {
@@ -356,30 +718,27 @@ static bool rest_tx(HTTPRequest* req, const std::string& strURIPart)
     if (!GetTransaction(hash, tx, hashBlock, true))
         return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
 
-    CDataStream ssTx(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
-    ssTx << tx;
-
     switch (rf) {
-    case RF_BINARY: {
-        string binaryTx = ssTx.str();
-        req->WriteHeader("Content-Type", "application/octet-stream");
-        req->WriteReply(HTTP_OK, binaryTx);
-        return true;
-    }
-
+    case RF_BINARY:
     case RF_HEX: {
-        string strHex = HexStr(ssTx.begin(), ssTx.end()) + "\n";
-        req->WriteHeader("Content-Type", "text/plain");
-        req->WriteReply(HTTP_OK, strHex);
+        CDataStream ssTx(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
+        ssTx << tx;
+        WriteSerializedReply(req, ssTx, rf);
         return true;
     }
 
     case RF_JSON: {
         UniValue objTx(UniValue::VOBJ);
-        TxToJSON(tx, hashBlock, objTx, true, RPCSerializationFlags());
-        string strJSON = objTx.write() + "\n";
+        {
+            LOCK(cs_main);
+            TxToJSON(tx, hashBlock, objTx, true, RPCSerializationFlags());
+        }
         req->WriteHeader("Content-Type", "application/json");
-        req->WriteReply(HTTP_OK, strJSON);
+        HTTPReplyStream reply(req, HTTP_OK);
+        CJSONStreamWriter writer(boost::bind(&HTTPReplyStream::Write, &reply, _1), REST_CHUNK_SIZE);
+        writer.Write(objTx);
+        writer.Finish();
+        reply.Finish();
         return true;
     }
 
@@ -595,10 +954,14 @@ static const struct {
       {"/rest/tx/", rest_tx},
       {"/rest/block/notxdetails/", rest_block_notxdetails},
       {"/rest/block/", rest_block_extended},
+      {"/rest/blocks/", rest_blocks},
+      {"/rest/blockundos/", rest_blockundos},
       {"/rest/chaininfo", rest_chaininfo},
       {"/rest/mempool/info", rest_mempool_info},
       {"/rest/mempool/contents", rest_mempool_contents},
       {"/rest/headers/", rest_headers},
+      {"/rest/blockfilterheaders/", rest_filter_header},
+      {"/rest/blockfilter/", rest_block_filter},
       {"/rest/getutxos", rest_getutxos},
 };
 
@@ -8,9 +8,11 @@
 #include "base58.h"
 #include "checkpoints.h"
 #include "clientversion.h"
+#include "coinstatsindex.h"
 #include "consensus/validation.h"
 #include "main.h"
 #include "rpcserver.h"
+#include "snapshot.h"
 #include "sync.h"
 #include "txdb.h"
 #include "util.h"
@@ -24,6 +26,43 @@ using namespace std;
 extern void TxToJSON(const CTransaction& tx, const uint256 hashBlock, UniValue& entry, bool include_hex, int serialize_flags);
 void ScriptPubKeyToJSON(const CScript& scriptPubKey, UniValue& out, bool fIncludeHex);
 
+CChainSnapshot::CChainSnapshot()
+{
+    LOCK(cs_main);
+    pindexTip = chainActive.Tip();
+}
+
+int CChainSnapshot::Height() const
+{
+    return pindexTip ? pindexTip->nHeight : -1;
+}
+
+const CBlockIndex* CChainSnapshot::operator[](int nHeight) const
+{
+    if (nHeight < 0 || nHeight > Height())
+        return NULL;
+    return pindexTip->GetAncestor(nHeight);
+}
+
+bool CChainSnapshot::Contains(const CBlockIndex* pindex) const
+{
+    return pindex && (*this)[pindex->nHeight] == pindex;
+}
+
+const CBlockIndex* CChainSnapshot::Next(const CBlockIndex* pindex) const
+{
+    if (Contains(pindex))
+        return (*this)[pindex->nHeight + 1];
+    return NULL;
+}
+
+const CBlockIndex* CChainSnapshot::Lookup(const uint256& hash) const
+{
+    LOCK(cs_main);
+    BlockMap::const_iterator mi = mapBlockIndex.find(hash);
+    return mi != mapBlockIndex.end() ? mi->second : NULL;
+}
+
 double GetDifficulty(const CBlockIndex* blockindex)
 {
     // Floating point number that is a multiple of the minimum difficulty,
@@ -52,14 +91,14 @@ double GetDifficulty(const CBlockIndex* blockindex)
     return dDiff;
 }
 
-UniValue blockheaderToJSON(const CBlockIndex* blockindex)
+UniValue blockheaderToJSON(const CBlockIndex* blockindex, const CChainSnapshot& chain)
 {
     UniValue result(UniValue::VOBJ);
     result.push_back(Pair("hash", blockindex->GetBlockHash().GetHex()));
     int confirmations = -1;
     // Only report confirmations if the block is on the main chain
-    if (chainActive.Contains(blockindex))
-        confirmations = chainActive.Height() - blockindex->nHeight + 1;
+    if (chain.Contains(blockindex))
+        confirmations = chain.Height() - blockindex->nHeight + 1;
     result.push_back(Pair("confirmations", confirmations));
     result.push_back(Pair("height", blockindex->nHeight));
     result.push_back(Pair("version", blockindex->nVersion));
@@ -72,20 +111,20 @@ UniValue blockheaderToJSON(const CBlockIndex* blockindex)
 
     if (blockindex->pprev)
         result.push_back(Pair("previousblockhash", blockindex->pprev->GetBlockHash().GetHex()));
-    CBlockIndex *pnext = chainActive.Next(blockindex);
+    const CBlockIndex* pnext = chain.Next(blockindex);
     if (pnext)
         result.push_back(Pair("nextblockhash", pnext->GetBlockHash().GetHex()));
     return result;
 }
 
-UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool txDetails = false)
+UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, const CChainSnapshot& chain, bool txDetails = false)
 {
     UniValue result(UniValue::VOBJ);
     result.push_back(Pair("hash", block.GetHash().GetHex()));
     int confirmations = -1;
     // Only report confirmations if the block is on the main chain
-    if (chainActive.Contains(blockindex))
-        confirmations = chainActive.Height() - blockindex->nHeight + 1;
+    if (chain.Contains(blockindex))
+        confirmations = chain.Height() - blockindex->nHeight + 1;
     result.push_back(Pair("confirmations", confirmations));
     result.push_back(Pair("strippedsize", (int)::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION | SERIALIZE_TRANSACTION_NO_WITNESS)));
     result.push_back(Pair("size", (int)::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION)));
@@ -111,7 +150,7 @@ UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool tx
 
     if (blockindex->pprev)
         result.push_back(Pair("previousblockhash", blockindex->pprev->GetBlockHash().GetHex()));
-    CBlockIndex* pnext = chainActive.Next(blockindex);
+    const CBlockIndex* pnext = chain.Next(blockindex);
     if (pnext)
         result.push_back(Pair("nextblockhash", pnext->GetBlockHash().GetHex()));
 
@@ -120,6 +159,32 @@ UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool tx
     return result;
 }
 
+/** Streaming version of blockToJSON. Only the transaction list can be large,
+ *  so that is written one transaction at a time. */
+void blockToJSON(CJSONStreamWriter& writer, const CBlock& block, const CBlockIndex* blockindex, const CChainSnapshot& chain, bool txDetails = false)
+{
+    UniValue obj = blockToJSON(block, blockindex, chain, false);
+    const vector<string>& keys = obj.getKeys();
+    const vector<UniValue>& values = obj.getValues();
+
+    writer.BeginObject();
+    for (unsigned int i = 0; i < keys.size(); i++) {
+        if (keys[i] != "tx" || !txDetails) {
+            writer.Write(keys[i], values[i]);
+            continue;
+        }
+        writer.Key("tx");
+        writer.BeginArray();
+        BOOST_FOREACH (const CTransaction& tx, block.vtx) {
+            UniValue objTx(UniValue::VOBJ);
+            TxToJSON(tx, uint256(0), objTx, true, RPCSerializationFlags());
+            writer.Write(objTx);
+        }
+        writer.EndArray();
+    }
+    writer.EndObject();
+}
+
 UniValue getblockcount(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() != 0)
@@ -131,8 +196,7 @@ UniValue getblockcount(const UniValue& params, bool fHelp)
             "\nExamples:\n" +
             HelpExampleCli("getblockcount", "") + HelpExampleRpc("getblockcount", ""));
 
-    LOCK(cs_main);
-    return chainActive.Height();
+    return CChainSnapshot().Height();
 }
 
 UniValue getbestblockhash(const UniValue& params, bool fHelp)
@@ -146,8 +210,7 @@ UniValue getbestblockhash(const UniValue& params, bool fHelp)
             "\nExamples\n" +
             HelpExampleCli("getbestblockhash", "") + HelpExampleRpc("getbestblockhash", ""));
 
-    LOCK(cs_main);
-    return chainActive.Tip()->GetBlockHash().GetHex();
+    return CChainSnapshot().Tip()->GetBlockHash().GetHex();
 }
 
 UniValue getdifficulty(const UniValue& params, bool fHelp)
@@ -166,36 +229,59 @@ UniValue getdifficulty(const UniValue& params, bool fHelp)
 }
 
 
-UniValue mempoolToJSON(bool fVerbose = false)
+static UniValue mempoolEntryToJSON(const CTxMemPoolEntry& e)
+{
+    AssertLockHeld(mempool.cs);
+    UniValue info(UniValue::VOBJ);
+    info.push_back(Pair("size", (int)e.GetTxSize()));
+    info.push_back(Pair("fee", ValueFromAmount(e.GetFee())));
+    info.push_back(Pair("time", e.GetTime()));
+    info.push_back(Pair("height", (int)e.GetHeight()));
+    info.push_back(Pair("startingpriority", e.GetPriority(e.GetHeight())));
+    info.push_back(Pair("currentpriority", e.GetPriority(chainActive.Height())));
+    const CTransaction& tx = e.GetTx();
+    set<string> setDepends;
+    BOOST_FOREACH (const CTxIn& txin, tx.vin) {
+        if (mempool.exists(txin.prevout.hash))
+            setDepends.insert(txin.prevout.hash.ToString());
+    }
+
+    UniValue depends(UniValue::VARR);
+    BOOST_FOREACH(const string& dep, setDepends) {
+        depends.push_back(dep);
+    }
+
+    info.push_back(Pair("depends", depends));
+    return info;
+}
+
+/** Streaming version of mempoolToJSON, writes one entry at a time */
+void mempoolToJSON(CJSONStreamWriter& writer, bool fVerbose = false)
 {
     if (fVerbose) {
         LOCK(mempool.cs);
-        UniValue o(UniValue::VOBJ);
-        BOOST_FOREACH (const PAIRTYPE(uint256, CTxMemPoolEntry) & entry, mempool.mapTx) {
-            const uint256& hash = entry.first;
-            const CTxMemPoolEntry& e = entry.second;
-            UniValue info(UniValue::VOBJ);
-            info.push_back(Pair("size", (int)e.GetTxSize()));
-            info.push_back(Pair("fee", ValueFromAmount(e.GetFee())));
-            info.push_back(Pair("time", e.GetTime()));
-            info.push_back(Pair("height", (int)e.GetHeight()));
-            info.push_back(Pair("startingpriority", e.GetPriority(e.GetHeight())));
-            info.push_back(Pair("currentpriority", e.GetPriority(chainActive.Height())));
-            const CTransaction& tx = e.GetTx();
-            set<string> setDepends;
-            BOOST_FOREACH (const CTxIn& txin, tx.vin) {
-                if (mempool.exists(txin.prevout.hash))
-                    setDepends.insert(txin.prevout.hash.ToString());
-            }
+        writer.BeginObject();
+        BOOST_FOREACH (const PAIRTYPE(uint256, CTxMemPoolEntry) & entry, mempool.mapTx)
+            writer.Write(entry.first.ToString(), mempoolEntryToJSON(entry.second));
+        writer.EndObject();
+    } else {
+        vector<uint256> vtxid;
+        mempool.queryHashes(vtxid);
 
-            UniValue depends(UniValue::VARR);
-            BOOST_FOREACH(const string& dep, setDepends) {
-                depends.push_back(dep);
-            }
+        writer.BeginArray();
+        BOOST_FOREACH (const uint256& hash, vtxid)
+            writer.Write(hash.ToString());
+        writer.EndArray();
+    }
+}
 
-            info.push_back(Pair("depends", depends));
-            o.push_back(Pair(hash.ToString(), info));
-        }
+UniValue mempoolToJSON(bool fVerbose = false)
+{
+    if (fVerbose) {
+        LOCK(mempool.cs);
+        UniValue o(UniValue::VOBJ);
+        BOOST_FOREACH (const PAIRTYPE(uint256, CTxMemPoolEntry) & entry, mempool.mapTx)
+            o.push_back(Pair(entry.first.ToString(), mempoolEntryToJSON(entry.second)));
         return o;
     } else {
         vector<uint256> vtxid;
@@ -261,14 +347,13 @@ UniValue getblockhash(const UniValue& params, bool fHelp)
             "\nExamples:\n" +
             HelpExampleCli("getblockhash", "1000") + HelpExampleRpc("getblockhash", "1000"));
 
-    LOCK(cs_main);
+    CChainSnapshot chain;
 
     int nHeight = params[0].get_int();
-    if (nHeight < 0 || nHeight > chainActive.Height())
+    if (nHeight < 0 || nHeight > chain.Height())
         throw JSONRPCError(RPC_INVALID_PARAMETER, "Block height out of range");
 
-    CBlockIndex* pblockindex = chainActive[nHeight];
-    return pblockindex->GetBlockHash().GetHex();
+    return chain[nHeight]->GetBlockHash().GetHex();
 }
 
 UniValue getblock(const UniValue& params, bool fHelp)
@@ -318,7 +403,7 @@ UniValue getblock(const UniValue& params, bool fHelp)
             "\nExamples:\n" +
             HelpExampleCli("getblock", "\"00000000000fd08c2fb661d2fcb0d49abb3a91e5f27082ce64feed3b4dede2e2\"") + HelpExampleRpc("getblock", "\"00000000000fd08c2fb661d2fcb0d49abb3a91e5f27082ce64feed3b4dede2e2\""));
 
-    LOCK(cs_main);
+    CChainSnapshot chain;
 
     std::string strHash = params[0].get_str();
     uint256 hash(strHash);
@@ -327,11 +412,11 @@ UniValue getblock(const UniValue& params, bool fHelp)
     if (params.size() > 1)
         fVerbose = params[1].get_bool();
 
-    if (mapBlockIndex.count(hash) == 0)
+    const CBlockIndex* pblockindex = chain.Lookup(hash);
+    if (!pblockindex)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
 
     CBlock block;
-    CBlockIndex* pblockindex = mapBlockIndex[hash];
 
     if (!ReadBlockFromDisk(block, pblockindex))
         throw JSONRPCError(RPC_INTERNAL_ERROR, "Can't read block from disk");
@@ -343,7 +428,7 @@ UniValue getblock(const UniValue& params, bool fHelp)
         return strHex;
     }
 
-    return blockToJSON(block, pblockindex);
+    return blockToJSON(block, pblockindex, chain);
 }
 
 UniValue getblockheader(const UniValue& params, bool fHelp)
@@ -376,6 +461,8 @@ UniValue getblockheader(const UniValue& params, bool fHelp)
             "\nExamples:\n" +
             HelpExampleCli("getblockheader", "\"00000000000fd08c2fb661d2fcb0d49abb3a91e5f27082ce64feed3b4dede2e2\"") + HelpExampleRpc("getblockheader", "\"00000000000fd08c2fb661d2fcb0d49abb3a91e5f27082ce64feed3b4dede2e2\""));
 
+    CChainSnapshot chain;
+
     std::string strHash = params[0].get_str();
     uint256 hash(strHash);
 
@@ -383,11 +470,10 @@ UniValue getblockheader(const UniValue& params, bool fHelp)
     if (params.size() > 1)
         fVerbose = params[1].get_bool();
 
-    if (mapBlockIndex.count(hash) == 0)
+    const CBlockIndex* pblockindex = chain.Lookup(hash);
+    if (!pblockindex)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
 
-    CBlockIndex* pblockindex = mapBlockIndex[hash];
-
     if (!fVerbose) {
         CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
         ssBlock << pblockindex->GetBlockHeader();
@@ -395,17 +481,22 @@ UniValue getblockheader(const UniValue& params, bool fHelp)
         return strHex;
     }
 
-    return blockheaderToJSON(pblockindex);
+    return blockheaderToJSON(pblockindex, chain);
 }
 
 UniValue gettxoutsetinfo(const UniValue& params, bool fHelp)
 {
-    if (fHelp || params.size() != 0)
+    if (fHelp || params.size() > 2)
         throw runtime_error(
-            "gettxoutsetinfo\n"
+            "gettxoutsetinfo ( \"hash_type\" hash_or_height )\n"
             "\nReturns statistics about the unspent transaction output set.\n"
-            "Note this call may take some time.\n"
-            "\nResult:\n"
+            "With -coinstatsindex the statistics are read from the index, for any block of the active chain.\n"
+            "Otherwise the whole set is scanned, which may take some time and only works for the current tip.\n"
+            "\nArguments:\n"
+            "1. \"hash_type\"      (string, optional) \"muhash\" (needs -coinstatsindex) or \"hash_serialized\" (scans the set).\n"
+            "                     Defaults to muhash when -coinstatsindex is set, hash_serialized otherwise.\n"
+            "2. hash_or_height   (string or numeric, optional) The block hash or height to report on (default: the tip)\n"
+            "\nResult (hash_serialized):\n"
             "{\n"
             "  \"height\":n,     (numeric) The current block height (index)\n"
             "  \"bestblock\": \"hex\",   (string) the best block hash hex\n"
@@ -415,13 +506,79 @@ UniValue gettxoutsetinfo(const UniValue& params, bool fHelp)
             "  \"hash_serialized\": \"hash\",   (string) The serialized hash\n"
             "  \"total_amount\": x.xxx          (numeric) The total amount\n"
             "}\n"
+            "\nResult (muhash):\n"
+            "{\n"
+            "  \"height\":n,     (numeric) The block height (index)\n"
+            "  \"bestblock\": \"hex\",   (string) the block hash hex\n"
+            "  \"txouts\": n,            (numeric) The number of unspent outputs\n"
+            "  \"bogosize\": n,          (numeric) A database independent size estimate of the set\n"
+            "  \"muhash\": \"hash\",       (string) The MuHash3072 set hash of the unspent outputs\n"
+            "  \"total_amount\": x.xxx   (numeric) The total amount\n"
+            "}\n"
             "\nExamples:\n" +
-            HelpExampleCli("gettxoutsetinfo", "") + HelpExampleRpc("gettxoutsetinfo", ""));
+            HelpExampleCli("gettxoutsetinfo", "") + HelpExampleCli("gettxoutsetinfo", "\"muhash\" 100000") +
+            HelpExampleRpc("gettxoutsetinfo", ""));
 
-    LOCK(cs_main);
+    std::string strHashType = pcoinstatsindex ? "muhash" : "hash_serialized";
+    if (params.size() > 0 && !params[0].isNull())
+        strHashType = params[0].get_str();
+    if (strHashType != "muhash" && strHashType != "hash_serialized")
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "hash_type must be muhash or hash_serialized");
+
+    const CBlockIndex* pindex = NULL;
+    {
+        LOCK(cs_main);
+        if (params.size() > 1) {
+            // trbo-cli passes heights as strings too
+            int nHeight = -1;
+            if (params[1].isNum() || (params[1].isStr() && params[1].get_str().size() != 64 && ParseInt32(params[1].get_str(), &nHeight))) {
+                if (params[1].isNum())
+                    nHeight = params[1].get_int();
+                if (nHeight < 0 || nHeight > chainActive.Height())
+                    throw JSONRPCError(RPC_INVALID_PARAMETER, "Block height out of range");
+                pindex = chainActive[nHeight];
+            } else {
+                uint256 hash = ParseHashV(params[1], "hash_or_height");
+                BlockMap::iterator mi = mapBlockIndex.find(hash);
+                if (mi == mapBlockIndex.end())
+                    throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+                if (!chainActive.Contains(mi->second))
+                    throw JSONRPCError(RPC_INVALID_PARAMETER, "Block is not in the active chain");
+                pindex = mi->second;
+            }
+        } else {
+            pindex = chainActive.Tip();
+        }
+    }
 
     UniValue ret(UniValue::VOBJ);
 
+    if (strHashType == "muhash") {
+        if (!pcoinstatsindex)
+            throw JSONRPCError(RPC_MISC_ERROR, "muhash needs -coinstatsindex");
+        CCoinStatsIndexEntry entry;
+        if (!pcoinstatsindex->LookupStats(pindex, entry)) {
+            std::string strStalled = pcoinstatsindex->GetStalledReason();
+            if (!strStalled.empty())
+                throw JSONRPCError(RPC_MISC_ERROR, "Coin stats index " + strStalled);
+            throw JSONRPCError(RPC_MISC_ERROR, "Coin stats of this block are not indexed yet");
+        }
+
+        uint256 hashMuHash;
+        entry.muhash.Finalize(hashMuHash.begin());
+        ret.push_back(Pair("height", pindex->nHeight));
+        ret.push_back(Pair("bestblock", pindex->GetBlockHash().GetHex()));
+        ret.push_back(Pair("txouts", (int64_t)entry.nTransactionOutputs));
+        ret.push_back(Pair("bogosize", (int64_t)entry.nBogoSize));
+        ret.push_back(Pair("muhash", hashMuHash.GetHex()));
+        ret.push_back(Pair("total_amount", ValueFromAmount(entry.nTotalAmount)));
+        return ret;
+    }
+
+    LOCK(cs_main);
+    if (pindex != chainActive.Tip())
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "hash_serialized is only available for the current tip, use muhash with -coinstatsindex");
+
     CCoinsStats stats;
     FlushStateToDisk();
     if (pcoinsTip->GetStats(stats)) {
@@ -436,6 +593,44 @@ UniValue gettxoutsetinfo(const UniValue& params, bool fHelp)
     return ret;
 }
 
+UniValue dumpsnapshot(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 1)
+        throw runtime_error(
+            "dumpsnapshot \"filename\"\n"
+            "\nWrite the unspent transaction output set, the block index and the masternode caches to a file\n"
+            "that a new node can start from with -loadsnapshot. Block validation continues while the file is written.\n"
+            "\nArguments:\n"
+            "1. \"filename\"    (string, required) The snapshot file, relative paths are taken from the data directory\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"filename\": \"path\",       (string) The file written\n"
+            "  \"height\":n,                (numeric) The height of the snapshot block\n"
+            "  \"bestblock\": \"hex\",       (string) The snapshot block hash hex\n"
+            "  \"transactions\": n,         (numeric) The number of transactions with unspent outputs\n"
+            "  \"hash_serialized\": \"hash\" (string) The UTXO set hash, as gettxoutsetinfo reports it at this block\n"
+            "}\n"
+            "\nExamples:\n" +
+            HelpExampleCli("dumpsnapshot", "\"trbo.snapshot\"") + HelpExampleRpc("dumpsnapshot", "\"trbo.snapshot\""));
+
+    boost::filesystem::path path(params[0].get_str());
+    if (!path.is_complete())
+        path = GetDataDir() / path;
+
+    CChainStateSnapshotInfo info;
+    std::string strError;
+    if (!DumpChainStateSnapshot(path, info, strError))
+        throw JSONRPCError(RPC_MISC_ERROR, "Unable to write snapshot: " + strError);
+
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("filename", path.string()));
+    ret.push_back(Pair("height", info.nHeight));
+    ret.push_back(Pair("bestblock", info.hashBlock.GetHex()));
+    ret.push_back(Pair("transactions", (int64_t)info.nTransactions));
+    ret.push_back(Pair("hash_serialized", info.hashSerialized.GetHex()));
+    return ret;
+}
+
 UniValue gettxout(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() < 2 || params.size() > 3)
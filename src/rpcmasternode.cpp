@@ -12,6 +12,7 @@
 #include "masternodeconfig.h"
 #include "masternodeman.h"
 #include "rpcserver.h"
+#include "swifttx.h"
 #include "utilmoneystr.h"
 
 #ifdef ENABLE_WALLET
@@ -335,6 +336,46 @@ UniValue getmasternodecount (const UniValue& params, bool fHelp)
     return obj;
 }
 
+UniValue getswifttxinfo (const UniValue& params, bool fHelp)
+{
+    if (fHelp || (params.size() > 0))
+        throw runtime_error(
+            "getswifttxinfo\n"
+            "\nGet the state of SwiftX transaction locks\n"
+
+            "\nResult:\n"
+            "{\n"
+            "  \"requests\": n,          (numeric) Accepted lock requests\n"
+            "  \"rejected\": n,          (numeric) Rejected lock requests\n"
+            "  \"locks\": n,             (numeric) Transaction locks being tracked\n"
+            "  \"votes\": n,             (numeric) Consensus votes being tracked\n"
+            "  \"lockedinputs\": n,      (numeric) Inputs claimed by locks\n"
+            "  \"unknownvoters\": n,     (numeric) Masternodes voting for unknown transactions\n"
+            "  \"completed\": n,         (numeric) Locks completed since startup\n"
+            "  \"expired\": n,           (numeric) Locks expired since startup\n"
+            "  \"avgvotelatency\": n,    (numeric) Average ms from lock creation to a vote arriving\n"
+            "  \"avglocklatency\": n     (numeric) Average ms from lock creation to completion\n"
+            "}\n"
+            "\nExamples:\n" +
+            HelpExampleCli("getswifttxinfo", "") + HelpExampleRpc("getswifttxinfo", ""));
+
+    CTxLockStats stats = txLockManager.GetStats();
+
+    UniValue obj(UniValue::VOBJ);
+    obj.push_back(Pair("requests", (uint64_t)stats.nRequests));
+    obj.push_back(Pair("rejected", (uint64_t)stats.nRejected));
+    obj.push_back(Pair("locks", (uint64_t)stats.nLocks));
+    obj.push_back(Pair("votes", (uint64_t)stats.nVotes));
+    obj.push_back(Pair("lockedinputs", (uint64_t)stats.nLockedInputs));
+    obj.push_back(Pair("unknownvoters", (uint64_t)stats.nUnknownVoters));
+    obj.push_back(Pair("completed", stats.nCompleted));
+    obj.push_back(Pair("expired", stats.nExpired));
+    obj.push_back(Pair("avgvotelatency", stats.nAvgVoteLatency));
+    obj.push_back(Pair("avglocklatency", stats.nAvgLockLatency));
+
+    return obj;
+}
+
 UniValue masternodecurrent (const UniValue& params, bool fHelp)
 {
     if (fHelp || (params.size() != 0))
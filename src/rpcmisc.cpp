@@ -11,6 +11,7 @@
 #include "init.h"
 #include "main.h"
 #include "masternode-sync.h"
+#include "masternode-tasks.h"
 #include "net.h"
 #include "netbase.h"
 #include "rpcserver.h"
@@ -63,6 +64,7 @@ UniValue getinfo(const UniValue& params, bool fHelp)
             "  \"proxy\": \"host:port\",     (string, optional) the proxy used by the server\n"
             "  \"difficulty\": xxxxxx,       (numeric) the current difficulty\n"
             "  \"testnet\": true|false,      (boolean) if the server is using testnet or not\n"
+            "  \"logmessagesdropped\": xxxx,  (numeric) -debug messages dropped because debug.log was not written fast enough\n"
             "  \"moneysupply\" : \"supply\"       (numeric) The money supply when this block was added to the blockchain\n"
             "  \"keypoololdest\": xxxxxx,    (numeric) the timestamp (seconds since GMT epoch) of the oldest pre-generated key in the key pool\n"
             "  \"keypoolsize\": xxxx,        (numeric) how many new keys are pre-generated\n"
@@ -99,6 +101,7 @@ UniValue getinfo(const UniValue& params, bool fHelp)
     obj.push_back(Pair("proxy", (proxy.IsValid() ? proxy.proxy.ToStringIPPort() : string())));
     obj.push_back(Pair("difficulty", (double)GetDifficulty()));
     obj.push_back(Pair("testnet", Params().TestnetToBeDeprecatedFieldRPC()));
+    obj.push_back(Pair("logmessagesdropped", GetLogMessagesDropped()));
 
     // During inital block verification chainActive.Tip() might be not yet initialized
     if (chainActive.Tip() == NULL) {
@@ -134,13 +137,13 @@ UniValue mnsync(const UniValue& params, bool fHelp)
     if (params.size() == 1)
         strMode = params[0].get_str();
 
-    if (fHelp || params.size() != 1 || (strMode != "status" && strMode != "reset")) {
+    if (fHelp || params.size() != 1 || (strMode != "status" && strMode != "tasks" && strMode != "reset")) {
         throw runtime_error(
-            "mnsync \"status|reset\"\n"
+            "mnsync \"status|tasks|reset\"\n"
             "\nReturns the sync status or resets sync.\n"
 
             "\nArguments:\n"
-            "1. \"mode\"    (string, required) either 'status' or 'reset'\n"
+            "1. \"mode\"    (string, required) either 'status', 'tasks' or 'reset'\n"
 
             "\nResult ('status' mode):\n"
             "{\n"
@@ -162,6 +165,23 @@ UniValue mnsync(const UniValue& params, bool fHelp)
             "  \"RequestedMasternodeAttempt\": n, (numeric) Status code of last sync attempt\n"
             "}\n"
 
+            "\nResult ('tasks' mode):\n"
+            "[\n"
+            "  {\n"
+            "    \"name\": \"name\",          (string) Name of the periodic masternode task\n"
+            "    \"interval\": n,           (numeric) Seconds between periodic runs\n"
+            "    \"runs\": n,               (numeric) Number of runs\n"
+            "    \"triggers\": n,           (numeric) Number of events that asked for a run\n"
+            "    \"pending\": true|false,   (boolean) 'true' if a run for an event is waiting\n"
+            "    \"lastrun\": xxxx,         (numeric) Timestamp of the last run\n"
+            "    \"timelast\": n,           (numeric) Run time of the last run, in microseconds\n"
+            "    \"timeavg\": n,            (numeric) Average run time, in microseconds\n"
+            "    \"timemax\": n,            (numeric) Longest run time, in microseconds\n"
+            "    \"delayavg\": n,           (numeric) Average time runs started after they were due, in microseconds\n"
+            "    \"delaymax\": n            (numeric) Longest time a run started after it was due, in microseconds\n"
+            "  }, ...\n"
+            "]\n"
+
             "\nResult ('reset' mode):\n"
             "\"status\"     (string) 'success'\n"
             "\nExamples:\n" +
@@ -191,6 +211,26 @@ UniValue mnsync(const UniValue& params, bool fHelp)
         return obj;
     }
 
+    if (strMode == "tasks") {
+        UniValue ret(UniValue::VARR);
+        BOOST_FOREACH (const CMasternodeTaskStats& stats, GetMasternodeTaskStats()) {
+            UniValue obj(UniValue::VOBJ);
+            obj.push_back(Pair("name", stats.strName));
+            obj.push_back(Pair("interval", stats.nInterval));
+            obj.push_back(Pair("runs", (uint64_t)stats.nRuns));
+            obj.push_back(Pair("triggers", (uint64_t)stats.nTriggers));
+            obj.push_back(Pair("pending", stats.fTriggered));
+            obj.push_back(Pair("lastrun", stats.nLastRun));
+            obj.push_back(Pair("timelast", stats.nTimeLast));
+            obj.push_back(Pair("timeavg", stats.nRuns ? stats.nTimeTotal / (int64_t)stats.nRuns : 0));
+            obj.push_back(Pair("timemax", stats.nTimeMax));
+            obj.push_back(Pair("delayavg", stats.nRuns ? stats.nDelayTotal / (int64_t)stats.nRuns : 0));
+            obj.push_back(Pair("delaymax", stats.nDelayMax));
+            ret.push_back(obj);
+        }
+        return ret;
+    }
+
     if (strMode == "reset") {
         masternodeSync.Reset();
         return "success";
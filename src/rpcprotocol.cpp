@@ -58,6 +58,108 @@ string JSONRPCReply(const UniValue& result, const UniValue& error, const UniValu
     return reply.write() + "\n";
 }
 
+CJSONStreamWriter::CJSONStreamWriter(const Sink& sinkIn, size_t nChunkSizeIn)
+    : sink(sinkIn), nChunkSize(nChunkSizeIn), fAfterKey(false)
+{
+}
+
+void CJSONStreamWriter::Separate()
+{
+    if (fAfterKey) {
+        fAfterKey = false;
+        return;
+    }
+    if (!vEmpty.empty()) {
+        if (!vEmpty.back())
+            Append(",");
+        vEmpty.back() = false;
+    }
+}
+
+void CJSONStreamWriter::Append(const string& str)
+{
+    strBuffer += str;
+    if (strBuffer.size() >= nChunkSize) {
+        sink(strBuffer);
+        strBuffer.clear();
+    }
+}
+
+void CJSONStreamWriter::BeginObject()
+{
+    Separate();
+    Append("{");
+    vEmpty.push_back(true);
+}
+
+void CJSONStreamWriter::EndObject()
+{
+    assert(!vEmpty.empty());
+    vEmpty.pop_back();
+    Append("}");
+}
+
+void CJSONStreamWriter::BeginArray()
+{
+    Separate();
+    Append("[");
+    vEmpty.push_back(true);
+}
+
+void CJSONStreamWriter::EndArray()
+{
+    assert(!vEmpty.empty());
+    vEmpty.pop_back();
+    Append("]");
+}
+
+void CJSONStreamWriter::Key(const string& strKey)
+{
+    Separate();
+    Append(UniValue(strKey).write());
+    Append(":");
+    fAfterKey = true;
+}
+
+void CJSONStreamWriter::Write(const UniValue& value)
+{
+    if (value.isObject()) {
+        const vector<string>& keys = value.getKeys();
+        const vector<UniValue>& values = value.getValues();
+        BeginObject();
+        for (unsigned int i = 0; i < keys.size(); i++)
+            Write(keys[i], values[i]);
+        EndObject();
+    } else if (value.isArray()) {
+        const vector<UniValue>& values = value.getValues();
+        BeginArray();
+        for (unsigned int i = 0; i < values.size(); i++)
+            Write(values[i]);
+        EndArray();
+    } else {
+        Separate();
+        Append(value.write());
+    }
+}
+
+void CJSONStreamWriter::Finish()
+{
+    assert(vEmpty.empty());
+    strBuffer += "\n";
+    sink(strBuffer);
+    strBuffer.clear();
+}
+
+void JSONRPCWriteReply(CJSONStreamWriter& writer, const UniValue& result, const UniValue& error, const UniValue& id)
+{
+    writer.BeginObject();
+    writer.Write("result", error.isNull() ? result : NullUniValue);
+    writer.Write("error", error);
+    writer.Write("id", id);
+    writer.EndObject();
+    writer.Finish();
+}
+
 UniValue JSONRPCError(int code, const string& message)
 {
     UniValue error(UniValue::VOBJ);
@@ -10,7 +10,9 @@
 #include <map>
 #include <stdint.h>
 #include <string>
+#include <vector>
 #include <boost/filesystem.hpp>
+#include <boost/function.hpp>
 
 #include <univalue.h>
 
@@ -79,6 +81,51 @@ UniValue JSONRPCReplyObj(const UniValue& result, const UniValue& error, const Un
 std::string JSONRPCReply(const UniValue& result, const UniValue& error, const UniValue& id);
 UniValue JSONRPCError(int code, const std::string& message);
 
+/**
+ * Writes a JSON document piece by piece instead of into one string. Large
+ * containers can be opened and closed explicitly so they never have to exist
+ * as a UniValue, and values that do are walked rather than written whole.
+ * The output is handed to the sink in pieces of about nChunkSize bytes and is
+ * identical to UniValue::write() without indentation.
+ */
+class CJSONStreamWriter
+{
+public:
+    typedef boost::function<void(const std::string&)> Sink;
+
+    explicit CJSONStreamWriter(const Sink& sinkIn, size_t nChunkSizeIn = 64 * 1024);
+
+    void BeginObject();
+    void EndObject();
+    void BeginArray();
+    void EndArray();
+
+    /** Start a member of the enclosing object, its value is written next */
+    void Key(const std::string& strKey);
+    void Write(const UniValue& value);
+    void Write(const std::string& strKey, const UniValue& value)
+    {
+        Key(strKey);
+        Write(value);
+    }
+
+    /** End the document with a newline and pass what is left to the sink */
+    void Finish();
+
+private:
+    Sink sink;
+    size_t nChunkSize;
+    std::string strBuffer;
+    std::vector<bool> vEmpty; //!< for each open container, whether nothing was written into it yet
+    bool fAfterKey;
+
+    void Separate();
+    void Append(const std::string& str);
+};
+
+/** Write a JSON-RPC reply, the streaming counterpart of JSONRPCReply */
+void JSONRPCWriteReply(CJSONStreamWriter& writer, const UniValue& result, const UniValue& error, const UniValue& id);
+
 /** Get name of RPC authentication cookie file */
 boost::filesystem::path GetAuthCookieFile();
 /** Generate a new RPC authentication cookie and write it to disk */
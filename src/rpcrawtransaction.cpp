@@ -255,8 +255,6 @@ UniValue getrawtransaction(const UniValue& params, bool fHelp)
             "\nExamples:\n" +
             HelpExampleCli("getrawtransaction", "\"mytxid\"") + HelpExampleCli("getrawtransaction", "\"mytxid\" 1") + HelpExampleRpc("getrawtransaction", "\"mytxid\", 1"));
 
-    LOCK(cs_main);
-
     uint256 hash = ParseHashV(params[0], "parameter 1");
 
     bool fVerbose = false;
@@ -273,6 +271,8 @@ UniValue getrawtransaction(const UniValue& params, bool fHelp)
         return strHex;
     }
 
+    // Only the confirmation count needs the chain, the lookup itself does not
+    LOCK(cs_main);
     UniValue result(UniValue::VOBJ);
     TxToJSON(tx, hashBlock, result, true, RPCSerializationFlags());
     return result;
@@ -901,7 +901,7 @@ UniValue sendrawtransaction(const UniValue& params, bool fHelp)
     if (!fHaveMempool && !fHaveChain) {
         // push to local node and sync with wallets
         if (fSwiftX) {
-            mapTxLockReq.insert(make_pair(tx.GetHash(), tx));
+            txLockManager.AddRequest(tx);
             CreateNewLock(tx);
             RelayTransactionLockReq(tx, true);
         }
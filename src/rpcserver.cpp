@@ -9,6 +9,7 @@
 #include "rpcserver.h"
 
 #include "base58.h"
+#include "httpserver.h"
 #include "init.h"
 #include "main.h"
 #include "random.h"
@@ -55,6 +56,52 @@ static struct CRPCSignals
     boost::signals2::signal<void (const CRPCCommand&)> PostCommand;
 } g_rpcSignals;
 
+/** Call counters and latency of one RPC method */
+struct CRPCMethodStats {
+    uint64_t nCalls;
+    uint64_t nErrors;
+    int nInFlight;
+    int64_t nTotalMicros;
+    int64_t nMaxMicros;
+
+    CRPCMethodStats() : nCalls(0), nErrors(0), nInFlight(0), nTotalMicros(0), nMaxMicros(0) {}
+};
+
+static CCriticalSection cs_rpcStats;
+static std::map<std::string, CRPCMethodStats> mapRPCStats;
+
+/** Tracks one call for the per-method statistics reported by getrpcinfo.
+ *  Calls that leave without Finish() are counted as errors. */
+class CRPCCallTracker
+{
+private:
+    const std::string& strMethod;
+    int64_t nStart;
+    bool fSuccess;
+
+public:
+    CRPCCallTracker(const std::string& strMethodIn) : strMethod(strMethodIn), nStart(GetTimeMicros()), fSuccess(false)
+    {
+        LOCK(cs_rpcStats);
+        mapRPCStats[strMethod].nInFlight++;
+    }
+
+    ~CRPCCallTracker()
+    {
+        int64_t nElapsed = GetTimeMicros() - nStart;
+        LOCK(cs_rpcStats);
+        CRPCMethodStats& stats = mapRPCStats[strMethod];
+        stats.nInFlight--;
+        stats.nCalls++;
+        if (!fSuccess)
+            stats.nErrors++;
+        stats.nTotalMicros += nElapsed;
+        stats.nMaxMicros = std::max(stats.nMaxMicros, nElapsed);
+    }
+
+    void Finish() { fSuccess = true; }
+};
+
 void RPCServer::OnStarted(boost::function<void ()> slot)
 {
     g_rpcSignals.Started.connect(slot);
@@ -275,171 +322,220 @@ UniValue stop(const UniValue& params, bool fHelp)
     return "TRBO server stopping";
 }
 
+UniValue getrpcinfo(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 0)
+        throw runtime_error(
+            "getrpcinfo\n"
+            "\nReturns call counts and latency of every RPC method called since startup.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"workers\": n,             (numeric) Number of threads serving RPC requests and batches\n"
+            "  \"methods\": {\n"
+            "    \"method\": {            (string) The method name\n"
+            "      \"calls\": n,          (numeric) Number of completed calls\n"
+            "      \"errors\": n,         (numeric) Number of calls that returned an error\n"
+            "      \"in_flight\": n,      (numeric) Number of calls currently executing\n"
+            "      \"total_ms\": x.xxx,   (numeric) Total time spent in completed calls\n"
+            "      \"avg_ms\": x.xxx,     (numeric) Average time of a completed call\n"
+            "      \"max_ms\": x.xxx      (numeric) Slowest completed call\n"
+            "    }, ...\n"
+            "  }\n"
+            "}\n"
+            "\nExamples:\n" +
+            HelpExampleCli("getrpcinfo", "") + HelpExampleRpc("getrpcinfo", ""));
+
+    UniValue methods(UniValue::VOBJ);
+    {
+        LOCK(cs_rpcStats);
+        for (std::map<std::string, CRPCMethodStats>::const_iterator it = mapRPCStats.begin(); it != mapRPCStats.end(); ++it) {
+            const CRPCMethodStats& stats = it->second;
+            UniValue entry(UniValue::VOBJ);
+            entry.push_back(Pair("calls", (uint64_t)stats.nCalls));
+            entry.push_back(Pair("errors", (uint64_t)stats.nErrors));
+            entry.push_back(Pair("in_flight", stats.nInFlight));
+            entry.push_back(Pair("total_ms", stats.nTotalMicros / 1000.0));
+            entry.push_back(Pair("avg_ms", stats.nCalls ? stats.nTotalMicros / 1000.0 / stats.nCalls : 0.0));
+            entry.push_back(Pair("max_ms", stats.nMaxMicros / 1000.0));
+            methods.push_back(Pair(it->first, entry));
+        }
+    }
+
+    UniValue result(UniValue::VOBJ);
+    result.push_back(Pair("workers", HTTPWorkerThreads()));
+    result.push_back(Pair("methods", methods));
+    return result;
+}
+
 
 /**
  * Call Table
  */
 static const CRPCCommand vRPCCommands[] =
     {
-        //  category              name                      actor (function)         okSafeMode threadSafe reqWallet
-        //  --------------------- ------------------------  -----------------------  ---------- ---------- ---------
+        //  category              name                      actor (function)         okSafeMode threadSafe reqWallet readOnly
+        //  --------------------- ------------------------  -----------------------  ---------- ---------- --------- --------
         /* Overall control/query calls */
-        {"control", "getinfo", &getinfo, true, false, false}, /* uses wallet if enabled */
-        {"control", "help", &help, true, true, false},
-        {"control", "stop", &stop, true, true, false},
+        {"control", "getinfo", &getinfo, true, false, false, true}, /* uses wallet if enabled */
+        {"control", "help", &help, true, true, false, true},
+        {"control", "stop", &stop, true, true, false, false},
+        {"control", "getrpcinfo", &getrpcinfo, true, true, false, true},
 
         /* P2P networking */
-        {"network", "getnetworkinfo", &getnetworkinfo, true, false, false},
-        {"network", "addnode", &addnode, true, true, false},
-        {"network", "disconnectnode", &disconnectnode, true, true, false},
-        {"network", "getaddednodeinfo", &getaddednodeinfo, true, true, false},
-        {"network", "getconnectioncount", &getconnectioncount, true, false, false},
-        {"network", "getnettotals", &getnettotals, true, true, false},
-        {"network", "getpeerinfo", &getpeerinfo, true, false, false},
-        {"network", "ping", &ping, true, false, false},
-        {"network", "setban", &setban, true, false, false},
-        {"network", "listbanned", &listbanned, true, false, false},
-        {"network", "clearbanned", &clearbanned, true, false, false},
+        {"network", "getnetworkinfo", &getnetworkinfo, true, false, false, true},
+        {"network", "addnode", &addnode, true, true, false, false},
+        {"network", "disconnectnode", &disconnectnode, true, true, false, false},
+        {"network", "getaddednodeinfo", &getaddednodeinfo, true, true, false, true},
+        {"network", "getconnectioncount", &getconnectioncount, true, false, false, true},
+        {"network", "getnettotals", &getnettotals, true, true, false, true},
+        {"network", "getpeerinfo", &getpeerinfo, true, false, false, true},
+        {"network", "ping", &ping, true, false, false, false},
+        {"network", "setban", &setban, true, false, false, false},
+        {"network", "listbanned", &listbanned, true, false, false, true},
+        {"network", "clearbanned", &clearbanned, true, false, false, false},
 
         /* Block chain and UTXO */
-        {"blockchain", "getblockchaininfo", &getblockchaininfo, true, false, false},
-        {"blockchain", "getbestblockhash", &getbestblockhash, true, false, false},
-        {"blockchain", "getblockcount", &getblockcount, true, false, false},
-        {"blockchain", "getblock", &getblock, true, false, false},
-        {"blockchain", "getblockhash", &getblockhash, true, false, false},
-        {"blockchain", "getblockheader", &getblockheader, false, false, false},
-        {"blockchain", "getchaintips", &getchaintips, true, false, false},
-        {"blockchain", "getdifficulty", &getdifficulty, true, false, false},
-        {"blockchain", "getmempoolinfo", &getmempoolinfo, true, true, false},
-        {"blockchain", "getrawmempool", &getrawmempool, true, false, false},
-        {"blockchain", "gettxout", &gettxout, true, false, false},
-        {"blockchain", "gettxoutsetinfo", &gettxoutsetinfo, true, false, false},
-        {"blockchain", "invalidateblock", &invalidateblock, true, true, false},
-        {"blockchain", "reconsiderblock", &reconsiderblock, true, true, false},
-        {"blockchain", "verifychain", &verifychain, true, false, false},
+        {"blockchain", "getblockchaininfo", &getblockchaininfo, true, false, false, true},
+        {"blockchain", "getbestblockhash", &getbestblockhash, true, false, false, true},
+        {"blockchain", "getblockcount", &getblockcount, true, false, false, true},
+        {"blockchain", "getblock", &getblock, true, false, false, true},
+        {"blockchain", "getblockhash", &getblockhash, true, false, false, true},
+        {"blockchain", "getblockheader", &getblockheader, false, false, false, true},
+        {"blockchain", "getchaintips", &getchaintips, true, false, false, true},
+        {"blockchain", "getdifficulty", &getdifficulty, true, false, false, true},
+        {"blockchain", "getmempoolinfo", &getmempoolinfo, true, true, false, true},
+        {"blockchain", "getrawmempool", &getrawmempool, true, false, false, true},
+        {"blockchain", "gettxout", &gettxout, true, false, false, true},
+        {"blockchain", "gettxoutsetinfo", &gettxoutsetinfo, true, false, false, true},
+        {"blockchain", "dumpsnapshot", &dumpsnapshot, true, true, false, false},
+        {"blockchain", "invalidateblock", &invalidateblock, true, true, false, false},
+        {"blockchain", "reconsiderblock", &reconsiderblock, true, true, false, false},
+        {"blockchain", "verifychain", &verifychain, true, false, false, false},
 
         /* Mining */
-        {"mining", "getblocktemplate", &getblocktemplate, true, false, false},
-        {"mining", "getmininginfo", &getmininginfo, true, false, false},
-        {"mining", "getnetworkhashps", &getnetworkhashps, true, false, false},
-        {"mining", "prioritisetransaction", &prioritisetransaction, true, false, false},
-        {"mining", "submitblock", &submitblock, true, true, false},
-        {"mining", "reservebalance", &reservebalance, true, true, false},
+        {"mining", "getblocktemplate", &getblocktemplate, true, false, false, false},
+        {"mining", "getmininginfo", &getmininginfo, true, false, false, true},
+        {"mining", "getnetworkhashps", &getnetworkhashps, true, false, false, true},
+        {"mining", "prioritisetransaction", &prioritisetransaction, true, false, false, false},
+        {"mining", "submitblock", &submitblock, true, true, false, false},
+        {"mining", "reservebalance", &reservebalance, true, true, false, false},
 
 #ifdef ENABLE_WALLET
         /* Coin generation */
-        {"generating", "getgenerate", &getgenerate, true, false, false},
-        {"generating", "gethashespersec", &gethashespersec, true, false, false},
-        {"generating", "setgenerate", &setgenerate, true, true, false},
+        {"generating", "getgenerate", &getgenerate, true, false, false, true},
+        {"generating", "gethashespersec", &gethashespersec, true, false, false, true},
+        {"generating", "setgenerate", &setgenerate, true, true, false, false},
 #endif
 
         /* Raw transactions */
-        {"rawtransactions", "createrawtransaction", &createrawtransaction, true, false, false},
-        {"rawtransactions", "decoderawtransaction", &decoderawtransaction, true, false, false},
-        {"rawtransactions", "decodescript", &decodescript, true, false, false},
-        {"rawtransactions", "getrawtransaction", &getrawtransaction, true, false, false},
-        {"rawtransactions", "searchrawtransactions", &searchrawtransactions, true, false, false},
-        {"rawtransactions", "sendrawtransaction", &sendrawtransaction, false, false, false},
-        {"rawtransactions", "signrawtransaction", &signrawtransaction, false, false, false}, /* uses wallet if enabled */
+        {"rawtransactions", "createrawtransaction", &createrawtransaction, true, false, false, true},
+        {"rawtransactions", "decoderawtransaction", &decoderawtransaction, true, false, false, true},
+        {"rawtransactions", "decodescript", &decodescript, true, false, false, true},
+        {"rawtransactions", "getrawtransaction", &getrawtransaction, true, false, false, true},
+        {"rawtransactions", "searchrawtransactions", &searchrawtransactions, true, false, false, true},
+        {"rawtransactions", "sendrawtransaction", &sendrawtransaction, false, false, false, false},
+        {"rawtransactions", "signrawtransaction", &signrawtransaction, false, false, false, false}, /* uses wallet if enabled */
 
         /* Utility functions */
-        {"util", "createmultisig", &createmultisig, true, true, false},
-        {"util", "createwitnessaddress", &createwitnessaddress, true, true, false},
-        {"util", "validateaddress", &validateaddress, true, false, false}, /* uses wallet if enabled */
-        {"util", "verifymessage", &verifymessage, true, false, false},
-        {"util", "estimatefee", &estimatefee, true, true, false},
-        {"util", "estimatepriority", &estimatepriority, true, true, false},
+        {"util", "createmultisig", &createmultisig, true, true, false, true},
+        {"util", "createwitnessaddress", &createwitnessaddress, true, true, false, false},
+        {"util", "validateaddress", &validateaddress, true, false, false, true}, /* uses wallet if enabled */
+        {"util", "verifymessage", &verifymessage, true, false, false, true},
+        {"util", "estimatefee", &estimatefee, true, true, false, true},
+        {"util", "estimatepriority", &estimatepriority, true, true, false, true},
 
         /* Not shown in help */
-        {"hidden", "invalidateblock", &invalidateblock, true, true, false},
-        {"hidden", "reconsiderblock", &reconsiderblock, true, true, false},
-        {"hidden", "setmocktime", &setmocktime, true, false, false},
+        {"hidden", "invalidateblock", &invalidateblock, true, true, false, false},
+        {"hidden", "reconsiderblock", &reconsiderblock, true, true, false, false},
+        {"hidden", "setmocktime", &setmocktime, true, false, false, false},
 
         /* TRBO features */
-        {"trbo", "masternode", &masternode, true, true, false},
-        {"trbo", "listmasternodes", &listmasternodes, true, true, false},
-        {"trbo", "createmasternodebroadcast", &createmasternodebroadcast, true, true, false},
-        {"trbo", "decodemasternodebroadcast", &decodemasternodebroadcast, true, true, false},
-        {"trbo", "relaymasternodebroadcast", &relaymasternodebroadcast, true, true, false},
-        {"trbo", "getmasternodecount", &getmasternodecount, true, true, false},
-        {"trbo", "masternodeconnect", &masternodeconnect, true, true, false},
-        {"trbo", "masternodecurrent", &masternodecurrent, true, true, false},
-        {"trbo", "masternodedebug", &masternodedebug, true, true, false},
-        {"trbo", "startmasternode", &startmasternode, true, true, false},
-        {"trbo", "createmasternodekey", &createmasternodekey, true, true, false},
-        {"trbo", "getmasternodeoutputs", &getmasternodeoutputs, true, true, false},
-        {"trbo", "listmasternodeconf", &listmasternodeconf, true, true, false},
-        {"trbo", "getmasternodestatus", &getmasternodestatus, true, true, false},
-        {"trbo", "getmasternodewinners", &getmasternodewinners, true, true, false},
-        {"trbo", "getmasternodescores", &getmasternodescores, true, true, false},
-        {"trbo", "mnbudget", &mnbudget, true, true, false},
-        {"trbo", "preparebudget", &preparebudget, true, true, false},
-        {"trbo", "submitbudget", &submitbudget, true, true, false},
-        {"trbo", "mnbudgetvote", &mnbudgetvote, true, true, false},
-        {"trbo", "getbudgetvotes", &getbudgetvotes, true, true, false},
-        {"trbo", "getnextsuperblock", &getnextsuperblock, true, true, false},
-        {"trbo", "getbudgetprojection", &getbudgetprojection, true, true, false},
-        {"trbo", "getbudgetinfo", &getbudgetinfo, true, true, false},
-        {"trbo", "mnbudgetrawvote", &mnbudgetrawvote, true, true, false},
-        {"trbo", "mnfinalbudget", &mnfinalbudget, true, true, false},
-        {"trbo", "checkbudgets", &checkbudgets, true, true, false},
-        {"trbo", "mnsync", &mnsync, true, true, false},
-        {"trbo", "spork", &spork, true, true, false},
-        {"trbo", "getpoolinfo", &getpoolinfo, true, true, false},
-        {"trbo", "makekeypair", &makekeypair, true, true, false},
+        {"trbo", "masternode", &masternode, true, true, false, false},
+        {"trbo", "listmasternodes", &listmasternodes, true, true, false, true},
+        {"trbo", "createmasternodebroadcast", &createmasternodebroadcast, true, true, false, false},
+        {"trbo", "decodemasternodebroadcast", &decodemasternodebroadcast, true, true, false, true},
+        {"trbo", "relaymasternodebroadcast", &relaymasternodebroadcast, true, true, false, false},
+        {"trbo", "getmasternodecount", &getmasternodecount, true, true, false, true},
+        {"trbo", "getswifttxinfo", &getswifttxinfo, true, true, false, true},
+        {"trbo", "masternodeconnect", &masternodeconnect, true, true, false, false},
+        {"trbo", "masternodecurrent", &masternodecurrent, true, true, false, true},
+        {"trbo", "masternodedebug", &masternodedebug, true, true, false, false},
+        {"trbo", "startmasternode", &startmasternode, true, true, false, false},
+        {"trbo", "createmasternodekey", &createmasternodekey, true, true, false, false},
+        {"trbo", "getmasternodeoutputs", &getmasternodeoutputs, true, true, false, false},
+        {"trbo", "listmasternodeconf", &listmasternodeconf, true, true, false, false},
+        {"trbo", "getmasternodestatus", &getmasternodestatus, true, true, false, true},
+        {"trbo", "getmasternodewinners", &getmasternodewinners, true, true, false, true},
+        {"trbo", "getmasternodescores", &getmasternodescores, true, true, false, true},
+        {"trbo", "mnbudget", &mnbudget, true, true, false, false},
+        {"trbo", "preparebudget", &preparebudget, true, true, false, false},
+        {"trbo", "submitbudget", &submitbudget, true, true, false, false},
+        {"trbo", "mnbudgetvote", &mnbudgetvote, true, true, false, false},
+        {"trbo", "getbudgetvotes", &getbudgetvotes, true, true, false, true},
+        {"trbo", "getnextsuperblock", &getnextsuperblock, true, true, false, true},
+        {"trbo", "getbudgetprojection", &getbudgetprojection, true, true, false, true},
+        {"trbo", "getbudgetinfo", &getbudgetinfo, true, true, false, true},
+        {"trbo", "mnbudgetrawvote", &mnbudgetrawvote, true, true, false, false},
+        {"trbo", "mnfinalbudget", &mnfinalbudget, true, true, false, false},
+        {"trbo", "checkbudgets", &checkbudgets, true, true, false, false},
+        {"trbo", "mnsync", &mnsync, true, true, false, false},
+        {"trbo", "spork", &spork, true, true, false, false},
+        {"trbo", "getpoolinfo", &getpoolinfo, true, true, false, true},
+        {"trbo", "makekeypair", &makekeypair, true, true, false, false},
 #ifdef ENABLE_WALLET
         /* Wallet */
-        {"wallet", "addmultisigaddress", &addmultisigaddress, true, false, true},
-        {"wallet", "addwitnessaddress", &addwitnessaddress, true, false, true},
-        {"wallet", "autocombinerewards", &autocombinerewards, false, false, true},
-        {"wallet", "backupwallet", &backupwallet, true, false, true},
-        {"wallet", "dumpprivkey", &dumpprivkey, true, false, true},
-        {"wallet", "dumphdinfo", &dumphdinfo, true, false, true},
-        {"wallet", "dumpwallet", &dumpwallet, true, false, true},
-        {"wallet", "dumpallprivatekeys", &dumpallprivatekeys, true, false, true},
-        {"wallet", "bip38encrypt", &bip38encrypt, true, false, true},
-        {"wallet", "bip38decrypt", &bip38decrypt, true, false, true},
-        {"wallet", "encryptwallet", &encryptwallet, true, false, true},
-        {"wallet", "getaccountaddress", &getaccountaddress, true, false, true},
-        {"wallet", "getaccount", &getaccount, true, false, true},
-        {"wallet", "getaddressesbyaccount", &getaddressesbyaccount, true, false, true},
-        {"wallet", "getbalance", &getbalance, false, false, true},
-        {"wallet", "getnewaddress", &getnewaddress, true, false, true},
-        {"wallet", "getrawchangeaddress", &getrawchangeaddress, true, false, true},
-        {"wallet", "getreceivedbyaccount", &getreceivedbyaccount, false, false, true},
-        {"wallet", "getreceivedbyaddress", &getreceivedbyaddress, false, false, true},
-        {"wallet", "getstakingstatus", &getstakingstatus, false, false, true},
-        {"wallet", "getstakesplitthreshold", &getstakesplitthreshold, false, false, true},
-        {"wallet", "gettransaction", &gettransaction, false, false, true},
-        {"wallet", "getunconfirmedbalance", &getunconfirmedbalance, false, false, true},
-        {"wallet", "getwalletinfo", &getwalletinfo, false, false, true},
-        {"wallet", "importprivkey", &importprivkey, true, false, true},
-        {"wallet", "importpubkey", &importpubkey, true, false, true},
-        {"wallet", "importwallet", &importwallet, true, false, true},
-        {"wallet", "importaddress", &importaddress, true, false, true},
-        {"wallet", "keypoolrefill", &keypoolrefill, true, false, true},
-        {"wallet", "listaccounts", &listaccounts, false, false, true},
-        {"wallet", "listaddressgroupings", &listaddressgroupings, false, false, true},
-        {"wallet", "listlockunspent", &listlockunspent, false, false, true},
-        {"wallet", "listreceivedbyaccount", &listreceivedbyaccount, false, false, true},
-        {"wallet", "listreceivedbyaddress", &listreceivedbyaddress, false, false, true},
-        {"wallet", "listsinceblock", &listsinceblock, false, false, true},
-        {"wallet", "listtransactions", &listtransactions, false, false, true},
-        {"wallet", "listunspent", &listunspent, false, false, true},
-        {"wallet", "lockunspent", &lockunspent, true, false, true},
-        {"wallet", "move", &movecmd, false, false, true},
-        {"wallet", "multisend", &multisend, false, false, true},
-        {"wallet", "sendfrom", &sendfrom, false, false, true},
-        {"wallet", "sendmany", &sendmany, false, false, true},
-        {"wallet", "sendtoaddress", &sendtoaddress, false, false, true},
-        {"wallet", "sendtoaddressix", &sendtoaddressix, false, false, true},
-        {"wallet", "setaccount", &setaccount, true, false, true},
-        {"wallet", "setstakesplitthreshold", &setstakesplitthreshold, false, false, true},
-        {"wallet", "settxfee", &settxfee, true, false, true},
-        {"wallet", "signmessage", &signmessage, true, false, true},
-        {"wallet", "walletlock", &walletlock, true, false, true},
-        {"wallet", "walletpassphrasechange", &walletpassphrasechange, true, false, true},
-        {"wallet", "walletpassphrase", &walletpassphrase, true, false, true}
+        {"wallet", "addmultisigaddress", &addmultisigaddress, true, false, true, false},
+        {"wallet", "addwitnessaddress", &addwitnessaddress, true, false, true, false},
+        {"wallet", "autocombinerewards", &autocombinerewards, false, false, true, false},
+        {"wallet", "abortrescan", &abortrescan, true, false, true, false},
+        {"wallet", "backupwallet", &backupwallet, true, false, true, false},
+        {"wallet", "dumpprivkey", &dumpprivkey, true, false, true, false},
+        {"wallet", "dumphdinfo", &dumphdinfo, true, false, true, false},
+        {"wallet", "dumpwallet", &dumpwallet, true, false, true, false},
+        {"wallet", "dumpallprivatekeys", &dumpallprivatekeys, true, false, true, false},
+        {"wallet", "bip38encrypt", &bip38encrypt, true, false, true, false},
+        {"wallet", "bip38decrypt", &bip38decrypt, true, false, true, false},
+        {"wallet", "encryptwallet", &encryptwallet, true, false, true, false},
+        {"wallet", "getaccountaddress", &getaccountaddress, true, false, true, false},
+        {"wallet", "getaccount", &getaccount, true, false, true, true},
+        {"wallet", "getaddressesbyaccount", &getaddressesbyaccount, true, false, true, true},
+        {"wallet", "getbalance", &getbalance, false, false, true, true},
+        {"wallet", "getnewaddress", &getnewaddress, true, false, true, false},
+        {"wallet", "getrawchangeaddress", &getrawchangeaddress, true, false, true, false},
+        {"wallet", "getreceivedbyaccount", &getreceivedbyaccount, false, false, true, true},
+        {"wallet", "getreceivedbyaddress", &getreceivedbyaddress, false, false, true, true},
+        {"wallet", "getstakingstatus", &getstakingstatus, false, false, true, true},
+        {"wallet", "getstakesplitthreshold", &getstakesplitthreshold, false, false, true, true},
+        {"wallet", "gettransaction", &gettransaction, false, false, true, true},
+        {"wallet", "getunconfirmedbalance", &getunconfirmedbalance, false, false, true, true},
+        {"wallet", "getwalletinfo", &getwalletinfo, false, false, true, true},
+        {"wallet", "importprivkey", &importprivkey, true, false, true, false},
+        {"wallet", "importpubkey", &importpubkey, true, false, true, false},
+        {"wallet", "importwallet", &importwallet, true, false, true, false},
+        {"wallet", "importaddress", &importaddress, true, false, true, false},
+        {"wallet", "keypoolrefill", &keypoolrefill, true, false, true, false},
+        {"wallet", "listaccounts", &listaccounts, false, false, true, true},
+        {"wallet", "listaddressgroupings", &listaddressgroupings, false, false, true, true},
+        {"wallet", "listlockunspent", &listlockunspent, false, false, true, true},
+        {"wallet", "listreceivedbyaccount", &listreceivedbyaccount, false, false, true, true},
+        {"wallet", "listreceivedbyaddress", &listreceivedbyaddress, false, false, true, true},
+        {"wallet", "listsinceblock", &listsinceblock, false, false, true, true},
+        {"wallet", "listtransactions", &listtransactions, false, false, true, true},
+        {"wallet", "listunspent", &listunspent, false, false, true, true},
+        {"wallet", "lockunspent", &lockunspent, true, false, true, false},
+        {"wallet", "move", &movecmd, false, false, true, false},
+        {"wallet", "multisend", &multisend, false, false, true, false},
+        {"wallet", "sendfrom", &sendfrom, false, false, true, false},
+        {"wallet", "sendmany", &sendmany, false, false, true, false},
+        {"wallet", "sendtoaddress", &sendtoaddress, false, false, true, false},
+        {"wallet", "sendtoaddressix", &sendtoaddressix, false, false, true, false},
+        {"wallet", "setaccount", &setaccount, true, false, true, false},
+        {"wallet", "setstakesplitthreshold", &setstakesplitthreshold, false, false, true, false},
+        {"wallet", "settxfee", &settxfee, true, false, true, false},
+        {"wallet", "signmessage", &signmessage, true, false, true, false},
+        {"wallet", "walletlock", &walletlock, true, false, true, false},
+        {"wallet", "walletpassphrasechange", &walletpassphrasechange, true, false, true, false},
+        {"wallet", "walletpassphrase", &walletpassphrase, true, false, true, false}
 
 #endif // ENABLE_WALLET
 };
@@ -562,13 +658,97 @@ static UniValue JSONRPCExecOne(const UniValue& req)
     return rpc_result;
 }
 
-std::string JSONRPCExecBatch(const UniValue& vReq)
+/** A batch whose entries are spread over the HTTP worker threads. The thread
+ *  that received the batch works on it too, so the batch completes even when
+ *  no other worker is free. */
+class CRPCParallelBatch
 {
+private:
+    CWaitableCriticalSection cs;
+    CConditionVariable condDone;
+    const UniValue vReq;
+    std::vector<UniValue> vResults;
+    size_t nNext;
+    size_t nDone;
+
+public:
+    CRPCParallelBatch(const UniValue& vReqIn) : vReq(vReqIn), vResults(vReqIn.size()), nNext(0), nDone(0) {}
+
+    /** Execute entries until every entry has been claimed */
+    void Work()
+    {
+        while (true) {
+            size_t nIdx;
+            {
+                boost::unique_lock<boost::mutex> lock(cs);
+                if (nNext >= vReq.size())
+                    return;
+                nIdx = nNext++;
+            }
+
+            UniValue result;
+            try {
+                result = JSONRPCExecOne(vReq[nIdx]);
+            } catch (...) {
+                result = JSONRPCReplyObj(NullUniValue, JSONRPCError(RPC_MISC_ERROR, "unknown error"), NullUniValue);
+            }
+
+            boost::unique_lock<boost::mutex> lock(cs);
+            vResults[nIdx] = result;
+            if (++nDone == vReq.size())
+                condDone.notify_all();
+        }
+    }
+
+    /** Wait for all entries to finish and return the replies in request order */
+    UniValue GetResults()
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        while (nDone < vReq.size())
+            condDone.wait(lock);
+
+        UniValue ret(UniValue::VARR);
+        for (size_t i = 0; i < vResults.size(); i++)
+            ret.push_back(vResults[i]);
+        return ret;
+    }
+};
+
+/** Only batches made up entirely of read-only calls are executed in
+ *  parallel, so that calls with side effects keep their order. */
+static bool IsReadOnlyBatch(const UniValue& vReq)
+{
+    for (unsigned int reqIdx = 0; reqIdx < vReq.size(); reqIdx++) {
+        if (!vReq[reqIdx].isObject())
+            return false;
+        const UniValue& valMethod = find_value(vReq[reqIdx].get_obj(), "method");
+        if (!valMethod.isStr())
+            return false;
+        const CRPCCommand* pcmd = tableRPC[valMethod.get_str()];
+        if (!pcmd || !pcmd->readOnly)
+            return false;
+    }
+    return true;
+}
+
+UniValue JSONRPCExecBatch(const UniValue& vReq)
+{
+    int nHelpers = std::min((int)vReq.size(), HTTPWorkerThreads()) - 1;
+    if (nHelpers > 0 && IsReadOnlyBatch(vReq)) {
+        boost::shared_ptr<CRPCParallelBatch> batch(new CRPCParallelBatch(vReq));
+        for (int i = 0; i < nHelpers; i++) {
+            if (!HTTPEnqueueTask(boost::bind(&CRPCParallelBatch::Work, batch)))
+                break;
+        }
+        batch->Work();
+        return batch->GetResults();
+    }
+
     UniValue ret(UniValue::VARR);
     for (unsigned int reqIdx = 0; reqIdx < vReq.size(); reqIdx++)
         ret.push_back(JSONRPCExecOne(vReq[reqIdx]));
 
-    return ret.write() + "\n";
+    return ret;
 }
 
 UniValue CRPCTable::execute(const std::string &strMethod, const UniValue &params) const
@@ -580,14 +760,18 @@ UniValue CRPCTable::execute(const std::string &strMethod, const UniValue &params
 
     g_rpcSignals.PreCommand(*pcmd);
 
+    CRPCCallTracker tracker(pcmd->name);
+    UniValue result;
     try {
         // Execute
-        return pcmd->actor(params, false);
+        result = pcmd->actor(params, false);
     } catch (std::exception& e) {
         throw JSONRPCError(RPC_MISC_ERROR, e.what());
     }
+    tracker.Finish();
 
     g_rpcSignals.PostCommand(*pcmd);
+    return result;
 }
 
 std::vector<std::string> CRPCTable::listCommands() const
@@ -123,6 +123,7 @@ public:
     bool okSafeMode;
     bool threadSafe;
     bool reqWallet;
+    bool readOnly; //!< No side effects, may run in parallel with other read-only calls of a batch
 };
 
 /**
@@ -156,6 +157,32 @@ public:
 
 extern const CRPCTable tableRPC;
 
+/**
+ * The active chain as it was at one moment. Read-only calls work against a
+ * snapshot instead of holding cs_main for their whole duration: block index
+ * entries are never freed, so the snapshot can be walked without locks, and
+ * everything one call reports stays consistent even if the tip moves on.
+ */
+class CChainSnapshot
+{
+private:
+    const CBlockIndex* pindexTip;
+
+public:
+    /** Take a snapshot of chainActive. Locks cs_main briefly. */
+    CChainSnapshot();
+
+    const CBlockIndex* Tip() const { return pindexTip; }
+    int Height() const;
+    const CBlockIndex* operator[](int nHeight) const;
+    bool Contains(const CBlockIndex* pindex) const;
+    const CBlockIndex* Next(const CBlockIndex* pindex) const;
+
+    /** Look up a block header by hash, whether or not it is part of this
+     *  chain. Locks cs_main briefly. */
+    const CBlockIndex* Lookup(const uint256& hash) const;
+};
+
 /**
  * Utilities: convert hex-encoded Values
  * (throws error if not hex).
@@ -242,6 +269,7 @@ extern UniValue walletpassphrasechange(const UniValue& params, bool fHelp);
 extern UniValue walletlock(const UniValue& params, bool fHelp);
 extern UniValue encryptwallet(const UniValue& params, bool fHelp);
 extern UniValue getwalletinfo(const UniValue& params, bool fHelp);
+extern UniValue abortrescan(const UniValue& params, bool fHelp);
 extern UniValue getblockchaininfo(const UniValue& params, bool fHelp);
 extern UniValue getnetworkinfo(const UniValue& params, bool fHelp);
 extern UniValue reservebalance(const UniValue& params, bool fHelp);
@@ -274,6 +302,7 @@ extern UniValue getblock(const UniValue& params, bool fHelp);
 extern UniValue getblockheader(const UniValue& params, bool fHelp);
 extern UniValue getfeeinfo(const UniValue& params, bool fHelp);
 extern UniValue gettxoutsetinfo(const UniValue& params, bool fHelp);
+extern UniValue dumpsnapshot(const UniValue& params, bool fHelp);
 extern UniValue gettxout(const UniValue& params, bool fHelp);
 extern UniValue verifychain(const UniValue& params, bool fHelp);
 extern UniValue getchaintips(const UniValue& params, bool fHelp);
@@ -285,6 +314,7 @@ extern UniValue getpoolinfo(const UniValue& params, bool fHelp);
 extern UniValue masternode(const UniValue& params, bool fHelp);
 extern UniValue listmasternodes(const UniValue& params, bool fHelp);
 extern UniValue getmasternodecount(const UniValue& params, bool fHelp);
+extern UniValue getswifttxinfo(const UniValue& params, bool fHelp);
 extern UniValue createmasternodebroadcast(const UniValue& params, bool fHelp);
 extern UniValue decodemasternodebroadcast(const UniValue& params, bool fHelp);
 extern UniValue relaymasternodebroadcast(const UniValue& params, bool fHelp);
@@ -324,6 +354,6 @@ extern UniValue getstakingstatus(const UniValue& params, bool fHelp);
 bool StartRPC();
 void InterruptRPC();
 void StopRPC();
-std::string JSONRPCExecBatch(const UniValue& vReq);
+UniValue JSONRPCExecBatch(const UniValue& vReq);
 
 #endif // BITCOIN_RPCSERVER_H
@@ -0,0 +1,381 @@
+// Copyright (c) 2019 The TRBO developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "snapshot.h"
+
+#include "chainparams.h"
+#include "clientversion.h"
+#include "hash.h"
+#include "main.h"
+#include "masternode-budget.h"
+#include "masternode-payments.h"
+#include "masternodeman.h"
+#include "streams.h"
+#include "txdb.h"
+#include "util.h"
+#include "utiltime.h"
+
+#include <boost/filesystem.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread.hpp>
+
+using namespace std;
+
+/**
+ * File layout, all in SER_DISK serialization:
+ * - magic string, network message start
+ * - version, best block hash, height, number of block index entries
+ * - block index entries of the active chain from genesis to the best block
+ *   (CDiskBlockIndex without file positions)
+ * - (txid, CCoins) for every transaction with unspent outputs, ending with a
+ *   null txid
+ * - number of transactions and hash_serialized of the UTXO set
+ * - raw mncache.dat, mnpayments.dat and budget.dat
+ * - double SHA256 of everything above
+ */
+static const std::string SNAPSHOT_MAGIC = "trbo-chainstate";
+
+/** Coins written to the database per batch while loading */
+static const unsigned int SNAPSHOT_COINS_BATCH = 100000;
+
+/** Block index entries serialized per cs_main acquisition while dumping */
+static const unsigned int SNAPSHOT_INDEX_BATCH = 2000;
+
+/** Cache files carried along in the snapshot, in file order */
+static const char* const SNAPSHOT_CACHE_FILES[] = {"mncache.dat", "mnpayments.dat", "budget.dat"};
+
+/** CAutoFile wrapper that hashes the bytes passing through it */
+class CHashedFile
+{
+private:
+    CAutoFile& file;
+    CHashWriter hasher;
+
+public:
+    CHashedFile(CAutoFile& fileIn) : file(fileIn), hasher(SER_DISK, CLIENT_VERSION) {}
+
+    void read(char* pch, size_t nSize)
+    {
+        file.read(pch, nSize);
+        hasher.write(pch, nSize);
+    }
+
+    void write(const char* pch, size_t nSize)
+    {
+        file.write(pch, nSize);
+        hasher.write(pch, nSize);
+    }
+
+    template <typename T>
+    CHashedFile& operator<<(const T& obj)
+    {
+        ::Serialize(*this, obj, SER_DISK, CLIENT_VERSION);
+        return *this;
+    }
+
+    template <typename T>
+    CHashedFile& operator>>(T& obj)
+    {
+        ::Unserialize(*this, obj, SER_DISK, CLIENT_VERSION);
+        return *this;
+    }
+
+    uint256 GetHash() { return hasher.GetHash(); }
+};
+
+static bool ReadCacheFile(const boost::filesystem::path& path, std::vector<unsigned char>& vData)
+{
+    vData.clear();
+    FILE* file = fopen(path.string().c_str(), "rb");
+    if (file == NULL)
+        return false;
+    unsigned char buf[65536];
+    size_t nRead;
+    while ((nRead = fread(buf, 1, sizeof(buf), file)) > 0)
+        vData.insert(vData.end(), buf, buf + nRead);
+    bool fOk = !ferror(file);
+    fclose(file);
+    return fOk;
+}
+
+static bool WriteCacheFile(const boost::filesystem::path& path, const std::vector<unsigned char>& vData)
+{
+    boost::filesystem::path pathTmp = path;
+    pathTmp += ".new";
+    FILE* file = fopen(pathTmp.string().c_str(), "wb");
+    if (file == NULL)
+        return false;
+    bool fOk = vData.empty() || fwrite(&vData[0], 1, vData.size(), file) == vData.size();
+    FileCommit(file);
+    fclose(file);
+    return fOk && RenameOver(pathTmp, path);
+}
+
+/** Write a masternode manager in the format of SNAPSHOT_CACHE_FILES[nCache] to a temporary file and read it back */
+static bool SerializeCacheFile(unsigned int nCache, const boost::filesystem::path& pathCache, std::vector<unsigned char>& vData)
+{
+    vData.clear();
+    bool fOk;
+    if (nCache == 0)
+        fOk = CMasternodeDB(pathCache).Write(mnodeman);
+    else if (nCache == 1)
+        fOk = CMasternodePaymentDB(pathCache).Write(masternodePayments);
+    else
+        fOk = CBudgetDB(pathCache).Write(budget);
+    fOk = fOk && ReadCacheFile(pathCache, vData);
+    boost::filesystem::remove(pathCache);
+    return fOk;
+}
+
+bool DumpChainStateSnapshot(const boost::filesystem::path& path, CChainStateSnapshotInfo& info, std::string& strError)
+{
+    int64_t nStart = GetTimeMillis();
+
+    // Pin the coin database and the chain it belongs to
+    boost::scoped_ptr<CCoinsViewDBCursor> pcursor;
+    std::vector<CBlockIndex*> vChain;
+    {
+        LOCK(cs_main);
+        FlushStateToDisk();
+        pcursor.reset(pcoinsdbview->Cursor());
+        info.hashBlock = pcoinsdbview->GetBestBlock();
+        BlockMap::iterator mi = mapBlockIndex.find(info.hashBlock);
+        if (mi == mapBlockIndex.end() || !chainActive.Contains(mi->second)) {
+            strError = "coin database is not at a block of the active chain";
+            return false;
+        }
+        info.nHeight = mi->second->nHeight;
+        vChain.reserve(info.nHeight + 1);
+        for (int nHeight = 0; nHeight <= info.nHeight; nHeight++)
+            vChain.push_back(chainActive[nHeight]);
+    }
+    info.nBlockIndex = vChain.size();
+
+    boost::filesystem::path pathTmp = path;
+    pathTmp += ".new";
+    FILE* file = fopen(pathTmp.string().c_str(), "wb");
+    CAutoFile fileout(file, SER_DISK, CLIENT_VERSION);
+    if (fileout.IsNull()) {
+        strError = strprintf("unable to open %s for writing", pathTmp.string());
+        return false;
+    }
+
+    try {
+        CHashedFile hashed(fileout);
+        hashed << SNAPSHOT_MAGIC << FLATDATA(Params().MessageStart());
+        hashed << CHAINSTATE_SNAPSHOT_VERSION << info.hashBlock << info.nHeight << info.nBlockIndex;
+
+        // Block index entries only change in their status and file positions,
+        // neither of which is written, so cs_main is taken in small batches
+        for (size_t i = 0; i < vChain.size(); i += SNAPSHOT_INDEX_BATCH) {
+            boost::this_thread::interruption_point();
+            std::vector<CDiskBlockIndex> vBatch;
+            {
+                LOCK(cs_main);
+                for (size_t j = i; j < std::min(vChain.size(), i + SNAPSHOT_INDEX_BATCH); j++) {
+                    CDiskBlockIndex diskindex(vChain[j]);
+                    diskindex.nStatus &= ~(BLOCK_HAVE_MASK | BLOCK_SNAPSHOT);
+                    diskindex.nFile = 0;
+                    diskindex.nDataPos = 0;
+                    diskindex.nUndoPos = 0;
+                    diskindex.hashNext = j + 1 < vChain.size() ? vChain[j + 1]->GetBlockHash() : uint256();
+                    vBatch.push_back(diskindex);
+                }
+            }
+            BOOST_FOREACH (const CDiskBlockIndex& diskindex, vBatch)
+                hashed << diskindex;
+        }
+
+        CCoinsStats stats;
+        CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
+        ss << info.hashBlock;
+        while (pcursor->Valid()) {
+            boost::this_thread::interruption_point();
+            CCoins coins;
+            if (!pcursor->GetCoins(coins)) {
+                strError = "unable to read coin database";
+                return false;
+            }
+            UpdateCoinsStatsHash(ss, pcursor->GetTxid(), coins, stats);
+            hashed << pcursor->GetTxid() << coins;
+            pcursor->Next();
+        }
+        info.nTransactions = stats.nTransactions;
+        info.hashSerialized = ss.GetHash();
+        hashed << uint256(0) << info.nTransactions << info.hashSerialized;
+
+        // Carry the masternode caches along in their flat file format
+        boost::filesystem::path pathCache = pathTmp;
+        pathCache += ".cache";
+        for (unsigned int i = 0; i < ARRAYLEN(SNAPSHOT_CACHE_FILES); i++) {
+            std::vector<unsigned char> vData;
+            if (!SerializeCacheFile(i, pathCache, vData))
+                LogPrintf("%s: unable to serialize %s, leaving it out of the snapshot\n", __func__, SNAPSHOT_CACHE_FILES[i]);
+            hashed << vData;
+        }
+
+        fileout << hashed.GetHash();
+    } catch (const std::exception& e) {
+        strError = strprintf("error writing %s: %s", pathTmp.string(), e.what());
+        return false;
+    }
+
+    FileCommit(fileout.Get());
+    fileout.fclose();
+    if (!RenameOver(pathTmp, path)) {
+        strError = strprintf("unable to rename %s to %s", pathTmp.string(), path.string());
+        return false;
+    }
+
+    LogPrintf("%s: wrote snapshot of block %s (height %d, %u transactions, hash_serialized %s) to %s in %dms\n", __func__,
+        info.hashBlock.ToString(), info.nHeight, info.nTransactions, info.hashSerialized.ToString(), path.string(), GetTimeMillis() - nStart);
+    return true;
+}
+
+/** Read a snapshot, verifying it when pcoinsdb is NULL and writing it to the databases otherwise */
+static bool ProcessSnapshotFile(const boost::filesystem::path& path, CCoinsViewDB* pcoinsdb, CChainStateSnapshotInfo& info, std::string& strError)
+{
+    FILE* file = fopen(path.string().c_str(), "rb");
+    CAutoFile filein(file, SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull()) {
+        strError = strprintf("unable to open %s", path.string());
+        return false;
+    }
+
+    try {
+        CHashedFile hashed(filein);
+
+        std::string strMagic;
+        MessageStartChars pchMessageStart;
+        int nVersion;
+        hashed >> strMagic >> FLATDATA(pchMessageStart) >> nVersion;
+        if (strMagic != SNAPSHOT_MAGIC) {
+            strError = "not a chainstate snapshot";
+            return false;
+        }
+        if (memcmp(pchMessageStart, Params().MessageStart(), sizeof(pchMessageStart)) != 0) {
+            strError = "snapshot belongs to another network";
+            return false;
+        }
+        if (nVersion != CHAINSTATE_SNAPSHOT_VERSION) {
+            strError = strprintf("unsupported snapshot version %d", nVersion);
+            return false;
+        }
+        hashed >> info.hashBlock >> info.nHeight >> info.nBlockIndex;
+        if (info.nHeight < 0 || info.nBlockIndex != (uint64_t)info.nHeight + 1) {
+            strError = "snapshot header is inconsistent";
+            return false;
+        }
+
+        // The entries must form one chain from our genesis block to the best block
+        uint256 hashPrev;
+        for (uint64_t i = 0; i < info.nBlockIndex; i++) {
+            boost::this_thread::interruption_point();
+            CDiskBlockIndex diskindex;
+            hashed >> diskindex;
+            uint256 hash = diskindex.GetBlockHash();
+            if (diskindex.nHeight != (int)i || diskindex.hashPrev != hashPrev || (i == 0 && hash != Params().HashGenesisBlock()) ||
+                (diskindex.nStatus & (BLOCK_HAVE_MASK | BLOCK_FAILED_MASK)) || diskindex.nTx == 0) {
+                strError = strprintf("invalid block index entry at height %d", i);
+                return false;
+            }
+            if (pcoinsdb) {
+                diskindex.nStatus |= BLOCK_SNAPSHOT;
+                if (!pblocktree->WriteBlockIndex(diskindex)) {
+                    strError = "failed to write block index";
+                    return false;
+                }
+            }
+            hashPrev = hash;
+        }
+        if (hashPrev != info.hashBlock) {
+            strError = "block index does not end at the snapshot block";
+            return false;
+        }
+
+        CCoinsStats stats;
+        CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
+        ss << info.hashBlock;
+        CCoinsMap mapCoins;
+        while (true) {
+            boost::this_thread::interruption_point();
+            uint256 txid;
+            hashed >> txid;
+            if (txid == 0)
+                break;
+            CCoins coins;
+            hashed >> coins;
+            UpdateCoinsStatsHash(ss, txid, coins, stats);
+            if (pcoinsdb) {
+                CCoinsCacheEntry& entry = mapCoins[txid];
+                entry.coins.swap(coins);
+                entry.flags = CCoinsCacheEntry::DIRTY | CCoinsCacheEntry::FRESH;
+                if (mapCoins.size() >= SNAPSHOT_COINS_BATCH && !pcoinsdb->BatchWrite(mapCoins, uint256(0))) {
+                    strError = "failed to write coin database";
+                    return false;
+                }
+            }
+        }
+        uint64_t nTransactions;
+        uint256 hashSerialized;
+        hashed >> nTransactions >> hashSerialized;
+        info.nTransactions = stats.nTransactions;
+        info.hashSerialized = ss.GetHash();
+        if (nTransactions != info.nTransactions || hashSerialized != info.hashSerialized) {
+            strError = strprintf("UTXO set hash mismatch, got %s, snapshot claims %s", info.hashSerialized.ToString(), hashSerialized.ToString());
+            return false;
+        }
+        // The best block is only recorded with the last batch, so an
+        // interrupted load leaves a coin database that is not used
+        if (pcoinsdb && !pcoinsdb->BatchWrite(mapCoins, info.hashBlock)) {
+            strError = "failed to write coin database";
+            return false;
+        }
+
+        BOOST_FOREACH (const char* pszCache, SNAPSHOT_CACHE_FILES) {
+            std::vector<unsigned char> vData;
+            hashed >> vData;
+            if (pcoinsdb && !vData.empty() && !WriteCacheFile(GetDataDir() / pszCache, vData))
+                LogPrintf("%s: unable to write %s, it will be rebuilt from the network\n", __func__, pszCache);
+        }
+
+        uint256 hashChecksum;
+        filein >> hashChecksum;
+        if (hashChecksum != hashed.GetHash()) {
+            strError = "checksum mismatch";
+            return false;
+        }
+    } catch (const std::exception& e) {
+        strError = strprintf("error reading %s: %s", path.string(), e.what());
+        return false;
+    }
+    return true;
+}
+
+bool LoadChainStateSnapshot(const boost::filesystem::path& path, const uint256& hashExpected, CChainStateSnapshotInfo& info, std::string& strError)
+{
+    int64_t nStart = GetTimeMillis();
+    LogPrintf("%s: verifying snapshot %s\n", __func__, path.string());
+
+    if (!ProcessSnapshotFile(path, NULL, info, strError))
+        return false;
+    if (hashExpected != 0 && info.hashSerialized != hashExpected) {
+        strError = strprintf("snapshot UTXO hash %s does not match -snapshothash", info.hashSerialized.ToString());
+        return false;
+    }
+
+    LogPrintf("%s: loading block %s (height %d, %u transactions, hash_serialized %s)\n", __func__,
+        info.hashBlock.ToString(), info.nHeight, info.nTransactions, info.hashSerialized.ToString());
+
+    if (!ProcessSnapshotFile(path, pcoinsdbview, info, strError))
+        return false;
+
+    // Nothing below the snapshot is indexed, the flags only record that blocks
+    // connected from here on are
+    pblocktree->WriteFlag("txindex", GetBoolArg("-txindex", true));
+    pblocktree->WriteFlag("addrindex", GetBoolArg("-addrindex", true));
+
+    LogPrintf("%s: snapshot loaded in %dms\n", __func__, GetTimeMillis() - nStart);
+    return true;
+}
@@ -0,0 +1,45 @@
+// Copyright (c) 2019 The TRBO developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_SNAPSHOT_H
+#define BITCOIN_SNAPSHOT_H
+
+#include "uint256.h"
+
+#include <stdint.h>
+#include <string>
+
+#include <boost/filesystem/path.hpp>
+
+/** Version of the chainstate snapshot format written by DumpChainStateSnapshot */
+static const int CHAINSTATE_SNAPSHOT_VERSION = 1;
+
+/** What a chainstate snapshot contains, as reported after writing or loading it */
+struct CChainStateSnapshotInfo {
+    uint256 hashBlock;
+    int nHeight;
+    uint64_t nBlockIndex;
+    uint64_t nTransactions;
+    uint256 hashSerialized; //!< Same value gettxoutsetinfo reports as hash_serialized at hashBlock
+
+    CChainStateSnapshotInfo() : hashBlock(0), nHeight(-1), nBlockIndex(0), nTransactions(0), hashSerialized(0) {}
+};
+
+/**
+ * Write the UTXO set, the block index of the active chain and the masternode,
+ * payment and budget caches to a single file. Only the start of the dump
+ * holds cs_main; the coins are read from a database snapshot afterwards, so
+ * block validation continues while the file is written.
+ */
+bool DumpChainStateSnapshot(const boost::filesystem::path& path, CChainStateSnapshotInfo& info, std::string& strError);
+
+/**
+ * Load a snapshot written by DumpChainStateSnapshot into an empty coin and
+ * block tree database. The whole file is verified (checksum, UTXO hash,
+ * block index linkage and, if not null, hashExpected against the UTXO hash)
+ * before anything is written. Must run before LoadBlockIndex.
+ */
+bool LoadChainStateSnapshot(const boost::filesystem::path& path, const uint256& hashExpected, CChainStateSnapshotInfo& info, std::string& strError);
+
+#endif // BITCOIN_SNAPSHOT_H
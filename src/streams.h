@@ -12,6 +12,7 @@
 #include <algorithm>
 #include <assert.h>
 #include <ios>
+#include <stdexcept>
 #include <limits>
 #include <map>
 #include <set>
@@ -606,4 +607,106 @@ public:
     int GetVersion() { return nVersion; }
 };
 
+/** Reads bits from a byte stream, most significant bit first. */
+template <typename IStream>
+class BitStreamReader
+{
+private:
+    IStream& m_istream;
+
+    /// Buffered byte read in from the input stream. A new byte is read into the
+    /// buffer when m_offset reaches 8.
+    uint8_t m_buffer;
+
+    /// Number of high order bits in m_buffer already returned by previous
+    /// Read() calls. The next bit to be returned is at this offset from the
+    /// most significant bit position.
+    int m_offset;
+
+public:
+    explicit BitStreamReader(IStream& istream) : m_istream(istream), m_buffer(0), m_offset(8) {}
+
+    /** Read the specified number of bits from the stream. The data is returned
+     *  in the nbits least significant bits of a 64-bit uint.
+     */
+    uint64_t Read(int nbits)
+    {
+        if (nbits < 0 || nbits > 64)
+            throw std::out_of_range("nbits must be between 0 and 64");
+
+        uint64_t data = 0;
+        while (nbits > 0) {
+            if (m_offset == 8) {
+                m_istream.read((char*)&m_buffer, 1);
+                m_offset = 0;
+            }
+
+            int bits = std::min(8 - m_offset, nbits);
+            data <<= bits;
+            data |= static_cast<uint8_t>(m_buffer << m_offset) >> (8 - bits);
+            m_offset += bits;
+            nbits -= bits;
+        }
+        return data;
+    }
+};
+
+/** Writes bits to a byte stream, most significant bit first. */
+template <typename OStream>
+class BitStreamWriter
+{
+private:
+    OStream& m_ostream;
+
+    /// Buffered byte waiting to be written to the output stream. The byte is
+    /// written when m_offset reaches 8 or Flush() is called.
+    uint8_t m_buffer;
+
+    /// Number of high order bits in m_buffer already written by previous
+    /// Write() calls and not yet flushed to the stream. The next bit to be
+    /// written to is at this offset from the most significant bit position.
+    int m_offset;
+
+public:
+    explicit BitStreamWriter(OStream& ostream) : m_ostream(ostream), m_buffer(0), m_offset(0) {}
+
+    ~BitStreamWriter()
+    {
+        Flush();
+    }
+
+    /** Write the nbits least significant bits of a 64-bit int to the output
+     *  stream. Data is buffered until it completes an octet.
+     */
+    void Write(uint64_t data, int nbits)
+    {
+        if (nbits < 0 || nbits > 64)
+            throw std::out_of_range("nbits must be between 0 and 64");
+
+        while (nbits > 0) {
+            int bits = std::min(8 - m_offset, nbits);
+            m_buffer |= (data << (64 - nbits)) >> (64 - 8 + m_offset);
+            m_offset += bits;
+            nbits -= bits;
+
+            if (m_offset == 8) {
+                Flush();
+            }
+        }
+    }
+
+    /** Flush any unwritten bits to the output stream, padding with 0's to the
+     *  next byte boundary.
+     */
+    void Flush()
+    {
+        if (m_offset == 0)
+            return;
+
+        m_ostream.write((const char*)&m_buffer, 1);
+        m_buffer = 0;
+        m_offset = 0;
+    }
+};
+
 #endif // BITCOIN_STREAMS_H
@@ -21,12 +21,7 @@
 using namespace std;
 using namespace boost;
 
-std::map<uint256, CTransaction> mapTxLockReq;
-std::map<uint256, CTransaction> mapTxLockReqRejected;
-std::map<uint256, CConsensusVote> mapTxLockVote;
-std::map<uint256, CTransactionLock> mapTxLocks;
-std::map<COutPoint, uint256> mapLockedInputs;
-std::map<uint256, int64_t> mapUnknownVotes; //track votes with no tx for DOS
+CTxLockManager txLockManager;
 int nCompleteTXLocks;
 
 //txlock - Locks transaction
@@ -52,7 +47,7 @@ void ProcessMessageSwiftTX(CNode* pfrom, std::string& strCommand, CDataStream& v
         pfrom->AddInventoryKnown(inv);
         GetMainSignals().Inventory(inv.hash);
 
-        if (mapTxLockReq.count(tx.GetHash()) || mapTxLockReqRejected.count(tx.GetHash())) {
+        if (txLockManager.HaveRequest(tx.GetHash())) {
             return;
         }
 
@@ -84,7 +79,7 @@ void ProcessMessageSwiftTX(CNode* pfrom, std::string& strCommand, CDataStream& v
 
             DoConsensusVote(tx, nBlockHeight);
 
-            mapTxLockReq.insert(make_pair(tx.GetHash(), tx));
+            txLockManager.AddRequest(tx);
 
             LogPrintf("ProcessMessageSwiftTX::ix - Transaction Lock Request: %s %s : accepted %s\n",
                 pfrom->addr.ToString().c_str(), pfrom->cleanSubVer.c_str(),
@@ -97,7 +92,7 @@ void ProcessMessageSwiftTX(CNode* pfrom, std::string& strCommand, CDataStream& v
             return;
 
         } else {
-            mapTxLockReqRejected.insert(make_pair(tx.GetHash(), tx));
+            txLockManager.AddRejectedRequest(tx);
 
             // can we get the conflicting transaction as proof?
 
@@ -105,24 +100,15 @@ void ProcessMessageSwiftTX(CNode* pfrom, std::string& strCommand, CDataStream& v
                 pfrom->addr.ToString().c_str(), pfrom->cleanSubVer.c_str(),
                 tx.GetHash().ToString().c_str());
 
-            BOOST_FOREACH (const CTxIn& in, tx.vin) {
-                if (!mapLockedInputs.count(in.prevout)) {
-                    mapLockedInputs.insert(make_pair(in.prevout, tx.GetHash()));
-                }
-            }
-
             // resolve conflicts
-            std::map<uint256, CTransactionLock>::iterator i = mapTxLocks.find(tx.GetHash());
-            if (i != mapTxLocks.end()) {
-                //we only care if we have a complete tx lock
-                if ((*i).second.CountSignatures() >= SWIFTTX_SIGNATURES_REQUIRED) {
-                    if (!CheckForConflictingLocks(tx)) {
-                        LogPrintf("ProcessMessageSwiftTX::ix - Found Existing Complete IX Lock\n");
-
-                        //reprocess the last 15 blocks
-                        ReprocessBlocks(15);
-                        mapTxLockReq.insert(make_pair(tx.GetHash(), tx));
-                    }
+            //we only care if we have a complete tx lock
+            if (txLockManager.CountSignatures(tx.GetHash()) >= SWIFTTX_SIGNATURES_REQUIRED) {
+                if (!txLockManager.CheckForConflictingLocks(tx)) {
+                    LogPrintf("ProcessMessageSwiftTX::ix - Found Existing Complete IX Lock\n");
+
+                    //reprocess the last 15 blocks
+                    ReprocessBlocks(15);
+                    txLockManager.AddRequest(tx);
                 }
             }
 
@@ -136,12 +122,10 @@ void ProcessMessageSwiftTX(CNode* pfrom, std::string& strCommand, CDataStream& v
         CInv inv(MSG_TXLOCK_VOTE, ctx.GetHash());
         pfrom->AddInventoryKnown(inv);
 
-        if (mapTxLockVote.count(ctx.GetHash())) {
+        if (!txLockManager.AddVote(ctx)) {
             return;
         }
 
-        mapTxLockVote.insert(make_pair(ctx.GetHash(), ctx));
-
         if (ProcessConsensusVote(pfrom, ctx)) {
             //Spam/Dos protection
             /*
@@ -149,26 +133,20 @@ void ProcessMessageSwiftTX(CNode* pfrom, std::string& strCommand, CDataStream& v
                 This tracks those messages and allows it at the same rate of the rest of the network, if
                 a peer violates it, it will simply be ignored
             */
-            if (!mapTxLockReq.count(ctx.txHash) && !mapTxLockReqRejected.count(ctx.txHash)) {
-                if (!mapUnknownVotes.count(ctx.vinMasternode.prevout.hash)) {
-                    mapUnknownVotes[ctx.vinMasternode.prevout.hash] = GetTime() + (60 * 10);
-                }
-
-                if (mapUnknownVotes[ctx.vinMasternode.prevout.hash] > GetTime() &&
-                    mapUnknownVotes[ctx.vinMasternode.prevout.hash] - GetAverageVoteTime() > 60 * 10) {
+            if (!txLockManager.HaveRequest(ctx.txHash)) {
+                if (!txLockManager.CheckUnknownVote(ctx.vinMasternode.prevout.hash, GetTime())) {
                     LogPrintf("ProcessMessageSwiftTX::ix - masternode is spamming transaction votes: %s %s\n",
                         ctx.vinMasternode.ToString().c_str(),
                         ctx.txHash.ToString().c_str());
                     return;
-                } else {
-                    mapUnknownVotes[ctx.vinMasternode.prevout.hash] = GetTime() + (60 * 10);
                 }
             }
             RelayInv(inv);
         }
 
-        if (mapTxLockReq.count(ctx.txHash) && GetTransactionLockSignatures(ctx.txHash) == SWIFTTX_SIGNATURES_REQUIRED) {
-            GetMainSignals().NotifyTransactionLock(mapTxLockReq[ctx.txHash]);
+        CTransaction tx;
+        if (txLockManager.GetRequest(ctx.txHash, tx) && GetTransactionLockSignatures(ctx.txHash) == SWIFTTX_SIGNATURES_REQUIRED) {
+            GetMainSignals().NotifyTransactionLock(tx);
         }
 
         return;
@@ -241,20 +219,7 @@ int64_t CreateNewLock(CTransaction tx)
     */
     int nBlockHeight = (chainActive.Tip()->nHeight - nTxAge) + 4;
 
-    if (!mapTxLocks.count(tx.GetHash())) {
-        LogPrintf("CreateNewLock - New Transaction Lock %s !\n", tx.GetHash().ToString().c_str());
-
-        CTransactionLock newLock;
-        newLock.nBlockHeight = nBlockHeight;
-        newLock.nExpiration = GetTime() + (60 * 60); //locks expire after 60 minutes (24 confirmations)
-        newLock.nTimeout = GetTime() + (60 * 5);
-        newLock.txHash = tx.GetHash();
-        mapTxLocks.insert(make_pair(tx.GetHash(), newLock));
-    } else {
-        mapTxLocks[tx.GetHash()].nBlockHeight = nBlockHeight;
-        LogPrint("swiftx", "CreateNewLock - Transaction Lock Exists %s !\n", tx.GetHash().ToString().c_str());
-    }
-
+    txLockManager.SetLockHeight(tx.GetHash(), nBlockHeight);
 
     return nBlockHeight;
 }
@@ -294,7 +259,7 @@ void DoConsensusVote(CTransaction& tx, int64_t nBlockHeight)
         return;
     }
 
-    mapTxLockVote[ctx.GetHash()] = ctx;
+    txLockManager.AddVote(ctx);
 
     CInv inv(MSG_TXLOCK_VOTE, ctx.GetHash());
     RelayInv(inv);
@@ -328,136 +293,48 @@ bool ProcessConsensusVote(CNode* pnode, CConsensusVote& ctx)
         return false;
     }
 
-    if (!mapTxLocks.count(ctx.txHash)) {
-        LogPrintf("SwiftX::ProcessConsensusVote - New Transaction Lock %s !\n", ctx.txHash.ToString().c_str());
-
-        CTransactionLock newLock;
-        newLock.nBlockHeight = 0;
-        newLock.nExpiration = GetTime() + (60 * 60);
-        newLock.nTimeout = GetTime() + (60 * 5);
-        newLock.txHash = ctx.txHash;
-        mapTxLocks.insert(make_pair(ctx.txHash, newLock));
-    } else
-        LogPrint("swiftx", "SwiftX::ProcessConsensusVote - Transaction Lock Exists %s !\n", ctx.txHash.ToString().c_str());
-
     //compile consessus vote
-    std::map<uint256, CTransactionLock>::iterator i = mapTxLocks.find(ctx.txHash);
-    if (i != mapTxLocks.end()) {
-        (*i).second.AddSignature(ctx);
+    int nSignatures = txLockManager.AddSignature(ctx);
 
 #ifdef ENABLE_WALLET
-        if (pwalletMain) {
-            //when we get back signatures, we'll count them as requests. Otherwise the client will think it didn't propagate.
-            if (pwalletMain->mapRequestCount.count(ctx.txHash))
-                pwalletMain->mapRequestCount[ctx.txHash]++;
-        }
+    if (pwalletMain) {
+        //when we get back signatures, we'll count them as requests. Otherwise the client will think it didn't propagate.
+        if (pwalletMain->mapRequestCount.count(ctx.txHash))
+            pwalletMain->mapRequestCount[ctx.txHash]++;
+    }
 #endif
 
-        LogPrint("swiftx", "SwiftX::ProcessConsensusVote - Transaction Lock Votes %d - %s !\n", (*i).second.CountSignatures(), ctx.GetHash().ToString().c_str());
+    LogPrint("swiftx", "SwiftX::ProcessConsensusVote - Transaction Lock Votes %d - %s !\n", nSignatures, ctx.GetHash().ToString().c_str());
 
-        if ((*i).second.CountSignatures() >= SWIFTTX_SIGNATURES_REQUIRED) {
-            LogPrint("swiftx", "SwiftX::ProcessConsensusVote - Transaction Lock Is Complete %s !\n", (*i).second.GetHash().ToString().c_str());
+    if (nSignatures >= SWIFTTX_SIGNATURES_REQUIRED) {
+        LogPrint("swiftx", "SwiftX::ProcessConsensusVote - Transaction Lock Is Complete %s !\n", ctx.txHash.ToString().c_str());
 
-            CTransaction& tx = mapTxLockReq[ctx.txHash];
-            if (!CheckForConflictingLocks(tx)) {
+        if (txLockManager.CompleteLock(ctx.txHash)) {
 #ifdef ENABLE_WALLET
-                if (pwalletMain) {
-                    if (pwalletMain->UpdatedTransaction((*i).second.txHash)) {
-                        nCompleteTXLocks++;
-                    }
-                }
-#endif
-
-                if (mapTxLockReq.count(ctx.txHash)) {
-                    BOOST_FOREACH (const CTxIn& in, tx.vin) {
-                        if (!mapLockedInputs.count(in.prevout)) {
-                            mapLockedInputs.insert(make_pair(in.prevout, ctx.txHash));
-                        }
-                    }
-                }
-
-                // resolve conflicts
-
-                //if this tx lock was rejected, we need to remove the conflicting blocks
-                if (mapTxLockReqRejected.count((*i).second.txHash)) {
-                    //reprocess the last 15 blocks
-                    ReprocessBlocks(15);
+            if (pwalletMain) {
+                if (pwalletMain->UpdatedTransaction(ctx.txHash)) {
+                    nCompleteTXLocks++;
                 }
             }
-        }
-        return true;
-    }
-
-
-    return false;
-}
+#endif
 
-bool CheckForConflictingLocks(CTransaction& tx)
-{
-    /*
-        It's possible (very unlikely though) to get 2 conflicting transaction locks approved by the network.
-        In that case, they will cancel each other out.
+            // resolve conflicts
 
-        Blocks could have been rejected during this time, which is OK. After they cancel out, the client will
-        rescan the blocks and find they're acceptable and then take the chain with the most work.
-    */
-    BOOST_FOREACH (const CTxIn& in, tx.vin) {
-        if (mapLockedInputs.count(in.prevout)) {
-            if (mapLockedInputs[in.prevout] != tx.GetHash()) {
-                LogPrintf("SwiftX::CheckForConflictingLocks - found two complete conflicting locks - removing both. %s %s", tx.GetHash().ToString().c_str(), mapLockedInputs[in.prevout].ToString().c_str());
-                if (mapTxLocks.count(tx.GetHash())) mapTxLocks[tx.GetHash()].nExpiration = GetTime();
-                if (mapTxLocks.count(mapLockedInputs[in.prevout])) mapTxLocks[mapLockedInputs[in.prevout]].nExpiration = GetTime();
-                return true;
+            //if this tx lock was rejected, we need to remove the conflicting blocks
+            if (txLockManager.IsRejected(ctx.txHash)) {
+                //reprocess the last 15 blocks
+                ReprocessBlocks(15);
             }
         }
     }
-
-    return false;
-}
-
-int64_t GetAverageVoteTime()
-{
-    std::map<uint256, int64_t>::iterator it = mapUnknownVotes.begin();
-    int64_t total = 0;
-    int64_t count = 0;
-
-    while (it != mapUnknownVotes.end()) {
-        total += it->second;
-        count++;
-        it++;
-    }
-
-    return total / count;
+    return true;
 }
 
 void CleanTransactionLocksList()
 {
     if (chainActive.Tip() == NULL) return;
 
-    std::map<uint256, CTransactionLock>::iterator it = mapTxLocks.begin();
-
-    while (it != mapTxLocks.end()) {
-        if (GetTime() > it->second.nExpiration) { //keep them for an hour
-            LogPrintf("Removing old transaction lock %s\n", it->second.txHash.ToString().c_str());
-
-            if (mapTxLockReq.count(it->second.txHash)) {
-                CTransaction& tx = mapTxLockReq[it->second.txHash];
-
-                BOOST_FOREACH (const CTxIn& in, tx.vin)
-                    mapLockedInputs.erase(in.prevout);
-
-                mapTxLockReq.erase(it->second.txHash);
-                mapTxLockReqRejected.erase(it->second.txHash);
-
-                BOOST_FOREACH (CConsensusVote& v, it->second.vecConsensusVotes)
-                    mapTxLockVote.erase(v.GetHash());
-            }
-
-            mapTxLocks.erase(it++);
-        } else {
-            it++;
-        }
-    }
+    txLockManager.RemoveExpired(GetTime());
 }
 
 int GetTransactionLockSignatures(uint256 txHash)
@@ -465,10 +342,7 @@ int GetTransactionLockSignatures(uint256 txHash)
     if(fLargeWorkForkFound || fLargeWorkInvalidChainFound) return -2;
     if (!IsSporkActive(SPORK_2_SWIFTTX)) return -1;
 
-    std::map<uint256, CTransactionLock>::iterator it = mapTxLocks.find(txHash);
-    if(it != mapTxLocks.end()) return it->second.CountSignatures();
-
-    return -1;
+    return txLockManager.CountSignatures(txHash);
 }
 
 uint256 CConsensusVote::GetHash() const
@@ -551,12 +425,12 @@ bool CTransactionLock::SignaturesValid()
     return true;
 }
 
-void CTransactionLock::AddSignature(CConsensusVote& cv)
+void CTransactionLock::AddSignature(const CConsensusVote& cv)
 {
     vecConsensusVotes.push_back(cv);
 }
 
-int CTransactionLock::CountSignatures()
+int CTransactionLock::CountSignatures() const
 {
     /*
         Only count signatures where the BlockHeight matches the transaction's blockheight.
@@ -573,3 +447,287 @@ int CTransactionLock::CountSignatures()
     }
     return n;
 }
+
+CTxLockHasher::CTxLockHasher() : salt(GetRandHash()) {}
+
+CTxLockManager::CTxLockManager() : nUnknownVotesTotal(0), nCompleted(0), nExpired(0), nVoteLatencyTotal(0), nVoteLatencyCount(0), nLockLatencyTotal(0), nLockEpoch(0) {}
+
+bool CTxLockManager::HaveRequest(const uint256& txHash) const
+{
+    LOCK(cs);
+    return mapLockRequests.count(txHash) || mapRejectedRequests.count(txHash);
+}
+
+bool CTxLockManager::GetRequest(const uint256& txHash, CTransaction& tx) const
+{
+    LOCK(cs);
+    boost::unordered_map<uint256, CTransaction, CTxLockHasher>::const_iterator it = mapLockRequests.find(txHash);
+    if (it == mapLockRequests.end())
+        return false;
+    tx = it->second;
+    return true;
+}
+
+void CTxLockManager::AddRequest(const CTransaction& tx)
+{
+    LOCK(cs);
+    mapLockRequests.insert(make_pair(tx.GetHash(), tx));
+}
+
+void CTxLockManager::AddRejectedRequest(const CTransaction& tx)
+{
+    LOCK(cs);
+    mapRejectedRequests.insert(make_pair(tx.GetHash(), tx));
+    LockInputs(tx, tx.GetHash());
+}
+
+bool CTxLockManager::IsRejected(const uint256& txHash) const
+{
+    LOCK(cs);
+    return mapRejectedRequests.count(txHash);
+}
+
+bool CTxLockManager::HaveVote(const uint256& hash) const
+{
+    LOCK(cs);
+    return mapVotes.count(hash);
+}
+
+bool CTxLockManager::GetVote(const uint256& hash, CConsensusVote& vote) const
+{
+    LOCK(cs);
+    boost::unordered_map<uint256, CConsensusVote, CTxLockHasher>::const_iterator it = mapVotes.find(hash);
+    if (it == mapVotes.end())
+        return false;
+    vote = it->second;
+    return true;
+}
+
+bool CTxLockManager::AddVote(const CConsensusVote& vote)
+{
+    LOCK(cs);
+    return mapVotes.insert(make_pair(vote.GetHash(), vote)).second;
+}
+
+CTxLockManager::LockMap::iterator CTxLockManager::CreateLock(const uint256& txHash, int nBlockHeight)
+{
+    LockMap::iterator it = mapLocks.find(txHash);
+    if (it != mapLocks.end())
+        return it;
+
+    LogPrintf("SwiftX - New Transaction Lock %s !\n", txHash.ToString().c_str());
+
+    CTransactionLock& lock = mapLocks[txHash];
+    lock.nBlockHeight = nBlockHeight;
+    lock.txHash = txHash;
+    lock.nTimeout = GetTime() + (60 * 5);
+    lock.nTimeCreated = GetTimeMillis();
+    SetExpiration(lock, GetTime() + (60 * 60)); //locks expire after 60 minutes (24 confirmations)
+    return mapLocks.find(txHash);
+}
+
+void CTxLockManager::SetExpiration(CTransactionLock& lock, int64_t nExpiration)
+{
+    if (lock.nExpiration != 0)
+        setExpiry.erase(make_pair((int64_t)lock.nExpiration, lock.txHash));
+    lock.nExpiration = nExpiration;
+    setExpiry.insert(make_pair(nExpiration, lock.txHash));
+}
+
+void CTxLockManager::LockInputs(const CTransaction& tx, const uint256& txHash)
+{
+    BOOST_FOREACH (const CTxIn& in, tx.vin)
+        mapLockedInputs.insert(make_pair(in.prevout, txHash));
+}
+
+void CTxLockManager::SetLockHeight(const uint256& txHash, int nBlockHeight)
+{
+    LOCK(cs);
+    if (mapLocks.count(txHash)) {
+        LogPrint("swiftx", "SwiftX - Transaction Lock Exists %s !\n", txHash.ToString().c_str());
+        CTransactionLock& lock = mapLocks[txHash];
+        // Signatures are counted at the lock height
+        if (lock.nBlockHeight != nBlockHeight)
+            nLockEpoch++;
+        lock.nBlockHeight = nBlockHeight;
+        return;
+    }
+    CreateLock(txHash, nBlockHeight);
+}
+
+int CTxLockManager::AddSignature(const CConsensusVote& vote)
+{
+    LOCK(cs);
+    CTransactionLock& lock = CreateLock(vote.txHash, 0)->second;
+    lock.AddSignature(vote);
+
+    int64_t nNow = GetTimeMillis();
+    nVoteLatencyTotal += nNow - lock.nTimeCreated;
+    nVoteLatencyCount++;
+
+    int nSignatures = lock.CountSignatures();
+    if (nSignatures >= SWIFTTX_SIGNATURES_REQUIRED && !lock.fComplete) {
+        lock.fComplete = true;
+        nCompleted++;
+        nLockEpoch++;
+        nLockLatencyTotal += nNow - lock.nTimeCreated;
+    }
+    return nSignatures;
+}
+
+int CTxLockManager::CountSignatures(const uint256& txHash) const
+{
+    LOCK(cs);
+    LockMap::const_iterator it = mapLocks.find(txHash);
+    if (it == mapLocks.end())
+        return -1;
+    return it->second.CountSignatures();
+}
+
+bool CTxLockManager::IsTimedOut(const uint256& txHash, int64_t nNow) const
+{
+    LOCK(cs);
+    LockMap::const_iterator it = mapLocks.find(txHash);
+    return it != mapLocks.end() && nNow > it->second.nTimeout;
+}
+
+bool CTxLockManager::CompleteLock(const uint256& txHash)
+{
+    LOCK(cs);
+    boost::unordered_map<uint256, CTransaction, CTxLockHasher>::const_iterator it = mapLockRequests.find(txHash);
+    if (it == mapLockRequests.end())
+        return true;
+    if (CheckForConflictingLocks(it->second))
+        return false;
+    LockInputs(it->second, txHash);
+    return true;
+}
+
+bool CTxLockManager::CheckForConflictingLocks(const CTransaction& tx)
+{
+    /*
+        It's possible (very unlikely though) to get 2 conflicting transaction locks approved by the network.
+        In that case, they will cancel each other out.
+
+        Blocks could have been rejected during this time, which is OK. After they cancel out, the client will
+        rescan the blocks and find they're acceptable and then take the chain with the most work.
+    */
+    LOCK(cs);
+    uint256 hashLock;
+    if (!IsConflicting(tx, hashLock))
+        return false;
+
+    LogPrintf("SwiftX::CheckForConflictingLocks - found two complete conflicting locks - removing both. %s %s", tx.GetHash().ToString().c_str(), hashLock.ToString().c_str());
+    LockMap::iterator it = mapLocks.find(tx.GetHash());
+    if (it != mapLocks.end())
+        SetExpiration(it->second, GetTime());
+    it = mapLocks.find(hashLock);
+    if (it != mapLocks.end())
+        SetExpiration(it->second, GetTime());
+    return true;
+}
+
+bool CTxLockManager::IsConflicting(const CTransaction& tx, uint256& hashLock) const
+{
+    LOCK(cs);
+    if (mapLockedInputs.empty())
+        return false;
+    const uint256 txHash = tx.GetHash();
+    BOOST_FOREACH (const CTxIn& in, tx.vin) {
+        boost::unordered_map<COutPoint, uint256, CTxLockHasher>::const_iterator it = mapLockedInputs.find(in.prevout);
+        if (it != mapLockedInputs.end() && it->second != txHash) {
+            hashLock = it->second;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool CTxLockManager::CheckUnknownVote(const uint256& hashMasternode, int64_t nNow)
+{
+    LOCK(cs);
+    boost::unordered_map<uint256, int64_t, CTxLockHasher>::iterator it = mapUnknownVotes.find(hashMasternode);
+    if (it == mapUnknownVotes.end()) {
+        it = mapUnknownVotes.insert(make_pair(hashMasternode, nNow + (60 * 10))).first;
+        nUnknownVotesTotal += it->second;
+    }
+
+    // The running total saves walking all masternodes for the average on every vote
+    int64_t nAverage = nUnknownVotesTotal / (int64_t)mapUnknownVotes.size();
+    if (it->second > nNow && it->second - nAverage > 60 * 10)
+        return false;
+
+    nUnknownVotesTotal += nNow + (60 * 10) - it->second;
+    it->second = nNow + (60 * 10);
+    return true;
+}
+
+void CTxLockManager::RemoveExpired(int64_t nNow)
+{
+    LOCK(cs);
+    while (!setExpiry.empty() && setExpiry.begin()->first < nNow) {
+        const uint256 txHash = setExpiry.begin()->second;
+        setExpiry.erase(setExpiry.begin());
+
+        LogPrintf("Removing old transaction lock %s\n", txHash.ToString().c_str());
+
+        LockMap::iterator itLock = mapLocks.find(txHash);
+        boost::unordered_map<uint256, CTransaction, CTxLockHasher>::iterator itReq = mapLockRequests.find(txHash);
+        if (itReq != mapLockRequests.end()) {
+            BOOST_FOREACH (const CTxIn& in, itReq->second.vin) {
+                boost::unordered_map<COutPoint, uint256, CTxLockHasher>::iterator itIn = mapLockedInputs.find(in.prevout);
+                if (itIn != mapLockedInputs.end() && itIn->second == txHash)
+                    mapLockedInputs.erase(itIn);
+            }
+
+            mapLockRequests.erase(itReq);
+            mapRejectedRequests.erase(txHash);
+
+            if (itLock != mapLocks.end()) {
+                BOOST_FOREACH (const CConsensusVote& v, itLock->second.vecConsensusVotes)
+                    mapVotes.erase(v.GetHash());
+            }
+        }
+
+        if (itLock != mapLocks.end()) {
+            if (itLock->second.fComplete || itLock->second.CountSignatures() >= SWIFTTX_SIGNATURES_REQUIRED)
+                nLockEpoch++;
+            mapLocks.erase(itLock);
+        }
+        nExpired++;
+    }
+
+    // Masternodes whose unknown vote allowance ran out are back to a clean slate anyway
+    boost::unordered_map<uint256, int64_t, CTxLockHasher>::iterator it = mapUnknownVotes.begin();
+    while (it != mapUnknownVotes.end()) {
+        if (it->second < nNow) {
+            nUnknownVotesTotal -= it->second;
+            mapUnknownVotes.erase(it++);
+        } else {
+            it++;
+        }
+    }
+}
+
+uint64_t CTxLockManager::GetLockEpoch() const
+{
+    LOCK(cs);
+    return nLockEpoch;
+}
+
+CTxLockStats CTxLockManager::GetStats() const
+{
+    LOCK(cs);
+    CTxLockStats stats;
+    stats.nRequests = mapLockRequests.size();
+    stats.nRejected = mapRejectedRequests.size();
+    stats.nLocks = mapLocks.size();
+    stats.nVotes = mapVotes.size();
+    stats.nLockedInputs = mapLockedInputs.size();
+    stats.nUnknownVoters = mapUnknownVotes.size();
+    stats.nCompleted = nCompleted;
+    stats.nExpired = nExpired;
+    stats.nAvgVoteLatency = nVoteLatencyCount ? nVoteLatencyTotal / (int64_t)nVoteLatencyCount : 0;
+    stats.nAvgLockLatency = nCompleted ? nLockLatencyTotal / (int64_t)nCompleted : 0;
+    return stats;
+}
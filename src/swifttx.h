@@ -14,6 +14,10 @@
 #include "sync.h"
 #include "util.h"
 
+#include <set>
+
+#include <boost/unordered_map.hpp>
+
 /*
     At 15 signatures, 1/2 of the masternode network can be owned by
     one party without comprimising the security of SwiftX
@@ -35,21 +39,12 @@ class CTransactionLock;
 
 static const int MIN_SWIFTTX_PROTO_VERSION = 70103;
 
-extern map<uint256, CTransaction> mapTxLockReq;
-extern map<uint256, CTransaction> mapTxLockReqRejected;
-extern map<uint256, CConsensusVote> mapTxLockVote;
-extern map<uint256, CTransactionLock> mapTxLocks;
-extern std::map<COutPoint, uint256> mapLockedInputs;
 extern int nCompleteTXLocks;
 
-
 int64_t CreateNewLock(CTransaction tx);
 
 bool IsIXTXValid(const CTransaction& txCollateral);
 
-// if two conflicting locks are approved by the network, they will cancel out
-bool CheckForConflictingLocks(CTransaction& tx);
-
 void ProcessMessageSwiftTX(CNode* pfrom, std::string& strCommand, CDataStream& vRecv);
 
 //check if we need to vote on this transaction
@@ -64,8 +59,6 @@ void CleanTransactionLocksList();
 // get the accepted transaction lock signatures
 int GetTransactionLockSignatures(uint256 txHash);
 
-int64_t GetAverageVoteTime();
-
 class CConsensusVote
 {
 public:
@@ -99,10 +92,14 @@ public:
     std::vector<CConsensusVote> vecConsensusVotes;
     int nExpiration;
     int nTimeout;
+    int64_t nTimeCreated; //!< in milliseconds, for vote latency statistics
+    bool fComplete;       //!< reached SWIFTTX_SIGNATURES_REQUIRED before
+
+    CTransactionLock() : nBlockHeight(0), nExpiration(0), nTimeout(0), nTimeCreated(0), fComplete(false) {}
 
     bool SignaturesValid();
-    int CountSignatures();
-    void AddSignature(CConsensusVote& cv);
+    int CountSignatures() const;
+    void AddSignature(const CConsensusVote& cv);
 
     uint256 GetHash()
     {
@@ -110,5 +107,127 @@ public:
     }
 };
 
+/** Salted hash of lock index keys, which are chosen by whoever sends them */
+class CTxLockHasher
+{
+private:
+    uint256 salt;
+
+public:
+    CTxLockHasher();
+
+    size_t operator()(const uint256& hash) const
+    {
+        return hash.GetHash(salt);
+    }
+
+    size_t operator()(const COutPoint& outpoint) const
+    {
+        return outpoint.hash.GetHash(salt) ^ ((uint64_t)outpoint.n * 0x9E3779B97F4A7C15ULL);
+    }
+};
+
+/** Snapshot of the lock manager's counters, see getswifttxinfo */
+struct CTxLockStats {
+    size_t nRequests;
+    size_t nRejected;
+    size_t nLocks;
+    size_t nVotes;
+    size_t nLockedInputs;
+    size_t nUnknownVoters;
+    uint64_t nCompleted;       //!< locks that reached the required signatures since startup
+    uint64_t nExpired;         //!< locks removed by RemoveExpired since startup
+    int64_t nAvgVoteLatency;   //!< ms between a lock being created and a vote for it arriving
+    int64_t nAvgLockLatency;   //!< ms between a lock being created and it completing
+};
+
+/**
+ * All SwiftX state: lock requests, votes, the locks they make up and the
+ * inputs complete locks claim. Everything is guarded by one mutex of its own
+ * so that block and mempool checks do not contend with cs_main holders.
+ *
+ * Requests, votes and locks are in hash maps; locked inputs are indexed by
+ * outpoint so a conflict check costs one lookup per input. Locks are also
+ * kept in a queue ordered by expiration time, so RemoveExpired only touches
+ * the locks that actually expire.
+ */
+class CTxLockManager
+{
+private:
+    typedef boost::unordered_map<uint256, CTransactionLock, CTxLockHasher> LockMap;
+    typedef std::set<std::pair<int64_t, uint256> > ExpiryQueue;
+
+    mutable CCriticalSection cs;
+
+    boost::unordered_map<uint256, CTransaction, CTxLockHasher> mapLockRequests;
+    boost::unordered_map<uint256, CTransaction, CTxLockHasher> mapRejectedRequests;
+    boost::unordered_map<uint256, CConsensusVote, CTxLockHasher> mapVotes;
+    LockMap mapLocks;
+    ExpiryQueue setExpiry;
+    boost::unordered_map<COutPoint, uint256, CTxLockHasher> mapLockedInputs;
+
+    // Votes for transactions we have no request for, by masternode, for DoS protection
+    boost::unordered_map<uint256, int64_t, CTxLockHasher> mapUnknownVotes;
+    int64_t nUnknownVotesTotal;
+
+    uint64_t nCompleted;
+    uint64_t nExpired;
+    int64_t nVoteLatencyTotal;
+    uint64_t nVoteLatencyCount;
+    int64_t nLockLatencyTotal;
+    uint64_t nLockEpoch;
+
+    LockMap::iterator CreateLock(const uint256& txHash, int nBlockHeight);
+    void SetExpiration(CTransactionLock& lock, int64_t nExpiration);
+    void LockInputs(const CTransaction& tx, const uint256& txHash);
+
+public:
+    CTxLockManager();
+
+    bool HaveRequest(const uint256& txHash) const;
+    bool GetRequest(const uint256& txHash, CTransaction& tx) const;
+    void AddRequest(const CTransaction& tx);
+    /** A request we could not accept; its inputs are claimed for it all the same */
+    void AddRejectedRequest(const CTransaction& tx);
+    bool IsRejected(const uint256& txHash) const;
+
+    bool HaveVote(const uint256& hash) const;
+    bool GetVote(const uint256& hash, CConsensusVote& vote) const;
+    /** Store a vote by its hash; false if it was already known */
+    bool AddVote(const CConsensusVote& vote);
+
+    /** Create the lock of a transaction or update the height its votes must be for */
+    void SetLockHeight(const uint256& txHash, int nBlockHeight);
+    /** Add a vote to its transaction's lock, creating the lock when needed.
+     *  Returns the number of signatures the lock has now. */
+    int AddSignature(const CConsensusVote& vote);
+    /** Signature count of a lock, -1 if there is no lock for the transaction */
+    int CountSignatures(const uint256& txHash) const;
+    bool IsTimedOut(const uint256& txHash, int64_t nNow) const;
+
+    /** Claim the inputs of a complete lock. False if it conflicts with another lock, see CheckForConflictingLocks. */
+    bool CompleteLock(const uint256& txHash);
+    /** If two conflicting locks are approved by the network they cancel out: expire both */
+    bool CheckForConflictingLocks(const CTransaction& tx);
+    /** Whether an input of tx is claimed by a lock on another transaction */
+    bool IsConflicting(const CTransaction& tx, uint256& hashLock) const;
+
+    /**
+     * Track a vote for a transaction we have no request for. Returns false if
+     * the masternode that cast it sends those faster than the network does.
+     */
+    bool CheckUnknownVote(const uint256& hashMasternode, int64_t nNow);
+
+    /** Remove locks past their expiration, with their requests, votes and inputs */
+    void RemoveExpired(int64_t nNow);
+
+    /** Bumped whenever a lock completes, changes height or is removed while complete, i.e. whenever
+     *  a transaction's SwiftTX depth may change; callers caching it compare epochs */
+    uint64_t GetLockEpoch() const;
+
+    CTxLockStats GetStats() const;
+};
+
+extern CTxLockManager txLockManager;
 
 #endif
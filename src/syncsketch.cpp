@@ -0,0 +1,147 @@
+// Copyright (c) 2019 The TRBO developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "syncsketch.h"
+
+#include "hash.h"
+#include "random.h"
+#include "uint256.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <limits>
+#include <map>
+
+using namespace std;
+
+//! Every id is added to one cell in each third of the sketch
+static const unsigned int SKETCH_HASH_FUNCS = 3;
+
+/** Mix the bits of a 64-bit value (the splitmix64 finalizer) */
+static uint64_t Mix(uint64_t n)
+{
+    n = (n ^ (n >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    n = (n ^ (n >> 27)) * 0x94d049bb133111ebULL;
+    return n ^ (n >> 31);
+}
+
+static uint64_t CheckSum(uint64_t nId)
+{
+    return Mix(nId ^ 0x5bd1e9955bd1e995ULL);
+}
+
+CSyncSketch::CSyncSketch(uint64_t nKey0In, uint64_t nKey1In, unsigned int nCells) : nKey0(nKey0In), nKey1(nKey1In)
+{
+    nCells = std::min(std::max(nCells, SKETCH_HASH_FUNCS), MAX_SYNC_SKETCH_CELLS);
+    vCells.resize(nCells - nCells % SKETCH_HASH_FUNCS);
+}
+
+CSyncSketch CSyncSketch::ForKeys(const std::vector<uint256>& vKeys)
+{
+    CSyncSketch sketch(GetRand(std::numeric_limits<uint64_t>::max()), GetRand(std::numeric_limits<uint64_t>::max()),
+        std::max(MIN_SYNC_SKETCH_CELLS, (unsigned int)vKeys.size() / SYNC_SKETCH_ITEMS_PER_CELL));
+    for (const uint256& key : vKeys)
+        sketch.Insert(key);
+    return sketch;
+}
+
+uint64_t CSyncSketch::GetShortID(const uint256& key) const
+{
+    return CSipHasher(nKey0, nKey1).Write(key.begin(), key.size()).Finalize();
+}
+
+void CSyncSketch::Update(uint64_t nId, int nDelta)
+{
+    unsigned int nPart = vCells.size() / SKETCH_HASH_FUNCS;
+    uint64_t nCheckSum = CheckSum(nId);
+    for (unsigned int i = 0; i < SKETCH_HASH_FUNCS; i++) {
+        Cell& cell = vCells[i * nPart + Mix(nId + i) % nPart];
+        cell.nCount += nDelta;
+        cell.nIdSum ^= nId;
+        cell.nCheckSum ^= nCheckSum;
+    }
+}
+
+void CSyncSketch::Insert(const uint256& key)
+{
+    Update(GetShortID(key), 1);
+}
+
+void CSyncSketch::Subtract(const CSyncSketch& other)
+{
+    assert(other.nKey0 == nKey0 && other.nKey1 == nKey1 && other.vCells.size() == vCells.size());
+    for (unsigned int i = 0; i < vCells.size(); i++) {
+        vCells[i].nCount -= other.vCells[i].nCount;
+        vCells[i].nIdSum ^= other.vCells[i].nIdSum;
+        vCells[i].nCheckSum ^= other.vCells[i].nCheckSum;
+    }
+}
+
+bool CSyncSketch::Decode(std::set<uint64_t>& setAdded, std::set<uint64_t>& setRemoved) const
+{
+    setAdded.clear();
+    setRemoved.clear();
+
+    // Peel off cells holding a single id, which may leave others with one
+    CSyncSketch sketch(*this);
+    std::vector<unsigned int> vPure;
+    for (unsigned int i = 0; i < sketch.vCells.size(); i++)
+        vPure.push_back(i);
+    while (!vPure.empty()) {
+        const Cell& cell = sketch.vCells[vPure.back()];
+        vPure.pop_back();
+        if ((cell.nCount != 1 && cell.nCount != -1) || cell.nCheckSum != CheckSum(cell.nIdSum))
+            continue;
+
+        uint64_t nId = cell.nIdSum;
+        int nCount = cell.nCount;
+        // An id found twice, or more ids than cells, means the cells are inconsistent
+        if (!(nCount > 0 ? setAdded : setRemoved).insert(nId).second || setAdded.size() + setRemoved.size() > sketch.vCells.size())
+            return false;
+        sketch.Update(nId, -nCount);
+
+        unsigned int nPart = sketch.vCells.size() / SKETCH_HASH_FUNCS;
+        for (unsigned int i = 0; i < SKETCH_HASH_FUNCS; i++)
+            vPure.push_back(i * nPart + Mix(nId + i) % nPart);
+    }
+
+    for (const Cell& cell : sketch.vCells) {
+        if (cell.nCount != 0 || cell.nIdSum != 0 || cell.nCheckSum != 0)
+            return false;
+    }
+    return true;
+}
+
+bool CSyncSketch::GetMissing(const std::vector<uint256>& vKeys, std::vector<size_t>& vMissing) const
+{
+    vMissing.clear();
+    if (!IsWithinSizeConstraints())
+        return false;
+
+    CSyncSketch sketch(nKey0, nKey1, vCells.size());
+    std::map<uint64_t, size_t> mapIds;
+    for (size_t i = 0; i < vKeys.size(); i++) {
+        uint64_t nId = sketch.GetShortID(vKeys[i]);
+        if (mapIds.insert(make_pair(nId, i)).second)
+            sketch.Update(nId, 1);
+    }
+    sketch.Subtract(*this);
+
+    std::set<uint64_t> setAdded, setRemoved;
+    if (!sketch.Decode(setAdded, setRemoved))
+        return false;
+    for (uint64_t nId : setAdded) {
+        std::map<uint64_t, size_t>::const_iterator it = mapIds.find(nId);
+        if (it == mapIds.end())
+            return false;
+        vMissing.push_back((*it).second);
+    }
+    std::sort(vMissing.begin(), vMissing.end());
+    return true;
+}
+
+bool CSyncSketch::IsWithinSizeConstraints() const
+{
+    return vCells.size() >= SKETCH_HASH_FUNCS && vCells.size() <= MAX_SYNC_SKETCH_CELLS && vCells.size() % SKETCH_HASH_FUNCS == 0;
+}
@@ -0,0 +1,112 @@
+// Copyright (c) 2019 The TRBO developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_SYNCSKETCH_H
+#define BITCOIN_SYNCSKETCH_H
+
+#include "serialize.h"
+
+#include <set>
+#include <stdint.h>
+#include <vector>
+
+class uint256;
+
+//! Limit on the cells of a received sketch, 600 kB
+static const unsigned int MAX_SYNC_SKETCH_CELLS = 30000;
+//! Fewest cells a sketch is created with, enough to decode a few dozen differences
+static const unsigned int MIN_SYNC_SKETCH_CELLS = 120;
+//! A sketch gets one cell for every this many items
+static const unsigned int SYNC_SKETCH_ITEMS_PER_CELL = 3;
+
+/**
+ * Sketch of a set of items, used to sync the masternode list, payment votes
+ * and budgets with a peer without sending what the peer already has.
+ *
+ * The syncing node sends a sketch of the keys of its items, where the key of
+ * an item changes with every new version of it. The peer subtracts that from
+ * a sketch of its own items with the same parameters, and what remains only
+ * depends on the items one of them has and the other has not. As long as
+ * there are fewer of those than about two thirds of the cells, they can be
+ * decoded, and the peer only sends the items the syncing node is missing.
+ * When they cannot be decoded the peer sends everything, as it would for a
+ * request without a sketch.
+ *
+ * This is an invertible Bloom lookup table of 64-bit short ids, salted with
+ * a random key chosen by the syncing node, so that colliding short ids do not
+ * persist between syncs.
+ */
+class CSyncSketch
+{
+public:
+    struct Cell {
+        int32_t nCount;
+        uint64_t nIdSum;
+        uint64_t nCheckSum;
+
+        Cell() : nCount(0), nIdSum(0), nCheckSum(0) {}
+
+        ADD_SERIALIZE_METHODS;
+
+        template <typename Stream, typename Operation>
+        inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+        {
+            READWRITE(nCount);
+            READWRITE(nIdSum);
+            READWRITE(nCheckSum);
+        }
+    };
+
+private:
+    uint64_t nKey0;
+    uint64_t nKey1;
+    std::vector<Cell> vCells;
+
+    void Update(uint64_t nId, int nDelta);
+
+public:
+    CSyncSketch() : nKey0(0), nKey1(0) {}
+    CSyncSketch(uint64_t nKey0In, uint64_t nKey1In, unsigned int nCells);
+
+    /** Create a sketch of the keys with a random salt, sized to decode a difference of about a quarter of them */
+    static CSyncSketch ForKeys(const std::vector<uint256>& vKeys);
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        READWRITE(nKey0);
+        READWRITE(nKey1);
+        READWRITE(vCells);
+    }
+
+    uint64_t GetShortID(const uint256& key) const;
+    void Insert(const uint256& key);
+
+    /** Remove the items of another sketch with the same salt and size */
+    void Subtract(const CSyncSketch& other);
+
+    /**
+     * Decode the ids the sketch holds: those with a positive count go to
+     * setAdded and those with a negative count, left over from a subtracted
+     * sketch, to setRemoved. Returns false if the sketch holds too many items
+     * to decode, in which case the sets are incomplete.
+     */
+    bool Decode(std::set<uint64_t>& setAdded, std::set<uint64_t>& setRemoved) const;
+
+    /**
+     * Find which of our keys the node that created this sketch is missing:
+     * the index in vKeys of each of them is put in vMissing. Returns false
+     * if the sets differ too much to tell.
+     */
+    bool GetMissing(const std::vector<uint256>& vKeys, std::vector<size_t>& vMissing) const;
+
+    unsigned int GetCells() const { return vCells.size(); }
+
+    //! True if the sketch has a usable number of cells (catch a sketch which was just deserialized)
+    bool IsWithinSizeConstraints() const;
+};
+
+#endif // BITCOIN_SYNCSKETCH_H
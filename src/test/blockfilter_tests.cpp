@@ -0,0 +1,148 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockfilter.h"
+
+#include "main.h"
+#include "script/script.h"
+#include "streams.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(blockfilter_tests)
+
+BOOST_AUTO_TEST_CASE(gcsfilter_test)
+{
+    CGCSFilter::ElementSet included_elements, excluded_elements;
+    for (int i = 0; i < 100; ++i) {
+        CGCSFilter::Element element1(32);
+        element1[0] = i;
+        included_elements.insert(element1);
+
+        CGCSFilter::Element element2(32);
+        element2[1] = i;
+        excluded_elements.insert(element2);
+    }
+
+    CGCSFilter filter(CGCSFilter::Params(0, 0, 10, 1 << 10), included_elements);
+    BOOST_FOREACH (const CGCSFilter::Element& element, included_elements) {
+        BOOST_CHECK(filter.Match(element));
+
+        std::pair<CGCSFilter::ElementSet::iterator, bool> insertion = excluded_elements.insert(element);
+        BOOST_CHECK(filter.MatchAny(excluded_elements));
+        if (insertion.second)
+            excluded_elements.erase(insertion.first);
+    }
+
+    // Reconstructing from the encoding gives the same filter
+    CGCSFilter filter2(filter.GetParams(), filter.GetEncoded());
+    BOOST_CHECK_EQUAL(filter2.GetN(), filter.GetN());
+    BOOST_CHECK(filter2.GetEncoded() == filter.GetEncoded());
+    BOOST_CHECK(filter2.MatchAny(included_elements));
+
+    // Trailing garbage is rejected
+    std::vector<unsigned char> vBad = filter.GetEncoded();
+    vBad.push_back(0);
+    BOOST_CHECK_THROW(CGCSFilter(filter.GetParams(), vBad), std::ios_base::failure);
+}
+
+BOOST_AUTO_TEST_CASE(gcsfilter_default_constructor)
+{
+    CGCSFilter filter;
+    BOOST_CHECK_EQUAL(filter.GetN(), 0U);
+    BOOST_CHECK_EQUAL(filter.GetEncoded().size(), 1U);
+
+    const CGCSFilter::Params& params = filter.GetParams();
+    BOOST_CHECK_EQUAL(params.nSipHashK0, 0U);
+    BOOST_CHECK_EQUAL(params.nSipHashK1, 0U);
+    BOOST_CHECK_EQUAL(params.nP, 0);
+    BOOST_CHECK_EQUAL(params.nM, 1U);
+}
+
+BOOST_AUTO_TEST_CASE(blockfilter_basic_test)
+{
+    CScript included_scripts[5], excluded_scripts[3];
+
+    // First two are outputs on a single transaction.
+    included_scripts[0] << std::vector<unsigned char>(0, 65) << OP_CHECKSIG;
+    included_scripts[1] << OP_DUP << OP_HASH160 << std::vector<unsigned char>(1, 20) << OP_EQUALVERIFY << OP_CHECKSIG;
+
+    // Third is an output in a second transaction.
+    included_scripts[2] << OP_1 << std::vector<unsigned char>(2, 33) << OP_1 << OP_CHECKMULTISIG;
+
+    // Last two are spent by a single transaction.
+    included_scripts[3] << OP_0 << std::vector<unsigned char>(3, 32);
+    included_scripts[4] << OP_4 << OP_ADD << OP_8 << OP_EQUAL;
+
+    // OP_RETURN output is an output on the second transaction.
+    excluded_scripts[0] << OP_RETURN << std::vector<unsigned char>(4, 40);
+
+    // This script is not related to the block at all.
+    excluded_scripts[1] << std::vector<unsigned char>(5, 33) << OP_CHECKSIG;
+
+    // Empty scripts, like the first output of a coinstake, are not included.
+    excluded_scripts[2] = CScript();
+
+    CMutableTransaction tx_1;
+    tx_1.vout.push_back(CTxOut(100, included_scripts[0]));
+    tx_1.vout.push_back(CTxOut(200, included_scripts[1]));
+    tx_1.vout.push_back(CTxOut(0, excluded_scripts[2]));
+
+    CMutableTransaction tx_2;
+    tx_2.vout.push_back(CTxOut(300, included_scripts[2]));
+    tx_2.vout.push_back(CTxOut(0, excluded_scripts[0]));
+
+    CBlock block;
+    block.vtx.push_back(tx_1);
+    block.vtx.push_back(tx_2);
+
+    CBlockUndo block_undo;
+    block_undo.vtxundo.push_back(CTxUndo());
+    block_undo.vtxundo.back().vprevout.push_back(CTxInUndo(CTxOut(400, included_scripts[3])));
+    block_undo.vtxundo.back().vprevout.push_back(CTxInUndo(CTxOut(500, included_scripts[4])));
+
+    CBlockFilter block_filter(BLOCK_FILTER_BASIC, block, block_undo);
+    const CGCSFilter& filter = block_filter.GetFilter();
+
+    BOOST_CHECK_EQUAL(filter.GetN(), 5U);
+    for (unsigned int i = 0; i < 5; i++)
+        BOOST_CHECK(filter.Match(CGCSFilter::Element(included_scripts[i].begin(), included_scripts[i].end())));
+    for (unsigned int i = 0; i < 3; i++)
+        BOOST_CHECK(!filter.Match(CGCSFilter::Element(excluded_scripts[i].begin(), excluded_scripts[i].end())));
+
+    // Test serialization/unserialization.
+    CBlockFilter block_filter2;
+
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    stream << block_filter;
+    stream >> block_filter2;
+
+    BOOST_CHECK_EQUAL(block_filter.GetFilterType(), block_filter2.GetFilterType());
+    BOOST_CHECK(block_filter.GetBlockHash() == block_filter2.GetBlockHash());
+    BOOST_CHECK(block_filter.GetEncodedFilter() == block_filter2.GetEncodedFilter());
+    BOOST_CHECK(block_filter.GetHash() == block_filter2.GetHash());
+
+    // Filter headers chain on the previous header
+    uint256 header = block_filter.ComputeHeader(uint256());
+    BOOST_CHECK(header != block_filter.ComputeHeader(header));
+
+    CBlockFilter default_ctor_block_filter_1;
+    CBlockFilter default_ctor_block_filter_2;
+    BOOST_CHECK_EQUAL(default_ctor_block_filter_1.GetFilterType(), default_ctor_block_filter_2.GetFilterType());
+    BOOST_CHECK(default_ctor_block_filter_1.GetBlockHash() == default_ctor_block_filter_2.GetBlockHash());
+}
+
+BOOST_AUTO_TEST_CASE(blockfilter_type_names)
+{
+    BOOST_CHECK_EQUAL(BlockFilterTypeName(BLOCK_FILTER_BASIC), "basic");
+    BOOST_CHECK_EQUAL(BlockFilterTypeName(BLOCK_FILTER_INVALID), "");
+
+    BlockFilterType filterType;
+    BOOST_CHECK(BlockFilterTypeByName("basic", filterType));
+    BOOST_CHECK_EQUAL(filterType, BLOCK_FILTER_BASIC);
+
+    BOOST_CHECK(!BlockFilterTypeByName("unknown", filterType));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,122 @@
+// Copyright (c) 2019 The TRBO developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "checkqueue.h"
+
+#include <atomic>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(checkqueue_tests)
+
+static std::atomic<unsigned int> nEvaluated(0);
+
+/** Counts its evaluations, and fails if constructed to */
+struct CCountingCheck {
+    bool fOk;
+
+    CCountingCheck(bool fOkIn = true) : fOk(fOkIn) {}
+
+    bool operator()()
+    {
+        nEvaluated++;
+        return fOk;
+    }
+
+    void swap(CCountingCheck& check)
+    {
+        std::swap(fOk, check.fOk);
+    }
+};
+
+static void RunChecks(CCheckQueue<CCountingCheck>& queue, unsigned int nChecks, unsigned int nPerAdd, int nFailAt, bool fExpected)
+{
+    CCheckQueueControl<CCountingCheck> control(&queue);
+    for (unsigned int i = 0; i < nChecks; i += nPerAdd) {
+        std::vector<CCountingCheck> vChecks;
+        for (unsigned int j = i; j < std::min(nChecks, i + nPerAdd); j++)
+            vChecks.push_back(CCountingCheck((int)j != nFailAt));
+        control.Add(vChecks);
+    }
+    BOOST_CHECK_EQUAL(control.Wait(), fExpected);
+}
+
+BOOST_AUTO_TEST_CASE(checkqueue_all_evaluated)
+{
+    CCheckQueue<CCountingCheck> queue(128);
+    boost::thread_group threadGroup;
+    for (int i = 0; i < 7; i++)
+        threadGroup.create_thread(boost::bind(&CCheckQueue<CCountingCheck>::Thread, boost::ref(queue)));
+
+    // One check per Add, as for single input transactions, and large batches
+    const unsigned int nPerAdd[] = {1, 3, 100, 10000};
+    for (unsigned int n : nPerAdd) {
+        nEvaluated = 0;
+        RunChecks(queue, 10000, n, -1, true);
+        BOOST_CHECK_EQUAL(nEvaluated, 10000U);
+        BOOST_CHECK(queue.IsIdle());
+
+        CCheckQueueStats stats = queue.GetStats();
+        BOOST_CHECK_EQUAL(stats.nChecks, 10000U);
+        BOOST_CHECK(stats.nThreads >= 1 && stats.nThreads <= 8);
+        BOOST_CHECK(stats.Utilization() >= 0.0 && stats.Utilization() <= 1.0);
+    }
+
+    // Nothing added at all
+    RunChecks(queue, 0, 1, -1, true);
+    BOOST_CHECK(queue.IsIdle());
+
+    threadGroup.interrupt_all();
+    threadGroup.join_all();
+}
+
+BOOST_AUTO_TEST_CASE(checkqueue_failure)
+{
+    CCheckQueue<CCountingCheck> queue(128);
+    boost::thread_group threadGroup;
+    for (int i = 0; i < 3; i++)
+        threadGroup.create_thread(boost::bind(&CCheckQueue<CCountingCheck>::Thread, boost::ref(queue)));
+
+    for (int nFailAt : {0, 4999, 9999}) {
+        nEvaluated = 0;
+        RunChecks(queue, 10000, 50, nFailAt, false);
+        BOOST_CHECK_EQUAL(queue.GetStats().nChecks, nEvaluated);
+        // The failure is not carried over to the next round
+        BOOST_CHECK(queue.IsIdle());
+        RunChecks(queue, 1000, 50, -1, true);
+    }
+
+    // When every check fails, no thread gets past the first one it evaluates,
+    // and the rest are discarded
+    nEvaluated = 0;
+    {
+        CCheckQueueControl<CCountingCheck> control(&queue);
+        std::vector<CCountingCheck> vChecks(10000, CCountingCheck(false));
+        control.Add(vChecks);
+        BOOST_CHECK(!control.Wait());
+    }
+    BOOST_CHECK(nEvaluated >= 1U && nEvaluated <= 4U);
+    BOOST_CHECK_EQUAL(queue.GetStats().nChecks, nEvaluated);
+    BOOST_CHECK(queue.IsIdle());
+
+    threadGroup.interrupt_all();
+    threadGroup.join_all();
+}
+
+BOOST_AUTO_TEST_CASE(checkqueue_master_only)
+{
+    // Without worker threads the master evaluates everything in Wait
+    CCheckQueue<CCountingCheck> queue(128);
+    nEvaluated = 0;
+    RunChecks(queue, 1000, 7, -1, true);
+    BOOST_CHECK_EQUAL(nEvaluated, 1000U);
+    BOOST_CHECK_EQUAL(queue.GetStats().nSteals, 0U);
+    RunChecks(queue, 1000, 7, 500, false);
+    BOOST_CHECK(queue.IsIdle());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,156 @@
+// Copyright (c) 2019 The TRBO developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "coinstatsindex.h"
+
+#include "chainparams.h"
+#include "coins.h"
+#include "main.h"
+#include "primitives/block.h"
+#include "txdb.h"
+#include "undo.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(coinstatsindex_tests)
+
+static uint256 MuHashFinalize(const CCoinStatsIndexEntry& entry)
+{
+    uint256 hash;
+    entry.muhash.Finalize(hash.begin());
+    return hash;
+}
+
+static void CheckStatsEqual(const CCoinStatsIndexEntry& a, const CCoinStatsIndexEntry& b)
+{
+    BOOST_CHECK(MuHashFinalize(a) == MuHashFinalize(b));
+    BOOST_CHECK_EQUAL(a.nTransactionOutputs, b.nTransactionOutputs);
+    BOOST_CHECK_EQUAL(a.nBogoSize, b.nBogoSize);
+    BOOST_CHECK_EQUAL(a.nTotalAmount, b.nTotalAmount);
+}
+
+/** The index statistics must agree with what GetStats scans from the coin database */
+static void CheckStatsMatchCoins(const CCoinStatsIndexEntry& entry, CCoinsViewDB& coinsdb)
+{
+    CCoinsStats stats;
+    BOOST_CHECK(coinsdb.GetStats(stats));
+    BOOST_CHECK_EQUAL(entry.nTransactionOutputs, stats.nTransactionOutputs);
+    BOOST_CHECK_EQUAL(entry.nTotalAmount, stats.nTotalAmount);
+
+    CCoinStatsIndexEntry scanned;
+    BOOST_CHECK(ComputeCoinStats(&coinsdb, scanned));
+    CheckStatsEqual(entry, scanned);
+}
+
+/** Connect the transactions of block to view the way ConnectBlock does, keeping the undo data */
+static void ConnectTransactions(const CBlock& block, CCoinsViewCache& view, CBlockUndo& blockundo, int nHeight)
+{
+    CTxUndo undoDummy;
+    for (unsigned int i = 0; i < block.vtx.size(); i++) {
+        CValidationState state;
+        if (i > 0)
+            blockundo.vtxundo.push_back(CTxUndo());
+        UpdateCoins(block.vtx[i], state, view, i == 0 ? undoDummy : blockundo.vtxundo.back(), nHeight);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(coinstatsindex_apply_block)
+{
+    const uint256 hashGenesis = Params().HashGenesisBlock();
+    CCoinsViewDB coinsdb(1 << 20, true);
+
+    // The coins the block spends from
+    CBlock blockPrev;
+    CMutableTransaction coinbasePrev;
+    coinbasePrev.vin.resize(1);
+    coinbasePrev.vin[0].scriptSig = CScript() << 1 << OP_0;
+    coinbasePrev.vout.push_back(CTxOut(50 * COIN, CScript() << OP_TRUE));
+    coinbasePrev.vout.push_back(CTxOut(25 * COIN, CScript() << OP_2));
+    coinbasePrev.vout.push_back(CTxOut(10 * COIN, CScript() << OP_3 << OP_DROP << OP_TRUE));
+    blockPrev.vtx.push_back(coinbasePrev);
+    {
+        CCoinsViewCache view(&coinsdb);
+        CBlockUndo blockundo;
+        ConnectTransactions(blockPrev, view, blockundo, 1);
+        view.SetBestBlock(hashGenesis);
+        BOOST_CHECK(view.Flush());
+    }
+
+    CCoinStatsIndexEntry entry;
+    BOOST_CHECK(ComputeCoinStats(&coinsdb, entry));
+    BOOST_CHECK_EQUAL(entry.nTransactionOutputs, 3U);
+    CheckStatsMatchCoins(entry, coinsdb);
+
+    // A coinbase with an unspendable output, a transaction spending two of the
+    // coins and one spending an output created earlier in the same block
+    CBlock block;
+    CMutableTransaction coinbase;
+    coinbase.vin.resize(1);
+    coinbase.vin[0].scriptSig = CScript() << 2 << OP_0;
+    coinbase.vout.push_back(CTxOut(50 * COIN, CScript() << OP_TRUE));
+    coinbase.vout.push_back(CTxOut(0, CScript() << OP_RETURN));
+    block.vtx.push_back(coinbase);
+
+    CMutableTransaction spend;
+    spend.vin.push_back(CTxIn(COutPoint(blockPrev.vtx[0].GetHash(), 0)));
+    spend.vin.push_back(CTxIn(COutPoint(blockPrev.vtx[0].GetHash(), 2)));
+    spend.vout.push_back(CTxOut(30 * COIN, CScript() << OP_4));
+    spend.vout.push_back(CTxOut(29 * COIN, CScript() << OP_5));
+    block.vtx.push_back(spend);
+
+    CMutableTransaction chained;
+    chained.vin.push_back(CTxIn(COutPoint(block.vtx[1].GetHash(), 1)));
+    chained.vout.push_back(CTxOut(28 * COIN, CScript() << OP_6));
+    block.vtx.push_back(chained);
+
+    CBlockUndo blockundo;
+    {
+        CCoinsViewCache view(&coinsdb);
+        ConnectTransactions(block, view, blockundo, 2);
+        view.SetBestBlock(hashGenesis);
+        BOOST_CHECK(view.Flush());
+    }
+
+    // What the index stores for the block is what a scan of the coins finds
+    BOOST_CHECK(ApplyBlockToCoinStats(entry, block, blockundo));
+    BOOST_CHECK_EQUAL(entry.nTransactionOutputs, 4U);
+    BOOST_CHECK_EQUAL(entry.nTotalAmount, 133 * COIN);
+    CheckStatsMatchCoins(entry, coinsdb);
+
+    // Undo data that does not belong to the block is refused
+    blockundo.vtxundo.pop_back();
+    BOOST_CHECK(!ApplyBlockToCoinStats(entry, block, blockundo));
+}
+
+BOOST_AUTO_TEST_CASE(coinstatsindex_seed)
+{
+    CCoinsViewDB coinsdb(1 << 20, true);
+    {
+        CCoinsViewCache view(&coinsdb);
+        CCoinsModifier coins = view.ModifyCoins(uint256(1));
+        coins->nVersion = 1;
+        coins->nHeight = 1;
+        coins->vout.push_back(CTxOut(7 * COIN, CScript() << OP_TRUE));
+        coins->vout.push_back(CTxOut(3 * COIN, CScript() << OP_2));
+        view.SetBestBlock(Params().HashGenesisBlock());
+        BOOST_CHECK(view.Flush());
+    }
+
+    // A snapshot's coins start the index at its block
+    CCoinStatsIndex index(1 << 20, true);
+    BOOST_CHECK(index.SeedFromCoins(&coinsdb));
+    CCoinStatsIndexEntry entry;
+    {
+        LOCK(cs_main);
+        BOOST_CHECK(index.LookupStats(chainActive.Genesis(), entry));
+    }
+    BOOST_CHECK_EQUAL(entry.nTotalAmount, 10 * COIN);
+    CheckStatsMatchCoins(entry, coinsdb);
+
+    // The sync has nothing left to do and did not stall
+    index.Sync();
+    BOOST_CHECK(index.GetStalledReason().empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -9,6 +9,7 @@
 #include "crypto/sha512.h"
 #include "crypto/hmac_sha256.h"
 #include "crypto/hmac_sha512.h"
+#include "crypto/muhash.h"
 #include "random.h"
 #include "utilstrencodings.h"
 
@@ -306,4 +307,99 @@ BOOST_AUTO_TEST_CASE(rfc6979_hmac_sha256)
             ("7597887cbd76321f32e30440679a22cf7f8d9d2eac390e581fea091ce202ba94"));
 }
 
+static uint256 MuHashFinalize(const MuHash3072& muhash)
+{
+    uint256 hash;
+    muhash.Finalize(hash.begin());
+    return hash;
+}
+
+BOOST_AUTO_TEST_CASE(muhash_tests)
+{
+    std::vector<uint256> elements;
+    for (int i = 0; i < 8; i++)
+        elements.push_back(GetRandHash());
+
+    MuHash3072 empty;
+    uint256 hashEmpty = MuHashFinalize(empty);
+
+    // Order of insertion does not matter
+    MuHash3072 forward, backward;
+    for (unsigned int i = 0; i < elements.size(); i++) {
+        forward.Insert(elements[i].begin(), 32);
+        backward.Insert(elements[elements.size() - 1 - i].begin(), 32);
+    }
+    BOOST_CHECK(MuHashFinalize(forward) == MuHashFinalize(backward));
+    BOOST_CHECK(MuHashFinalize(forward) != hashEmpty);
+
+    // Removing everything gives the empty set again, also when removal comes first
+    MuHash3072 removed = forward;
+    removed.Remove(elements[0].begin(), 32);
+    BOOST_CHECK(MuHashFinalize(removed) != MuHashFinalize(forward));
+    for (unsigned int i = 1; i < elements.size(); i++)
+        removed.Remove(elements[i].begin(), 32);
+    BOOST_CHECK(MuHashFinalize(removed) == hashEmpty);
+
+    MuHash3072 early;
+    early.Remove(elements[0].begin(), 32);
+    early.Insert(elements[0].begin(), 32);
+    BOOST_CHECK(MuHashFinalize(early) == hashEmpty);
+
+    // Combining sets
+    MuHash3072 first, second;
+    for (unsigned int i = 0; i < elements.size(); i++)
+        (i % 2 ? first : second).Insert(elements[i].begin(), 32);
+    MuHash3072 combined = first;
+    combined *= second;
+    BOOST_CHECK(MuHashFinalize(combined) == MuHashFinalize(forward));
+    combined /= second;
+    BOOST_CHECK(MuHashFinalize(combined) == MuHashFinalize(first));
+
+    // The raw state round trips
+    unsigned char state[MuHash3072::SERIALIZED_SIZE];
+    forward.ToBytes(state);
+    MuHash3072 restored;
+    restored.FromBytes(state);
+    BOOST_CHECK(MuHashFinalize(restored) == MuHashFinalize(forward));
+}
+
+static std::string MuHashFinalizeHex(const MuHash3072& muhash)
+{
+    unsigned char hash[MuHash3072::OUTPUT_SIZE];
+    muhash.Finalize(hash);
+    return HexStr(hash, hash + sizeof(hash));
+}
+
+BOOST_AUTO_TEST_CASE(muhash_vectors)
+{
+    // Computed with a bignum implementation of the same construction:
+    // elements are SHA256 hashed, expanded with SHA512(key || counter) for
+    // counters 0 to 5, read little-endian and reduced modulo 2^3072 - 1103717;
+    // the final hash is SHA256 of numerator / denominator as 384 little-endian bytes.
+    BOOST_CHECK_EQUAL(MuHashFinalizeHex(MuHash3072()), "c85525462fdcf30a2c18d6f4b92923000974355c2477f59594d2c205a1d25add");
+
+    MuHash3072 abc;
+    abc.Insert((const unsigned char*)"abc", 3);
+    BOOST_CHECK_EQUAL(MuHashFinalizeHex(abc), "dd026e59b7cd56a8ba5c21c0acb5a1940b96712a41a49507d7cb55be6c8dbad5");
+
+    // Elements are 32 bytes, the first one set to 0, 1 and 2
+    unsigned char element[3][32] = {};
+    for (int i = 0; i < 3; i++)
+        element[i][0] = i;
+    MuHash3072 acc;
+    acc.Insert(element[0], 32).Insert(element[1], 32).Remove(element[2], 32);
+    BOOST_CHECK_EQUAL(MuHashFinalizeHex(acc), "5e52916264e1074983f2f09d1b1f2af91590ffe58e92e0eb9b80a975cc6942bc");
+
+    // The same set built from combined halves
+    MuHash3072 half;
+    half.Insert(element[1], 32);
+    MuHash3072 other;
+    other.Insert(element[2], 32);
+    MuHash3072 combined;
+    combined.Insert(element[0], 32);
+    combined *= half;
+    combined /= other;
+    BOOST_CHECK_EQUAL(MuHashFinalizeHex(combined), MuHashFinalizeHex(acc));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,354 @@
+// Copyright (c) 2019 The TRBO developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "data/tx_invalid.json.h"
+#include "data/tx_valid.json.h"
+
+#include "core_io.h"
+#include "ecwrapper.h"
+#include "hash.h"
+#include "key.h"
+#include "pubkey.h"
+#include "random.h"
+#include "script/interpreter.h"
+#include "streams.h"
+#include "uint256.h"
+#include "utilstrencodings.h"
+#include "version.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+#include <univalue.h>
+
+// In script_tests.cpp
+extern UniValue read_json(const std::string& jsondata);
+// In transaction_tests.cpp
+extern unsigned int ParseScriptFlags(std::string strFlags);
+
+/*
+ * CPubKey verifies strict DER signatures and recovers with libsecp256k1 when
+ * built with USE_SECP256K1, and leaves every other encoding to the OpenSSL
+ * wrapper. These tests check it agrees with OpenSSL on every signature and
+ * key encoding we can come up with. Block signatures are not covered by any
+ * encoding rule, so any disagreement would be a fork.
+ */
+
+/** Signature check through the OpenSSL wrapper */
+static bool OpenSSLVerify(const CPubKey& pubkey, const uint256& hash, const std::vector<unsigned char>& vchSig)
+{
+    CECKey key;
+    if (!key.SetPubKey(pubkey.begin(), pubkey.size()))
+        return false;
+    return key.Verify(hash, vchSig);
+}
+
+/** Whether a signature (without hash type) is strict DER, see BIP66 */
+static bool IsStrictDER(const std::vector<unsigned char>& sig)
+{
+    if (sig.size() < 8 || sig.size() > 72 || sig[0] != 0x30 || sig[1] != sig.size() - 2 || sig[2] != 0x02)
+        return false;
+    unsigned int lenR = sig[3];
+    if (lenR == 0 || lenR + 5 >= sig.size() || sig[lenR + 4] != 0x02)
+        return false;
+    unsigned int lenS = sig[lenR + 5];
+    if (lenS == 0 || lenR + lenS + 6 != sig.size())
+        return false;
+    // Both integers positive and without excess padding
+    if ((sig[4] & 0x80) || (lenR > 1 && sig[4] == 0 && !(sig[5] & 0x80)))
+        return false;
+    if ((sig[lenR + 6] & 0x80) || (lenS > 1 && sig[lenR + 6] == 0 && !(sig[lenR + 7] & 0x80)))
+        return false;
+    return true;
+}
+
+/** Checks every signature a script verifies with both implementations */
+class DifferentialSignatureChecker : public TransactionSignatureChecker
+{
+public:
+    mutable unsigned int nChecked;
+
+    DifferentialSignatureChecker(const CTransaction* txToIn, unsigned int nInIn, const CAmount& amountIn) : TransactionSignatureChecker(txToIn, nInIn, amountIn), nChecked(0) {}
+
+protected:
+    bool VerifySignature(const std::vector<unsigned char>& vchSig, const CPubKey& pubkey, const uint256& sighash) const
+    {
+        bool fRet = pubkey.Verify(sighash, vchSig);
+        BOOST_CHECK_MESSAGE(fRet == OpenSSLVerify(pubkey, sighash, vchSig), HexStr(vchSig) + " " + HexStr(pubkey.begin(), pubkey.end()));
+        nChecked++;
+        return fRet;
+    }
+};
+
+/** n - s for a 32-byte big endian s, turning a low S signature into its high S twin */
+static void NegateS(unsigned char* s)
+{
+    static const unsigned char order[32] = {
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFE,
+        0xBA, 0xAE, 0xDC, 0xE6, 0xAF, 0x48, 0xA0, 0x3B, 0xBF, 0xD2, 0x5E, 0x8C, 0xD0, 0x36, 0x41, 0x41};
+    int borrow = 0;
+    for (int i = 31; i >= 0; i--) {
+        int d = order[i] - s[i] - borrow;
+        borrow = d < 0;
+        s[i] = d & 0xFF;
+    }
+}
+
+/** Rebuild a DER signature from R and S (both 32 bytes), with optional encoding quirks */
+static std::vector<unsigned char> EncodeSignature(const unsigned char* r, const unsigned char* s, int nPadR, bool fLongLength)
+{
+    std::vector<unsigned char> vchR(r, r + 32), vchS(s, s + 32);
+    while (vchR.size() > 1 && vchR[0] == 0 && !(vchR[1] & 0x80))
+        vchR.erase(vchR.begin());
+    while (vchS.size() > 1 && vchS[0] == 0 && !(vchS[1] & 0x80))
+        vchS.erase(vchS.begin());
+    if (vchR[0] & 0x80)
+        vchR.insert(vchR.begin(), 0);
+    if (vchS[0] & 0x80)
+        vchS.insert(vchS.begin(), 0);
+    vchR.insert(vchR.begin(), nPadR, 0);
+
+    std::vector<unsigned char> body;
+    body.push_back(0x02);
+    body.push_back(vchR.size());
+    body.insert(body.end(), vchR.begin(), vchR.end());
+    body.push_back(0x02);
+    body.push_back(vchS.size());
+    body.insert(body.end(), vchS.begin(), vchS.end());
+
+    std::vector<unsigned char> sig;
+    sig.push_back(0x30);
+    if (fLongLength)
+        sig.push_back(0x81);
+    sig.push_back(body.size());
+    sig.insert(sig.end(), body.begin(), body.end());
+    return sig;
+}
+
+BOOST_AUTO_TEST_SUITE(ecdsa_tests)
+
+BOOST_AUTO_TEST_CASE(ecdsa_verify_encodings)
+{
+    for (int i = 0; i < 200; i++) {
+        CKey key;
+        key.MakeNewKey(i % 2 == 0);
+        CPubKey pubkey = key.GetPubKey();
+        uint256 hash = GetRandHash();
+
+        std::vector<unsigned char> vchSig;
+        BOOST_REQUIRE(key.Sign(hash, vchSig));
+
+        // The compact form gives us R and S without parsing DER
+        std::vector<unsigned char> vchCompact;
+        BOOST_REQUIRE(key.SignCompact(hash, vchCompact));
+        unsigned char r[32], s[32], sHigh[32];
+        memcpy(r, &vchCompact[1], 32);
+        memcpy(s, &vchCompact[33], 32);
+        memcpy(sHigh, s, 32);
+        NegateS(sHigh);
+
+        std::vector<std::vector<unsigned char> > vSigs;
+        vSigs.push_back(vchSig);
+        vSigs.push_back(EncodeSignature(r, s, 0, false));
+        vSigs.push_back(EncodeSignature(r, sHigh, 0, false));
+        vSigs.push_back(EncodeSignature(r, s, 1, false));
+        vSigs.push_back(EncodeSignature(r, s, 0, true));
+        vSigs.push_back(EncodeSignature(r, s, 0, false));
+        vSigs.back().push_back(0x01); // trailing data
+        vSigs.push_back(std::vector<unsigned char>(vchSig.begin(), vchSig.end() - 1));
+        vSigs.push_back(vchSig);
+        vSigs.back()[4 + GetRandInt(vchSig[3])] ^= 1 << GetRandInt(8); // somewhere in R
+        if (r[0] & 0x80) {
+            // R without the padding that keeps it positive
+            vSigs.push_back(EncodeSignature(r, s, 0, false));
+            vSigs.back().erase(vSigs.back().begin() + 4);
+            vSigs.back()[3]--;
+            vSigs.back()[1]--;
+        }
+
+        for (unsigned int j = 0; j < vSigs.size(); j++) {
+            bool fRet = pubkey.Verify(hash, vSigs[j]);
+            BOOST_CHECK_MESSAGE(fRet == OpenSSLVerify(pubkey, hash, vSigs[j]), HexStr(vSigs[j]));
+            // The strict DER ones are valid, the broken ones are not; what the
+            // other encodings get is up to OpenSSL
+            if (j <= 2)
+                BOOST_CHECK_MESSAGE(fRet, HexStr(vSigs[j]));
+            else if (j >= 6)
+                BOOST_CHECK_MESSAGE(!fRet, HexStr(vSigs[j]));
+        }
+    }
+}
+
+/** Verify through CPubKey and with OpenSSL, expecting both to return fExpected */
+static void CheckVerify(const CPubKey& pubkey, const uint256& hash, const std::vector<unsigned char>& vchSig, bool fExpected)
+{
+    BOOST_CHECK_MESSAGE(pubkey.Verify(hash, vchSig) == fExpected, "CPubKey " + HexStr(vchSig) + " " + hash.GetHex());
+    BOOST_CHECK_MESSAGE(OpenSSLVerify(pubkey, hash, vchSig) == fExpected, "OpenSSL " + HexStr(vchSig) + " " + hash.GetHex());
+}
+
+/** Verify an encoding that is not strict DER, expecting CPubKey to say what OpenSSL says */
+static void CheckVerifyLikeOpenSSL(const CPubKey& pubkey, const uint256& hash, const std::vector<unsigned char>& vchSig)
+{
+    BOOST_CHECK_MESSAGE(pubkey.Verify(hash, vchSig) == OpenSSLVerify(pubkey, hash, vchSig), HexStr(vchSig) + " " + hash.GetHex());
+}
+
+BOOST_AUTO_TEST_CASE(ecdsa_verify_sig_vectors)
+{
+    // Fixed keys and messages; signatures are deterministic (RFC6979), so a
+    // failure shows up on every run
+    for (unsigned char i = 1; i <= 16; i++) {
+        unsigned char secret[32] = {};
+        secret[0] = i;
+        secret[31] = i;
+        CKey key;
+        key.Set(secret, secret + sizeof(secret), i % 2 == 0);
+        CPubKey pubkey = key.GetPubKey();
+        const uint256 hash = Hash(secret, secret + sizeof(secret));
+
+        std::vector<unsigned char> vchSig;
+        BOOST_REQUIRE(key.Sign(hash, vchSig));
+        BOOST_REQUIRE(IsStrictDER(vchSig));
+        std::vector<unsigned char> vchCompact;
+        BOOST_REQUIRE(key.SignCompact(hash, vchCompact));
+        unsigned char r[32], s[32], sHigh[32];
+        memcpy(r, &vchCompact[1], 32);
+        memcpy(s, &vchCompact[33], 32);
+        memcpy(sHigh, s, 32);
+        NegateS(sHigh);
+        BOOST_CHECK(EncodeSignature(r, s, 0, false) == vchSig);
+
+        uint256 hashTampered = hash;
+        *hashTampered.begin() ^= 1;
+        std::vector<unsigned char> vchSigTampered = vchSig;
+        vchSigTampered.back() ^= 1; // the last byte of S
+        std::vector<unsigned char> vchHighS = EncodeSignature(r, sHigh, 0, false);
+        BOOST_CHECK(IsStrictDER(vchHighS));
+
+        // Strict DER
+        CheckVerify(pubkey, hash, vchSig, true);
+        CheckVerify(pubkey, hashTampered, vchSig, false);
+        CheckVerify(pubkey, hash, vchSigTampered, false);
+        CheckVerify(pubkey, hash, vchHighS, true);
+        CheckVerify(pubkey, hashTampered, vchHighS, false);
+
+        // Another key's signature
+        CKey keyOther;
+        secret[1] = 1;
+        keyOther.Set(secret, secret + sizeof(secret), true);
+        std::vector<unsigned char> vchSigOther;
+        BOOST_REQUIRE(keyOther.Sign(hash, vchSigOther));
+        CheckVerify(pubkey, hash, vchSigOther, false);
+
+        // Not DER: padded R, long form lengths, both with high S, trailing
+        // data, and a negative S that is only valid read as unsigned
+        const std::vector<unsigned char> vchPaddedR = EncodeSignature(r, s, 1, false);
+        const std::vector<unsigned char> vchLongLength = EncodeSignature(r, s, 0, true);
+        const std::vector<unsigned char> vchHighSNonDER = EncodeSignature(r, sHigh, 1, true);
+        std::vector<unsigned char> vchTrailing = vchSig;
+        vchTrailing.push_back(0);
+        std::vector<unsigned char> vchNegativeS = EncodeSignature(r, sHigh, 0, false);
+        BOOST_REQUIRE(vchNegativeS[vchNegativeS[3] + 6] == 0);
+        vchNegativeS.erase(vchNegativeS.begin() + vchNegativeS[3] + 6);
+        vchNegativeS[vchNegativeS[3] + 5]--;
+        vchNegativeS[1]--;
+        BOOST_CHECK(!IsStrictDER(vchPaddedR) && !IsStrictDER(vchLongLength) && !IsStrictDER(vchHighSNonDER));
+        BOOST_CHECK(!IsStrictDER(vchTrailing) && !IsStrictDER(vchNegativeS));
+        CheckVerifyLikeOpenSSL(pubkey, hash, vchPaddedR);
+        CheckVerifyLikeOpenSSL(pubkey, hash, vchLongLength);
+        CheckVerifyLikeOpenSSL(pubkey, hash, vchHighSNonDER);
+        CheckVerifyLikeOpenSSL(pubkey, hash, vchTrailing);
+        CheckVerify(pubkey, hash, vchNegativeS, false);
+        CheckVerify(pubkey, hashTampered, vchPaddedR, false);
+        CheckVerify(pubkey, hashTampered, vchHighSNonDER, false);
+
+        // Not a signature at all
+        BOOST_CHECK(!pubkey.Verify(hash, std::vector<unsigned char>()));
+        BOOST_CHECK(!pubkey.Verify(hash, std::vector<unsigned char>(vchSig.begin(), vchSig.begin() + 6)));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(ecdsa_recover)
+{
+    for (int i = 0; i < 100; i++) {
+        CKey key;
+        key.MakeNewKey(i % 2 == 0);
+        CPubKey pubkey = key.GetPubKey();
+        uint256 hash = GetRandHash();
+
+        std::vector<unsigned char> vchSig;
+        BOOST_REQUIRE(key.SignCompact(hash, vchSig));
+        if (i % 4 == 3)
+            vchSig[1 + GetRandInt(64)] ^= 1 << GetRandInt(8);
+
+        CPubKey pubkeyRecovered;
+        bool fRet = pubkeyRecovered.RecoverCompact(hash, vchSig);
+
+        CECKey ecKey;
+        int recid = (vchSig[0] - 27) & 3;
+        bool fRetOpenSSL = ecKey.Recover(hash, &vchSig[1], recid);
+        BOOST_CHECK_EQUAL(fRet, fRetOpenSSL);
+        if (fRet && fRetOpenSSL) {
+            std::vector<unsigned char> vchPubKey;
+            ecKey.GetPubKey(vchPubKey, pubkey.IsCompressed());
+            BOOST_CHECK(std::vector<unsigned char>(pubkeyRecovered.begin(), pubkeyRecovered.end()) == vchPubKey);
+        }
+        if (i % 4 != 3)
+            BOOST_CHECK(pubkeyRecovered == pubkey);
+    }
+}
+
+static unsigned int RunTransactionVectors(const UniValue& tests)
+{
+    unsigned int nChecked = 0;
+    for (unsigned int idx = 0; idx < tests.size(); idx++) {
+        const UniValue& test = tests[idx];
+        if (!test[0].isArray() || test.size() != 3 || !test[1].isStr() || !test[2].isStr())
+            continue;
+
+        std::map<COutPoint, CScript> mapprevOutScriptPubKeys;
+        std::map<COutPoint, int64_t> mapprevOutValues;
+        const UniValue& inputs = test[0];
+        for (unsigned int inpIdx = 0; inpIdx < inputs.size(); inpIdx++) {
+            const UniValue& vinput = inputs[inpIdx];
+            COutPoint outpoint(uint256S(vinput[0].get_str()), vinput[1].get_int());
+            mapprevOutScriptPubKeys[outpoint] = ParseScript(vinput[2].get_str());
+            if (vinput.size() >= 4)
+                mapprevOutValues[outpoint] = vinput[3].get_int64();
+        }
+
+        CDataStream stream(ParseHex(test[1].get_str()), SER_NETWORK, PROTOCOL_VERSION);
+        CTransaction tx;
+        try {
+            stream >> tx;
+        } catch (const std::exception&) {
+            continue; // some invalid vectors do not even deserialize
+        }
+
+        unsigned int flags = ParseScriptFlags(test[2].get_str());
+        for (unsigned int i = 0; i < tx.vin.size(); i++) {
+            if (!mapprevOutScriptPubKeys.count(tx.vin[i].prevout))
+                break;
+            CAmount amount = mapprevOutValues.count(tx.vin[i].prevout) ? mapprevOutValues[tx.vin[i].prevout] : 0;
+            const CScriptWitness* witness = (i < tx.wit.vtxinwit.size()) ? &tx.wit.vtxinwit[i].scriptWitness : NULL;
+            DifferentialSignatureChecker checker(&tx, i, amount);
+            VerifyScript(tx.vin[i].scriptSig, mapprevOutScriptPubKeys[tx.vin[i].prevout], witness, flags, checker, NULL);
+            nChecked += checker.nChecked;
+        }
+    }
+    return nChecked;
+}
+
+BOOST_AUTO_TEST_CASE(ecdsa_transaction_vectors)
+{
+    // Agreement is checked on every signature, tx_valid and tx_invalid check the verdicts
+    UniValue valid = read_json(std::string(json_tests::tx_valid, json_tests::tx_valid + sizeof(json_tests::tx_valid)));
+    UniValue invalid = read_json(std::string(json_tests::tx_invalid, json_tests::tx_invalid + sizeof(json_tests::tx_invalid)));
+    BOOST_CHECK(RunTransactionVectors(valid) > 0);
+    RunTransactionVectors(invalid);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,232 @@
+// Copyright (c) 2019 The TRBO developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "kernel.h"
+
+#include "chain.h"
+#include "coins.h"
+#include "key.h"
+#include "keystore.h"
+#include "main.h"
+#include "random.h"
+#include "script/sign.h"
+#include "script/standard.h"
+#include "txdb.h"
+
+#include <limits>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(kernel_tests)
+
+/** CheckProofOfStake as it was before it took the stake input from the chainstate */
+static bool CheckProofOfStakeFromDisk(const CBlock& block, uint256& hashProofOfStake)
+{
+    const CTransaction& tx = block.vtx[1];
+    const CTxIn& txin = tx.vin[0];
+
+    uint256 hashBlock;
+    CTransaction txPrev;
+    if (!GetTransaction(txin.prevout.hash, txPrev, hashBlock, true))
+        return false;
+    if (!VerifyScript(txin.scriptSig, txPrev.vout[txin.prevout.n].scriptPubKey,
+        tx.wit.vtxinwit.size() > 0 ? &tx.wit.vtxinwit[0].scriptWitness : NULL, STANDARD_SCRIPT_VERIFY_FLAGS, TransactionSignatureChecker(&tx, 0, txPrev.vout[txin.prevout.n].nValue)))
+        return false;
+
+    BlockMap::iterator it = mapBlockIndex.find(hashBlock);
+    if (it == mapBlockIndex.end())
+        return false;
+    CBlock blockprev;
+    if (!ReadBlockFromDisk(blockprev, it->second->GetBlockPos()))
+        return false;
+
+    unsigned int nTime = block.nTime;
+    if (!CheckStakeKernelHash(block.nBits, blockprev, txPrev, txin.prevout, nTime, 0, true, hashProofOfStake) && (nTime > 1505247602))
+        return false;
+    return true;
+}
+
+static CBlockIndex* AddTestBlockIndex(const uint256& hash, CBlockIndex* pprev, unsigned int nTime)
+{
+    CBlockIndex* pindex = new CBlockIndex();
+    pindex->pprev = pprev;
+    pindex->nHeight = pprev->nHeight + 1;
+    pindex->nTime = nTime;
+    pindex->phashBlock = &mapBlockIndex.insert(std::make_pair(hash, pindex)).first->first;
+    pindex->BuildSkip();
+    return pindex;
+}
+
+static CMutableTransaction CreateCoinStake(const CKeyStore& keystore, const CTransaction& txPrev, const COutPoint& prevout)
+{
+    CMutableTransaction txStake;
+    txStake.vin.push_back(CTxIn(prevout));
+    txStake.vout.resize(2);
+    txStake.vout[0].SetEmpty();
+    txStake.vout[1] = CTxOut(1000 * COIN, CScript() << OP_TRUE);
+    if (prevout.hash == txPrev.GetHash())
+        BOOST_CHECK(SignSignature(keystore, txPrev, txStake, 0, SIGHASH_ALL));
+    return txStake;
+}
+
+static CBlock CreateStakeBlock(const CBlockIndex* pindexPrev, const CTransaction& txStake, unsigned int nTime, unsigned int nBits)
+{
+    CMutableTransaction txCoinbase;
+    txCoinbase.vin.resize(1);
+    txCoinbase.vin[0].prevout.SetNull();
+    txCoinbase.vout.resize(1);
+    txCoinbase.vout[0].SetEmpty();
+
+    CBlock block;
+    block.nVersion = 4;
+    block.hashPrevBlock = pindexPrev->GetBlockHash();
+    block.nTime = nTime;
+    block.nBits = nBits;
+    block.vtx.push_back(txCoinbase);
+    block.vtx.push_back(txStake);
+    block.hashMerkleRoot = block.BuildMerkleTree();
+    return block;
+}
+
+/** Both paths agree; returns what they decided */
+static bool CheckBothPaths(const CBlock& block, const CBlockIndex* pindexPrev, uint256& hashProofOfStake)
+{
+    uint256 hashFromDisk;
+    bool fFromDisk = CheckProofOfStakeFromDisk(block, hashFromDisk);
+    bool fResult = CheckProofOfStake(block, pindexPrev, hashProofOfStake);
+    BOOST_CHECK_EQUAL(fResult, fFromDisk);
+    if (fResult && fFromDisk)
+        BOOST_CHECK(hashProofOfStake == hashFromDisk);
+    return fResult;
+}
+
+BOOST_AUTO_TEST_CASE(stake_kernel_cache)
+{
+    CStakeKernelCache cache(2);
+    uint256 hash;
+    BOOST_CHECK(!cache.Get(uint256(1), hash));
+    cache.Insert(uint256(1), uint256(11));
+    cache.Insert(uint256(2), uint256(12));
+    BOOST_CHECK(cache.Get(uint256(1), hash));
+    BOOST_CHECK(hash == uint256(11));
+
+    // The least recently used entry goes first
+    cache.Insert(uint256(3), uint256(13));
+    BOOST_CHECK(!cache.Get(uint256(2), hash));
+    BOOST_CHECK(cache.Get(uint256(1), hash));
+    BOOST_CHECK(cache.Get(uint256(3), hash));
+    BOOST_CHECK(hash == uint256(13));
+
+    // Inserting a known block keeps its first entry
+    cache.Insert(uint256(3), uint256(23));
+    BOOST_CHECK(cache.Get(uint256(3), hash));
+    BOOST_CHECK(hash == uint256(13));
+}
+
+BOOST_AUTO_TEST_CASE(check_proof_of_stake_chainstate)
+{
+    LOCK(cs_main);
+    CBlockIndex* pindexGenesis = chainActive.Tip();
+    BOOST_REQUIRE(pindexGenesis != NULL);
+
+    CBasicKeyStore keystore;
+    CKey key;
+    key.MakeNewKey(true);
+    keystore.AddKey(key);
+
+    // The block holding the staked output, on disk where the old path reads it
+    CMutableTransaction txPrev;
+    txPrev.vin.push_back(CTxIn(COutPoint(GetRandHash(), 0)));
+    txPrev.vout.push_back(CTxOut(1000 * COIN, GetScriptForDestination(key.GetPubKey().GetID())));
+    txPrev.vout.push_back(CTxOut(1 * COIN, CScript() << OP_TRUE));
+    const unsigned int nTimeFrom = pindexGenesis->nTime + 60;
+    CBlock blockFrom = CreateStakeBlock(pindexGenesis, CreateCoinStake(keystore, txPrev, COutPoint(GetRandHash(), 0)), nTimeFrom, pindexGenesis->nBits);
+    blockFrom.vtx.push_back(txPrev);
+    blockFrom.hashMerkleRoot = blockFrom.BuildMerkleTree();
+    CDiskBlockPos pos(99, 0);
+    BOOST_REQUIRE(WriteBlockToDisk(blockFrom, pos));
+    CBlockIndex* pindexFrom = AddTestBlockIndex(blockFrom.GetHash(), pindexGenesis, nTimeFrom);
+    pindexFrom->nFile = pos.nFile;
+    pindexFrom->nDataPos = pos.nPos;
+    pindexFrom->nStatus |= BLOCK_HAVE_DATA;
+    CExtDiskTxPos postx(CDiskTxPos(pos, GetSizeOfCompactSize(blockFrom.vtx.size())), pindexFrom->nHeight);
+    for (unsigned int i = 0; i < 2; i++)
+        postx.nTxOffset += ::GetSerializeSize(blockFrom.vtx[i], SER_DISK, CLIENT_VERSION);
+    std::vector<std::pair<uint256, CExtDiskTxPos> > vPos(1, std::make_pair(txPrev.GetHash(), postx));
+    BOOST_REQUIRE(pblocktree->WriteTxIndex(vPos));
+
+    // A minute per block past the minimum stake age and the modifier
+    // selection interval, each generating a new stake modifier
+    CBlockIndex* pindexTip = pindexFrom;
+    while (pindexTip->nTime < nTimeFrom + nStakeMinAge + 4 * 60 * 60) {
+        pindexTip = AddTestBlockIndex(GetRandHash(), pindexTip, pindexTip->nTime + 60);
+        pindexTip->SetStakeModifier(GetRand(std::numeric_limits<uint64_t>::max()), true);
+    }
+    chainActive.SetTip(pindexTip);
+    {
+        CCoinsModifier coins = pcoinsTip->ModifyCoins(txPrev.GetHash());
+        *coins = CCoins(txPrev, pindexFrom->nHeight);
+    }
+
+    // A valid stake, found at the first time that hits an easy target
+    const unsigned int nBits = 0x1d010000;
+    const COutPoint prevout(txPrev.GetHash(), 0);
+    unsigned int nTime = nTimeFrom + nStakeMinAge;
+    uint256 hashProofOfStake;
+    for (; nTime < nTimeFrom + nStakeMinAge + 1000; nTime++) {
+        unsigned int nTimeTx = nTime;
+        if (CheckStakeKernelHash(nBits, pindexFrom->GetBlockHash(), nTimeFrom, 1000 * COIN, prevout, nTimeTx, 0, true, hashProofOfStake))
+            break;
+    }
+    const CTransaction txStake = CreateCoinStake(keystore, txPrev, prevout);
+    const CBlock block = CreateStakeBlock(pindexTip, txStake, nTime, nBits);
+    BOOST_CHECK(CheckBothPaths(block, pindexTip, hashProofOfStake));
+    uint256 hashCached;
+    BOOST_CHECK(stakeKernelCache.Get(block.GetHash(), hashCached));
+    BOOST_CHECK(hashCached == hashProofOfStake);
+
+    // The same input from a parent that is not the tip goes through the tx index
+    uint256 hashSide;
+    const CBlock blockSide = CreateStakeBlock(pindexTip->pprev, txStake, nTime, nBits);
+    BOOST_CHECK(CheckBothPaths(blockSide, pindexTip->pprev, hashSide));
+
+    // An unknown input
+    const CTransaction txUnknown = CreateCoinStake(keystore, txPrev, COutPoint(GetRandHash(), 0));
+    BOOST_CHECK(!CheckBothPaths(CreateStakeBlock(pindexTip, txUnknown, nTime, nBits), pindexTip, hashSide));
+
+    // An input younger than the minimum stake age
+    BOOST_CHECK(!CheckBothPaths(CreateStakeBlock(pindexTip, txStake, nTimeFrom + nStakeMinAge - 60, nBits), pindexTip, hashSide));
+
+    // An input the active chain already spent
+    {
+        CCoinsModifier coins = pcoinsTip->ModifyCoins(txPrev.GetHash());
+        coins->Spend(0);
+    }
+    uint256 hashSpent;
+    CheckBothPaths(CreateStakeBlock(pindexTip, txStake, nTime + 1, nBits), pindexTip, hashSpent);
+
+    // After a reorg that drops the origin block the valid stake is still
+    // answered from the cache, with the hash it was first checked with
+    chainActive.SetTip(pindexGenesis);
+    BOOST_CHECK(!CheckProofOfStakeFromDisk(block, hashSide));
+    uint256 hashAfterReorg;
+    BOOST_CHECK(CheckProofOfStake(block, pindexTip, hashAfterReorg));
+    BOOST_CHECK(hashAfterReorg == hashProofOfStake);
+
+    {
+        CCoinsModifier coins = pcoinsTip->ModifyCoins(txPrev.GetHash());
+        coins->Clear();
+    }
+    for (BlockMap::iterator it = mapBlockIndex.begin(); it != mapBlockIndex.end();) {
+        if (it->second->nHeight > pindexGenesis->nHeight) {
+            delete it->second;
+            mapBlockIndex.erase(it++);
+        } else {
+            ++it;
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,158 @@
+// Copyright (c) 2019 The TRBO developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "logging.h"
+#include "util.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(logging_tests)
+
+BOOST_AUTO_TEST_CASE(logging_categories)
+{
+    uint64_t flags;
+    BOOST_CHECK(GetLogCategory("net", flags) && flags == LOG_NET);
+    BOOST_CHECK(GetLogCategory("masternode", flags) && flags == LOG_MASTERNODE);
+    BOOST_CHECK(GetLogCategory("", flags) && flags == LOG_ALL);
+    BOOST_CHECK(GetLogCategory("1", flags) && flags == LOG_ALL);
+    BOOST_CHECK(GetLogCategory("trbo", flags) && (flags & LOG_MNBUDGET) && (flags & LOG_SWIFTX) && !(flags & LOG_NET));
+    BOOST_CHECK(!GetLogCategory("nosuchcategory", flags));
+    BOOST_CHECK_EQUAL(LogCategoryFlag("nosuchcategory"), LOG_NONE);
+    BOOST_CHECK_EQUAL(LogCategoryFlag(NULL), LOG_ALL);
+
+    uint64_t nSaved = logCategories;
+    logCategories = LOG_NONE;
+    BOOST_CHECK(LogAcceptCategory(NULL));
+    BOOST_CHECK(!LogAcceptCategory("net"));
+    logCategories = LOG_MASTERNODE | LOG_NET;
+    BOOST_CHECK(LogAcceptCategory("net"));
+    BOOST_CHECK(LogAcceptCategory("masternode"));
+    BOOST_CHECK(!LogAcceptCategory("mnbudget"));
+    BOOST_CHECK(!LogAcceptCategory("nosuchcategory"));
+    logCategories = LOG_ALL;
+    BOOST_CHECK(LogAcceptCategory("mnbudget"));
+    BOOST_CHECK(LogAcceptCategory("nosuchcategory"));
+    BOOST_CHECK(LogAcceptFlag(LOG_NET));
+    logCategories = LOG_NONE;
+    BOOST_CHECK(LogAcceptFlag(LOG_ALL));
+    BOOST_CHECK(!LogAcceptFlag(LOG_NET));
+    logCategories = nSaved;
+}
+
+static int nEvaluated = 0;
+static int Evaluate()
+{
+    return ++nEvaluated;
+}
+
+BOOST_AUTO_TEST_CASE(logging_lazy_arguments)
+{
+    uint64_t nSaved = logCategories;
+    logCategories = LOG_NET;
+    nEvaluated = 0;
+    LogPrint("masternode", "%d\n", Evaluate());
+    BOOST_CHECK_EQUAL(nEvaluated, 0);
+    LogPrint("net", "%d\n", Evaluate());
+    BOOST_CHECK_EQUAL(nEvaluated, 1);
+    LogPrintf("%d\n", Evaluate());
+    BOOST_CHECK_EQUAL(nEvaluated, 2);
+    LogPrint(NULL, "%d\n", Evaluate());
+    BOOST_CHECK_EQUAL(nEvaluated, 3);
+
+    // The category of a call site is looked up once, its setting every time
+    for (int i = 0; i < 2; i++) {
+        logCategories = i == 0 ? LOG_NET : LOG_MASTERNODE;
+        LogPrint("masternode", "%d\n", Evaluate());
+    }
+    BOOST_CHECK_EQUAL(nEvaluated, 4);
+    logCategories = nSaved;
+}
+
+static CLogQueue::Entry MakeEntry(uint64_t nSequence)
+{
+    CLogQueue::Entry entry;
+    entry.nSequence = nSequence;
+    entry.nTime = 0;
+    entry.fStartsLine = true;
+    entry.str = strprintf("message %u\n", nSequence);
+    return entry;
+}
+
+BOOST_AUTO_TEST_CASE(logging_queue)
+{
+    CLogQueue queue(4);
+    std::vector<CLogQueue::Entry> vEntries;
+    BOOST_CHECK_EQUAL(queue.Pop(vEntries), 0U);
+
+    // Fill up, then wrap around the ring a few times
+    uint64_t nPushed = 0, nPopped = 0;
+    for (int nRound = 0; nRound < 5; nRound++) {
+        while (true) {
+            CLogQueue::Entry entry = MakeEntry(nPushed);
+            if (!queue.Push(entry))
+                break;
+            nPushed++;
+        }
+        BOOST_CHECK_EQUAL(queue.Size(), 4U);
+
+        vEntries.clear();
+        BOOST_CHECK_EQUAL(queue.Pop(vEntries), 4U);
+        BOOST_CHECK_EQUAL(queue.Size(), 0U);
+        for (const CLogQueue::Entry& entry : vEntries) {
+            BOOST_CHECK_EQUAL(entry.nSequence, nPopped);
+            BOOST_CHECK_EQUAL(entry.str, strprintf("message %u\n", nPopped));
+            nPopped++;
+        }
+    }
+    BOOST_CHECK_EQUAL(nPushed, 20U);
+    BOOST_CHECK_EQUAL(nPopped, 20U);
+
+    // A partial pop leaves room for exactly as many new messages
+    for (int i = 0; i < 2; i++) {
+        CLogQueue::Entry entry = MakeEntry(nPushed++);
+        BOOST_CHECK(queue.Push(entry));
+    }
+    vEntries.clear();
+    BOOST_CHECK_EQUAL(queue.Pop(vEntries), 2U);
+    BOOST_CHECK_EQUAL(vEntries.front().nSequence, 20U);
+    BOOST_CHECK_EQUAL(vEntries.back().nSequence, 21U);
+}
+
+BOOST_AUTO_TEST_CASE(logging_queue_full)
+{
+    CLogQueue queue(2);
+    std::vector<CLogQueue::Entry> vEntries;
+    CLogQueue::Entry entry = MakeEntry(0);
+    BOOST_CHECK(queue.Push(entry, true));
+    entry = MakeEntry(1);
+    BOOST_CHECK(queue.Push(entry));
+
+    // LogPrint output is dropped and counted, the queue is left as it was
+    entry = MakeEntry(2);
+    BOOST_CHECK(!queue.Push(entry, true));
+    BOOST_CHECK(!queue.Push(entry, true));
+    BOOST_CHECK_EQUAL(queue.nDropped, 2U);
+    BOOST_CHECK_EQUAL(queue.Size(), 2U);
+
+    // LogPrintf output is not dropped; the caller keeps the message and waits
+    entry = MakeEntry(3);
+    BOOST_CHECK(!queue.Push(entry));
+    BOOST_CHECK_EQUAL(queue.nDropped, 2U);
+    BOOST_CHECK_EQUAL(entry.nSequence, 3U);
+    BOOST_CHECK_EQUAL(queue.Pop(vEntries), 2U);
+    BOOST_CHECK(queue.Push(entry));
+
+    // Nothing dropped made it in, and what did comes out in order
+    vEntries.clear();
+    BOOST_CHECK_EQUAL(queue.Pop(vEntries), 1U);
+    BOOST_CHECK_EQUAL(vEntries[0].nSequence, 3U);
+    BOOST_CHECK_EQUAL(vEntries[0].str, "message 3\n");
+    BOOST_CHECK_EQUAL(queue.nDropped, 2U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
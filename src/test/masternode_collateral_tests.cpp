@@ -0,0 +1,112 @@
+// Copyright (c) 2019 The TRBO developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "masternode-collateral.h"
+
+#include "coins.h"
+#include "main.h"
+#include "primitives/block.h"
+#include "script/script.h"
+#include "txmempool.h"
+#include "validationinterface.h"
+
+#include <list>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(masternode_collateral_tests)
+
+static void AddCoins(const uint256& hash)
+{
+    LOCK(cs_main);
+    CCoinsModifier coins = pcoinsTip->ModifyCoins(hash);
+    coins->nVersion = 1;
+    coins->nHeight = 1;
+    coins->vout.assign(1, CTxOut(10000 * COIN, CScript() << OP_TRUE));
+}
+
+static CTransaction Spend(const COutPoint& outpoint)
+{
+    CMutableTransaction tx;
+    tx.vin.push_back(CTxIn(outpoint));
+    tx.vout.push_back(CTxOut(10000 * COIN, CScript() << OP_TRUE));
+    return tx;
+}
+
+BOOST_AUTO_TEST_CASE(masternode_collateral_watch)
+{
+    CCollateralWatcher watcher;
+    RegisterValidationInterface(&watcher);
+
+    COutPoint collateral(uint256(1), 0);
+    COutPoint missing(uint256(2), 0);
+    COutPoint unwatched(uint256(3), 0);
+    AddCoins(collateral.hash);
+    AddCoins(unwatched.hash);
+
+    // Nothing is known to be spent before the one look at the chain state
+    watcher.Watch(collateral);
+    watcher.Watch(missing);
+    BOOST_CHECK(!watcher.IsSpent(collateral));
+    BOOST_CHECK(!watcher.IsSpent(missing));
+    watcher.CheckUnchecked();
+    BOOST_CHECK(!watcher.IsSpent(collateral));
+    BOOST_CHECK(watcher.IsSpent(missing));
+
+    // A transaction spending it enters the mempool
+    CTransaction tx = Spend(collateral);
+    {
+        LOCK(cs_main);
+        mempool.addUnchecked(tx.GetHash(), CTxMemPoolEntry(tx, 0, 0, 0.0, 1));
+        SyncWithWallets(tx, NULL);
+    }
+    BOOST_CHECK(watcher.IsSpent(collateral));
+
+    // It leaves the mempool, and a block spending the collateral is connected
+    CBlock block;
+    block.vtx.push_back(tx);
+    {
+        LOCK(cs_main);
+        std::list<CTransaction> removed;
+        mempool.remove(tx, removed);
+        SyncWithWallets(tx, NULL);
+        BOOST_CHECK(!watcher.IsSpent(collateral));
+        pcoinsTip->ModifyCoins(collateral.hash)->Spend(collateral.n);
+        SyncWithWallets(block.vtx, &block);
+    }
+    BOOST_CHECK(watcher.IsSpent(collateral));
+
+    // The block is disconnected
+    AddCoins(collateral.hash);
+    {
+        LOCK(cs_main);
+        SyncWithWallets(block.vtx, NULL);
+    }
+    BOOST_CHECK(!watcher.IsSpent(collateral));
+
+    // Collaterals not watched are never looked at
+    {
+        LOCK(cs_main);
+        pcoinsTip->ModifyCoins(unwatched.hash)->Spend(unwatched.n);
+        SyncWithWallets(Spend(unwatched), NULL);
+    }
+    BOOST_CHECK(!watcher.IsSpent(unwatched));
+
+    // Only the list given is watched, keeping what is known
+    BOOST_CHECK_EQUAL(watcher.size(), 2U);
+    watcher.SetWatched(std::vector<COutPoint>(1, missing));
+    BOOST_CHECK_EQUAL(watcher.size(), 1U);
+    BOOST_CHECK(watcher.IsSpent(missing));
+    watcher.Clear();
+    BOOST_CHECK(!watcher.IsSpent(missing));
+
+    UnregisterValidationInterface(&watcher);
+    {
+        LOCK(cs_main);
+        pcoinsTip->ModifyCoins(collateral.hash)->Clear();
+        pcoinsTip->ModifyCoins(unwatched.hash)->Clear();
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
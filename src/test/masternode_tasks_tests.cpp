@@ -0,0 +1,106 @@
+// Copyright (c) 2019 The TRBO developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "masternode-tasks.h"
+#include "scheduler.h"
+#include "utiltime.h"
+
+#include <atomic>
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(masternode_tasks_tests)
+
+static std::atomic<int> nTaskRuns(0);
+static void CountRun()
+{
+    nTaskRuns++;
+}
+
+static bool WaitForRuns(int nRuns)
+{
+    for (int i = 0; i < 200 && nTaskRuns < nRuns; i++)
+        MilliSleep(10);
+    return nTaskRuns == nRuns;
+}
+
+BOOST_AUTO_TEST_CASE(masternode_task_trigger)
+{
+    CScheduler scheduler;
+    // Too long an interval to run periodically during the test
+    CMasternodeTask task("test", CountRun, 3600, 300);
+    nTaskRuns = 0;
+
+    // Events before Start are ignored
+    task.Trigger();
+    task.Start(scheduler);
+
+    // Events coming in together share one run
+    for (int i = 0; i < 5; i++)
+        task.Trigger();
+    BOOST_CHECK(task.GetStats().fTriggered);
+    boost::thread thread(boost::bind(&CScheduler::serviceQueue, &scheduler));
+    BOOST_CHECK(WaitForRuns(1));
+
+    // The next run for an event keeps its distance from the previous one
+    int64_t nStart = GetTimeMillis();
+    task.Trigger();
+    BOOST_CHECK(WaitForRuns(2));
+    BOOST_CHECK(GetTimeMillis() - nStart >= 250);
+
+    CMasternodeTaskStats stats = task.GetStats();
+    BOOST_CHECK_EQUAL(stats.strName, "test");
+    BOOST_CHECK_EQUAL(stats.nInterval, 3600);
+    BOOST_CHECK_EQUAL(stats.nRuns, 2U);
+    BOOST_CHECK_EQUAL(stats.nTriggers, 7U);
+    BOOST_CHECK(!stats.fTriggered);
+    BOOST_CHECK(stats.nTimeMax >= stats.nTimeLast);
+    BOOST_CHECK(stats.nLastRun > 0);
+
+    thread.interrupt();
+    thread.join();
+}
+
+static std::atomic<bool> fSlowRunning(false);
+static void SlowRun()
+{
+    fSlowRunning = true;
+    MilliSleep(200);
+    nTaskRuns++;
+    fSlowRunning = false;
+}
+
+BOOST_AUTO_TEST_CASE(masternode_task_stop)
+{
+    CScheduler scheduler;
+    CMasternodeTask task("test", SlowRun, 3600, 300);
+    nTaskRuns = 0;
+    task.Start(scheduler);
+    boost::thread thread(boost::bind(&CScheduler::serviceQueue, &scheduler));
+
+    // Stop waits for the run in progress
+    task.Trigger();
+    for (int i = 0; i < 200 && !fSlowRunning; i++)
+        MilliSleep(10);
+    BOOST_CHECK(fSlowRunning);
+    task.Stop();
+    BOOST_CHECK(!fSlowRunning);
+    BOOST_CHECK_EQUAL(nTaskRuns, 1);
+
+    // Nothing runs afterwards, whether scheduled before or triggered after
+    task.Start(scheduler);
+    task.Trigger();
+    task.Stop();
+    task.Trigger();
+    MilliSleep(500);
+    BOOST_CHECK_EQUAL(nTaskRuns, 1);
+    BOOST_CHECK_EQUAL(task.GetStats().nRuns, 1U);
+
+    thread.interrupt();
+    thread.join();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
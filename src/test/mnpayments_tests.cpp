@@ -0,0 +1,138 @@
+// Copyright (c) 2019 The TRBO developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "masternode-payments.h"
+
+#include "random.h"
+#include "streams.h"
+#include "version.h"
+
+#include <limits>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(mnpayments_tests)
+
+static CMasternodePaymentWinner MakeWinner(int nBlockHeight, const CScript& payee)
+{
+    CMasternodePaymentWinner winner(CTxIn(GetRandHash(), 0));
+    winner.nBlockHeight = nBlockHeight;
+    winner.AddPayee(payee);
+    return winner;
+}
+
+static uint256 AddVote(CMasternodePaymentVotes& votes, int nBlockHeight, const CScript& payee)
+{
+    CMasternodePaymentWinner winner = MakeWinner(nBlockHeight, payee);
+    uint256 hash = winner.GetHash();
+    BOOST_CHECK(votes.Add(hash, winner));
+    return hash;
+}
+
+BOOST_AUTO_TEST_CASE(mnpayments_votes_leading)
+{
+    CScript payeeA = CScript() << OP_TRUE;
+    CScript payeeB = CScript() << OP_FALSE;
+    CMasternodePaymentVotes votes;
+
+    uint256 hash = AddVote(votes, 100, payeeA);
+    CMasternodePaymentWinner winner;
+    BOOST_CHECK(votes.Get(hash, winner));
+    BOOST_CHECK(!votes.Add(hash, winner));
+    BOOST_CHECK(votes.IsLeading(payeeA, 100, 108, -1));
+    BOOST_CHECK(!votes.IsLeading(payeeA, 101, 108, -1));
+    BOOST_CHECK(!votes.IsLeading(payeeA, 100, 108, 100));
+
+    // The lead changes hands as votes come in
+    AddVote(votes, 100, payeeB);
+    AddVote(votes, 100, payeeB);
+    BOOST_CHECK(!votes.IsLeading(payeeA, 100, 108, -1));
+    BOOST_CHECK(votes.IsLeading(payeeB, 100, 108, -1));
+    CScript payee;
+    BOOST_CHECK(votes.GetBlock(100)->GetPayee(payee));
+    BOOST_CHECK(payee == payeeB);
+    BOOST_CHECK(votes.GetBlock(100)->HasPayeeWithVotes(payeeB, 2));
+    BOOST_CHECK(votes.GetBlock(101) == NULL);
+
+    AddVote(votes, 104, payeeA);
+    BOOST_CHECK(votes.IsLeading(payeeA, 100, 108, -1));
+    BOOST_CHECK_EQUAL(votes.size(), 4U);
+    BOOST_CHECK_EQUAL(votes.CountBlocks(), 2U);
+    BOOST_CHECK_EQUAL(votes.GetOldestHeight(), 100);
+    BOOST_CHECK_EQUAL(votes.GetNewestHeight(), 104);
+
+    std::vector<uint256> vHashes;
+    votes.GetHashes(101, 110, vHashes);
+    BOOST_CHECK_EQUAL(vHashes.size(), 1U);
+}
+
+BOOST_AUTO_TEST_CASE(mnpayments_votes_ring)
+{
+    CScript payeeA = CScript() << OP_TRUE;
+    CScript payeeB = CScript() << OP_FALSE;
+    CMasternodePaymentVotes votes;
+
+    // Heights a ring size apart do not share a bucket
+    uint256 hashOld = AddVote(votes, 1000, payeeA);
+    AddVote(votes, 1000 + MNPAYMENTS_VOTE_RING_SIZE, payeeB);
+    AddVote(votes, 1001, payeeB);
+    BOOST_CHECK(votes.GetBlock(1000)->HasPayeeWithVotes(payeeA, 1));
+    BOOST_CHECK(!votes.GetBlock(1000)->HasPayeeWithVotes(payeeB, 1));
+    BOOST_CHECK(votes.GetBlock(1000 + MNPAYMENTS_VOTE_RING_SIZE)->HasPayeeWithVotes(payeeB, 1));
+
+    // Heights too far apart for the largest ring are refused
+    CMasternodePaymentWinner winner = MakeWinner(1000 + MNPAYMENTS_VOTE_RING_MAX_SIZE, payeeA);
+    BOOST_CHECK(!votes.Add(winner.GetHash(), winner));
+    winner.nBlockHeight = -1;
+    BOOST_CHECK(!votes.Add(winner.GetHash(), winner));
+
+    // Old blocks go with all their votes
+    std::vector<uint256> vErased;
+    votes.EraseBefore(1001, vErased);
+    BOOST_CHECK_EQUAL(vErased.size(), 1U);
+    BOOST_CHECK(vErased[0] == hashOld);
+    BOOST_CHECK(!votes.Has(hashOld));
+    BOOST_CHECK(votes.GetBlock(1000) == NULL);
+    BOOST_CHECK(!votes.IsLeading(payeeA, 0, std::numeric_limits<int>::max(), -1));
+    BOOST_CHECK_EQUAL(votes.GetOldestHeight(), 1001);
+
+    // A bucket dropped is used again by a later height
+    AddVote(votes, 1000 + 2 * MNPAYMENTS_VOTE_RING_SIZE, payeeA);
+    BOOST_CHECK(votes.GetBlock(1000 + 2 * MNPAYMENTS_VOTE_RING_SIZE)->HasPayeeWithVotes(payeeA, 1));
+    BOOST_CHECK_EQUAL(votes.CountBlocks(), 3U);
+
+    votes.EraseBefore(std::numeric_limits<int>::max(), vErased);
+    BOOST_CHECK_EQUAL(votes.size(), 0U);
+    BOOST_CHECK_EQUAL(votes.GetOldestHeight(), std::numeric_limits<int>::max());
+    BOOST_CHECK_EQUAL(votes.GetNewestHeight(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(mnpayments_votes_serialize)
+{
+    CScript payeeA = CScript() << OP_TRUE;
+    CScript payeeB = CScript() << OP_FALSE;
+    CMasternodePaymentVotes votes;
+    AddVote(votes, 50, payeeA);
+    AddVote(votes, 50, payeeA);
+    AddVote(votes, 51, payeeB);
+
+    // The layout of mnpayments.dat: the votes, then the payees of each block
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << votes;
+    CDataStream ssLegacy(ss);
+    std::map<uint256, CMasternodePaymentWinner> mapVotes;
+    std::map<int, CMasternodeBlockPayees> mapBlocks;
+    ssLegacy >> mapVotes >> mapBlocks;
+    BOOST_CHECK_EQUAL(mapVotes.size(), 3U);
+    BOOST_CHECK_EQUAL(mapBlocks.size(), 2U);
+    BOOST_CHECK(mapBlocks[50].HasPayeeWithVotes(payeeA, 2));
+
+    CMasternodePaymentVotes loaded;
+    ss >> loaded;
+    BOOST_CHECK_EQUAL(loaded.size(), 3U);
+    BOOST_CHECK(loaded.GetBlock(50)->HasPayeeWithVotes(payeeA, 2));
+    BOOST_CHECK(loaded.IsLeading(payeeB, 51, 51, -1));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
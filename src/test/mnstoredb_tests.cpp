@@ -0,0 +1,117 @@
+// Copyright (c) 2019 The TRBO developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "mnstoredb.h"
+
+#include "masternode-budget.h"
+#include "masternode-payments.h"
+#include "masternodeman.h"
+#include "random.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(mnstoredb_tests)
+
+static CMasternodePaymentWinner MakeWinner(int nBlockHeight, const CScript& payee)
+{
+    CMasternodePaymentWinner winner(CTxIn(GetRandHash(), 0));
+    winner.nBlockHeight = nBlockHeight;
+    winner.AddPayee(payee);
+    return winner;
+}
+
+BOOST_AUTO_TEST_CASE(mnstoredb_change_set)
+{
+    CStoreChangeSet<int> changed;
+    changed.Add(1);
+    changed.Add(2);
+    changed.Add(1);
+    BOOST_CHECK_EQUAL(changed.size(), 2U);
+
+    std::set<int> setTaken;
+    changed.Take(setTaken);
+    BOOST_CHECK_EQUAL(setTaken.size(), 2U);
+    BOOST_CHECK_EQUAL(changed.size(), 0U);
+
+    // A failed write puts the keys back, merged with the ones changed meanwhile
+    changed.Add(3);
+    changed.Restore(setTaken);
+    BOOST_CHECK_EQUAL(changed.size(), 3U);
+}
+
+BOOST_AUTO_TEST_CASE(mnstoredb_payee_votes)
+{
+    CMasternodeStoreDB db(1 << 20, true);
+    CScript payeeA = CScript() << OP_TRUE;
+    CScript payeeB = CScript() << OP_FALSE;
+
+    CMasternodePayments payments;
+    std::vector<CMasternodePaymentWinner> vWinners;
+    vWinners.push_back(MakeWinner(10, payeeA));
+    vWinners.push_back(MakeWinner(10, payeeA));
+    vWinners.push_back(MakeWinner(10, payeeB));
+    vWinners.push_back(MakeWinner(11, payeeB));
+    BOOST_FOREACH (CMasternodePaymentWinner& winner, vWinners)
+        payments.votes.Add(winner.GetHash(), winner);
+    payments.SetAllChanged(db);
+    BOOST_CHECK(payments.WriteStore(db));
+
+    // Records of the masternode list are kept apart from the votes
+    CMasternodeMan man;
+    man.nDsqCount = 7;
+    BOOST_CHECK(man.WriteStore(db));
+
+    std::vector<uint256> vKeys;
+    BOOST_CHECK(db.ReadKeys(DB_PAYEE_VOTE, vKeys));
+    BOOST_CHECK_EQUAL(vKeys.size(), 4U);
+
+    // The votes come back, and are counted per block again
+    CMasternodePayments loaded;
+    BOOST_CHECK(loaded.ReadStore(db));
+    BOOST_CHECK_EQUAL(loaded.votes.size(), 4U);
+    BOOST_CHECK(loaded.HasPayeeWithVotes(10, payeeA, 2));
+    BOOST_CHECK(!loaded.HasPayeeWithVotes(10, payeeB, 2));
+    BOOST_CHECK(loaded.HasPayeeWithVotes(11, payeeB, 1));
+
+    // Nothing changed, nothing written
+    BOOST_CHECK(loaded.WriteStore(db));
+
+    // A removed vote is erased from the store
+    CMasternodePayments remaining;
+    for (unsigned int i = 1; i < vWinners.size(); i++)
+        remaining.votes.Add(vWinners[i].GetHash(), vWinners[i]);
+    remaining.SetAllChanged(db);
+    BOOST_CHECK(remaining.WriteStore(db));
+    BOOST_CHECK(loaded.ReadStore(db));
+    BOOST_CHECK_EQUAL(loaded.votes.size(), 3U);
+    BOOST_CHECK(!loaded.HasVote(vWinners[0].GetHash()));
+    BOOST_CHECK(!loaded.HasPayeeWithVotes(10, payeeA, 2));
+
+    CMasternodeMan manLoaded;
+    BOOST_CHECK(manLoaded.ReadStore(db));
+    BOOST_CHECK_EQUAL(manLoaded.size(), 0);
+    BOOST_CHECK_EQUAL(manLoaded.nDsqCount, 7);
+}
+
+BOOST_AUTO_TEST_CASE(mnstoredb_budget_votes_cleaned)
+{
+    // The vote of a masternode that is not in the list stops counting
+    CBudgetProposal proposal;
+    CBudgetVote vote(CTxIn(GetRandHash(), 0), GetRandHash(), VOTE_YES);
+    proposal.mapVotes[vote.GetHash()] = vote;
+    BOOST_CHECK(proposal.CleanAndRemove(false));
+    BOOST_CHECK(!proposal.mapVotes.begin()->second.fValid);
+    BOOST_CHECK_EQUAL(proposal.GetYeas(), 0);
+
+    // Nothing changed the second time, so there is nothing to write
+    BOOST_CHECK(!proposal.CleanAndRemove(false));
+
+    CFinalizedBudget finalizedBudget;
+    CFinalizedBudgetVote finalVote(CTxIn(GetRandHash(), 0), GetRandHash());
+    finalizedBudget.mapVotes[finalVote.GetHash()] = finalVote;
+    BOOST_CHECK(finalizedBudget.CleanAndRemove(false));
+    BOOST_CHECK(!finalizedBudget.CleanAndRemove(false));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
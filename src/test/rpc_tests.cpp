@@ -10,6 +10,7 @@
 #include "util.h"
 
 #include <boost/algorithm/string.hpp>
+#include <boost/bind.hpp>
 #include <boost/test/unit_test.hpp>
 
 #include <univalue.h>
@@ -263,4 +264,50 @@ BOOST_AUTO_TEST_CASE(rpc_ban)
     BOOST_CHECK_EQUAL(adr.get_str(), "2001:4d48:ac57:400:cacf:e9ff:fe1d:9c63/128");
 }
 
+static void AppendChunk(std::vector<std::string>& vChunks, const std::string& strChunk)
+{
+    vChunks.push_back(strChunk);
+}
+
+BOOST_AUTO_TEST_CASE(rpc_stream_writer)
+{
+    UniValue value;
+    BOOST_CHECK(value.read("{\"a\":[1,2,{\"b\":null,\"c\":\"x\\\"y\"}],\"d\":{},\"e\":[],\"f\":1.5e3,\"g\":true}"));
+
+    // Small chunks force the output to be split in many places
+    std::vector<std::string> vChunks;
+    CJSONStreamWriter writer(boost::bind(&AppendChunk, boost::ref(vChunks), _1), 4);
+    writer.Write(value);
+    writer.Finish();
+    BOOST_CHECK(vChunks.size() > 1);
+    BOOST_CHECK_EQUAL(boost::algorithm::join(vChunks, ""), value.write() + "\n");
+
+    // Containers opened explicitly give the same result
+    vChunks.clear();
+    CJSONStreamWriter writer2(boost::bind(&AppendChunk, boost::ref(vChunks), _1));
+    writer2.BeginObject();
+    writer2.Key("a");
+    writer2.BeginArray();
+    const std::vector<UniValue>& values = find_value(value, "a").getValues();
+    for (unsigned int i = 0; i < values.size(); i++)
+        writer2.Write(values[i]);
+    writer2.EndArray();
+    writer2.Write("d", find_value(value, "d"));
+    writer2.Key("e");
+    writer2.BeginArray();
+    writer2.EndArray();
+    writer2.Write("f", find_value(value, "f"));
+    writer2.Write("g", find_value(value, "g"));
+    writer2.EndObject();
+    writer2.Finish();
+    BOOST_CHECK_EQUAL(vChunks.size(), 1U);
+    BOOST_CHECK_EQUAL(vChunks[0], value.write() + "\n");
+
+    // A JSON-RPC reply matches the non-streaming one
+    vChunks.clear();
+    CJSONStreamWriter writer3(boost::bind(&AppendChunk, boost::ref(vChunks), _1));
+    JSONRPCWriteReply(writer3, value, NullUniValue, UniValue(1));
+    BOOST_CHECK_EQUAL(vChunks[0], JSONRPCReply(value, NullUniValue, UniValue(1)));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
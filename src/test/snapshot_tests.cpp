@@ -0,0 +1,110 @@
+// Copyright (c) 2019 The TRBO developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "snapshot.h"
+
+#include "main.h"
+#include "random.h"
+#include "script/script.h"
+#include "txdb.h"
+#include "util.h"
+
+#include <stdio.h>
+
+#include <boost/filesystem.hpp>
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(snapshot_tests)
+
+/** Swap in empty coin and block tree databases for the duration of a load */
+struct EmptyChainState {
+    CCoinsViewDB* pcoinsdbviewOld;
+    CBlockTreeDB* pblocktreeOld;
+
+    EmptyChainState() : pcoinsdbviewOld(pcoinsdbview), pblocktreeOld(pblocktree)
+    {
+        pcoinsdbview = new CCoinsViewDB(1 << 20, true);
+        pblocktree = new CBlockTreeDB(1 << 20, true);
+    }
+
+    ~EmptyChainState()
+    {
+        delete pcoinsdbview;
+        delete pblocktree;
+        pcoinsdbview = pcoinsdbviewOld;
+        pblocktree = pblocktreeOld;
+    }
+};
+
+BOOST_AUTO_TEST_CASE(snapshot_roundtrip)
+{
+    {
+        LOCK(cs_main);
+        for (int i = 0; i < 10; i++) {
+            CCoinsModifier coins = pcoinsTip->ModifyCoins(GetRandHash());
+            coins->nVersion = 1;
+            coins->nHeight = 0;
+            coins->vout.resize(i + 1);
+            coins->vout[i].nValue = (i + 1) * COIN;
+            coins->vout[i].scriptPubKey = CScript() << OP_TRUE;
+        }
+    }
+
+    boost::filesystem::path path = GetDataDir() / "test.snapshot";
+    CChainStateSnapshotInfo infoDump;
+    std::string strError;
+    BOOST_CHECK_MESSAGE(DumpChainStateSnapshot(path, infoDump, strError), strError);
+
+    CCoinsStats stats;
+    {
+        LOCK(cs_main);
+        BOOST_CHECK(pcoinsTip->GetStats(stats));
+        BOOST_CHECK(infoDump.hashBlock == chainActive.Tip()->GetBlockHash());
+    }
+    BOOST_CHECK(infoDump.hashSerialized == stats.hashSerialized);
+    BOOST_CHECK_EQUAL(infoDump.nTransactions, stats.nTransactions);
+    BOOST_CHECK(infoDump.nTransactions >= 10);
+
+    {
+        EmptyChainState chainstate;
+        CChainStateSnapshotInfo infoLoad;
+        BOOST_CHECK_MESSAGE(LoadChainStateSnapshot(path, infoDump.hashSerialized, infoLoad, strError), strError);
+        BOOST_CHECK(infoLoad.hashBlock == infoDump.hashBlock);
+        BOOST_CHECK_EQUAL(infoLoad.nHeight, infoDump.nHeight);
+        BOOST_CHECK(pcoinsdbview->GetBestBlock() == infoDump.hashBlock);
+
+        CCoinsStats statsLoaded;
+        BOOST_CHECK(pcoinsdbview->GetStats(statsLoaded));
+        BOOST_CHECK(statsLoaded.hashSerialized == stats.hashSerialized);
+        BOOST_CHECK_EQUAL(statsLoaded.nTotalAmount, stats.nTotalAmount);
+    }
+
+    // A snapshot of some other UTXO set is refused before anything is written
+    {
+        EmptyChainState chainstate;
+        CChainStateSnapshotInfo infoLoad;
+        BOOST_CHECK(!LoadChainStateSnapshot(path, GetRandHash(), infoLoad, strError));
+        BOOST_CHECK(pcoinsdbview->GetBestBlock() == 0);
+    }
+
+    // So is a damaged one
+    FILE* file = fopen(path.string().c_str(), "r+b");
+    BOOST_REQUIRE(file != NULL);
+    long nOffset = boost::filesystem::file_size(path) / 2;
+    fseek(file, nOffset, SEEK_SET);
+    int ch = fgetc(file);
+    fseek(file, nOffset, SEEK_SET);
+    fputc(ch ^ 0x01, file);
+    fclose(file);
+    {
+        EmptyChainState chainstate;
+        CChainStateSnapshotInfo infoLoad;
+        BOOST_CHECK(!LoadChainStateSnapshot(path, uint256(0), infoLoad, strError));
+        BOOST_CHECK(pcoinsdbview->GetBestBlock() == 0);
+    }
+
+    boost::filesystem::remove(path);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
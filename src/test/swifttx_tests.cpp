@@ -0,0 +1,84 @@
+// Copyright (c) 2019 The TRBO developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "swifttx.h"
+
+#include "primitives/transaction.h"
+#include "random.h"
+#include "utiltime.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(swifttx_tests)
+
+static CTransaction SpendingTx(const COutPoint& prevout)
+{
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].prevout = prevout;
+    tx.vout.resize(1);
+    tx.vout[0].nValue = GetRandInt(1000) + 1;
+    return tx;
+}
+
+BOOST_AUTO_TEST_CASE(lock_conflicts_and_expiry)
+{
+    CTxLockManager locks;
+    COutPoint prevout(GetRandHash(), 0);
+    CTransaction tx = SpendingTx(prevout);
+    CTransaction txDoubleSpend = SpendingTx(prevout);
+    uint256 hashLock;
+
+    locks.AddRequest(tx);
+    locks.SetLockHeight(tx.GetHash(), 100);
+    BOOST_CHECK(locks.HaveRequest(tx.GetHash()));
+    BOOST_CHECK_EQUAL(locks.CountSignatures(tx.GetHash()), 0);
+    BOOST_CHECK_EQUAL(locks.CountSignatures(txDoubleSpend.GetHash()), -1);
+
+    // Inputs are only claimed once the lock completes
+    BOOST_CHECK(!locks.IsConflicting(txDoubleSpend, hashLock));
+    BOOST_CHECK(locks.CompleteLock(tx.GetHash()));
+    BOOST_CHECK(locks.IsConflicting(txDoubleSpend, hashLock));
+    BOOST_CHECK(hashLock == tx.GetHash());
+    BOOST_CHECK(!locks.IsConflicting(tx, hashLock));
+
+    CTxLockStats stats = locks.GetStats();
+    BOOST_CHECK_EQUAL(stats.nRequests, 1U);
+    BOOST_CHECK_EQUAL(stats.nLocks, 1U);
+    BOOST_CHECK_EQUAL(stats.nLockedInputs, 1U);
+
+    // Locks live for an hour; expiring them releases their inputs
+    int64_t nNow = GetTime();
+    locks.RemoveExpired(nNow);
+    BOOST_CHECK_EQUAL(locks.GetStats().nLocks, 1U);
+    locks.RemoveExpired(nNow + 60 * 60 + 60);
+    stats = locks.GetStats();
+    BOOST_CHECK_EQUAL(stats.nLocks, 0U);
+    BOOST_CHECK_EQUAL(stats.nRequests, 0U);
+    BOOST_CHECK_EQUAL(stats.nLockedInputs, 0U);
+    BOOST_CHECK_EQUAL(stats.nExpired, 1U);
+    BOOST_CHECK(!locks.IsConflicting(txDoubleSpend, hashLock));
+}
+
+BOOST_AUTO_TEST_CASE(conflicting_locks_cancel_out)
+{
+    CTxLockManager locks;
+    COutPoint prevout(GetRandHash(), 1);
+    CTransaction tx = SpendingTx(prevout);
+    CTransaction txDoubleSpend = SpendingTx(prevout);
+
+    locks.AddRequest(tx);
+    locks.SetLockHeight(tx.GetHash(), 100);
+    BOOST_CHECK(locks.CompleteLock(tx.GetHash()));
+
+    locks.AddRequest(txDoubleSpend);
+    locks.SetLockHeight(txDoubleSpend.GetHash(), 100);
+    BOOST_CHECK(!locks.CompleteLock(txDoubleSpend.GetHash()));
+
+    // Both locks now expire with the next clean up
+    locks.RemoveExpired(GetTime() + 1);
+    BOOST_CHECK_EQUAL(locks.GetStats().nLocks, 0U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
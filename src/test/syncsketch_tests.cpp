@@ -0,0 +1,106 @@
+// Copyright (c) 2019 The TRBO developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "syncsketch.h"
+
+#include "random.h"
+#include "streams.h"
+#include "uint256.h"
+#include "version.h"
+
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(syncsketch_tests)
+
+static std::vector<uint256> RandomKeys(int nKeys)
+{
+    std::vector<uint256> vKeys;
+    for (int i = 0; i < nKeys; i++)
+        vKeys.push_back(GetRandHash());
+    return vKeys;
+}
+
+/** Keys that decode with a fixed salt, as a small sketch fails to decode a few sets */
+static std::vector<uint256> FixedKeys(int nKeys)
+{
+    std::vector<uint256> vKeys;
+    for (int i = 0; i < nKeys; i++)
+        vKeys.push_back(uint256(i + 1));
+    return vKeys;
+}
+
+BOOST_AUTO_TEST_CASE(syncsketch_decode)
+{
+    std::vector<uint256> vKeys = FixedKeys(100);
+    CSyncSketch sketch(1, 2, 60);
+    for (int i = 0; i < 20; i++)
+        sketch.Insert(vKeys[i]);
+    CSyncSketch sketchOther(1, 2, 60);
+    for (int i = 10; i < 25; i++)
+        sketchOther.Insert(vKeys[i]);
+    sketch.Subtract(sketchOther);
+
+    // The items both have cancel out
+    std::set<uint64_t> setAdded, setRemoved;
+    BOOST_CHECK(sketch.Decode(setAdded, setRemoved));
+    BOOST_CHECK_EQUAL(setAdded.size(), 10U);
+    BOOST_CHECK_EQUAL(setRemoved.size(), 5U);
+    for (int i = 0; i < 10; i++)
+        BOOST_CHECK(setAdded.count(sketch.GetShortID(vKeys[i])));
+    for (int i = 20; i < 25; i++)
+        BOOST_CHECK(setRemoved.count(sketch.GetShortID(vKeys[i])));
+
+    // Far more differences than cells
+    CSyncSketch sketchFull(1, 2, 60);
+    for (const uint256& key : vKeys)
+        sketchFull.Insert(key);
+    BOOST_CHECK(!sketchFull.Decode(setAdded, setRemoved));
+}
+
+BOOST_AUTO_TEST_CASE(syncsketch_missing)
+{
+    std::vector<uint256> vOurs = RandomKeys(3000);
+
+    // The peer has all but a few of ours, and some we do not have
+    std::vector<uint256> vTheirs(vOurs.begin() + 7, vOurs.end());
+    std::vector<uint256> vExtra = RandomKeys(5);
+    vTheirs.insert(vTheirs.end(), vExtra.begin(), vExtra.end());
+
+    CSyncSketch sketch = CSyncSketch::ForKeys(vTheirs);
+    BOOST_CHECK(sketch.IsWithinSizeConstraints());
+    BOOST_CHECK_EQUAL(sketch.GetCells(), 999U);
+
+    // It travels over the network
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << sketch;
+    CSyncSketch sketchPeer;
+    ss >> sketchPeer;
+
+    std::vector<size_t> vMissing;
+    BOOST_CHECK(sketchPeer.GetMissing(vOurs, vMissing));
+    BOOST_CHECK_EQUAL(vMissing.size(), 7U);
+    for (size_t i = 0; i < vMissing.size(); i++)
+        BOOST_CHECK_EQUAL(vMissing[i], i);
+
+    // Nothing missing
+    BOOST_CHECK(CSyncSketch::ForKeys(vOurs).GetMissing(vOurs, vMissing));
+    BOOST_CHECK(vMissing.empty());
+
+    // An unrelated set is too different to decode, and the caller sends everything
+    BOOST_CHECK(!CSyncSketch::ForKeys(RandomKeys(3000)).GetMissing(vOurs, vMissing));
+
+    // A peer without anything gets all of a small set
+    std::vector<uint256> vFew = FixedKeys(20);
+    CSyncSketch sketchEmpty(1, 2, MIN_SYNC_SKETCH_CELLS);
+    BOOST_CHECK(sketchEmpty.GetMissing(vFew, vMissing));
+    BOOST_CHECK_EQUAL(vMissing.size(), 20U);
+
+    // Sketches with a size that does not fit the cells are refused
+    BOOST_CHECK(!CSyncSketch().IsWithinSizeConstraints());
+    BOOST_CHECK(!CSyncSketch().GetMissing(vFew, vMissing));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
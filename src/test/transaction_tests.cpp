@@ -502,6 +502,51 @@ BOOST_AUTO_TEST_CASE(test_big_witness_transaction) {
     threadGroup.join_all();
 }
 
+BOOST_AUTO_TEST_CASE(test_CheckInputs_parallel)
+{
+    LOCK(cs_main);
+    CKey key;
+    key.MakeNewKey(true);
+    CBasicKeyStore keystore;
+    keystore.AddKey(key);
+    CScript scriptPubKey = GetScriptForDestination(key.GetPubKey().GetID());
+
+    // Enough inputs for CheckInputs to verify them on the script check threads
+    const unsigned int nInputs = 8;
+    CMutableTransaction txFrom;
+    txFrom.vin.resize(1);
+    txFrom.vin[0].prevout.hash.SetHex("0000000000000000000000000000000000000000000000000000000000000100");
+    for (unsigned int i = 0; i < nInputs; i++)
+        txFrom.vout.push_back(CTxOut(COIN, scriptPubKey));
+
+    CCoinsView coinsDummy;
+    CCoinsViewCache view(&coinsDummy);
+    view.SetBestBlock(chainActive.Tip()->GetBlockHash());
+    view.ModifyCoins(txFrom.GetHash())->FromTx(txFrom, 0);
+
+    CMutableTransaction tx;
+    for (unsigned int i = 0; i < nInputs; i++)
+        tx.vin.push_back(CTxIn(txFrom.GetHash(), i));
+    tx.vout.push_back(CTxOut((nInputs - 1) * COIN, scriptPubKey));
+    for (unsigned int i = 0; i < nInputs; i++)
+        BOOST_CHECK(SignSignature(keystore, txFrom, tx, i, SIGHASH_ALL));
+
+    CValidationState state;
+    BOOST_CHECK(CheckInputs(tx, state, view, true, STANDARD_SCRIPT_VERIFY_FLAGS, false));
+
+    // A signature of another input fails, and is reported like a serial check would
+    CMutableTransaction txBad(tx);
+    txBad.vin[5].scriptSig = tx.vin[4].scriptSig;
+    CValidationState stateBad;
+    BOOST_CHECK(!CheckInputs(txBad, stateBad, view, true, STANDARD_SCRIPT_VERIFY_FLAGS, false));
+    BOOST_CHECK_EQUAL(stateBad.GetRejectCode(), REJECT_INVALID);
+    BOOST_CHECK(stateBad.GetRejectReason().find("mandatory-script-verify-flag-failed") == 0);
+
+    // The queue is left idle for the next user
+    CValidationState stateAgain;
+    BOOST_CHECK(CheckInputs(tx, stateAgain, view, true, STANDARD_SCRIPT_VERIFY_FLAGS, false));
+}
+
 BOOST_AUTO_TEST_CASE(test_witness)
 {
     CBasicKeyStore keystore, keystore2;
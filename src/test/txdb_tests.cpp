@@ -0,0 +1,166 @@
+// Copyright (c) 2019 The TRBO developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "txdb.h"
+
+#include "chain.h"
+#include "main.h"
+#include "random.h"
+
+#include <limits>
+#include <map>
+#include <set>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(txdb_tests)
+
+/** What LoadBlockIndexGuts restores of a block index entry */
+struct CLoadedBlockIndex {
+    uint256 hashPrev;
+    uint256 hashNext;
+    CDiskBlockIndex diskindex;
+};
+
+static std::map<uint256, CLoadedBlockIndex> ReadLoaded()
+{
+    std::map<uint256, CLoadedBlockIndex> mapLoaded;
+    for (BlockMap::const_iterator it = mapBlockIndex.begin(); it != mapBlockIndex.end(); ++it) {
+        CLoadedBlockIndex& loaded = mapLoaded[it->first];
+        loaded.hashPrev = it->second->pprev ? it->second->pprev->GetBlockHash() : uint256();
+        loaded.hashNext = it->second->pnext ? it->second->pnext->GetBlockHash() : uint256();
+        loaded.diskindex = CDiskBlockIndex(it->second);
+    }
+    return mapLoaded;
+}
+
+static void CheckLoadedEqual(const std::map<uint256, CLoadedBlockIndex>& a, const std::map<uint256, CLoadedBlockIndex>& b)
+{
+    BOOST_REQUIRE_EQUAL(a.size(), b.size());
+    std::map<uint256, CLoadedBlockIndex>::const_iterator ita = a.begin(), itb = b.begin();
+    for (; ita != a.end(); ++ita, ++itb) {
+        BOOST_REQUIRE(ita->first == itb->first);
+        const CDiskBlockIndex& x = ita->second.diskindex;
+        const CDiskBlockIndex& y = itb->second.diskindex;
+        BOOST_CHECK(ita->second.hashPrev == itb->second.hashPrev);
+        BOOST_CHECK(ita->second.hashNext == itb->second.hashNext);
+        BOOST_CHECK_EQUAL(x.nHeight, y.nHeight);
+        BOOST_CHECK_EQUAL(x.nStatus, y.nStatus);
+        BOOST_CHECK_EQUAL(x.nTx, y.nTx);
+        BOOST_CHECK_EQUAL(x.nFile, y.nFile);
+        BOOST_CHECK_EQUAL(x.nDataPos, y.nDataPos);
+        BOOST_CHECK_EQUAL(x.nUndoPos, y.nUndoPos);
+        BOOST_CHECK_EQUAL(x.nFlags, y.nFlags);
+        BOOST_CHECK_EQUAL(x.nMint, y.nMint);
+        BOOST_CHECK_EQUAL(x.nMoneySupply, y.nMoneySupply);
+        BOOST_CHECK_EQUAL(x.nStakeModifier, y.nStakeModifier);
+        BOOST_CHECK(x.prevoutStake == y.prevoutStake);
+        BOOST_CHECK_EQUAL(x.nStakeTime, y.nStakeTime);
+        BOOST_CHECK(x.GetBlockHash() == y.GetBlockHash());
+    }
+}
+
+/** Load the block index from blocktree into an empty mapBlockIndex, with nThreads script check threads */
+static bool LoadBlockIndex(CBlockTreeDB& blocktree, int nThreads, std::map<uint256, CLoadedBlockIndex>& mapLoaded, std::set<std::pair<COutPoint, unsigned int> >& setStake)
+{
+    int nSavedThreads = nScriptCheckThreads;
+    nScriptCheckThreads = nThreads;
+    bool fRet = blocktree.LoadBlockIndexGuts();
+    nScriptCheckThreads = nSavedThreads;
+
+    mapLoaded = ReadLoaded();
+    setStake = setStakeSeen;
+    for (BlockMap::iterator it = mapBlockIndex.begin(); it != mapBlockIndex.end(); ++it)
+        delete it->second;
+    mapBlockIndex.clear();
+    setStakeSeen.clear();
+    return fRet;
+}
+
+BOOST_AUTO_TEST_CASE(txdb_load_block_index_parallel)
+{
+    LOCK(cs_main);
+    BlockMap mapSaved;
+    mapSaved.swap(mapBlockIndex);
+    std::set<std::pair<COutPoint, unsigned int> > setStakeSaved;
+    setStakeSaved.swap(setStakeSeen);
+
+    // More records than fit in one batch, after the proof of work era, with
+    // a mix of validity flags, stored data and stake
+    CBlockTreeDB blocktree(1 << 22, true);
+    const int nBlocks = 20000;
+    const int nStartHeight = 1000;
+    std::vector<CBlockIndex> vIndex(nBlocks);
+    std::vector<uint256> vHashes(nBlocks);
+    for (int i = 0; i < nBlocks; i++) {
+        CBlockIndex& index = vIndex[i];
+        index.pprev = i > 0 ? &vIndex[i - 1] : NULL;
+        index.nHeight = nStartHeight + i;
+        index.nVersion = 3;
+        index.nTime = 1500000000 + 60 * i;
+        index.nBits = 0x1e0fffff;
+        index.nNonce = i;
+        index.hashMerkleRoot = GetRandHash();
+        index.nTx = 1 + i % 7;
+        if (i % 11 == 0)
+            index.nStatus = BLOCK_VALID_TREE;
+        else if (i % 13 == 0)
+            index.nStatus = BLOCK_VALID_TRANSACTIONS | BLOCK_HAVE_DATA | BLOCK_FAILED_VALID;
+        else
+            index.nStatus = BLOCK_VALID_SCRIPTS | BLOCK_HAVE_DATA | BLOCK_HAVE_UNDO;
+        index.nFile = i / 1000;
+        index.nDataPos = 8 + i * 300;
+        index.nUndoPos = 8 + i * 100;
+        index.nMint = i * COIN;
+        index.nMoneySupply = (int64_t)i * 1000 * COIN;
+        index.nStakeModifier = GetRand(std::numeric_limits<uint64_t>::max());
+        if (i % 2 == 0) {
+            index.SetProofOfStake();
+            index.prevoutStake = COutPoint(GetRandHash(), i % 5);
+            index.nStakeTime = index.nTime;
+        }
+        vHashes[i] = CDiskBlockIndex(&index).GetBlockHash();
+        index.phashBlock = &vHashes[i];
+    }
+    for (int i = 0; i < nBlocks; i++) {
+        CDiskBlockIndex diskindex(&vIndex[i]);
+        if (i + 1 < nBlocks)
+            diskindex.hashNext = vHashes[i + 1];
+        BOOST_REQUIRE(blocktree.WriteBlockIndex(diskindex));
+    }
+
+    std::map<uint256, CLoadedBlockIndex> mapSerial, mapParallel;
+    std::set<std::pair<COutPoint, unsigned int> > setStakeSerial, setStakeParallel;
+    BOOST_CHECK(LoadBlockIndex(blocktree, 0, mapSerial, setStakeSerial));
+    BOOST_CHECK(LoadBlockIndex(blocktree, 4, mapParallel, setStakeParallel));
+
+    // Both agree with each other and with what was written
+    BOOST_CHECK_EQUAL(mapSerial.size(), (size_t)nBlocks);
+    CheckLoadedEqual(mapSerial, mapParallel);
+    BOOST_CHECK(setStakeSerial == setStakeParallel);
+    BOOST_CHECK_EQUAL(setStakeSerial.size(), (size_t)nBlocks / 2);
+    for (int i = 0; i < nBlocks; i += 997) {
+        const CLoadedBlockIndex& loaded = mapParallel[vHashes[i]];
+        BOOST_CHECK_EQUAL(loaded.diskindex.nHeight, nStartHeight + i);
+        BOOST_CHECK_EQUAL(loaded.diskindex.nStatus, vIndex[i].nStatus);
+        BOOST_CHECK(loaded.hashPrev == (i > 0 ? vHashes[i - 1] : uint256()));
+        BOOST_CHECK(loaded.hashNext == (i + 1 < nBlocks ? vHashes[i + 1] : uint256()));
+    }
+
+    // A record that does not decode fails either way
+    CBlockTreeDB blocktreeBad(1 << 20, true);
+    for (int i = 0; i < 100; i++) {
+        CDiskBlockIndex diskindex(&vIndex[i]);
+        BOOST_REQUIRE(blocktreeBad.WriteBlockIndex(diskindex));
+    }
+    BOOST_REQUIRE(blocktreeBad.Write(std::make_pair('b', vHashes[100]), std::string("not a block index")));
+    BOOST_CHECK(!LoadBlockIndex(blocktreeBad, 0, mapSerial, setStakeSerial));
+    BOOST_CHECK(!LoadBlockIndex(blocktreeBad, 4, mapParallel, setStakeParallel));
+
+    mapSaved.swap(mapBlockIndex);
+    setStakeSaved.swap(setStakeSeen);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -4,6 +4,15 @@
 
 #include "wallet/wallet.h"
 
+#include "base58.h"
+#include "main.h"
+#include "random.h"
+#include "swifttx.h"
+#include "txmempool.h"
+#include "wallet/walletdb.h"
+
+#include <limits>
+#include <list>
 #include <set>
 #include <stdint.h>
 #include <utility>
@@ -305,4 +314,363 @@ BOOST_AUTO_TEST_CASE(coin_selection_tests)
     empty_wallet();
 }
 
+BOOST_AUTO_TEST_CASE(scan_filter_tests)
+{
+    CKey key, keyOther;
+    key.MakeNewKey(true);
+    keyOther.MakeNewKey(true);
+    CScript scriptOther = GetScriptForDestination(keyOther.GetPubKey().GetID());
+    std::vector<CPubKey> vMultisigKeys;
+    vMultisigKeys.push_back(keyOther.GetPubKey());
+    vMultisigKeys.push_back(key.GetPubKey());
+
+    CWalletScanFilter filter;
+    size_t nGeneration;
+    {
+        LOCK(wallet.cs_wallet);
+        BOOST_CHECK(wallet.AddKeyPubKey(key, key.GetPubKey()));
+        nGeneration = wallet.GetScanFilter(filter);
+    }
+    BOOST_CHECK(filter.IsRelevant(GetScriptForDestination(key.GetPubKey().GetID())));
+    BOOST_CHECK(filter.IsRelevant(GetScriptForRawPubKey(key.GetPubKey())));
+    BOOST_CHECK(filter.IsRelevant(GetScriptForMultisig(1, vMultisigKeys)));
+    BOOST_CHECK(!filter.IsRelevant(scriptOther));
+    BOOST_CHECK(!filter.IsRelevant(GetScriptForRawPubKey(keyOther.GetPubKey())));
+
+    CMutableTransaction tx;
+    tx.vout.resize(2);
+    tx.vout[0].scriptPubKey = scriptOther;
+    BOOST_CHECK(!filter.IsRelevant(CTransaction(tx)));
+    tx.vout[1].scriptPubKey = GetScriptForRawPubKey(key.GetPubKey());
+    BOOST_CHECK(filter.IsRelevant(CTransaction(tx)));
+
+    // Watching a script makes the snapshot stale
+    {
+        LOCK(wallet.cs_wallet);
+        BOOST_CHECK(wallet.AddWatchOnly(scriptOther));
+        BOOST_CHECK(wallet.GetScanFilter(filter) != nGeneration);
+    }
+    BOOST_CHECK(filter.IsRelevant(scriptOther));
+}
+
+BOOST_AUTO_TEST_CASE(rescan_reserver_tests)
+{
+    BOOST_CHECK(!wallet.IsScanning());
+    {
+        CWalletRescanReserver reserver(&wallet);
+        BOOST_CHECK(reserver.Reserve());
+        BOOST_CHECK(wallet.IsScanning());
+
+        // Neither another reservation nor a scan without one gets in while it is held
+        CWalletRescanReserver reserverOther(&wallet);
+        BOOST_CHECK(!reserverOther.Reserve());
+        BOOST_CHECK(!reserverOther.IsReserved());
+        BOOST_CHECK_EQUAL(wallet.ScanForWalletTransactions(NULL, true), WALLET_RESCAN_BUSY);
+        BOOST_CHECK_EQUAL(wallet.ScanForWalletTransactions(NULL, true, &reserverOther), WALLET_RESCAN_BUSY);
+
+        // The holder scans, and keeps the reservation until it goes out of scope
+        BOOST_CHECK_EQUAL(wallet.ScanForWalletTransactions(NULL, true, &reserver), 0);
+        BOOST_CHECK(wallet.IsScanning());
+    }
+    BOOST_CHECK(!wallet.IsScanning());
+    BOOST_CHECK_EQUAL(wallet.ScanForWalletTransactions(NULL, true), 0);
+    BOOST_CHECK(!wallet.IsScanning());
+}
+
+BOOST_AUTO_TEST_CASE(coin_index_tests)
+{
+    CWallet indexWallet;
+    CKey key;
+    key.MakeNewKey(true);
+    CScript scriptMine = GetScriptForDestination(key.GetPubKey().GetID());
+
+    CMutableTransaction tx;
+    tx.vout.resize(3);
+    tx.vout[0].nValue = 1 * COIN;
+    tx.vout[0].scriptPubKey = scriptMine;
+    tx.vout[1].nValue = 2 * COIN;
+    tx.vout[2].nValue = 3 * COIN;
+    tx.vout[2].scriptPubKey = scriptMine;
+    CWalletTx wtx(&indexWallet, tx);
+
+    LOCK2(cs_main, indexWallet.cs_wallet);
+    BOOST_CHECK(indexWallet.AddToWallet(wtx, true));
+
+    // Nothing is ours until the key is known
+    vector<COutput> vAvailable;
+    indexWallet.AvailableCoins(vAvailable, false);
+    BOOST_CHECK(vAvailable.empty());
+
+    BOOST_CHECK(indexWallet.AddKeyPubKey(key, key.GetPubKey()));
+    indexWallet.AvailableCoins(vAvailable, false);
+    BOOST_CHECK_EQUAL(vAvailable.size(), 2U);
+    BOOST_CHECK_EQUAL(vAvailable[0].i, 0);
+    BOOST_CHECK_EQUAL(vAvailable[1].i, 2);
+
+    COutPoint outpoint(wtx.GetHash(), 2);
+    indexWallet.LockCoin(outpoint);
+    indexWallet.AvailableCoins(vAvailable, false);
+    BOOST_CHECK_EQUAL(vAvailable.size(), 1U);
+    indexWallet.UnlockCoin(outpoint);
+    indexWallet.AvailableCoins(vAvailable, false);
+    BOOST_CHECK_EQUAL(vAvailable.size(), 2U);
+}
+
+/** Connect a block holding vtx on top of the active chain and sync it to the wallet */
+static CBlock ConnectTestBlock(CWallet& w, const std::vector<CTransaction>& vtx)
+{
+    CBlock block;
+    block.nTime = chainActive.Height() + 1;
+    block.nNonce = GetRand(std::numeric_limits<uint32_t>::max());
+    block.vtx = vtx;
+    block.hashMerkleRoot = block.BuildMerkleTree();
+    CBlockIndex* pindex = new CBlockIndex(block);
+    pindex->pprev = chainActive.Tip();
+    pindex->nHeight = chainActive.Height() + 1;
+    pindex->phashBlock = &mapBlockIndex.insert(std::make_pair(block.GetHash(), pindex)).first->first;
+    chainActive.SetTip(pindex);
+    BOOST_FOREACH (const CTransaction& tx, vtx) {
+        std::list<CTransaction> removed;
+        mempool.remove(tx, removed);
+        w.SyncTransaction(tx, &block);
+    }
+    return block;
+}
+
+/** The balances as GetBalance & co. computed them before they were kept running */
+static void CheckBalances(const CWallet& w)
+{
+    CAmount nBalance = 0, nUnconfirmed = 0, nImmature = 0, nWatchOnly = 0;
+    BOOST_FOREACH (const PAIRTYPE(const uint256, CWalletTx)& item, w.mapWallet) {
+        const CWalletTx& wtx = item.second;
+        bool fTrusted = wtx.IsTrusted();
+        if (fTrusted) {
+            nBalance += wtx.GetAvailableCredit();
+            nWatchOnly += wtx.GetAvailableWatchOnlyCredit();
+        }
+        if (!IsFinalTx(wtx) || (!fTrusted && wtx.GetDepthInMainChain() == 0))
+            nUnconfirmed += wtx.GetAvailableCredit();
+        nImmature += wtx.GetImmatureCredit();
+    }
+    BOOST_CHECK_EQUAL(w.GetBalance(), nBalance);
+    BOOST_CHECK_EQUAL(w.GetUnconfirmedBalance(), nUnconfirmed);
+    BOOST_CHECK_EQUAL(w.GetImmatureBalance(), nImmature);
+    BOOST_CHECK_EQUAL(w.GetWatchOnlyBalance(), nWatchOnly);
+}
+
+BOOST_AUTO_TEST_CASE(running_balance_tests)
+{
+    const std::string strFile = "wallet_balance_test.dat";
+    CWalletDB(strFile, "cr+").WriteVersion(CLIENT_VERSION);
+    CWallet balanceWallet(strFile);
+    CKey key;
+    key.MakeNewKey(true);
+    CScript scriptMine = GetScriptForDestination(key.GetPubKey().GetID());
+    CKey keyWatch, keyWatchOther;
+    keyWatch.MakeNewKey(true);
+    keyWatchOther.MakeNewKey(true);
+    CScript scriptWatch = GetScriptForDestination(keyWatch.GetPubKey().GetID());
+    CScript scriptWatchOther = GetScriptForDestination(keyWatchOther.GetPubKey().GetID());
+
+    LOCK2(cs_main, balanceWallet.cs_wallet);
+    CBlockIndex* pindexSaved = chainActive.Tip();
+    BOOST_CHECK(balanceWallet.AddKeyPubKey(key, key.GetPubKey()));
+
+    // A buried receive
+    CMutableTransaction txReceived;
+    txReceived.vin.push_back(CTxIn(COutPoint(GetRandHash(), 0)));
+    txReceived.vout.push_back(CTxOut(10 * COIN, scriptMine));
+    txReceived.vout.push_back(CTxOut(3 * COIN, scriptWatch));
+    CBlock blockReceived = ConnectTestBlock(balanceWallet, std::vector<CTransaction>(1, txReceived));
+    for (int i = 0; i < 6; i++)
+        ConnectTestBlock(balanceWallet, std::vector<CTransaction>());
+    CheckBalances(balanceWallet);
+    BOOST_CHECK_EQUAL(balanceWallet.GetBalance(), 10 * COIN);
+    BOOST_CHECK_EQUAL(balanceWallet.GetWatchOnlyBalance(), 0);
+
+    // Watching a script, then swapping it for another keeps the keystore sizes
+    // but still changes the generation; each is followed by the rescan importing it does
+    BOOST_CHECK(balanceWallet.AddWatchOnly(scriptWatch));
+    balanceWallet.SyncTransaction(txReceived, &blockReceived);
+    CheckBalances(balanceWallet);
+    BOOST_CHECK_EQUAL(balanceWallet.GetWatchOnlyBalance(), 3 * COIN);
+    CWalletScanFilter filter;
+    size_t nGeneration = balanceWallet.GetScanFilter(filter);
+    BOOST_CHECK(balanceWallet.RemoveWatchOnly(scriptWatch));
+    BOOST_CHECK(balanceWallet.AddWatchOnly(scriptWatchOther));
+    BOOST_CHECK(balanceWallet.GetScanFilter(filter) != nGeneration);
+    balanceWallet.SyncTransaction(txReceived, &blockReceived);
+    CheckBalances(balanceWallet);
+    BOOST_CHECK_EQUAL(balanceWallet.GetWatchOnlyBalance(), 0);
+
+    // An unconfirmed receive counts once SwiftTX locks it, and no longer once the lock expires
+    CMutableTransaction txLocked;
+    txLocked.vin.push_back(CTxIn(COutPoint(GetRandHash(), 0)));
+    txLocked.vout.push_back(CTxOut(2 * COIN, scriptMine));
+    const uint256 hashLocked = CTransaction(txLocked).GetHash();
+    mempool.addUnchecked(hashLocked, CTxMemPoolEntry(txLocked, 0, GetTime(), 0, chainActive.Height()));
+    balanceWallet.SyncTransaction(txLocked, NULL);
+    CheckBalances(balanceWallet);
+    BOOST_CHECK_EQUAL(balanceWallet.GetBalance(), 10 * COIN);
+    BOOST_CHECK_EQUAL(balanceWallet.GetUnconfirmedBalance(), 2 * COIN);
+
+    txLockManager.SetLockHeight(hashLocked, chainActive.Height());
+    for (int i = 0; i < SWIFTTX_SIGNATURES_REQUIRED; i++) {
+        CConsensusVote vote;
+        vote.txHash = hashLocked;
+        vote.nBlockHeight = chainActive.Height();
+        vote.vinMasternode = CTxIn(COutPoint(GetRandHash(), 0));
+        txLockManager.AddSignature(vote);
+    }
+    CheckBalances(balanceWallet);
+    BOOST_CHECK_EQUAL(balanceWallet.GetBalance(), 12 * COIN);
+    BOOST_CHECK_EQUAL(balanceWallet.GetUnconfirmedBalance(), 0);
+
+    txLockManager.RemoveExpired(GetTime() + 2 * 60 * 60);
+    CheckBalances(balanceWallet);
+    BOOST_CHECK_EQUAL(balanceWallet.GetBalance(), 10 * COIN);
+    BOOST_CHECK_EQUAL(balanceWallet.GetUnconfirmedBalance(), 2 * COIN);
+
+    // Spending the buried receive, in the mempool, then in a block, then disconnected again
+    CMutableTransaction txSpend;
+    txSpend.vin.push_back(CTxIn(COutPoint(txReceived.GetHash(), 0)));
+    txSpend.vout.push_back(CTxOut(4 * COIN, scriptWatchOther));
+    txSpend.vout.push_back(CTxOut(6 * COIN, scriptMine));
+    mempool.addUnchecked(txSpend.GetHash(), CTxMemPoolEntry(txSpend, 0, GetTime(), 0, chainActive.Height()));
+    balanceWallet.SyncTransaction(txSpend, NULL);
+    CheckBalances(balanceWallet);
+    BOOST_CHECK_EQUAL(balanceWallet.GetBalance(), 6 * COIN);
+
+    CBlockIndex* pindexFork = chainActive.Tip();
+    ConnectTestBlock(balanceWallet, std::vector<CTransaction>(1, txSpend));
+    CheckBalances(balanceWallet);
+    BOOST_CHECK_EQUAL(balanceWallet.GetBalance(), 6 * COIN);
+    for (int i = 0; i < 6; i++) {
+        ConnectTestBlock(balanceWallet, std::vector<CTransaction>());
+        CheckBalances(balanceWallet);
+    }
+
+    chainActive.SetTip(pindexFork);
+    mempool.addUnchecked(txSpend.GetHash(), CTxMemPoolEntry(txSpend, 0, GetTime(), 0, chainActive.Height()));
+    balanceWallet.SyncTransaction(txSpend, NULL);
+    CheckBalances(balanceWallet);
+    BOOST_CHECK_EQUAL(balanceWallet.GetBalance(), 6 * COIN);
+    BOOST_CHECK_EQUAL(balanceWallet.GetUnconfirmedBalance(), 2 * COIN);
+
+    mempool.clear();
+    chainActive.SetTip(pindexSaved);
+    for (BlockMap::iterator it = mapBlockIndex.begin(); it != mapBlockIndex.end();) {
+        if (it->second->nHeight > (pindexSaved ? pindexSaved->nHeight : -1)) {
+            delete it->second;
+            mapBlockIndex.erase(it++);
+        } else {
+            ++it;
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(write_batch_tests)
+{
+    const std::string strFile = "wallet_batch_test.dat";
+    CBlockLocator locator, locatorRead;
+    locator.vHave.push_back(uint256(1));
+    CWalletDB(strFile, "cr+").WriteVersion(CLIENT_VERSION);
+
+    {
+        CDBWriteBatch batch(strFile);
+        {
+            // Nested batches join the outer one and do not commit it
+            CDBWriteBatch nested(strFile);
+            BOOST_CHECK(CWalletDB(strFile).WriteBestBlock(locator));
+            BOOST_CHECK(nested.Commit());
+        }
+        // Handles opened inside the batch see its uncommitted writes
+        BOOST_CHECK(CWalletDB(strFile).ReadBestBlock(locatorRead));
+        BOOST_CHECK(locatorRead.vHave == locator.vHave);
+        BOOST_CHECK(batch.Commit());
+    }
+
+    locatorRead.SetNull();
+    BOOST_CHECK(CWalletDB(strFile).ReadBestBlock(locatorRead));
+    BOOST_CHECK(locatorRead.vHave == locator.vHave);
+}
+
+/** Write a wallet with keys, key metadata, names and transactions straight to its file */
+static void WriteLoadTestWallet(const std::string& strFile, unsigned int nRecords)
+{
+    CWalletDB walletdb(strFile, "cr+");
+    walletdb.WriteVersion(CLIENT_VERSION);
+    for (unsigned int i = 0; i < nRecords; i++) {
+        CKey key;
+        key.MakeNewKey(i % 2 == 0);
+        CPubKey pubkey = key.GetPubKey();
+        BOOST_CHECK(walletdb.WriteKey(pubkey, key.GetPrivKey(), CKeyMetadata(1000 + i)));
+        BOOST_CHECK(walletdb.WriteName(EncodeDestination(pubkey.GetID()), strprintf("label %u", i)));
+
+        CMutableTransaction tx;
+        tx.vin.push_back(CTxIn(COutPoint(GetRandHash(), i)));
+        tx.vout.resize(1);
+        tx.vout[0].nValue = (i + 1) * COIN;
+        tx.vout[0].scriptPubKey = GetScriptForDestination(pubkey.GetID());
+        CWalletTx wtx(NULL, tx);
+        wtx.nTimeReceived = 2000 + i;
+        wtx.nOrderPos = i;
+        wtx.mapValue["comment"] = strprintf("tx %u", i);
+        BOOST_CHECK(walletdb.WriteTx(wtx.GetHash(), wtx));
+    }
+}
+
+static DBErrors LoadTestWallet(const std::string& strFile, CWallet& loaded, int nThreads)
+{
+    int nThreadsSaved = nScriptCheckThreads;
+    nScriptCheckThreads = nThreads;
+    DBErrors ret = CWalletDB(strFile, "cr+").LoadWallet(&loaded);
+    nScriptCheckThreads = nThreadsSaved;
+    return ret;
+}
+
+BOOST_AUTO_TEST_CASE(parallel_load_tests)
+{
+    // More records than one decode batch
+    const std::string strFile = "wallet_load_test.dat";
+    WriteLoadTestWallet(strFile, 2500);
+
+    CWallet walletSerial(strFile), walletParallel(strFile);
+    BOOST_CHECK_EQUAL(LoadTestWallet(strFile, walletSerial, 0), DB_LOAD_OK);
+    BOOST_CHECK_EQUAL(LoadTestWallet(strFile, walletParallel, 4), DB_LOAD_OK);
+
+    LOCK2(walletSerial.cs_wallet, walletParallel.cs_wallet);
+
+    // Keys and their metadata
+    std::set<CKeyID> setSerial, setParallel;
+    walletSerial.GetKeys(setSerial);
+    walletParallel.GetKeys(setParallel);
+    BOOST_CHECK_EQUAL(setSerial.size(), 2500U);
+    BOOST_CHECK(setSerial == setParallel);
+    BOOST_FOREACH (const CKeyID& keyid, setSerial) {
+        CKey keySerial, keyParallel;
+        BOOST_CHECK(walletSerial.GetKey(keyid, keySerial));
+        BOOST_CHECK(walletParallel.GetKey(keyid, keyParallel));
+        BOOST_CHECK(keySerial == keyParallel);
+        BOOST_CHECK_EQUAL(walletSerial.mapKeyMetadata[keyid].nCreateTime, walletParallel.mapKeyMetadata[keyid].nCreateTime);
+        BOOST_CHECK_EQUAL(walletSerial.mapAddressBook[keyid].name, walletParallel.mapAddressBook[keyid].name);
+    }
+    BOOST_CHECK_EQUAL(walletSerial.nTimeFirstKey, walletParallel.nTimeFirstKey);
+
+    // Transactions and their metadata
+    BOOST_CHECK_EQUAL(walletSerial.mapWallet.size(), 2500U);
+    BOOST_CHECK_EQUAL(walletParallel.mapWallet.size(), walletSerial.mapWallet.size());
+    BOOST_FOREACH (const PAIRTYPE(const uint256, CWalletTx)& item, walletSerial.mapWallet) {
+        std::map<uint256, CWalletTx>::const_iterator mi = walletParallel.mapWallet.find(item.first);
+        BOOST_REQUIRE(mi != walletParallel.mapWallet.end());
+        const CWalletTx& wtx = (*mi).second;
+        BOOST_CHECK(wtx.GetHash() == item.second.GetHash());
+        BOOST_CHECK_EQUAL(wtx.nTimeReceived, item.second.nTimeReceived);
+        BOOST_CHECK_EQUAL(wtx.nOrderPos, item.second.nOrderPos);
+        BOOST_CHECK(wtx.mapValue == item.second.mapValue);
+        BOOST_CHECK(wtx.GetAvailableCredit() == item.second.GetAvailableCredit());
+    }
+    BOOST_CHECK_EQUAL(walletSerial.wtxOrdered.size(), walletParallel.wtxOrdered.size());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -7,6 +7,7 @@
 
 #include "txdb.h"
 
+#include "checkqueue.h"
 #include "main.h"
 #include "pow.h"
 #include "random.h"
@@ -14,6 +15,7 @@
 
 #include <stdint.h>
 
+#include <boost/bind.hpp>
 #include <boost/thread.hpp>
 
 using namespace std;
@@ -87,6 +89,18 @@ bool CBlockTreeDB::WriteBlockIndex(const CDiskBlockIndex& blockindex)
     return Write(make_pair('b', blockindex.GetBlockHash()), blockindex);
 }
 
+bool CBlockTreeDB::WriteBlockIndexRange(const std::vector<CBlockIndex*>& vpindex, const std::string& name, int nProgress)
+{
+    CLevelDBBatch batch;
+    for (std::vector<CBlockIndex*>::const_iterator it = vpindex.begin(); it != vpindex.end(); ++it)
+        batch.Write(make_pair('b', (*it)->GetBlockHash()), CDiskBlockIndex(*it));
+    if (nProgress < 0)
+        batch.Erase(std::make_pair('I', name));
+    else
+        batch.Write(std::make_pair('I', name), nProgress);
+    return WriteBatch(batch, true);
+}
+
 bool CBlockTreeDB::WriteBlockFileInfo(int nFile, const CBlockFileInfo& info)
 {
     return Write(make_pair('f', nFile), info);
@@ -121,69 +135,121 @@ bool CBlockTreeDB::ReadLastBlockFile(int& nFile)
     return Read('l', nFile);
 }
 
+void UpdateCoinsStatsHash(CHashWriter& ss, const uint256& txid, const CCoins& coins, CCoinsStats& stats)
+{
+    ss << txid;
+    ss << VARINT(coins.nVersion);
+    ss << (coins.fCoinBase ? 'c' : 'n');
+    ss << VARINT(coins.nHeight);
+    stats.nTransactions++;
+    for (unsigned int i = 0; i < coins.vout.size(); i++) {
+        const CTxOut& out = coins.vout[i];
+        if (!out.IsNull()) {
+            stats.nTransactionOutputs++;
+            ss << VARINT(i + 1);
+            ss << out;
+            stats.nTotalAmount += out.nValue;
+        }
+    }
+    ss << VARINT(0);
+}
+
 bool CCoinsViewDB::GetStats(CCoinsStats& stats) const
 {
-    /* It seems that there are no "const iterators" for LevelDB.  Since we
-       only need read operations on it, use a const-cast to get around
-       that restriction.  */
-    boost::scoped_ptr<leveldb::Iterator> pcursor(const_cast<CLevelDBWrapper*>(&db)->NewIterator());
-    pcursor->SeekToFirst();
+    boost::scoped_ptr<CCoinsViewDBCursor> pcursor(Cursor());
 
     CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
     stats.hashBlock = GetBestBlock();
     ss << stats.hashBlock;
-    CAmount nTotalAmount = 0;
+    stats.nTotalAmount = 0;
     while (pcursor->Valid()) {
         boost::this_thread::interruption_point();
-        try {
-            leveldb::Slice slKey = pcursor->key();
-            CDataStream ssKey(slKey.data(), slKey.data() + slKey.size(), SER_DISK, CLIENT_VERSION);
-            char chType;
-            ssKey >> chType;
-            if (chType == 'c') {
-                leveldb::Slice slValue = pcursor->value();
-                CDataStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
-                CCoins coins;
-                ssValue >> coins;
-                uint256 txhash;
-                ssKey >> txhash;
-                ss << txhash;
-                ss << VARINT(coins.nVersion);
-                ss << (coins.fCoinBase ? 'c' : 'n');
-                ss << VARINT(coins.nHeight);
-                stats.nTransactions++;
-                for (unsigned int i = 0; i < coins.vout.size(); i++) {
-                    const CTxOut& out = coins.vout[i];
-                    if (!out.IsNull()) {
-                        stats.nTransactionOutputs++;
-                        ss << VARINT(i + 1);
-                        ss << out;
-                        nTotalAmount += out.nValue;
-                    }
-                }
-                stats.nSerializedSize += 32 + slValue.size();
-                ss << VARINT(0);
-            }
-            pcursor->Next();
-        } catch (std::exception& e) {
-            return error("%s : Deserialize or I/O error - %s", __func__, e.what());
-        }
+        CCoins coins;
+        if (!pcursor->GetCoins(coins))
+            return error("%s : Deserialize or I/O error", __func__);
+        UpdateCoinsStatsHash(ss, pcursor->GetTxid(), coins, stats);
+        stats.nSerializedSize += 32 + pcursor->GetValueSize();
+        pcursor->Next();
     }
     stats.nHeight = mapBlockIndex.find(GetBestBlock())->second->nHeight;
     stats.hashSerialized = ss.GetHash();
-    stats.nTotalAmount = nTotalAmount;
     return true;
 }
 
+CCoinsViewDBCursor* CCoinsViewDB::Cursor() const
+{
+    /* It seems that there are no "const iterators" for LevelDB.  Since we
+       only need read operations on it, use a const-cast to get around
+       that restriction.  */
+    return new CCoinsViewDBCursor(const_cast<CLevelDBWrapper*>(&db)->NewIterator());
+}
+
+CCoinsViewDBCursor::CCoinsViewDBCursor(leveldb::Iterator* pcursorIn) : pcursor(pcursorIn), fValid(false)
+{
+    pcursor->Seek("c");
+    Seek();
+}
+
+void CCoinsViewDBCursor::Seek()
+{
+    txidCur.SetNull();
+    fValid = false;
+    if (!pcursor->Valid())
+        return;
+    // Coins entries are keyed by 'c' + txid and sort together, so the first
+    // other key ends the iteration
+    leveldb::Slice slKey = pcursor->key();
+    if (slKey.size() != 33 || slKey[0] != 'c')
+        return;
+    memcpy(txidCur.begin(), slKey.data() + 1, 32);
+    fValid = true;
+}
+
+bool CCoinsViewDBCursor::Valid() const
+{
+    return fValid;
+}
+
+void CCoinsViewDBCursor::Next()
+{
+    pcursor->Next();
+    Seek();
+}
+
+bool CCoinsViewDBCursor::GetCoins(CCoins& coins) const
+{
+    leveldb::Slice slValue = pcursor->value();
+    try {
+        CDataStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
+        ssValue >> coins;
+    } catch (const std::exception&) {
+        return false;
+    }
+    return true;
+}
+
+unsigned int CCoinsViewDBCursor::GetValueSize() const
+{
+    return pcursor->value().size();
+}
+
 bool CBlockTreeDB::ReadTxIndex(const uint256& txid, CDiskTxPos& pos)
 {
     return Read(make_pair('t', txid), pos);
 }
 
-bool CBlockTreeDB::WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos> >& vect)
+// Entries carry the height of the containing block after the plain position,
+// so readers asking for a CDiskTxPos still decode them. Entries written before
+// the height was added fail to decode as a CExtDiskTxPos.
+bool CBlockTreeDB::ReadTxIndex(const uint256& txid, CExtDiskTxPos& pos)
+{
+    return Read(make_pair('t', txid), pos);
+}
+
+bool CBlockTreeDB::WriteTxIndex(const std::vector<std::pair<uint256, CExtDiskTxPos> >& vect)
 {
     CLevelDBBatch batch;
-    for (std::vector<std::pair<uint256, CDiskTxPos> >::const_iterator it = vect.begin(); it != vect.end(); it++)
+    for (std::vector<std::pair<uint256, CExtDiskTxPos> >::const_iterator it = vect.begin(); it != vect.end(); it++)
         batch.Write(make_pair('t', it->first), it->second);
     return WriteBatch(batch);
 }
@@ -261,70 +327,194 @@ bool CBlockTreeDB::ReadInt(const std::string& name, int& nValue)
     return Read(std::make_pair('I', name), nValue);
 }
 
+/** Number of 'b' records read from the cursor and decoded per batch */
+static const unsigned int BLOCK_INDEX_LOAD_BATCH = 16384;
+
+/** A raw block index record and the result of decoding it on a worker thread */
+struct CBlockIndexRecord {
+    std::string strValue;
+    CDiskBlockIndex diskindex;
+    uint256 hashBlock;
+    std::string strError;
+};
+
+/**
+ * Closure representing the deserialization of one block index record,
+ * including its header hash and, for PoW-era entries, its proof of work.
+ */
+class CBlockIndexLoadCheck
+{
+private:
+    CBlockIndexRecord* precord;
+
+public:
+    CBlockIndexLoadCheck() : precord(NULL) {}
+    CBlockIndexLoadCheck(CBlockIndexRecord* precordIn) : precord(precordIn) {}
+
+    bool operator()()
+    {
+        try {
+            CDataStream ssValue(precord->strValue.data(), precord->strValue.data() + precord->strValue.size(), SER_DISK, CLIENT_VERSION);
+            ssValue >> precord->diskindex;
+        } catch (std::exception& e) {
+            precord->strError = strprintf("Deserialize or I/O error - %s", e.what());
+            return false;
+        }
+        precord->hashBlock = precord->diskindex.GetBlockHash();
+        if (precord->diskindex.nHeight <= Params().LAST_POW_BLOCK()) {
+            if (!CheckProofOfWork(precord->hashBlock, precord->diskindex.nBits)) {
+                precord->strError = strprintf("CheckProofOfWork failed: %s", precord->diskindex.ToString());
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void swap(CBlockIndexLoadCheck& check)
+    {
+        std::swap(precord, check.precord);
+    }
+};
+
+static void ThreadLoadBlockIndex(CCheckQueue<CBlockIndexLoadCheck>* pqueue)
+{
+    RenameThread("trbo-loadblkidx");
+    pqueue->Thread();
+}
+
 bool CBlockTreeDB::LoadBlockIndexGuts()
 {
+    // Decode on the master plus the same number of helpers as -par allows for script checks
+    CCheckQueue<CBlockIndexLoadCheck> queue(128);
+    boost::thread_group threadGroup;
+    for (int i = 0; i < nScriptCheckThreads - 1; i++)
+        threadGroup.create_thread(boost::bind(&ThreadLoadBlockIndex, &queue));
+
+    bool fRet;
+    try {
+        fRet = LoadBlockIndexRecords(queue);
+    } catch (...) {
+        threadGroup.interrupt_all();
+        threadGroup.join_all();
+        throw;
+    }
+    threadGroup.interrupt_all();
+    threadGroup.join_all();
+    return fRet;
+}
+
+bool CBlockTreeDB::LoadBlockIndexRecords(CCheckQueue<CBlockIndexLoadCheck>& queue)
+{
+    int64_t nTimeStart = GetTimeMicros();
+    int64_t nTimeRead = 0, nTimeDecode = 0, nTimeLink = 0;
+    uint64_t nRecords = 0;
+
     boost::scoped_ptr<leveldb::Iterator> pcursor(NewIterator());
 
     CDataStream ssKeySet(SER_DISK, CLIENT_VERSION);
     ssKeySet << make_pair('b', uint256(0));
     pcursor->Seek(ssKeySet.str());
 
-    // Load mapBlockIndex
-    uint256 nPreviousCheckpoint;
-    while (pcursor->Valid()) {
+    std::vector<CBlockIndexRecord> vRecords(BLOCK_INDEX_LOAD_BATCH);
+    std::vector<CBlockIndexLoadCheck> vChecks;
+    vChecks.reserve(BLOCK_INDEX_LOAD_BATCH);
+    bool fDone = false;
+    while (!fDone) {
         boost::this_thread::interruption_point();
+
+        // Read a batch of raw records from the cursor
+        int64_t nTime0 = GetTimeMicros();
+        unsigned int nBatch = 0;
+        uint64_t nBatchBytes = 0;
         try {
-            leveldb::Slice slKey = pcursor->key();
-            CDataStream ssKey(slKey.data(), slKey.data() + slKey.size(), SER_DISK, CLIENT_VERSION);
-            char chType;
-            ssKey >> chType;
-            if (chType == 'b') {
-                leveldb::Slice slValue = pcursor->value();
-                CDataStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
-                CDiskBlockIndex diskindex;
-                ssValue >> diskindex;
-
-                // Construct block index object
-                CBlockIndex* pindexNew = InsertBlockIndex(diskindex.GetBlockHash());
-                pindexNew->pprev = InsertBlockIndex(diskindex.hashPrev);
-                pindexNew->pnext = InsertBlockIndex(diskindex.hashNext);
-                pindexNew->nHeight = diskindex.nHeight;
-                pindexNew->nFile = diskindex.nFile;
-                pindexNew->nDataPos = diskindex.nDataPos;
-                pindexNew->nUndoPos = diskindex.nUndoPos;
-                pindexNew->nVersion = diskindex.nVersion;
-                pindexNew->hashMerkleRoot = diskindex.hashMerkleRoot;
-                pindexNew->nTime = diskindex.nTime;
-                pindexNew->nBits = diskindex.nBits;
-                pindexNew->nNonce = diskindex.nNonce;
-                pindexNew->nStatus = diskindex.nStatus;
-                pindexNew->nTx = diskindex.nTx;
-
-                //Proof Of Stake
-                pindexNew->nMint = diskindex.nMint;
-                pindexNew->nMoneySupply = diskindex.nMoneySupply;
-                pindexNew->nFlags = diskindex.nFlags;
-                pindexNew->nStakeModifier = diskindex.nStakeModifier;
-                pindexNew->prevoutStake = diskindex.prevoutStake;
-                pindexNew->nStakeTime = diskindex.nStakeTime;
-                pindexNew->hashProofOfStake = diskindex.hashProofOfStake;
-
-                if (pindexNew->nHeight <= Params().LAST_POW_BLOCK()) {
-                    if (!CheckProofOfWork(pindexNew->GetBlockHash(), pindexNew->nBits))
-                        return error("LoadBlockIndex() : CheckProofOfWork failed: %s", pindexNew->ToString());
+            while (nBatch < vRecords.size()) {
+                if (!pcursor->Valid()) {
+                    fDone = true;
+                    break;
                 }
-                // ppcoin: build setStakeSeen
-                if (pindexNew->IsProofOfStake())
-                    setStakeSeen.insert(make_pair(pindexNew->prevoutStake, pindexNew->nStakeTime));
-
+                leveldb::Slice slKey = pcursor->key();
+                if (slKey.size() == 0 || slKey[0] != 'b') {
+                    fDone = true; // finished loading block index
+                    break;
+                }
+                leveldb::Slice slValue = pcursor->value();
+                CBlockIndexRecord& record = vRecords[nBatch++];
+                record.strValue.assign(slValue.data(), slValue.size());
+                record.strError.clear();
+                nBatchBytes += slKey.size() + slValue.size();
                 pcursor->Next();
-            } else {
-                break; // if shutdown requested or finished loading block index
             }
         } catch (std::exception& e) {
             return error("%s : Deserialize or I/O error - %s", __func__, e.what());
         }
+        if (nBatch == 0)
+            break;
+
+        // Pre-size mapBlockIndex from the size of the 'b' key range and the record size of the first batch
+        if (nRecords == 0 && !fDone) {
+            uint64_t nEstimate = EstimateSize(make_pair('b', uint256(0)), make_pair('c', uint256(0))) / std::max<uint64_t>(nBatchBytes / nBatch, 1);
+            mapBlockIndex.reserve(mapBlockIndex.size() + nEstimate + nEstimate / 8);
+        }
+
+        // Decode and check proof of work in parallel
+        int64_t nTime1 = GetTimeMicros();
+        nTimeRead += nTime1 - nTime0;
+        {
+            CCheckQueueControl<CBlockIndexLoadCheck> control(&queue);
+            for (unsigned int i = 0; i < nBatch; i++)
+                vChecks.push_back(CBlockIndexLoadCheck(&vRecords[i]));
+            control.Add(vChecks);
+            vChecks.clear();
+            if (!control.Wait()) {
+                for (unsigned int i = 0; i < nBatch; i++) {
+                    if (!vRecords[i].strError.empty())
+                        return error("LoadBlockIndex() : %s", vRecords[i].strError);
+                }
+                return error("LoadBlockIndex() : block index record check failed");
+            }
+        }
+
+        // Link the decoded entries into mapBlockIndex
+        int64_t nTime2 = GetTimeMicros();
+        nTimeDecode += nTime2 - nTime1;
+        for (unsigned int i = 0; i < nBatch; i++) {
+            const CDiskBlockIndex& diskindex = vRecords[i].diskindex;
+
+            // Construct block index object
+            CBlockIndex* pindexNew = InsertBlockIndex(vRecords[i].hashBlock);
+            pindexNew->pprev = InsertBlockIndex(diskindex.hashPrev);
+            pindexNew->pnext = InsertBlockIndex(diskindex.hashNext);
+            pindexNew->nHeight = diskindex.nHeight;
+            pindexNew->nFile = diskindex.nFile;
+            pindexNew->nDataPos = diskindex.nDataPos;
+            pindexNew->nUndoPos = diskindex.nUndoPos;
+            pindexNew->nVersion = diskindex.nVersion;
+            pindexNew->hashMerkleRoot = diskindex.hashMerkleRoot;
+            pindexNew->nTime = diskindex.nTime;
+            pindexNew->nBits = diskindex.nBits;
+            pindexNew->nNonce = diskindex.nNonce;
+            pindexNew->nStatus = diskindex.nStatus;
+            pindexNew->nTx = diskindex.nTx;
+
+            //Proof Of Stake
+            pindexNew->nMint = diskindex.nMint;
+            pindexNew->nMoneySupply = diskindex.nMoneySupply;
+            pindexNew->nFlags = diskindex.nFlags;
+            pindexNew->nStakeModifier = diskindex.nStakeModifier;
+            pindexNew->prevoutStake = diskindex.prevoutStake;
+            pindexNew->nStakeTime = diskindex.nStakeTime;
+            pindexNew->hashProofOfStake = diskindex.hashProofOfStake;
+
+            // ppcoin: build setStakeSeen
+            if (pindexNew->IsProofOfStake())
+                setStakeSeen.insert(make_pair(pindexNew->prevoutStake, pindexNew->nStakeTime));
+        }
+        nTimeLink += GetTimeMicros() - nTime2;
+        nRecords += nBatch;
     }
 
+    LogPrintf("%s: loaded %u block index records in %.2fms (read %.2fms, decode %.2fms on %d threads, link %.2fms)\n", __func__,
+        nRecords, 0.001 * (GetTimeMicros() - nTimeStart), 0.001 * nTimeRead, 0.001 * nTimeDecode, std::max(nScriptCheckThreads, 1), 0.001 * nTimeLink);
+
     return true;
-}
\ No newline at end of file
+}
@@ -16,9 +16,17 @@
 #include <utility>
 #include <vector>
 
+#include <boost/scoped_ptr.hpp>
+
+class CBlockIndexLoadCheck;
 class CCoins;
+class CCoinsViewDBCursor;
+class CHashWriter;
 class uint256;
 
+template <typename T>
+class CCheckQueue;
+
 //! -dbcache default (MiB)
 static const int64_t nDefaultDbCache = 100;
 //! max. -dbcache in (MiB)
@@ -40,8 +48,38 @@ public:
     uint256 GetBestBlock() const;
     bool BatchWrite(CCoinsMap& mapCoins, const uint256& hashBlock);
     bool GetStats(CCoinsStats& stats) const;
+
+    /** Iterate over the coins as they are at this moment. Later writes are
+     *  not seen by the cursor. The caller owns the returned object. */
+    CCoinsViewDBCursor* Cursor() const;
+};
+
+/** Iterator over the coin database, see CCoinsViewDB::Cursor */
+class CCoinsViewDBCursor
+{
+private:
+    boost::scoped_ptr<leveldb::Iterator> pcursor;
+    uint256 txidCur;
+    bool fValid;
+
+    friend class CCoinsViewDB;
+    CCoinsViewDBCursor(leveldb::Iterator* pcursorIn);
+
+    /** Skip ahead to the next coins entry */
+    void Seek();
+
+public:
+    bool Valid() const;
+    void Next();
+
+    const uint256& GetTxid() const { return txidCur; }
+    bool GetCoins(CCoins& coins) const;
+    unsigned int GetValueSize() const;
 };
 
+/** Add one entry of the UTXO set to the hash gettxoutsetinfo reports as hash_serialized */
+void UpdateCoinsStatsHash(CHashWriter& ss, const uint256& txid, const CCoins& coins, CCoinsStats& stats);
+
 /** Access to the block database (blocks/index/) */
 class CBlockTreeDB : public CLevelDBWrapper
 {
@@ -53,8 +91,14 @@ private:
     CBlockTreeDB(const CBlockTreeDB&);
     void operator=(const CBlockTreeDB&);
 
+    bool LoadBlockIndexRecords(CCheckQueue<CBlockIndexLoadCheck>& queue);
+
 public:
     bool WriteBlockIndex(const CDiskBlockIndex& blockindex);
+    /** Rewrite the entries of a range of blocks together with a named progress
+     *  counter (see WriteInt) in one synced batch. A negative nProgress erases
+     *  the counter instead. */
+    bool WriteBlockIndexRange(const std::vector<CBlockIndex*>& vpindex, const std::string& name, int nProgress);
     bool ReadBlockFileInfo(int nFile, CBlockFileInfo& fileinfo);
     bool WriteBlockFileInfo(int nFile, const CBlockFileInfo& fileinfo);
     bool ReadLastBlockFile(int& nFile);
@@ -62,7 +106,8 @@ public:
     bool WriteReindexing(bool fReindex);
     bool ReadReindexing(bool& fReindex);
     bool ReadTxIndex(const uint256& txid, CDiskTxPos& pos);
-    bool WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos> >& list);
+    bool ReadTxIndex(const uint256& txid, CExtDiskTxPos& pos);
+    bool WriteTxIndex(const std::vector<std::pair<uint256, CExtDiskTxPos> >& list);
     bool ReadAddrIndex(uint160 addrid, std::vector<CExtDiskTxPos> &list);
     bool AddAddrIndex(const std::vector<std::pair<uint160, CExtDiskTxPos> > &list);
     bool WriteFlag(const std::string& name, bool fValue);
@@ -17,6 +17,7 @@
 #endif
 
 #include "compat.h"
+#include "logging.h"
 #include "tinyformat.h"
 #include "utiltime.h"
 
@@ -71,31 +72,39 @@ extern volatile bool fReopenDebugLog;
 void SetupEnvironment();
 bool SetupNetworking();
 
-/** Return true if log accepts specified category */
-bool LogAcceptCategory(const char* category);
-/** Send a string to the log output */
-int LogPrintStr(const std::string& str);
+#define LogPrintf(...) LogPrintFormat(false, __VA_ARGS__)
 
-#define LogPrintf(...) LogPrint(NULL, __VA_ARGS__)
+/**
+ * Print to debug.log if -debug=category switch is given OR category is NULL.
+ * The category is checked before the arguments are even evaluated, so
+ * disabled categories cost nothing on hot paths. Its name is looked up once
+ * per call site, so it has to be the same every time the call site runs.
+ * Output of a category is the first to be dropped when the log writer falls
+ * behind.
+ */
+#define LogPrint(category, ...)                                             \
+    do {                                                                    \
+        static const uint64_t nLogPrintFlag = LogCategoryFlag(category);    \
+        if (LogAcceptFlag(nLogPrintFlag))                                   \
+            LogPrintFormat(nLogPrintFlag != LOG_ALL, __VA_ARGS__);          \
+    } while (0)
 
 /**
  * When we switch to C++11, this can be switched to variadic templates instead
  * of this macro-based construction (see tinyformat.h).
  */
-#define MAKE_ERROR_AND_LOG_FUNC(n)                                                              \
-    /**   Print to debug.log if -debug=category switch is given OR category is NULL. */         \
-    template <TINYFORMAT_ARGTYPES(n)>                                                           \
-    static inline int LogPrint(const char* category, const char* format, TINYFORMAT_VARARGS(n)) \
-    {                                                                                           \
-        if (!LogAcceptCategory(category)) return 0;                                             \
-        return LogPrintStr(tfm::format(format, TINYFORMAT_PASSARGS(n)));                        \
-    }                                                                                           \
-    /**   Log error and return false */                                                         \
-    template <TINYFORMAT_ARGTYPES(n)>                                                           \
-    static inline bool error(const char* format, TINYFORMAT_VARARGS(n))                         \
-    {                                                                                           \
-        LogPrintStr(std::string("ERROR: ") + tfm::format(format, TINYFORMAT_PASSARGS(n)) + "\n");            \
-        return false;                                                                           \
+#define MAKE_ERROR_AND_LOG_FUNC(n)                                                                  \
+    template <TINYFORMAT_ARGTYPES(n)>                                                               \
+    static inline int LogPrintFormat(bool fDroppable, const char* format, TINYFORMAT_VARARGS(n))    \
+    {                                                                                               \
+        return LogPrintStr(tfm::format(format, TINYFORMAT_PASSARGS(n)), fDroppable);                \
+    }                                                                                               \
+    /**   Log error and return false */                                                             \
+    template <TINYFORMAT_ARGTYPES(n)>                                                               \
+    static inline bool error(const char* format, TINYFORMAT_VARARGS(n))                             \
+    {                                                                                               \
+        LogPrintStr(std::string("ERROR: ") + tfm::format(format, TINYFORMAT_PASSARGS(n)) + "\n");   \
+        return false;                                                                               \
     }
 
 TINYFORMAT_FOREACH_ARGNUM(MAKE_ERROR_AND_LOG_FUNC)
@@ -104,10 +113,9 @@ TINYFORMAT_FOREACH_ARGNUM(MAKE_ERROR_AND_LOG_FUNC)
  * Zero-arg versions of logging and error, these are not covered by
  * TINYFORMAT_FOREACH_ARGNUM
  */
-static inline int LogPrint(const char* category, const char* format)
+static inline int LogPrintFormat(bool fDroppable, const char* format)
 {
-    if (!LogAcceptCategory(category)) return 0;
-    return LogPrintStr(format);
+    return LogPrintStr(format, fDroppable);
 }
 static inline bool error(const char* format)
 {
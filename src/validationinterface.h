@@ -11,6 +11,8 @@
 #include <boost/signals2/signal.hpp>
 #include <boost/shared_ptr.hpp>
 
+#include <vector>
+
 class CBlock;
 struct CBlockLocator;
 class CBlockIndex;
@@ -29,12 +31,16 @@ void UnregisterValidationInterface(CValidationInterface* pwalletIn);
 void UnregisterAllValidationInterfaces();
 /** Push an updated transaction to all registered wallets */
 void SyncWithWallets(const CTransaction& tx, const CBlock* pblock);
+/** Push the transactions of a connected (pblock set) or disconnected block to all registered wallets */
+void SyncWithWallets(const std::vector<CTransaction>& vtx, const CBlock* pblock);
 
 class CValidationInterface {
 protected:
 // XX42    virtual void EraseFromWallet(const uint256& hash){};
     virtual void UpdatedBlockTip(const CBlockIndex *pindex) {}
     virtual void SyncTransaction(const CTransaction &tx, const CBlock *pblock) {}
+    /** Defaults to SyncTransaction for each transaction; wallets override it to batch their writes */
+    virtual void SyncTransactions(const std::vector<CTransaction> &vtx, const CBlock *pblock);
     virtual void NotifyTransactionLock(const CTransaction &tx) {}
     virtual void SetBestChain(const CBlockLocator &locator) {}
     virtual bool UpdatedTransaction(const uint256 &hash) { return false;}
@@ -55,6 +61,8 @@ struct CMainSignals {
     boost::signals2::signal<void (const CBlockIndex *)> UpdatedBlockTip;
     /** Notifies listeners of updated transaction data (transaction, and optionally the block it is found in. */
     boost::signals2::signal<void (const CTransaction &, const CBlock *)> SyncTransaction;
+    /** Notifies listeners of all transactions of a block being connected or disconnected, in block order. */
+    boost::signals2::signal<void (const std::vector<CTransaction> &, const CBlock *)> SyncTransactions;
     /** Notifies listeners of an updated transaction lock without new data. */
     boost::signals2::signal<void (const CTransaction &)> NotifyTransactionLock;
     /** Notifies listeners of an updated transaction without new data (for now: a coinbase potentially becoming visible). */
@@ -12,7 +12,7 @@
  * network protocol versioning
  */
 
-static const int PROTOCOL_VERSION = 70009;
+static const int PROTOCOL_VERSION = 70010;
 
 //! initial proto version, to be increased after version/verack negotiation
 static const int INIT_PROTO_VERSION = 209;
@@ -29,6 +29,9 @@ static const int MIN_PEER_VERSION_FIXED_SIGTIME = 70004;
 //! masternodes older than this proto version use old strMessage format for mnannounce
 static const int MIN_PEER_MNANNOUNCE = 70008;
 
+//! dsegsketch, mngetsketch and mnvssketch are understood starting with this version
+static const int SYNC_SKETCH_VERSION = 70010;
+
 //! nTime field added to CAddress, starting with this version;
 //! if possible, avoid requesting addresses nodes older than this
 static const int CADDR_TIME_VERSION = 31402;
@@ -438,6 +438,7 @@ bool CCryptoKeyStore::AddCryptedKey(const CPubKey& vchPubKey, const std::vector<
             return false;
 
         mapCryptedKeys[vchPubKey.GetID()] = make_pair(vchPubKey, vchCryptedSecret);
+        nKeyStoreGeneration++;
         ImplicitlyLearnRelatedKeyScripts(vchPubKey);
     }
     return true;
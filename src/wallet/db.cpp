@@ -216,7 +216,75 @@ void CDBEnv::CheckpointLSN(const std::string& strFile)
 }
 
 
-CDB::CDB(const std::string& strFilename, const char* pszMode, int nSerVersion) : pdb(NULL), activeTxn(NULL)
+DbTxn* CDBEnv::GetBatchTxn(const std::string& strFile)
+{
+    AssertLockHeld(cs_db);
+    std::map<std::string, CWriteBatch>::iterator it = mapWriteBatch.find(strFile);
+    if (it == mapWriteBatch.end() || it->second.threadId != boost::this_thread::get_id())
+        return NULL;
+    if (!it->second.ptxn) {
+        it->second.ptxn = TxnBegin();
+        if (!it->second.ptxn)
+            throw runtime_error(strprintf("CDB : Failed to begin write batch on %s", strFile));
+    }
+    return it->second.ptxn;
+}
+
+CDBWriteBatch::CDBWriteBatch(const std::string& strFilename) : strFile(strFilename), fOwner(false), nStart(GetTimeMicros())
+{
+    if (strFile.empty())
+        return;
+
+    LOCK(bitdb.cs_db);
+    if (bitdb.mapWriteBatch.count(strFile)) {
+        // Nested in a batch of this thread, or another thread's batch which we cannot join
+        return;
+    }
+    CDBEnv::CWriteBatch& batch = bitdb.mapWriteBatch[strFile];
+    batch.threadId = boost::this_thread::get_id();
+    batch.ptxn = NULL;
+    // Keep the file open for the lifetime of the transaction
+    ++bitdb.mapFileUseCount[strFile];
+    fOwner = true;
+}
+
+CDBWriteBatch::~CDBWriteBatch()
+{
+    Commit();
+}
+
+bool CDBWriteBatch::Commit()
+{
+    if (!fOwner)
+        return true;
+    fOwner = false;
+
+    DbTxn* ptxn = NULL;
+    {
+        LOCK(bitdb.cs_db);
+        ptxn = bitdb.mapWriteBatch[strFile].ptxn;
+        bitdb.mapWriteBatch.erase(strFile);
+    }
+
+    bool fSuccess = true;
+    if (ptxn) {
+        int ret = ptxn->commit(0);
+        if (ret != 0) {
+            LogPrintf("CDBWriteBatch::Commit : Error %d committing batch on %s: %s\n", ret, strFile, DbEnv::strerror(ret));
+            fSuccess = false;
+        }
+        bitdb.dbenv.txn_checkpoint(0, 0, 0);
+    }
+    LogPrint("db", "CDBWriteBatch::Commit : %s %s in %.2fms\n", strFile, ptxn ? "committed" : "empty", (GetTimeMicros() - nStart) * 0.001);
+
+    {
+        LOCK(bitdb.cs_db);
+        --bitdb.mapFileUseCount[strFile];
+    }
+    return fSuccess;
+}
+
+CDB::CDB(const std::string& strFilename, const char* pszMode, int nSerVersion) : pdb(NULL), activeTxn(NULL), fBatchTxn(false)
 {
     int ret;
     fReadOnly = (!strchr(pszMode, '+') && !strchr(pszMode, 'w'));
@@ -271,6 +339,10 @@ CDB::CDB(const std::string& strFilename, const char* pszMode, int nSerVersion) :
 
             bitdb.mapDb[strFile] = pdb;
         }
+
+        // Join this thread's write batch, if any
+        activeTxn = bitdb.GetBatchTxn(strFile);
+        fBatchTxn = activeTxn != NULL;
     }
 }
 
@@ -291,12 +363,16 @@ void CDB::Close()
 {
     if (!pdb)
         return;
-    if (activeTxn)
+    bool fBatched = fBatchTxn;
+    if (activeTxn && !fBatched)
         activeTxn->abort();
     activeTxn = NULL;
+    fBatchTxn = false;
     pdb = NULL;
 
-    Flush();
+    // The write batch flushes once when it commits
+    if (!fBatched)
+        Flush();
 
     {
         LOCK(bitdb.cs_db);
@@ -17,6 +17,7 @@
 #include <vector>
 
 #include <boost/filesystem/path.hpp>
+#include <boost/thread/thread.hpp>
 
 #include <db_cxx.h>
 
@@ -47,6 +48,13 @@ public:
     std::map<std::string, int> mapFileUseCount;
     std::map<std::string, Db*> mapDb;
 
+    /** Open write batch of a database file: owning thread and its transaction, begun on first use */
+    struct CWriteBatch {
+        boost::thread::id threadId;
+        DbTxn* ptxn;
+    };
+    std::map<std::string, CWriteBatch> mapWriteBatch;
+
     CDBEnv();
     ~CDBEnv();
     void MakeMock();
@@ -88,6 +96,9 @@ public:
             return NULL;
         return ptxn;
     }
+
+    /** Transaction of the write batch this thread has open on strFile, or NULL. Requires cs_db. */
+    DbTxn* GetBatchTxn(const std::string& strFile);
 };
 
 extern CDBEnv bitdb;
@@ -100,6 +111,8 @@ protected:
     Db* pdb;
     std::string strFile;
     DbTxn* activeTxn;
+    //! activeTxn belongs to a CDBWriteBatch and is committed by it
+    bool fBatchTxn;
     bool fReadOnly;
     int nSerVersion;
 
@@ -225,7 +238,7 @@ protected:
         if (!pdb)
             return NULL;
         Dbc* pcursor = NULL;
-        int ret = pdb->cursor(NULL, &pcursor, 0);
+        int ret = pdb->cursor(activeTxn, &pcursor, 0);
         if (ret != 0)
             return NULL;
         return pcursor;
@@ -282,7 +295,7 @@ public:
 
     bool TxnCommit()
     {
-        if (!pdb || !activeTxn)
+        if (!pdb || !activeTxn || fBatchTxn)
             return false;
         int ret = activeTxn->commit(0);
         activeTxn = NULL;
@@ -291,7 +304,7 @@ public:
 
     bool TxnAbort()
     {
-        if (!pdb || !activeTxn)
+        if (!pdb || !activeTxn || fBatchTxn)
             return false;
         int ret = activeTxn->abort();
         activeTxn = NULL;
@@ -312,4 +325,30 @@ public:
     bool static Rewrite(const std::string& strFile, const char* pszSkip = NULL);
 };
 
+/**
+ * Group commit for one database file. Every CDB opened on this thread while the
+ * batch is open writes inside a single transaction, so a burst of writes costs
+ * one commit and one checkpoint instead of one per handle. Batches nest; only the
+ * outermost one commits. Destroying an open batch commits it, so writes stay as
+ * durable as they were unbatched. Other threads keep writing outside the batch
+ * and wait on its locks, so never hold a batch across a release of the locks
+ * that serialize those writers.
+ */
+class CDBWriteBatch
+{
+private:
+    std::string strFile;
+    bool fOwner;
+    int64_t nStart;
+
+    CDBWriteBatch(const CDBWriteBatch&);
+    void operator=(const CDBWriteBatch&);
+
+public:
+    explicit CDBWriteBatch(const std::string& strFilename);
+    ~CDBWriteBatch();
+
+    bool Commit();
+};
+
 #endif // BITCOIN_DB_H
@@ -2145,6 +2145,15 @@ UniValue getwalletinfo(const UniValue& params, bool fHelp)
             "      }\n"
             "      ,...\n"
             "    ]\n"
+            "  \"scanning\":                   (json object) current rescan progress, false if no rescan is running\n"
+            "    {\n"
+            "      \"duration\": xxxx,          (numeric) elapsed seconds since the rescan started\n"
+            "      \"progress\": x.xxxx,        (numeric) scanning progress percentage [0.0, 1.0]\n"
+            "      \"height\": xxxx,            (numeric) height of the last block committed to the wallet\n"
+            "      \"tipheight\": xxxx,         (numeric) height of the chain tip\n"
+            "      \"blockspersecond\": x.xx,   (numeric) average scanning rate\n"
+            "      \"txfound\": xxxx,           (numeric) number of wallet transactions found so far\n"
+            "    }\n"
             "}\n"
             "\nExamples:\n" +
             HelpExampleCli("getwalletinfo", "") + HelpExampleRpc("getwalletinfo", ""));
@@ -2183,9 +2192,44 @@ UniValue getwalletinfo(const UniValue& params, bool fHelp)
         }
         obj.push_back(Pair("hdaccounts", accounts));
     }
+    CWalletRescanStatus rescanStatus = pwalletMain->GetRescanStatus();
+    if (rescanStatus.fScanning) {
+        int64_t nDuration = GetTimeMillis() - rescanStatus.nStartTime;
+        UniValue scanning(UniValue::VOBJ);
+        scanning.push_back(Pair("duration", nDuration / 1000));
+        scanning.push_back(Pair("progress", rescanStatus.dProgress));
+        scanning.push_back(Pair("height", rescanStatus.nHeight));
+        scanning.push_back(Pair("tipheight", rescanStatus.nTipHeight));
+        scanning.push_back(Pair("blockspersecond", 1000.0 * rescanStatus.nBlocks / std::max<int64_t>(nDuration, 1)));
+        scanning.push_back(Pair("txfound", rescanStatus.nTxFound));
+        obj.push_back(Pair("scanning", scanning));
+    } else {
+        obj.push_back(Pair("scanning", false));
+    }
     return obj;
 }
 
+UniValue abortrescan(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 0)
+        throw runtime_error(
+            "abortrescan\n"
+            "\nStops the current wallet rescan triggered e.g. by an importprivkey call.\n"
+            "The transactions found in the blocks scanned so far stay in the wallet.\n"
+            "\nResult:\n"
+            "true|false        (boolean) Whether a rescan was running and has been asked to stop\n"
+            "\nExamples:\n"
+            "\nImport a private key\n" +
+            HelpExampleCli("importprivkey", "\"mykey\"") +
+            "\nAbort the running wallet rescan\n" + HelpExampleCli("abortrescan", "") +
+            "\nAs a JSON-RPC call\n" + HelpExampleRpc("abortrescan", ""));
+
+    if (!pwalletMain->IsScanning())
+        return false;
+    pwalletMain->AbortRescan();
+    return true;
+}
+
 // ppcoin: reserve balance from being staked for network protection
 UniValue reservebalance(const UniValue& params, bool fHelp)
 {
@@ -33,6 +33,9 @@
 #include <assert.h>
 
 #include <boost/algorithm/string/replace.hpp>
+#include <boost/bind.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
 #include <boost/thread.hpp>
 #include <boost/filesystem/operations.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
@@ -251,6 +254,8 @@ bool CWallet::LoadHDPubKey(const CHDPubKey &hdPubKey)
     AssertLockHeld(cs_wallet);
 
     mapHdPubKeys[hdPubKey.extPubKey.pubkey.GetID()] = hdPubKey;
+    LOCK(cs_KeyStore);
+    nKeyStoreGeneration++;
     return true;
 }
 
@@ -266,6 +271,10 @@ bool CWallet::AddHDPubKey(const CExtPubKey &extPubKey, bool fInternal)
     hdPubKey.hdchainID = hdChainCurrent.GetID();
     hdPubKey.nChangeIndex = fInternal ? 1 : 0;
     mapHdPubKeys[extPubKey.pubkey.GetID()] = hdPubKey;
+    {
+        LOCK(cs_KeyStore);
+        nKeyStoreGeneration++;
+    }
 
     // check if we need to remove from watch-only
     CScript script;
@@ -635,6 +644,82 @@ void CWallet::AddToSpends(const uint256& wtxid)
         AddToSpends(txin.prevout, wtxid);
 }
 
+void CWallet::MarkCoinIndexDirty(const CWalletTx& wtx)
+{
+    AssertLockHeld(cs_wallet);
+    if (!fCoinIndexValid)
+        return;
+    // A new or (dis)confirmed spender changes which of its prevouts are indexed
+    setCoinIndexDirty.insert(wtx.GetHash());
+    if (!wtx.IsCoinBase()) {
+        BOOST_FOREACH (const CTxIn& txin, wtx.vin)
+            setCoinIndexDirty.insert(txin.prevout.hash);
+    }
+}
+
+/**
+ * Outpoint is spent by a wallet transaction that made it into the
+ * active chain. Confirmed spends only go away on disconnect, which
+ * passes the spender through AddToWallet again.
+ */
+bool CWallet::IsSpentInChain(const COutPoint& outpoint) const
+{
+    pair<TxSpends::const_iterator, TxSpends::const_iterator> range = mapTxSpends.equal_range(outpoint);
+    for (TxSpends::const_iterator it = range.first; it != range.second; ++it) {
+        std::map<uint256, CWalletTx>::const_iterator mit = mapWallet.find(it->second);
+        if (mit != mapWallet.end() && mit->second.GetDepthInMainChain(false) >= 1)
+            return true;
+    }
+    return false;
+}
+
+void CWallet::UpdateCoinIndexTx(const CWalletTx& wtx) const
+{
+    const uint256& hash = wtx.GetHash();
+    for (unsigned int i = 0; i < wtx.vout.size(); i++) {
+        COutPoint outpoint(hash, i);
+        isminetype mine = IsMine(wtx.vout[i]);
+        if (mine != ISMINE_NO && !IsSpentInChain(outpoint))
+            mapWalletCoins[outpoint] = mine;
+        else
+            mapWalletCoins.erase(outpoint);
+    }
+}
+
+void CWallet::UpdateCoinIndex() const
+{
+    AssertLockHeld(cs_main);
+    AssertLockHeld(cs_wallet);
+
+    // New keys or watched scripts change IsMine for outputs we already have
+    size_t nKeyGeneration = GetKeyStoreGeneration();
+    if (!fCoinIndexValid || nKeyGeneration != nCoinIndexKeyGeneration) {
+        int64_t nStart = GetTimeMillis();
+        mapWalletCoins.clear();
+        setCoinIndexDirty.clear();
+        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
+            UpdateCoinIndexTx(it->second);
+        fCoinIndexValid = true;
+        nCoinIndexKeyGeneration = nKeyGeneration;
+        fBalancesValid = false;
+        LogPrint("wallet", "%s: indexed %u coins of %u transactions in %dms\n", __func__, mapWalletCoins.size(), mapWallet.size(), GetTimeMillis() - nStart);
+        return;
+    }
+
+    BOOST_FOREACH (const uint256& hash, setCoinIndexDirty) {
+        map<uint256, CWalletTx>::const_iterator mi = mapWallet.find(hash);
+        if (mi != mapWallet.end())
+            UpdateCoinIndexTx(mi->second);
+        setBalancesDirty.insert(hash);
+    }
+    setCoinIndexDirty.clear();
+}
+
+CWallet::CoinIndex::const_iterator CWallet::NextCoinIndexTx(const CoinIndex& index, CoinIndex::const_iterator it)
+{
+    return index.upper_bound(COutPoint(it->first.hash, std::numeric_limits<uint32_t>::max()));
+}
+
 void CWallet::FinishEncryptWallet() {
     {
         LOCK(cs_wallet);
@@ -944,6 +1029,7 @@ void CWallet::MarkDirty()
         LOCK(cs_wallet);
         BOOST_FOREACH (PAIRTYPE(const uint256, CWalletTx) & item, mapWallet)
             item.second.MarkDirty();
+        fBalancesValid = false;
     }
 }
 
@@ -957,6 +1043,7 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet)
         wtx.BindWallet(this);
         wtxOrdered.insert(make_pair(wtx.nOrderPos, TxPair(&wtx, (CAccountingEntry*)0)));
         AddToSpends(hash);
+        fCoinIndexValid = false;
     } else {
         LOCK(cs_wallet);
         // Inserts only if not already there, returns tx inserted or tx found
@@ -1004,6 +1091,7 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet)
 
         // Break debit/credit balance caches:
         wtx.MarkDirty();
+        MarkCoinIndexDirty(wtx);
 
         // Notify UI of new or updated transaction
         NotifyTransactionChanged(this, hash, fInsertedNew ? CT_NEW : CT_UPDATED);
@@ -1056,14 +1144,25 @@ void CWallet::SyncTransaction(const CTransaction& tx, const CBlock* pblock)
     }
 }
 
+void CWallet::SyncTransactions(const std::vector<CTransaction>& vtx, const CBlock* pblock)
+{
+    LOCK2(cs_main, cs_wallet);
+    // One durable write for everything a block changes in the wallet
+    CDBWriteBatch dbBatch(fFileBacked ? strWalletFile : std::string());
+    BOOST_FOREACH (const CTransaction& tx, vtx)
+        SyncTransaction(tx, pblock);
+}
+
 void CWallet::EraseFromWallet(const uint256& hash)
 {
     if (!fFileBacked)
         return;
     {
         LOCK(cs_wallet);
-        if (mapWallet.erase(hash))
+        if (mapWallet.erase(hash)) {
             CWalletDB(strWalletFile).EraseTx(hash);
+            fCoinIndexValid = false;
+        }
     }
     return;
 }
@@ -1722,17 +1821,229 @@ bool CWalletTx::WriteToDisk()
     return CWalletDB(pwallet->strWalletFile).WriteTx(GetHash(), *this);
 }
 
+bool CWalletScanFilter::IsRelevant(const CScript& scriptPubKey) const
+{
+    if (setWatchOnly.count(scriptPubKey))
+        return true;
+
+    std::vector<std::vector<unsigned char> > vSolutions;
+    txnouttype whichType;
+    if (!Solver(scriptPubKey, whichType, vSolutions))
+        return false;
+
+    switch (whichType) {
+    case TX_PUBKEY:
+        return setKeys.count(CPubKey(vSolutions[0]).GetID()) > 0;
+    case TX_PUBKEYHASH:
+        return setKeys.count(CKeyID(uint160(vSolutions[0]))) > 0;
+    case TX_SCRIPTHASH:
+        return setScripts.count(CScriptID(uint160(vSolutions[0]))) > 0;
+    case TX_WITNESS_V0_KEYHASH:
+    case TX_WITNESS_V0_SCRIPTHASH:
+        // IsMine() only accepts witness outputs whose P2SH wrapper is known
+        return setScripts.count(CScriptID(CScript() << OP_0 << vSolutions[0])) > 0;
+    case TX_MULTISIG:
+        for (unsigned int i = 1; i + 1 < vSolutions.size(); i++) {
+            if (setKeys.count(CPubKey(vSolutions[i]).GetID()))
+                return true;
+        }
+        return false;
+    default:
+        return false;
+    }
+}
+
+bool CWalletScanFilter::IsRelevant(const CTransaction& tx) const
+{
+    BOOST_FOREACH (const CTxOut& txout, tx.vout) {
+        if (IsRelevant(txout.scriptPubKey))
+            return true;
+    }
+    return false;
+}
+
+size_t CWallet::GetKeyStoreGeneration() const
+{
+    AssertLockHeld(cs_wallet);
+    LOCK(cs_KeyStore);
+    return nKeyStoreGeneration;
+}
+
+size_t CWallet::GetScanFilter(CWalletScanFilter& filter) const
+{
+    AssertLockHeld(cs_wallet);
+    GetKeys(filter.setKeys);
+    for (std::map<CKeyID, CHDPubKey>::const_iterator it = mapHdPubKeys.begin(); it != mapHdPubKeys.end(); ++it)
+        filter.setKeys.insert(it->first);
+
+    LOCK(cs_KeyStore);
+    filter.setScripts.clear();
+    for (ScriptMap::const_iterator it = mapScripts.begin(); it != mapScripts.end(); ++it)
+        filter.setScripts.insert(it->first);
+    filter.setWatchOnly = setWatchOnly;
+    return GetKeyStoreGeneration();
+}
+
+void CWallet::AbortRescan()
+{
+    LOCK(cs_rescan);
+    if (rescanStatus.fScanning)
+        fAbortRescan = true;
+}
+
+bool CWallet::IsScanning() const
+{
+    LOCK(cs_rescan);
+    return rescanStatus.fScanning;
+}
+
+CWalletRescanStatus CWallet::GetRescanStatus() const
+{
+    LOCK(cs_rescan);
+    return rescanStatus;
+}
+
+bool CWallet::ReserveRescan()
+{
+    LOCK(cs_rescan);
+    if (rescanStatus.fScanning)
+        return false;
+    rescanStatus.SetNull();
+    rescanStatus.fScanning = true;
+    rescanStatus.nStartTime = GetTimeMillis();
+    fAbortRescan = false;
+    return true;
+}
+
+void CWallet::ReleaseRescan()
+{
+    LOCK(cs_rescan);
+    rescanStatus.fScanning = false;
+}
+
+bool CWalletRescanReserver::Reserve()
+{
+    assert(!fReserved);
+    fReserved = pwallet->ReserveRescan();
+    return fReserved;
+}
+
+CWalletRescanReserver::~CWalletRescanReserver()
+{
+    if (fReserved)
+        pwallet->ReleaseRescan();
+}
+
+/** A block of a rescan batch, read from disk and pre-filtered by a rescan worker */
+struct CWalletRescanBlock {
+    CBlockIndex* pindex;
+    CDiskBlockPos pos;
+    uint256 hashBlock;
+    CBlock block;
+    bool fRead;
+    std::vector<bool> vRelevant;
+};
+
+/** Consecutive blocks of the active chain, read ahead while the previous batch is committed */
+struct CWalletRescanBatch {
+    std::vector<CWalletRescanBlock> vBlocks;
+    boost::shared_ptr<const CWalletScanFilter> pfilter;
+    size_t nGeneration;
+    boost::scoped_ptr<boost::thread_group> pthreadGroup;
+
+    //! Wait for the workers reading this batch
+    void Join()
+    {
+        if (pthreadGroup) {
+            pthreadGroup->join_all();
+            pthreadGroup.reset();
+        }
+    }
+
+    ~CWalletRescanBatch()
+    {
+        Join();
+    }
+};
+
+static void FilterRescanBlock(CWalletRescanBlock& blk, const CWalletScanFilter& filter)
+{
+    blk.vRelevant.assign(blk.block.vtx.size(), false);
+    for (unsigned int i = 0; i < blk.block.vtx.size(); i++)
+        blk.vRelevant[i] = filter.IsRelevant(blk.block.vtx[i]);
+}
+
+static void ThreadRescanReadBlocks(CWalletRescanBatch* pbatch, unsigned int nThread, unsigned int nThreads)
+{
+    RenameThread("trbo-rescan");
+    for (unsigned int i = nThread; i < pbatch->vBlocks.size(); i += nThreads) {
+        CWalletRescanBlock& blk = pbatch->vBlocks[i];
+        blk.fRead = ReadBlockFromDisk(blk.block, blk.pos) && blk.block.GetHash() == blk.hashBlock;
+        if (blk.fRead)
+            FilterRescanBlock(blk, *pbatch->pfilter);
+        else
+            LogPrintf("%s : failed to read block %s\n", __func__, blk.hashBlock.ToString());
+    }
+}
+
+/** Queue up the blocks following pindexNext, and start reading them on the rescan workers */
+static void StartRescanBatch(CWalletRescanBatch& batch, CBlockIndex*& pindexNext, const boost::shared_ptr<const CWalletScanFilter>& pfilter, size_t nGeneration)
+{
+    batch.Join();
+    batch.vBlocks.clear();
+    batch.pfilter = pfilter;
+    batch.nGeneration = nGeneration;
+    {
+        LOCK(cs_main);
+        if (pindexNext && !chainActive.Contains(pindexNext))
+            pindexNext = chainActive.Next(chainActive.FindFork(pindexNext));
+        while (pindexNext && batch.vBlocks.size() < WALLET_RESCAN_BATCH_BLOCKS) {
+            batch.vBlocks.push_back(CWalletRescanBlock());
+            CWalletRescanBlock& blk = batch.vBlocks.back();
+            blk.pindex = pindexNext;
+            blk.pos = pindexNext->GetBlockPos();
+            blk.hashBlock = pindexNext->GetBlockHash();
+            blk.fRead = false;
+            pindexNext = chainActive.Next(pindexNext);
+        }
+    }
+
+    unsigned int nThreads = std::min((unsigned int)batch.vBlocks.size(), (unsigned int)std::max(2, nScriptCheckThreads));
+    batch.pthreadGroup.reset(new boost::thread_group());
+    for (unsigned int i = 0; i < nThreads; i++)
+        batch.pthreadGroup->create_thread(boost::bind(&ThreadRescanReadBlocks, &batch, i, nThreads));
+}
+
 /**
  * Scan the block chain (starting in pindexStart) for transactions
  * from or to us. If fUpdate is true, found transactions that already
  * exist in the wallet will be updated.
+ * Blocks are read and matched against a snapshot of the keystore on worker
+ * threads one batch ahead; cs_main and cs_wallet are only held while a batch
+ * is committed, so validation continues during the scan.
  */
-int CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate)
+int CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate, const CWalletRescanReserver* preserver)
+{
+    CWalletRescanReserver reserver(this);
+    if (preserver && preserver->IsReserved()) {
+        assert(preserver->GetWallet() == this);
+    } else if (!reserver.Reserve()) {
+        LogPrintf("%s : a rescan is already in progress\n", __func__);
+        return WALLET_RESCAN_BUSY;
+    }
+
+    return ScanBlocks(pindexStart, fUpdate);
+}
+
+int CWallet::ScanBlocks(CBlockIndex* pindexStart, bool fUpdate)
 {
     int ret = 0;
     int64_t nNow = GetTime();
 
     CBlockIndex* pindex = pindexStart;
+    double dProgressStart, dProgressTip;
+    boost::shared_ptr<CWalletScanFilter> pfilter(new CWalletScanFilter());
+    size_t nGeneration;
     {
         LOCK2(cs_main, cs_wallet);
 
@@ -1741,29 +2052,101 @@ int CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate)
         while (pindex && nTimeFirstKey && (pindex->GetBlockTime() < (nTimeFirstKey - 7200)))
             pindex = chainActive.Next(pindex);
 
-        ShowProgress(_("Rescanning..."), 0); // show rescan progress in GUI as dialog or on splashscreen, if -rescan on startup
-        double dProgressStart = Checkpoints::GuessVerificationProgress(pindex, false);
-        double dProgressTip = Checkpoints::GuessVerificationProgress(chainActive.Tip(), false);
-        set<uint256> setAddedToWallet;
-        while (pindex) {
-            if (pindex->nHeight % 100 == 0 && dProgressTip - dProgressStart > 0.0)
-                ShowProgress(_("Rescanning..."), std::max(1, std::min(99, (int)((Checkpoints::GuessVerificationProgress(pindex, false) - dProgressStart) / (dProgressTip - dProgressStart) * 100))));
-
-            CBlock block;
-            ReadBlockFromDisk(block, pindex);
-            BOOST_FOREACH (CTransaction& tx, block.vtx) {
-                if (AddToWalletIfInvolvingMe(tx, &block, fUpdate))
+        dProgressStart = Checkpoints::GuessVerificationProgress(pindex, false);
+        dProgressTip = Checkpoints::GuessVerificationProgress(chainActive.Tip(), false);
+        nGeneration = GetScanFilter(*pfilter);
+
+        LOCK(cs_rescan);
+        rescanStatus.nStartHeight = pindex ? pindex->nHeight : chainActive.Height();
+        rescanStatus.nHeight = rescanStatus.nStartHeight;
+        rescanStatus.nTipHeight = chainActive.Height();
+    }
+    ShowProgress(_("Rescanning..."), 0); // show rescan progress in GUI as dialog or on splashscreen, if -rescan on startup
+
+    CWalletRescanBatch batches[2];
+    CWalletRescanBatch* pbatch = &batches[0];
+    CWalletRescanBatch* pbatchNext = &batches[1];
+    StartRescanBatch(*pbatch, pindex, pfilter, nGeneration);
+    while (!pbatch->vBlocks.empty()) {
+        // Read ahead the next batch while this one is committed
+        StartRescanBatch(*pbatchNext, pindex, pfilter, nGeneration);
+        pbatch->Join();
+
+        bool fReorganized = false;
+        bool fAbort = false;
+        int nBlocks = 0;
+        {
+            LOCK2(cs_main, cs_wallet);
+            // All wallet writes of this batch go to disk as one transaction
+            CDBWriteBatch dbBatch(fFileBacked ? strWalletFile : std::string());
+            int64_t nTimeCommit = GetTimeMicros();
+            int nTxBefore = ret;
+            for (unsigned int nBlock = 0; nBlock < pbatch->vBlocks.size(); nBlock++) {
+                CWalletRescanBlock& blk = pbatch->vBlocks[nBlock];
+                if (!chainActive.Contains(blk.pindex)) {
+                    // Restart from the fork point; blocks of the new branch are synced as they connect
+                    pbatchNext->Join();
+                    pbatchNext->vBlocks.clear();
+                    pindex = chainActive.Next(chainActive.FindFork(blk.pindex));
+                    fReorganized = true;
+                    break;
+                }
+                nBlocks++;
+                if (!blk.fRead)
+                    continue;
+                if (pbatch->nGeneration != nGeneration)
+                    FilterRescanBlock(blk, *pfilter);
+
+                for (unsigned int nTx = 0; nTx < blk.block.vtx.size(); nTx++) {
+                    const CTransaction& tx = blk.block.vtx[nTx];
+                    bool fRelevant = blk.vRelevant[nTx] || mapWallet.count(tx.GetHash());
+                    for (unsigned int i = 0; !fRelevant && i < tx.vin.size(); i++)
+                        fRelevant = mapWallet.count(tx.vin[i].prevout.hash) > 0;
+                    if (!fRelevant || !AddToWalletIfInvolvingMe(tx, &blk.block, fUpdate))
+                        continue;
                     ret++;
-            }
 
-            pindex = chainActive.Next(pindex);
-            if (GetTime() >= nNow + 60) {
-                nNow = GetTime();
-                LogPrintf("Still rescanning. At block %d. Progress=%f\n", pindex->nHeight, Checkpoints::GuessVerificationProgress(pindex));
+                    // New keys (e.g. from a keypool top-up) invalidate the filter of the blocks not committed yet
+                    if (GetKeyStoreGeneration() != nGeneration) {
+                        pfilter.reset(new CWalletScanFilter());
+                        nGeneration = GetScanFilter(*pfilter);
+                    }
+                }
+            }
+            dbBatch.Commit();
+            LogPrint("bench", "  - Rescan commit: %d blocks, %d txs in %.2fms\n", nBlocks, ret - nTxBefore, (GetTimeMicros() - nTimeCommit) * 0.001);
+
+            if (nBlocks > 0) {
+                CBlockIndex* pindexLast = pbatch->vBlocks[nBlocks - 1].pindex;
+                LOCK(cs_rescan);
+                rescanStatus.nHeight = pindexLast->nHeight;
+                rescanStatus.nTipHeight = chainActive.Height();
+                rescanStatus.nBlocks += nBlocks;
+                rescanStatus.nTxFound = ret;
+                if (dProgressTip - dProgressStart > 0.0)
+                    rescanStatus.dProgress = std::max(0.0, std::min(1.0, (Checkpoints::GuessVerificationProgress(pindexLast, false) - dProgressStart) / (dProgressTip - dProgressStart)));
+                fAbort = fAbortRescan;
             }
         }
-        ShowProgress(_("Rescanning..."), 100); // hide progress dialog in GUI
+
+        CWalletRescanStatus status = GetRescanStatus();
+        ShowProgress(_("Rescanning..."), std::max(1, std::min(99, (int)(status.dProgress * 100))));
+        if (GetTime() >= nNow + 60) {
+            nNow = GetTime();
+            LogPrintf("Still rescanning. At block %d. Progress=%f, %.2f blocks/s\n", status.nHeight, status.dProgress,
+                1000.0 * status.nBlocks / std::max<int64_t>(GetTimeMillis() - status.nStartTime, 1));
+        }
+        if (fAbort) {
+            LogPrintf("Rescan aborted at block %d\n", status.nHeight);
+            break;
+        }
+
+        std::swap(pbatch, pbatchNext);
+        if (fReorganized)
+            StartRescanBatch(*pbatch, pindex, pfilter, nGeneration);
     }
+    ShowProgress(_("Rescanning..."), 100); // hide progress dialog in GUI
+
     return ret;
 }
 
@@ -1803,7 +2186,7 @@ void CWalletTx::RelayWalletTransaction(std::string strCommand)
             LogPrintf("Relaying wtx %s\n", hash.ToString());
 
             if (strCommand == NetMsgType::IX) {
-                mapTxLockReq.insert(make_pair(hash, (CTransaction) * this));
+                txLockManager.AddRequest((CTransaction) * this);
                 CreateNewLock(((CTransaction) * this));
                 RelayTransactionLockReq((CTransaction) * this, true);
             } else {
@@ -1868,55 +2251,125 @@ void CWallet::ResendWalletTransactions()
  * @{
  */
 
-CAmount CWallet::GetBalance() const
+/** Re-evaluate what one transaction contributes to the running balances */
+void CWallet::UpdateTxBalances(const uint256& hash) const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
-            if (pcoin->IsTrusted())
-                nTotal += pcoin->GetAvailableCredit();
-        }
+    std::map<uint256, CWalletBalances>::iterator itBalances = mapTxBalances.find(hash);
+    if (itBalances != mapTxBalances.end()) {
+        balancesTotal -= itBalances->second;
+        mapTxBalances.erase(itBalances);
+    }
+    std::map<uint256, bool>::iterator itVolatile = mapBalancesVolatile.find(hash);
+    if (itVolatile != mapBalancesVolatile.end()) {
+        if (itVolatile->second)
+            nBalancesNonFinal--;
+        mapBalancesVolatile.erase(itVolatile);
     }
 
-    return nTotal;
+    // Only transactions owning indexed coins contribute
+    CoinIndex::const_iterator itCoin = mapWalletCoins.lower_bound(COutPoint(hash, 0));
+    if (itCoin == mapWalletCoins.end() || itCoin->first.hash != hash)
+        return;
+    map<uint256, CWalletTx>::const_iterator mi = mapWallet.find(hash);
+    if (mi == mapWallet.end())
+        return;
+    const CWalletTx* pcoin = &mi->second;
+
+    CWalletBalances balances;
+    bool fFinal = IsFinalTx(*pcoin);
+    bool fTrusted = pcoin->IsTrusted();
+    int nDepth = pcoin->GetDepthInMainChain();
+
+    if (fTrusted) {
+        balances.nBalance = pcoin->GetAvailableCredit();
+        balances.nWatchOnly = pcoin->GetAvailableWatchOnlyCredit();
+    }
+    if (!fFinal || (!fTrusted && nDepth == 0)) {
+        balances.nUnconfirmed = pcoin->GetAvailableCredit();
+        balances.nUnconfirmedWatchOnly = pcoin->GetAvailableWatchOnlyCredit();
+    }
+    balances.nImmature = pcoin->GetImmatureCredit();
+    balances.nImmatureWatchOnly = pcoin->GetImmatureWatchOnlyCredit();
+    if (fTrusted && nDepth > 0) {
+        balances.nUnlocked = pcoin->GetUnlockedCredit();
+        balances.nLocked = pcoin->GetLockedCredit();
+        balances.nLockedWatchOnly = pcoin->GetLockedWatchOnlyCredit();
+    }
+    balancesTotal += balances;
+    mapTxBalances[hash] = balances;
+
+    // SwiftTX adds depth below 6 confirmations (see GetDepthInMainChain), and an
+    // indexed coin with a spender is only spent by an unconfirmed or conflicted one
+    bool fVolatile = !fFinal || pcoin->GetDepthInMainChain(false) < 6 || pcoin->GetBlocksToMaturity() > 0;
+    for (; !fVolatile && itCoin != mapWalletCoins.end() && itCoin->first.hash == hash; ++itCoin)
+        fVolatile = mapTxSpends.count(itCoin->first) > 0;
+    if (fVolatile) {
+        mapBalancesVolatile[hash] = !fFinal;
+        if (!fFinal)
+            nBalancesNonFinal++;
+    }
 }
 
-CAmount CWallet::GetUnlockedCoins() const
+/**
+ * Bring the running balances up to date. Only the transactions that changed are
+ * re-evaluated, plus the volatile ones when the tip, the mempool or the SwiftTX
+ * locks moved, or on every call while one of them is non-final.
+ */
+const CWalletBalances& CWallet::GetBalances() const
 {
-    if (fLiteMode) return 0;
-
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
+    AssertLockHeld(cs_main);
+    AssertLockHeld(cs_wallet);
 
-            if (pcoin->IsTrusted() && pcoin->GetDepthInMainChain() > 0)
-                nTotal += pcoin->GetUnlockedCredit();
+    UpdateCoinIndex();
+    const CBlockIndex* pindexTip = chainActive.Tip();
+    unsigned int nMempoolUpdated = mempool.GetTransactionsUpdated();
+    uint64_t nLockEpoch = txLockManager.GetLockEpoch();
+    if (!fBalancesValid) {
+        int64_t nStart = GetTimeMillis();
+        balancesTotal.SetNull();
+        mapTxBalances.clear();
+        mapBalancesVolatile.clear();
+        nBalancesNonFinal = 0;
+        setBalancesDirty.clear();
+        for (CoinIndex::const_iterator it = mapWalletCoins.begin(); it != mapWalletCoins.end(); it = NextCoinIndexTx(mapWalletCoins, it))
+            UpdateTxBalances(it->first.hash);
+        fBalancesValid = true;
+        LogPrint("wallet", "%s: balances of %u transactions, %u volatile, in %dms\n", __func__, mapTxBalances.size(), mapBalancesVolatile.size(), GetTimeMillis() - nStart);
+    } else {
+        if (pindexTip != pindexBalancesTip || nMempoolUpdated != nBalancesMempoolUpdated || nLockEpoch != nBalancesLockEpoch || nBalancesNonFinal > 0) {
+            for (std::map<uint256, bool>::const_iterator it = mapBalancesVolatile.begin(); it != mapBalancesVolatile.end(); ++it)
+                setBalancesDirty.insert(it->first);
         }
+        BOOST_FOREACH (const uint256& hash, setBalancesDirty)
+            UpdateTxBalances(hash);
+        setBalancesDirty.clear();
     }
+    pindexBalancesTip = pindexTip;
+    nBalancesMempoolUpdated = nMempoolUpdated;
+    nBalancesLockEpoch = nLockEpoch;
+    return balancesTotal;
+}
 
-    return nTotal;
+CAmount CWallet::GetBalance() const
+{
+    LOCK2(cs_main, cs_wallet);
+    return GetBalances().nBalance;
 }
 
-CAmount CWallet::GetLockedCoins() const
+CAmount CWallet::GetUnlockedCoins() const
 {
     if (fLiteMode) return 0;
 
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
+    LOCK2(cs_main, cs_wallet);
+    return GetBalances().nUnlocked;
+}
 
-            if (pcoin->IsTrusted() && pcoin->GetDepthInMainChain() > 0)
-                nTotal += pcoin->GetLockedCredit();
-        }
-    }
+CAmount CWallet::GetLockedCoins() const
+{
+    if (fLiteMode) return 0;
 
-    return nTotal;
+    LOCK2(cs_main, cs_wallet);
+    return GetBalances().nLocked;
 }
 
 CAmount CWallet::GetAnonymizableBalance() const
@@ -2037,89 +2490,43 @@ CAmount CWallet::GetDenominatedBalance(bool unconfirmed) const
 
 CAmount CWallet::GetUnconfirmedBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
-            if (!IsFinalTx(*pcoin) || (!pcoin->IsTrusted() && pcoin->GetDepthInMainChain() == 0))
-                nTotal += pcoin->GetAvailableCredit();
-        }
-    }
-    return nTotal;
+    LOCK2(cs_main, cs_wallet);
+    return GetBalances().nUnconfirmed;
 }
 
 CAmount CWallet::GetImmatureBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
-            nTotal += pcoin->GetImmatureCredit();
-        }
-    }
-    return nTotal;
+    LOCK2(cs_main, cs_wallet);
+    return GetBalances().nImmature;
 }
 
 CAmount CWallet::GetWatchOnlyBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
-            if (pcoin->IsTrusted())
-                nTotal += pcoin->GetAvailableWatchOnlyCredit();
-        }
-    }
-
-    return nTotal;
+    LOCK2(cs_main, cs_wallet);
+    return GetBalances().nWatchOnly;
 }
 
 CAmount CWallet::GetUnconfirmedWatchOnlyBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
-            if (!IsFinalTx(*pcoin) || (!pcoin->IsTrusted() && pcoin->GetDepthInMainChain() == 0))
-                nTotal += pcoin->GetAvailableWatchOnlyCredit();
-        }
-    }
-    return nTotal;
+    LOCK2(cs_main, cs_wallet);
+    return GetBalances().nUnconfirmedWatchOnly;
 }
 
 CAmount CWallet::GetImmatureWatchOnlyBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
-            nTotal += pcoin->GetImmatureWatchOnlyCredit();
-        }
-    }
-    return nTotal;
+    LOCK2(cs_main, cs_wallet);
+    return GetBalances().nImmatureWatchOnly;
 }
 
 CAmount CWallet::GetLockedWatchOnlyBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
-            if (pcoin->IsTrusted() && pcoin->GetDepthInMainChain() > 0)
-                nTotal += pcoin->GetLockedWatchOnlyCredit();
-        }
-    }
-    return nTotal;
+    LOCK2(cs_main, cs_wallet);
+    return GetBalances().nLockedWatchOnly;
 }
 
 /**
- * populate vCoins with vector of available COutputs.
+ * populate vCoins with vector of available COutputs,
+ * walking the coin index rather than all of mapWallet.
  */
 void CWallet::AvailableCoins(vector<COutput>& vCoins, bool fOnlyConfirmed, const CCoinControl* coinControl, bool fIncludeZeroValue, AvailableCoinsType nCoinType, bool fUseIX, int nWatchonlyConfig) const
 {
@@ -2127,9 +2534,13 @@ void CWallet::AvailableCoins(vector<COutput>& vCoins, bool fOnlyConfirmed, const
 
     {
         LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const uint256& wtxid = it->first;
-            const CWalletTx* pcoin = &(*it).second;
+        UpdateCoinIndex();
+        for (CoinIndex::const_iterator it = mapWalletCoins.begin(); it != mapWalletCoins.end(); it = NextCoinIndexTx(mapWalletCoins, it)) {
+            const uint256& wtxid = it->first.hash;
+            map<uint256, CWalletTx>::const_iterator mi = mapWallet.find(wtxid);
+            if (mi == mapWallet.end())
+                continue;
+            const CWalletTx* pcoin = &mi->second;
 
             if (!CheckFinalTx(*pcoin))
                 continue;
@@ -2150,7 +2561,9 @@ void CWallet::AvailableCoins(vector<COutput>& vCoins, bool fOnlyConfirmed, const
             if (nDepth == 0 && !pcoin->InMempool())
                 continue;
 
-            for (unsigned int i = 0; i < pcoin->vout.size(); i++) {
+            CoinIndex::const_iterator itEnd = NextCoinIndexTx(mapWalletCoins, it);
+            for (CoinIndex::const_iterator itCoin = it; itCoin != itEnd; ++itCoin) {
+                unsigned int i = itCoin->first.n;
                 bool found = false;
                 if (nCoinType == ONLY_DENOMINATED) {
                     found = IsDenominatedAmount(pcoin->vout[i].nValue);
@@ -2167,11 +2580,9 @@ void CWallet::AvailableCoins(vector<COutput>& vCoins, bool fOnlyConfirmed, const
                 }
                 if (!found) continue;
 
-                isminetype mine = IsMine(pcoin->vout[i]);
+                isminetype mine = itCoin->second;
                 if (IsSpent(wtxid, i))
                     continue;
-                if (mine == ISMINE_NO)
-                    continue;
 
                 if (mine == ISMINE_SPENDABLE && nWatchonlyConfig == 2)
                     continue;
@@ -2179,11 +2590,11 @@ void CWallet::AvailableCoins(vector<COutput>& vCoins, bool fOnlyConfirmed, const
                 if (mine == ISMINE_WATCH_ONLY && nWatchonlyConfig == 1)
                     continue;
 
-                if (IsLockedCoin((*it).first, i) && nCoinType != ONLY_5000000)
+                if (IsLockedCoin(wtxid, i) && nCoinType != ONLY_5000000)
                     continue;
                 if (pcoin->vout[i].nValue <= 0 && !fIncludeZeroValue)
                     continue;
-                if (coinControl && coinControl->HasSelected() && !coinControl->fAllowOtherInputs && !coinControl->IsSelected((*it).first, i))
+                if (coinControl && coinControl->HasSelected() && !coinControl->fAllowOtherInputs && !coinControl->IsSelected(wtxid, i))
                     continue;
 
                 bool fIsSpendable = false;
@@ -3729,6 +4140,9 @@ bool CWallet::TopUpKeyPool(unsigned int kpSize)
             nTargetSize *= 2;
         }
         bool fInternal = false;
+        // Write the whole refill as one transaction; GenerateNewKey's writes join it
+        CDBWriteBatch dbBatch(fFileBacked ? strWalletFile : std::string());
+        int64_t nTimeStart = GetTimeMicros();
         CWalletDB walletdb(strWalletFile);
         for (int64_t i = missingInternal + missingExternal; i--;) {
             int64_t nEnd = 1;
@@ -3754,6 +4168,13 @@ bool CWallet::TopUpKeyPool(unsigned int kpSize)
             std::string strMsg = strprintf(_("Loading wallet... (%3.2f %%)"), dProgress);
             uiInterface.InitMessage(strMsg);
         }
+        if (!dbBatch.Commit())
+            throw runtime_error("TopUpKeyPool() : committing generated keys failed");
+        if (missingInternal + missingExternal > 0) {
+            int64_t nTime = GetTimeMicros() - nTimeStart;
+            LogPrint("bench", "- Keypool refill: %d keys in %.2fms (%.2f keys/s)\n", missingInternal + missingExternal, nTime * 0.001,
+                1000000.0 * (missingInternal + missingExternal) / std::max<int64_t>(nTime, 1));
+        }
     }
     return true;
 }
@@ -4067,6 +4488,8 @@ bool CWallet::UpdatedTransaction(const uint256& hashTx)
         // Only notify UI if this transaction is in this wallet
         map<uint256, CWalletTx>::const_iterator mi = mapWallet.find(hashTx);
         if (mi != mapWallet.end()) {
+            // SwiftTX lock state feeds into GetDepthInMainChain
+            setBalancesDirty.insert(hashTx);
             NotifyTransactionChanged(this, hashTx, CT_UPDATED);
             return true;
         }
@@ -4078,17 +4501,21 @@ void CWallet::LockCoin(COutPoint& output)
 {
     AssertLockHeld(cs_wallet); // setLockedCoins
     setLockedCoins.insert(output);
+    setBalancesDirty.insert(output.hash);
 }
 
 void CWallet::UnlockCoin(COutPoint& output)
 {
     AssertLockHeld(cs_wallet); // setLockedCoins
     setLockedCoins.erase(output);
+    setBalancesDirty.insert(output.hash);
 }
 
 void CWallet::UnlockAllCoins()
 {
     AssertLockHeld(cs_wallet); // setLockedCoins
+    BOOST_FOREACH (const COutPoint& output, setLockedCoins)
+        setBalancesDirty.insert(output.hash);
     setLockedCoins.clear();
 }
 
@@ -4627,26 +5054,14 @@ int CMerkleTx::GetTransactionLockSignatures() const
     if (!IsSporkActive(SPORK_2_SWIFTTX)) return -3;
     if (!fEnableSwiftTX) return -1;
 
-    //compile consessus vote
-    std::map<uint256, CTransactionLock>::iterator i = mapTxLocks.find(GetHash());
-    if (i != mapTxLocks.end()) {
-        return (*i).second.CountSignatures();
-    }
-
-    return -1;
+    return txLockManager.CountSignatures(GetHash());
 }
 
 bool CMerkleTx::IsTransactionLockTimedOut() const
 {
     if (!fEnableSwiftTX) return 0;
 
-    //compile consessus vote
-    std::map<uint256, CTransactionLock>::iterator i = mapTxLocks.find(GetHash());
-    if (i != mapTxLocks.end()) {
-        return GetTime() > (*i).second.nTimeout;
-    }
-
-    return false;
+    return txLockManager.IsTimedOut(GetHash(), GetTime());
 }
 
 static const std::string OUTPUT_TYPE_STRING_LEGACY = "legacy";
@@ -63,13 +63,124 @@ static const bool DEFAULT_USE_HD_WALLET = true;
 //! if set,will show warning if the wallet is a hd wallet and is unencrypted
 static const bool DEFAULT_ENABLE_WARN_ENCRYPTHD = false;
 
+//! Number of blocks read ahead and committed per batch by ScanForWalletTransactions
+static const unsigned int WALLET_RESCAN_BATCH_BLOCKS = 500;
+//! Returned by ScanForWalletTransactions when another rescan holds the reservation
+static const int WALLET_RESCAN_BUSY = -1;
+
 class CAccountingEntry;
 class CCoinControl;
+class CWalletRescanReserver;
 class COutput;
 class CReserveKey;
 class CScript;
 class CWalletTx;
 
+/**
+ * Read-only snapshot of the keys, redeem scripts and watch-only scripts of a
+ * wallet. Rescan workers use it to discard outputs without taking cs_wallet;
+ * it may report outputs that IsMine() later rejects, but never misses one.
+ */
+class CWalletScanFilter
+{
+public:
+    std::set<CKeyID> setKeys;
+    std::set<CScriptID> setScripts;
+    std::set<CScript> setWatchOnly;
+
+    bool IsRelevant(const CScript& scriptPubKey) const;
+    //! True if any output of tx may belong to the wallet
+    bool IsRelevant(const CTransaction& tx) const;
+};
+
+/** Progress of a running ScanForWalletTransactions (see getwalletinfo) */
+struct CWalletRescanStatus {
+    bool fScanning;
+    int nStartHeight;
+    int nHeight;
+    int nTipHeight;
+    int64_t nStartTime;
+    int nBlocks;
+    int nTxFound;
+    double dProgress;
+
+    CWalletRescanStatus()
+    {
+        SetNull();
+    }
+
+    void SetNull()
+    {
+        fScanning = false;
+        nStartHeight = 0;
+        nHeight = 0;
+        nTipHeight = 0;
+        nStartTime = 0;
+        nBlocks = 0;
+        nTxFound = 0;
+        dProgress = 0.0;
+    }
+};
+
+/** Wallet balances, both what one transaction owning indexed coins contributes and their running total */
+struct CWalletBalances {
+    CAmount nBalance;
+    CAmount nUnconfirmed;
+    CAmount nImmature;
+    CAmount nLocked;
+    CAmount nUnlocked;
+    CAmount nWatchOnly;
+    CAmount nUnconfirmedWatchOnly;
+    CAmount nImmatureWatchOnly;
+    CAmount nLockedWatchOnly;
+
+    CWalletBalances()
+    {
+        SetNull();
+    }
+
+    void SetNull()
+    {
+        nBalance = 0;
+        nUnconfirmed = 0;
+        nImmature = 0;
+        nLocked = 0;
+        nUnlocked = 0;
+        nWatchOnly = 0;
+        nUnconfirmedWatchOnly = 0;
+        nImmatureWatchOnly = 0;
+        nLockedWatchOnly = 0;
+    }
+
+    CWalletBalances& operator+=(const CWalletBalances& b)
+    {
+        nBalance += b.nBalance;
+        nUnconfirmed += b.nUnconfirmed;
+        nImmature += b.nImmature;
+        nLocked += b.nLocked;
+        nUnlocked += b.nUnlocked;
+        nWatchOnly += b.nWatchOnly;
+        nUnconfirmedWatchOnly += b.nUnconfirmedWatchOnly;
+        nImmatureWatchOnly += b.nImmatureWatchOnly;
+        nLockedWatchOnly += b.nLockedWatchOnly;
+        return *this;
+    }
+
+    CWalletBalances& operator-=(const CWalletBalances& b)
+    {
+        nBalance -= b.nBalance;
+        nUnconfirmed -= b.nUnconfirmed;
+        nImmature -= b.nImmature;
+        nLocked -= b.nLocked;
+        nUnlocked -= b.nUnlocked;
+        nWatchOnly -= b.nWatchOnly;
+        nUnconfirmedWatchOnly -= b.nUnconfirmedWatchOnly;
+        nImmatureWatchOnly -= b.nImmatureWatchOnly;
+        nLockedWatchOnly -= b.nLockedWatchOnly;
+        return *this;
+    }
+};
+
 /** (client) version numbers for particular wallet features */
 enum WalletFeature {
     FEATURE_BASE = 10500, // the earliest version new wallets supports (only useful for getinfo's clientversion output)
@@ -212,6 +323,61 @@ private:
     void AddToSpends(const uint256& wtxid);
 
     void SyncMetaData(std::pair<TxSpends::iterator, TxSpends::iterator>);
+
+    //! Protects rescanStatus and fAbortRescan. Taken inside cs_main and cs_wallet when the scan
+    //! starts and commits a batch; no other lock is ever taken while it is held
+    mutable CCriticalSection cs_rescan;
+    CWalletRescanStatus rescanStatus;
+    bool fAbortRescan;
+
+    friend class CWalletRescanReserver;
+    bool ReserveRescan();
+    void ReleaseRescan();
+
+    //! Bumped by every change to the keystore or HD pubkeys; a scan filter or the coin index built at another generation is stale
+    size_t GetKeyStoreGeneration() const;
+    int ScanBlocks(CBlockIndex* pindexStart, bool fUpdate);
+
+    /**
+     * Coin index: outputs of wallet transactions that pay to us and are not spent
+     * by a wallet transaction with confirmations, ordered by outpoint so that the
+     * outputs of one transaction are adjacent. It only narrows the candidates;
+     * spent, trust and maturity checks still run when the coins are used.
+     * Transactions touched since the last query are queued in setCoinIndexDirty
+     * and re-evaluated lazily with cs_main held.
+     */
+    typedef std::map<COutPoint, isminetype> CoinIndex;
+    mutable CoinIndex mapWalletCoins;
+    mutable std::set<uint256> setCoinIndexDirty;
+    mutable bool fCoinIndexValid;
+    mutable size_t nCoinIndexKeyGeneration;
+
+    /**
+     * Running balances: the total of what each transaction owning indexed coins
+     * contributes, kept in mapTxBalances. A transaction is re-evaluated when it
+     * or one of its spenders changes (setBalancesDirty). Those whose contribution
+     * also depends on the tip, the mempool, SwiftTX locks or the clock (unconfirmed,
+     * shallow, immature or non-final ones) are in mapBalancesVolatile and are
+     * re-evaluated when one of those changes; everything else is left alone.
+     */
+    mutable CWalletBalances balancesTotal;
+    mutable std::map<uint256, CWalletBalances> mapTxBalances;
+    //! Volatile transactions, mapped to whether they are non-final and so depend on the clock
+    mutable std::map<uint256, bool> mapBalancesVolatile;
+    mutable unsigned int nBalancesNonFinal;
+    mutable std::set<uint256> setBalancesDirty;
+    mutable bool fBalancesValid;
+    mutable const CBlockIndex* pindexBalancesTip;
+    mutable unsigned int nBalancesMempoolUpdated;
+    mutable uint64_t nBalancesLockEpoch;
+
+    void MarkCoinIndexDirty(const CWalletTx& wtx);
+    void UpdateCoinIndex() const;
+    void UpdateCoinIndexTx(const CWalletTx& wtx) const;
+    bool IsSpentInChain(const COutPoint& outpoint) const;
+    static CoinIndex::const_iterator NextCoinIndexTx(const CoinIndex& index, CoinIndex::const_iterator it);
+    void UpdateTxBalances(const uint256& hash) const;
+    const CWalletBalances& GetBalances() const;
     /* HD derive new child key (on internal or external chain) */
     void DeriveNewChildKey(const CKeyMetadata& metadata, CKey& secretRet, uint32_t nAccountIndex, bool fInternal /*= false*/);
 
@@ -334,6 +500,16 @@ public:
         //Auto Combine Dust
         fCombineDust = false;
         nAutoCombineThreshold = 0;
+
+        fAbortRescan = false;
+
+        fCoinIndexValid = false;
+        nCoinIndexKeyGeneration = 0;
+        fBalancesValid = false;
+        nBalancesNonFinal = 0;
+        pindexBalancesTip = NULL;
+        nBalancesMempoolUpdated = 0;
+        nBalancesLockEpoch = 0;
     }
 
     bool isMultiSendEnabled()
@@ -491,9 +667,18 @@ public:
     void MarkDirty();
     bool AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet = false);
     void SyncTransaction(const CTransaction& tx, const CBlock* pblock);
+    void SyncTransactions(const std::vector<CTransaction>& vtx, const CBlock* pblock);
     bool AddToWalletIfInvolvingMe(const CTransaction& tx, const CBlock* pblock, bool fUpdate);
     void EraseFromWallet(const uint256& hash);
-    int ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate = false);
+    //! Returns the number of transactions found, or WALLET_RESCAN_BUSY if preserver does not
+    //! hold the reservation and another rescan does
+    int ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate = false, const CWalletRescanReserver* preserver = NULL);
+    //! Snapshot the keystore into filter, returning its generation
+    size_t GetScanFilter(CWalletScanFilter& filter) const;
+    //! Ask a running ScanForWalletTransactions to stop after its current batch
+    void AbortRescan();
+    bool IsScanning() const;
+    CWalletRescanStatus GetRescanStatus() const;
     void ReacceptWalletTransactions();
     void ResendWalletTransactions();
     CAmount GetBalance() const;
@@ -707,6 +892,27 @@ public:
 
 
 /** A key allocated from the key pool. */
+/**
+ * Reserves the rescan of a wallet while in scope. Callers that change the wallet
+ * before rescanning take it first, so they fail before the change rather than
+ * finding another rescan running afterwards.
+ */
+class CWalletRescanReserver
+{
+private:
+    CWallet* pwallet;
+    bool fReserved;
+
+public:
+    explicit CWalletRescanReserver(CWallet* pwalletIn) : pwallet(pwalletIn), fReserved(false) {}
+    ~CWalletRescanReserver();
+
+    //! False if another rescan is running or reserved
+    bool Reserve();
+    bool IsReserved() const { return fReserved; }
+    const CWallet* GetWallet() const { return pwallet; }
+};
+
 class CReserveKey
 {
 protected:
@@ -8,6 +8,7 @@
 #include "wallet/walletdb.h"
 
 #include "base58.h"
+#include "checkqueue.h"
 #include "consensus/validation.h"
 #include "protocol.h"
 #include "serialize.h"
@@ -18,6 +19,7 @@
 #include "utiltime.h"
 #include "wallet/wallet.h"
 
+#include <boost/bind.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/foreach.hpp>
 #include <boost/scoped_ptr.hpp>
@@ -419,6 +421,106 @@ public:
     }
 };
 
+/**
+ * Deserialize and check a "tx" record. Touches no wallet state, so it
+ * can run on the wallet load helper threads.
+ */
+static bool DecodeWalletTx(CDataStream& ssKey, CDataStream& ssValue, bool fSegWitActive, uint256& hash, CWalletTx& wtx, bool& fUpgraded, string& strErr)
+{
+    ssKey >> hash;
+    ssValue >> wtx;
+    CValidationState state;
+    if (!(CheckTransaction(wtx, false, state, fSegWitActive) && (wtx.GetHash() == hash) && state.IsValid()))
+        return false;
+
+    // Undo serialize changes in 31600
+    fUpgraded = false;
+    if (31404 <= wtx.fTimeReceivedIsTxTime && wtx.fTimeReceivedIsTxTime <= 31703) {
+        if (!ssValue.empty()) {
+            char fTmp;
+            char fUnused;
+            ssValue >> fTmp >> fUnused >> wtx.strFromAccount;
+            strErr = strprintf("LoadWallet() upgrading tx ver=%d %d '%s' %s",
+                wtx.fTimeReceivedIsTxTime, fTmp, wtx.strFromAccount, hash.ToString());
+            wtx.fTimeReceivedIsTxTime = fTmp;
+        } else {
+            strErr = strprintf("LoadWallet() repairing tx ver=%d %s", wtx.fTimeReceivedIsTxTime, hash.ToString());
+            wtx.fTimeReceivedIsTxTime = 0;
+        }
+        fUpgraded = true;
+    }
+    return true;
+}
+
+static void LoadWalletTx(CWallet* pwallet, const uint256& hash, const CWalletTx& wtx, bool fUpgraded, CWalletScanState& wss)
+{
+    if (fUpgraded)
+        wss.vWalletUpgrade.push_back(hash);
+
+    if (wtx.nOrderPos == -1)
+        wss.fAnyUnordered = true;
+
+    // Credit/debit caches and merkle branch checks are filled in on first use
+    pwallet->AddToWallet(wtx, true);
+}
+
+/**
+ * Deserialize a "key" or "wkey" record and verify that the private key
+ * matches its public key. Touches no wallet state, so it can run on the
+ * wallet load helper threads.
+ */
+static bool DecodeWalletKey(const string& strType, CDataStream& ssKey, CDataStream& ssValue, CPubKey& vchPubKey, CKey& key, string& strErr)
+{
+    ssKey >> vchPubKey;
+    if (!vchPubKey.IsValid()) {
+        strErr = "Error reading wallet database: CPubKey corrupt";
+        return false;
+    }
+    CPrivKey pkey;
+    uint256 hash = 0;
+
+    if (strType == "key") {
+        ssValue >> pkey;
+    } else {
+        CWalletKey wkey;
+        ssValue >> wkey;
+        pkey = wkey.vchPrivKey;
+    }
+
+    // Old wallets store keys as "key" [pubkey] => [privkey]
+    // ... which was slow for wallets with lots of keys, because the public key is re-derived from the private key
+    // using EC operations as a checksum.
+    // Newer wallets store keys as "key"[pubkey] => [privkey][hash(pubkey,privkey)], which is much faster while
+    // remaining backwards-compatible.
+    try {
+        ssValue >> hash;
+    } catch (...) {
+    }
+
+    bool fSkipCheck = false;
+
+    if (hash != 0) {
+        // hash pubkey/privkey to accelerate wallet load
+        std::vector<unsigned char> vchKey;
+        vchKey.reserve(vchPubKey.size() + pkey.size());
+        vchKey.insert(vchKey.end(), vchPubKey.begin(), vchPubKey.end());
+        vchKey.insert(vchKey.end(), pkey.begin(), pkey.end());
+
+        if (Hash(vchKey.begin(), vchKey.end()) != hash) {
+            strErr = "Error reading wallet database: CPubKey/CPrivKey corrupt";
+            return false;
+        }
+
+        fSkipCheck = true;
+    }
+
+    if (!key.Load(pkey, vchPubKey, fSkipCheck)) {
+        strErr = "Error reading wallet database: CPrivKey corrupt";
+        return false;
+    }
+    return true;
+}
+
 bool ReadKeyValue(CWallet* pwallet, CDataStream& ssKey, CDataStream& ssValue, CWalletScanState& wss, string& strType, string& strErr)
 {
     try {
@@ -436,33 +538,11 @@ bool ReadKeyValue(CWallet* pwallet, CDataStream& ssKey, CDataStream& ssValue, CW
             ssValue >> pwallet->mapAddressBook[DecodeDestination(strAddress)].purpose;
         } else if (strType == "tx") {
             uint256 hash;
-            ssKey >> hash;
             CWalletTx wtx;
-            ssValue >> wtx;
-            CValidationState state;
-            if (!(CheckTransaction(wtx, false, state, IsSporkActive(SPORK_13_SEGWIT_ACTIVATION)) && (wtx.GetHash() == hash) && state.IsValid()))
+            bool fUpgraded = false;
+            if (!DecodeWalletTx(ssKey, ssValue, IsSporkActive(SPORK_13_SEGWIT_ACTIVATION), hash, wtx, fUpgraded, strErr))
                 return false;
-
-            // Undo serialize changes in 31600
-            if (31404 <= wtx.fTimeReceivedIsTxTime && wtx.fTimeReceivedIsTxTime <= 31703) {
-                if (!ssValue.empty()) {
-                    char fTmp;
-                    char fUnused;
-                    ssValue >> fTmp >> fUnused >> wtx.strFromAccount;
-                    strErr = strprintf("LoadWallet() upgrading tx ver=%d %d '%s' %s",
-                        wtx.fTimeReceivedIsTxTime, fTmp, wtx.strFromAccount, hash.ToString());
-                    wtx.fTimeReceivedIsTxTime = fTmp;
-                } else {
-                    strErr = strprintf("LoadWallet() repairing tx ver=%d %s", wtx.fTimeReceivedIsTxTime, hash.ToString());
-                    wtx.fTimeReceivedIsTxTime = 0;
-                }
-                wss.vWalletUpgrade.push_back(hash);
-            }
-
-            if (wtx.nOrderPos == -1)
-                wss.fAnyUnordered = true;
-
-            pwallet->AddToWallet(wtx, true);
+            LoadWalletTx(pwallet, hash, wtx, fUpgraded, wss);
         } else if (strType == "acentry") {
             string strAccount;
             ssKey >> strAccount;
@@ -500,56 +580,12 @@ bool ReadKeyValue(CWallet* pwallet, CDataStream& ssKey, CDataStream& ssValue, CW
             // so set the wallet birthday to the beginning of time.
             pwallet->nTimeFirstKey = 1;
         } else if (strType == "key" || strType == "wkey") {
+            if (strType == "key")
+                wss.nKeys++;
             CPubKey vchPubKey;
-            ssKey >> vchPubKey;
-            if (!vchPubKey.IsValid()) {
-                strErr = "Error reading wallet database: CPubKey corrupt";
-                return false;
-            }
             CKey key;
-            CPrivKey pkey;
-            uint256 hash = 0;
-
-            if (strType == "key") {
-                wss.nKeys++;
-                ssValue >> pkey;
-            } else {
-                CWalletKey wkey;
-                ssValue >> wkey;
-                pkey = wkey.vchPrivKey;
-            }
-
-            // Old wallets store keys as "key" [pubkey] => [privkey]
-            // ... which was slow for wallets with lots of keys, because the public key is re-derived from the private key
-            // using EC operations as a checksum.
-            // Newer wallets store keys as "key"[pubkey] => [privkey][hash(pubkey,privkey)], which is much faster while
-            // remaining backwards-compatible.
-            try {
-                ssValue >> hash;
-            } catch (...) {
-            }
-
-            bool fSkipCheck = false;
-
-            if (hash != 0) {
-                // hash pubkey/privkey to accelerate wallet load
-                std::vector<unsigned char> vchKey;
-                vchKey.reserve(vchPubKey.size() + pkey.size());
-                vchKey.insert(vchKey.end(), vchPubKey.begin(), vchPubKey.end());
-                vchKey.insert(vchKey.end(), pkey.begin(), pkey.end());
-
-                if (Hash(vchKey.begin(), vchKey.end()) != hash) {
-                    strErr = "Error reading wallet database: CPubKey/CPrivKey corrupt";
-                    return false;
-                }
-
-                fSkipCheck = true;
-            }
-
-            if (!key.Load(pkey, vchPubKey, fSkipCheck)) {
-                strErr = "Error reading wallet database: CPrivKey corrupt";
+            if (!DecodeWalletKey(strType, ssKey, ssValue, vchPubKey, key, strErr))
                 return false;
-            }
             if (!pwallet->LoadKey(key, vchPubKey)) {
                 strErr = "Error reading wallet database: LoadKey failed";
                 return false;
@@ -704,12 +740,109 @@ static bool IsKeyType(string strType)
             strType == "hdchain" || strType == "chdchain");
 }
 
+/** Number of wallet records read from the cursor and decoded per batch */
+static const unsigned int WALLET_LOAD_BATCH = 4096;
+
+/** A raw wallet record and, for transactions and plaintext keys, the result of decoding it on a worker thread */
+struct CWalletRecord {
+    CDataStream ssKey;
+    CDataStream ssValue;
+    std::string strType;
+    //! Decoded by CWalletLoadCheck; otherwise left for ReadKeyValue
+    bool fDecoded;
+    bool fValid;
+    std::string strErr;
+
+    uint256 hash;
+    CWalletTx wtx;
+    bool fUpgraded;
+    CPubKey vchPubKey;
+    CKey key;
+
+    CWalletRecord() : ssKey(SER_DISK, CLIENT_VERSION), ssValue(SER_DISK, CLIENT_VERSION), fDecoded(false), fValid(false), fUpgraded(false) {}
+};
+
+/**
+ * Closure representing the decoding of one wallet record: deserialization and
+ * CheckTransaction for transactions, deserialization and the pubkey/privkey
+ * consistency check for plaintext keys. Other record types are cheap and are
+ * handed back to ReadKeyValue untouched.
+ */
+class CWalletLoadCheck
+{
+private:
+    CWalletRecord* precord;
+    bool fSegWitActive;
+
+public:
+    CWalletLoadCheck() : precord(NULL), fSegWitActive(false) {}
+    CWalletLoadCheck(CWalletRecord* precordIn, bool fSegWitActiveIn) : precord(precordIn), fSegWitActive(fSegWitActiveIn) {}
+
+    bool operator()()
+    {
+        CWalletRecord& record = *precord;
+        try {
+            // Peek at the type on a copy, ReadKeyValue wants the key stream intact
+            CDataStream ssKey(record.ssKey);
+            ssKey >> record.strType;
+            if (record.strType == "tx") {
+                record.fDecoded = true;
+                record.wtx = CWalletTx();
+                record.fValid = DecodeWalletTx(ssKey, record.ssValue, fSegWitActive, record.hash, record.wtx, record.fUpgraded, record.strErr);
+            } else if (record.strType == "key" || record.strType == "wkey") {
+                record.fDecoded = true;
+                record.fValid = DecodeWalletKey(record.strType, ssKey, record.ssValue, record.vchPubKey, record.key, record.strErr);
+            }
+        } catch (...) {
+            record.fValid = false;
+        }
+        // Bad records are reported by the loading thread, never abort the batch
+        return true;
+    }
+
+    void swap(CWalletLoadCheck& check)
+    {
+        std::swap(precord, check.precord);
+        std::swap(fSegWitActive, check.fSegWitActive);
+    }
+};
+
+static void ThreadLoadWallet(CCheckQueue<CWalletLoadCheck>* pqueue)
+{
+    RenameThread("trbo-loadwallet");
+    pqueue->Thread();
+}
+
 DBErrors CWalletDB::LoadWallet(CWallet* pwallet)
+{
+    // Decode on the master plus the same number of helpers as -par allows for script checks
+    CCheckQueue<CWalletLoadCheck> queue(128);
+    boost::thread_group threadGroup;
+    for (int i = 0; i < nScriptCheckThreads - 1; i++)
+        threadGroup.create_thread(boost::bind(&ThreadLoadWallet, &queue));
+
+    DBErrors result;
+    try {
+        result = LoadWalletRecords(pwallet, queue);
+    } catch (...) {
+        threadGroup.interrupt_all();
+        threadGroup.join_all();
+        throw;
+    }
+    threadGroup.interrupt_all();
+    threadGroup.join_all();
+    return result;
+}
+
+DBErrors CWalletDB::LoadWalletRecords(CWallet* pwallet, CCheckQueue<CWalletLoadCheck>& queue)
 {
     pwallet->vchDefaultKey = CPubKey();
     CWalletScanState wss;
     bool fNoncriticalErrors = false;
     DBErrors result = DB_LOAD_OK;
+    int64_t nTimeStart = GetTimeMicros();
+    int64_t nTimeRead = 0, nTimeDecode = 0, nTimeApply = 0;
+    unsigned int nRecords = 0;
 
     try {
         LOCK(pwallet->cs_wallet);
@@ -727,35 +860,87 @@ DBErrors CWalletDB::LoadWallet(CWallet* pwallet)
             return DB_CORRUPT;
         }
 
-        while (true) {
-            // Read next record
-            CDataStream ssKey(SER_DISK, nSerVersion);
-            CDataStream ssValue(SER_DISK, nSerVersion);
-            int ret = ReadAtCursor(pcursor, ssKey, ssValue);
-            if (ret == DB_NOTFOUND)
-                break;
-            else if (ret != 0) {
-                LogPrintf("Error reading next record from wallet database\n");
-                return DB_CORRUPT;
+        bool fSegWitActive = IsSporkActive(SPORK_13_SEGWIT_ACTIVATION);
+        std::vector<CWalletRecord> vRecords(WALLET_LOAD_BATCH);
+        std::vector<CWalletLoadCheck> vChecks;
+        vChecks.reserve(WALLET_LOAD_BATCH);
+        bool fDone = false;
+        while (!fDone) {
+            // Read a batch of raw records
+            int64_t nTime0 = GetTimeMicros();
+            unsigned int nBatch = 0;
+            while (nBatch < vRecords.size()) {
+                CWalletRecord& record = vRecords[nBatch];
+                int ret = ReadAtCursor(pcursor, record.ssKey, record.ssValue);
+                if (ret == DB_NOTFOUND) {
+                    fDone = true;
+                    break;
+                } else if (ret != 0) {
+                    LogPrintf("Error reading next record from wallet database\n");
+                    return DB_CORRUPT;
+                }
+                record.strType.clear();
+                record.fDecoded = false;
+                record.fValid = false;
+                record.strErr.clear();
+                nBatch++;
             }
 
-            // Try to be tolerant of single corrupt records:
-            string strType, strErr;
-            if (!ReadKeyValue(pwallet, ssKey, ssValue, wss, strType, strErr)) {
-                // losing keys is considered a catastrophic error, anything else
-                // we assume the user can live with:
-                if (IsKeyType(strType))
-                    result = DB_CORRUPT;
-                else {
-                    // Leave other errors alone, if we try to fix them we might make things worse.
-                    fNoncriticalErrors = true; // ... but do warn the user there is something wrong.
-                    if (strType == "tx")
-                        // Rescan if there is a bad transaction record:
-                        SoftSetBoolArg("-rescan", true);
+            // Decode transactions and verify keys in parallel
+            int64_t nTime1 = GetTimeMicros();
+            nTimeRead += nTime1 - nTime0;
+            {
+                CCheckQueueControl<CWalletLoadCheck> control(&queue);
+                for (unsigned int i = 0; i < nBatch; i++)
+                    vChecks.push_back(CWalletLoadCheck(&vRecords[i], fSegWitActive));
+                control.Add(vChecks);
+                vChecks.clear();
+                control.Wait();
+            }
+
+            // Load the records into the wallet in cursor order
+            int64_t nTime2 = GetTimeMicros();
+            nTimeDecode += nTime2 - nTime1;
+            for (unsigned int i = 0; i < nBatch; i++) {
+                CWalletRecord& record = vRecords[i];
+
+                // Try to be tolerant of single corrupt records:
+                string strType, strErr;
+                bool fOk;
+                if (record.fDecoded) {
+                    strType = record.strType;
+                    strErr = record.strErr;
+                    if (strType == "key")
+                        wss.nKeys++;
+                    fOk = record.fValid;
+                    if (fOk && strType == "tx") {
+                        LoadWalletTx(pwallet, record.hash, record.wtx, record.fUpgraded, wss);
+                    } else if (fOk && !pwallet->LoadKey(record.key, record.vchPubKey)) {
+                        strErr = "Error reading wallet database: LoadKey failed";
+                        fOk = false;
+                    }
+                    record.key = CKey();
+                } else {
+                    fOk = ReadKeyValue(pwallet, record.ssKey, record.ssValue, wss, strType, strErr);
                 }
+                if (!fOk) {
+                    // losing keys is considered a catastrophic error, anything else
+                    // we assume the user can live with:
+                    if (IsKeyType(strType))
+                        result = DB_CORRUPT;
+                    else {
+                        // Leave other errors alone, if we try to fix them we might make things worse.
+                        fNoncriticalErrors = true; // ... but do warn the user there is something wrong.
+                        if (strType == "tx")
+                            // Rescan if there is a bad transaction record:
+                            SoftSetBoolArg("-rescan", true);
+                    }
+                }
+                if (!strErr.empty())
+                    LogPrintf("%s\n", strErr);
             }
-            if (!strErr.empty())
-                LogPrintf("%s\n", strErr);
+            nTimeApply += GetTimeMicros() - nTime2;
+            nRecords += nBatch;
         }
         pcursor->close();
     } catch (boost::thread_interrupted) {
@@ -781,12 +966,19 @@ DBErrors CWalletDB::LoadWallet(CWallet* pwallet)
     if ((wss.nKeys + wss.nCKeys) != wss.nKeyMeta)
         pwallet->nTimeFirstKey = 1; // 0 would be considered 'no value'
 
+    // Rewrite upgraded and reordered records in one transaction
+    int64_t nTimeFinish = GetTimeMicros();
+    bool fTxn = (!wss.vWalletUpgrade.empty() || wss.fAnyUnordered) && TxnBegin();
+
     BOOST_FOREACH (uint256 hash, wss.vWalletUpgrade)
         WriteTx(hash, pwallet->mapWallet[hash]);
 
     // Rewrite encrypted wallets of versions 0.4.0 and 0.5.0rc:
-    if (wss.fIsEncrypted && (wss.nFileVersion == 9533 || wss.nFileVersion == 50000))
+    if (wss.fIsEncrypted && (wss.nFileVersion == 9533 || wss.nFileVersion == 50000)) {
+        if (fTxn)
+            TxnCommit();
         return DB_NEED_REWRITE;
+    }
 
     if (wss.nFileVersion < CLIENT_VERSION) // Update
         WriteVersion(CLIENT_VERSION);
@@ -794,12 +986,19 @@ DBErrors CWalletDB::LoadWallet(CWallet* pwallet)
     if (wss.fAnyUnordered)
         result = ReorderTransactions(pwallet);
 
+    if (fTxn && !TxnCommit())
+        LogPrintf("%s: failed to commit rewritten wallet records\n", __func__);
+
     pwallet->laccentries.clear();
     ListAccountCreditDebit("*", pwallet->laccentries);
     BOOST_FOREACH(CAccountingEntry& entry, pwallet->laccentries) {
         pwallet->wtxOrdered.insert(make_pair(entry.nOrderPos, CWallet::TxPair((CWalletTx*)0, &entry)));
     }
 
+    LogPrintf("%s: loaded %u records in %.2fms (read %.2fms, decode %.2fms on %d threads, load %.2fms, finish %.2fms)\n", __func__,
+        nRecords, 0.001 * (GetTimeMicros() - nTimeStart), 0.001 * nTimeRead, 0.001 * nTimeDecode, std::max(nScriptCheckThreads, 1),
+        0.001 * nTimeApply, 0.001 * (GetTimeMicros() - nTimeFinish));
+
     return result;
 }
 
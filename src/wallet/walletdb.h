@@ -21,6 +21,9 @@
 #include <utility>
 #include <vector>
 
+template <typename T>
+class CCheckQueue;
+
 class CAccount;
 class CAccountingEntry;
 struct CBlockLocator;
@@ -28,6 +31,7 @@ class CKeyPool;
 class CMasterKey;
 class CScript;
 class CWallet;
+class CWalletLoadCheck;
 class CWalletTx;
 class uint160;
 class uint256;
@@ -159,6 +163,7 @@ private:
     void operator=(const CWalletDB&);
 
     bool WriteAccountingEntry(const uint64_t nAccEntryNum, const CAccountingEntry& acentry);
+    DBErrors LoadWalletRecords(CWallet* pwallet, CCheckQueue<CWalletLoadCheck>& queue);
 };
 
 void NotifyBacked(const CWallet& wallet, bool fSuccess, string strMessage);
@@ -0,0 +1,98 @@
+#!/usr/bin/env python3
+# Copyright (c) 2019 The TRBO developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test the /rest/blocks/ and /rest/blockundos/ range endpoints.
+
+Blocks and undo data come back as records prefixed with their size, a range
+is cut at the end of the chain, and a block or undo file missing from disk
+turns into an error instead of a short reply."""
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import *
+import http.client
+import os
+import struct
+import urllib.parse
+
+def http_get(url, path):
+    conn = http.client.HTTPConnection(url.hostname, url.port)
+    conn.request('GET', path)
+    return conn.getresponse()
+
+def split_records(data):
+    records = []
+    while data:
+        assert(len(data) >= 4)
+        size = struct.unpack("<I", data[:4])[0]
+        assert(len(data) >= 4 + size)
+        records.append(data[4:4 + size])
+        data = data[4 + size:]
+    return records
+
+class RESTBlockRangeTest(BitcoinTestFramework):
+
+    def __init__(self):
+        super().__init__()
+        self.num_nodes = 1
+        self.setup_clean_chain = True
+
+    def setup_network(self, split=False):
+        self.nodes = start_nodes(self.num_nodes, self.options.tmpdir)
+        self.is_network_split = False
+
+    def run_test(self):
+        url = urllib.parse.urlparse(rpc_url(0))
+        node = self.nodes[0]
+        node.setgenerate(True, 20)
+        hashes = [node.getblockhash(height) for height in range(21)]
+
+        # Every block of the range, as stored and as getblock returns it
+        response = http_get(url, "/rest/blocks/0/21.bin")
+        assert_equal(response.status, 200)
+        blocks = split_records(response.read())
+        assert_equal(len(blocks), 21)
+        for height in range(21):
+            assert_equal(bytes_to_hex_str(blocks[height]), node.getblock(hashes[height], False))
+
+        response = http_get(url, "/rest/blocks/5/3.hex")
+        assert_equal(response.status, 200)
+        records = split_records(hex_str_to_bytes(response.read().decode('ascii').strip()))
+        assert_equal(records, blocks[5:8])
+
+        # The range stops at the tip
+        response = http_get(url, "/rest/blocks/18/10.bin")
+        assert_equal(response.status, 200)
+        assert_equal(split_records(response.read()), blocks[18:])
+
+        # The genesis block has no undo data, the others have a record each
+        response = http_get(url, "/rest/blockundos/0/21.bin")
+        assert_equal(response.status, 200)
+        undos = split_records(response.read())
+        assert_equal(len(undos), 21)
+        assert_equal(undos[0], b'')
+
+        # Out of range requests
+        assert_equal(http_get(url, "/rest/blocks/21/1.bin").status, 404)
+        assert_equal(http_get(url, "/rest/blocks/0/0.bin").status, 400)
+        assert_equal(http_get(url, "/rest/blocks/0/10001.bin").status, 400)
+        assert_equal(http_get(url, "/rest/blocks/0.bin").status, 400)
+
+        # A missing block or undo file is an error, not an empty or short reply
+        blocksdir = os.path.join(self.options.tmpdir, "node0", "regtest", "blocks")
+        for name, path in (("blk00000.dat", "/rest/blocks/0/21.bin"), ("rev00000.dat", "/rest/blockundos/0/21.bin")):
+            os.rename(os.path.join(blocksdir, name), os.path.join(blocksdir, name + ".moved"))
+            try:
+                response = http_get(url, path)
+                assert_equal(response.status, 500)
+                response.read()
+            finally:
+                os.rename(os.path.join(blocksdir, name + ".moved"), os.path.join(blocksdir, name))
+
+        # The files are back
+        response = http_get(url, "/rest/blocks/0/21.bin")
+        assert_equal(response.status, 200)
+        assert_equal(split_records(response.read()), blocks)
+
+if __name__ == '__main__':
+    RESTBlockRangeTest().main()
@@ -54,6 +54,7 @@ BASE_SCRIPTS= [
     'wallet.py',
     'wallet_hd.py',
     'decodetx.py',
+    'interface_rest_blocks.py',
     'listtransaction.py',
     'segwit.py',
     'test_case_base.py',